@@ -0,0 +1,524 @@
+#include <benchmark/benchmark.h>
+
+#include <ClassFile/ClassFile.hpp>
+#include <ClassFile/Misc.hpp>
+#include <ClassFile/Parser.hpp>
+#include <ClassFile/Serializer.hpp>
+
+#include <atomic>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+#ifndef RES_DIR
+  #define RES_DIR "res"
+#endif
+
+//Every allocation of the process is counted so that the benchmarks can report
+//allocations per iteration next to their timings
+static std::atomic<size_t> allocations{0};
+
+void* operator new(size_t size)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+
+  if(void* p = std::malloc(size == 0 ? 1 : size))
+    return p;
+
+  throw std::bad_alloc{};
+}
+
+//GCC can't tell that the replacement new above is malloc based
+#if defined(__GNUC__) && !defined(__clang__)
+  #pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+  std::free(p);
+}
+
+namespace
+{
+
+using namespace ClassFile;
+
+//Reports the allocations made since construction as a per iteration average
+class allocationCounter
+{
+  public:
+    allocationCounter() : m_start{allocations.load(std::memory_order_relaxed)} {}
+
+    void Report(benchmark::State& state) const
+    {
+      size_t n = allocations.load(std::memory_order_relaxed) - m_start;
+      state.counters["allocs"] = benchmark::Counter(static_cast<double>(n),
+          benchmark::Counter::kAvgIterations);
+    }
+
+  private:
+    size_t m_start;
+};
+
+//Discards what the library writes to std::cerr while in scope, such as the
+//warning for every raw attribute of a parsed class, so timed loops don't
+//measure console output
+class quietStderr
+{
+  public:
+    quietStderr() : m_saved{std::cerr.rdbuf(&m_null)} {}
+    ~quietStderr() { std::cerr.rdbuf(m_saved); }
+
+    quietStderr(const quietStderr&) = delete;
+    quietStderr& operator=(const quietStderr&) = delete;
+
+  private:
+    struct nullBuf : public std::streambuf
+    {
+      int overflow(int c) override { return traits_type::not_eof(c); }
+    };
+
+    nullBuf m_null;
+    std::streambuf* m_saved;
+};
+
+enum shape : int64_t
+{
+  Small,        //HelloWorld: a couple of methods, a tiny pool
+  Typical,      //Complex: obfuscated compiler output with frames
+  Pathological, //thousands of methods & a pool near its size limit
+};
+
+static const char* shapeNames[] = {"small", "typical", "pathological"};
+
+static std::string readFile(const char* path)
+{
+  std::ifstream file{path, std::ios::binary};
+  std::stringstream ss;
+  ss << file.rdbuf();
+  return ss.str();
+}
+
+static ClassFile::ClassFile parse(const std::string& bytes)
+{
+  std::istringstream stream{bytes};
+  auto errOrClass = [&]
+  {
+    quietStderr quiet;
+    return Parser::ParseClassFile(stream);
+  }();
+
+  if(errOrClass.IsError())
+  {
+    std::cerr << errOrClass.GetError().What << '\n';
+    std::abort();
+  }
+
+  return errOrClass.Release();
+}
+
+static std::string serialize(const ClassFile::ClassFile& cf)
+{
+  std::ostringstream stream;
+
+  if(Serializer::SerializeClassFile(stream, cf).IsError())
+    std::abort();
+
+  return stream.str();
+}
+
+static Instruction makeInstruction(OpCode op, std::initializer_list<S32> operands = {})
+{
+  Instruction instr = Instruction::MakeInstruction(op).Release();
+
+  size_t i = 0;
+  for(S32 operand : operands)
+    (void)instr.SetOperand(i++, operand);
+
+  return instr;
+}
+
+//HelloWorld grown to 4000 methods with long descriptors, each calling 16
+//others & loading a few strings, which takes the pool to ~40000 entries
+static std::string makePathological()
+{
+  ClassFile::ClassFile cf = parse(readFile(RES_DIR "/HelloWorld.class"));
+  ConstantPool& cp = cf.ConstPool;
+
+  static constexpr int methodCount = 4000;
+  const std::string descriptor = "(IJLjava/lang/String;[[DLjava/util/Map;ZBSC[Ljava/lang/Object;)V";
+  const std::string className{cp.LookupString(cf.ThisClass).Get()};
+
+  std::vector<U16> methodrefs;
+  for(int i = 0; i < methodCount; i++)
+    methodrefs.push_back(cp.FindOrAddMethodref(className, "m" + std::to_string(i), descriptor).Get());
+
+  U16 codeName = cp.FindOrAddUTF8("Code").Get();
+  U16 descriptorIndex = cp.FindOrAddUTF8(descriptor).Get();
+
+  for(int i = 0; i < methodCount; i++)
+  {
+    FieldMethodInfo method;
+    method.AccessFlags = static_cast<U16>(FieldMethodInfo::AccessFlag::STATIC);
+    method.NameIndex = cp.FindOrAddUTF8("m" + std::to_string(i)).Get();
+    method.DescriptorIndex = descriptorIndex;
+
+    auto code = std::make_unique<CodeAttribute>();
+    code->NameIndex = codeName;
+    code->MaxStack = 12;
+    code->MaxLocals = 13;
+
+    for(int call = 0; call < 16; call++)
+    {
+      U16 string = cp.FindOrAddString("s" + std::to_string((i * 16 + call) % 5000)).Get();
+      code->Code.push_back(makeInstruction(LDC_W, {string}));
+      code->Code.push_back(makeInstruction(POP));
+      code->Code.push_back(makeInstruction(ILOAD_0));
+      code->Code.push_back(makeInstruction(LLOAD_1));
+      code->Code.push_back(makeInstruction(ALOAD_3));
+      code->Code.push_back(makeInstruction(ALOAD, {4}));
+      code->Code.push_back(makeInstruction(ALOAD, {5}));
+      code->Code.push_back(makeInstruction(ILOAD, {6}));
+      code->Code.push_back(makeInstruction(ILOAD, {7}));
+      code->Code.push_back(makeInstruction(ILOAD, {8}));
+      code->Code.push_back(makeInstruction(ILOAD, {9}));
+      code->Code.push_back(makeInstruction(ALOAD, {10}));
+      code->Code.push_back(makeInstruction(INVOKESTATIC, {methodrefs[(i + call * 131) % methodCount]}));
+    }
+
+    code->Code.push_back(makeInstruction(RETURN));
+    method.Attributes.push_back(std::move(code));
+    cf.Methods.push_back(std::move(method));
+  }
+
+  return serialize(cf);
+}
+
+static const std::string& getShapeBytes(int64_t s)
+{
+  static const std::string shapes[] =
+  {
+    readFile(RES_DIR "/HelloWorld.class"),
+    readFile(RES_DIR "/Complex.class"),
+    makePathological(),
+  };
+
+  return shapes[s];
+}
+
+static const ClassFile::ClassFile& getShape(int64_t s)
+{
+  static const ClassFile::ClassFile shapes[] =
+  {
+    parse(getShapeBytes(Small)),
+    parse(getShapeBytes(Typical)),
+    parse(getShapeBytes(Pathological)),
+  };
+
+  return shapes[s];
+}
+
+static void ParseClassFile(benchmark::State& state)
+{
+  const std::string& bytes = getShapeBytes(state.range(0));
+  std::istringstream stream{bytes};
+  allocationCounter counter;
+  quietStderr quiet;
+
+  for(auto _ : state)
+  {
+    stream.clear();
+    stream.seekg(0);
+    auto errOrClass = Parser::ParseClassFile(stream);
+    benchmark::DoNotOptimize(errOrClass);
+  }
+
+  counter.Report(state);
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes.size()));
+  state.SetLabel(shapeNames[state.range(0)]);
+}
+
+static void ParseConstantPool(benchmark::State& state)
+{
+  const std::string& bytes = getShapeBytes(state.range(0));
+  std::istringstream stream{bytes};
+  size_t poolBytes = 0;
+
+  //the pool starts after magic, minor & major version
+  stream.seekg(8);
+  Parser::ParseConstantPool(stream);
+  poolBytes = static_cast<size_t>(stream.tellg()) - 8;
+
+  allocationCounter counter;
+
+  for(auto _ : state)
+  {
+    stream.clear();
+    stream.seekg(8);
+    auto errOrPool = Parser::ParseConstantPool(stream);
+    benchmark::DoNotOptimize(errOrPool);
+  }
+
+  counter.Report(state);
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * poolBytes));
+  state.SetLabel(shapeNames[state.range(0)]);
+}
+
+static void ParseInstruction(benchmark::State& state)
+{
+  //the code of every method, serialized on its own so that switch padding
+  //stays relative to the start of the code
+  std::vector<std::string> codes;
+  size_t totalBytes = 0;
+
+  for(const FieldMethodInfo& method : getShape(state.range(0)).Methods)
+  {
+    for(const auto& attr : method.Attributes)
+    {
+      if(attr->GetType() != AttributeInfo::Type::Code)
+        continue;
+
+      std::ostringstream stream;
+      for(const Instruction& instr : static_cast<const CodeAttribute&>(*attr).Code)
+        (void)Serializer::SerializeInstruction(stream, instr);
+
+      codes.push_back(stream.str());
+      totalBytes += codes.back().size();
+    }
+  }
+
+  std::vector<std::istringstream> streams;
+  for(const std::string& code : codes)
+    streams.emplace_back(code);
+
+  allocationCounter counter;
+  quietStderr quiet;
+
+  for(auto _ : state)
+  {
+    for(size_t i = 0; i < streams.size(); i++)
+    {
+      std::istringstream& stream = streams[i];
+      stream.clear();
+      stream.seekg(0);
+
+      while(static_cast<size_t>(stream.tellg()) < codes[i].size())
+      {
+        auto errOrInstr = Parser::ParseInstruction(stream);
+        benchmark::DoNotOptimize(errOrInstr);
+
+        if(errOrInstr.IsError())
+          break;
+      }
+    }
+  }
+
+  counter.Report(state);
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * totalBytes));
+  state.SetLabel(shapeNames[state.range(0)]);
+}
+
+static void SerializeClassFile(benchmark::State& state)
+{
+  const ClassFile::ClassFile& cf = getShape(state.range(0));
+  size_t bytes = getShapeBytes(state.range(0)).size();
+  std::ostringstream stream;
+  allocationCounter counter;
+
+  for(auto _ : state)
+  {
+    stream.seekp(0);
+    auto result = Serializer::SerializeClassFile(stream, cf);
+    benchmark::DoNotOptimize(result);
+  }
+
+  counter.Report(state);
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+  state.SetLabel(shapeNames[state.range(0)]);
+}
+
+//indices of the constants of the given types
+static std::vector<U16> findConstants(const ConstantPool& cp, std::initializer_list<CPInfo::Type> types)
+{
+  std::vector<U16> indices;
+
+  for(U16 i = 1; i < cp.GetCount(); i++)
+  {
+    const CPInfo* info = cp[i];
+
+    if(info && std::find(types.begin(), types.end(), info->GetType()) != types.end())
+      indices.push_back(i);
+  }
+
+  return indices;
+}
+
+static void LookupString(benchmark::State& state)
+{
+  const ConstantPool& cp = getShape(state.range(0)).ConstPool;
+  std::vector<U16> indices = findConstants(cp, {CPInfo::Type::Class,
+      CPInfo::Type::Methodref, CPInfo::Type::Fieldref, CPInfo::Type::String});
+  allocationCounter counter;
+
+  for(auto _ : state)
+  {
+    for(U16 index : indices)
+    {
+      auto errOrString = cp.LookupString(index);
+      benchmark::DoNotOptimize(errOrString);
+    }
+  }
+
+  counter.Report(state);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * indices.size()));
+  state.SetLabel(shapeNames[state.range(0)]);
+}
+
+static void LookupDescriptor(benchmark::State& state)
+{
+  const ConstantPool& cp = getShape(state.range(0)).ConstPool;
+  std::vector<U16> indices = findConstants(cp, {CPInfo::Type::Methodref,
+      CPInfo::Type::Fieldref, CPInfo::Type::InterfaceMethodref});
+  allocationCounter counter;
+
+  for(auto _ : state)
+  {
+    for(U16 index : indices)
+    {
+      auto errOrDescriptor = cp.LookupDescriptor(index);
+      benchmark::DoNotOptimize(errOrDescriptor);
+    }
+  }
+
+  counter.Report(state);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * indices.size()));
+  state.SetLabel(shapeNames[state.range(0)]);
+}
+
+static void ResolveMemberRef(benchmark::State& state)
+{
+  const ConstantPool& cp = getShape(state.range(0)).ConstPool;
+  std::vector<U16> indices = findConstants(cp, {CPInfo::Type::Methodref,
+      CPInfo::Type::Fieldref, CPInfo::Type::InterfaceMethodref});
+  allocationCounter counter;
+
+  for(auto _ : state)
+  {
+    for(U16 index : indices)
+    {
+      auto errOrRef = cp.ResolveMemberRef(index);
+      benchmark::DoNotOptimize(errOrRef);
+    }
+  }
+
+  counter.Report(state);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * indices.size()));
+  state.SetLabel(shapeNames[state.range(0)]);
+}
+
+static void DecodeMethodDescriptor(benchmark::State& state)
+{
+  const ClassFile::ClassFile& cf = getShape(state.range(0));
+  std::vector<std::string_view> descriptors;
+  size_t bytes = 0;
+
+  for(const FieldMethodInfo& method : cf.Methods)
+  {
+    descriptors.push_back(cf.ConstPool.LookupString(method.DescriptorIndex).Get());
+    bytes += descriptors.back().size();
+  }
+
+  allocationCounter counter;
+
+  for(auto _ : state)
+  {
+    for(std::string_view descriptor : descriptors)
+    {
+      auto errOrDescriptor = ClassFile::DecodeMethodDescriptor(descriptor);
+      benchmark::DoNotOptimize(errOrDescriptor);
+    }
+  }
+
+  counter.Report(state);
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+  state.SetLabel(shapeNames[state.range(0)]);
+}
+
+static void ViewMethodDescriptor(benchmark::State& state)
+{
+  const ClassFile::ClassFile& cf = getShape(state.range(0));
+  std::vector<std::string_view> descriptors;
+  size_t bytes = 0;
+
+  for(const FieldMethodInfo& method : cf.Methods)
+  {
+    descriptors.push_back(cf.ConstPool.LookupString(method.DescriptorIndex).Get());
+    bytes += descriptors.back().size();
+  }
+
+  allocationCounter counter;
+
+  for(auto _ : state)
+  {
+    for(std::string_view descriptor : descriptors)
+    {
+      auto errOrDescriptor = ClassFile::ViewMethodDescriptor(descriptor);
+
+      for(TypeView parameter : errOrDescriptor.Get())
+        benchmark::DoNotOptimize(parameter);
+    }
+  }
+
+  counter.Report(state);
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+  state.SetLabel(shapeNames[state.range(0)]);
+}
+
+static void FindMethod(benchmark::State& state)
+{
+  const ClassFile::ClassFile& cf = getShape(state.range(0));
+  std::vector< std::pair<std::string_view, std::string_view> > keys;
+
+  for(const FieldMethodInfo& method : cf.Methods)
+  {
+    keys.emplace_back(cf.ConstPool.LookupString(method.NameIndex).Get(),
+        cf.ConstPool.LookupString(method.DescriptorIndex).Get());
+  }
+
+  allocationCounter counter;
+
+  for(auto _ : state)
+  {
+    for(auto [name, descriptor] : keys)
+      benchmark::DoNotOptimize(cf.FindMethod(name, descriptor));
+  }
+
+  counter.Report(state);
+  state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * keys.size()));
+  state.SetLabel(shapeNames[state.range(0)]);
+}
+
+} //namespace
+
+BENCHMARK(ParseClassFile)->DenseRange(Small, Pathological);
+BENCHMARK(ParseConstantPool)->DenseRange(Small, Pathological);
+BENCHMARK(ParseInstruction)->DenseRange(Small, Pathological);
+BENCHMARK(SerializeClassFile)->DenseRange(Small, Pathological);
+BENCHMARK(LookupString)->DenseRange(Small, Pathological);
+BENCHMARK(LookupDescriptor)->DenseRange(Small, Pathological);
+BENCHMARK(ResolveMemberRef)->DenseRange(Small, Pathological);
+BENCHMARK(DecodeMethodDescriptor)->DenseRange(Small, Pathological);
+BENCHMARK(ViewMethodDescriptor)->DenseRange(Small, Pathological);
+BENCHMARK(FindMethod)->DenseRange(Small, Pathological);
+
+BENCHMARK_MAIN();
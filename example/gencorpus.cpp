@@ -0,0 +1,32 @@
+/*
+ * Writes the synthetic class corpus (classes at the limits of the format) to a
+ * directory, for stress, benchmark & scaling runs
+ */
+
+#include <ClassFile/Synthetic.hpp>
+
+#include <iostream>
+#include <string>
+
+int main(int argc, char** argv)
+{
+  if(argc < 2)
+  {
+    std::cout << "Usage: " << argv[0] << " <output dir> [seed]\n";
+    return -1;
+  }
+
+  ClassFile::U64 seed = argc > 2 ? std::stoull(argv[2]) : 0;
+  auto errOrPaths = ClassFile::Synthetic::WriteCorpus(argv[1], seed);
+
+  if(errOrPaths.IsError())
+  {
+    std::cout << "GENERATION ERROR: " << errOrPaths.GetError().What << '\n';
+    return -2;
+  }
+
+  for(const std::string& path : errOrPaths.Get())
+    std::cout << path << '\n';
+
+  return 0;
+}
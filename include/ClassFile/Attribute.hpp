@@ -1,11 +1,13 @@
 #pragma once
 
+#include "CowPtr.hpp"
 #include "Instruction.hpp"
 #include "Defs.hpp"
 #include "Error.hpp"
 
 #include <string_view>
 #include <cassert>
+#include <memory_resource>
 #include <vector>
 
 namespace ClassFile
@@ -58,6 +60,10 @@ struct AttributeInfo
     //size of a serialized attribute: 
     //GetHeaderLength() + GetLength() = actual serialized length of attribute
     static U32 GetHeaderLength() { return 6; }
+
+    //A copy of the attribute, see CowPtr. Nested attributes (those of Code)
+    //are shared with the original, not copied.
+    virtual std::unique_ptr<AttributeInfo> Clone() const = 0;
   
     virtual ~AttributeInfo() = default;
   
@@ -74,16 +80,22 @@ struct ConstantValueAttribute : public AttributeInfo
   ConstantValueAttribute() : AttributeInfo(Type::ConstantValue) {}
   U32 GetLength() const override { return 2;  }
 
+  std::unique_ptr<AttributeInfo> Clone() const override
+  {
+    return std::make_unique<ConstantValueAttribute>(*this);
+  }
+
   U16 Index;
 };
 
 struct CodeAttribute : public AttributeInfo
 {
-  CodeAttribute() : AttributeInfo(Type::Code) {}
+  explicit CodeAttribute(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : AttributeInfo(Type::Code), Code{resource}, ExceptionTable{resource}, Attributes{resource} {}
 
   U16 MaxStack;
   U16 MaxLocals;
-  std::vector<Instruction> Code;
+  std::pmr::vector<Instruction> Code;
 
   struct ExceptionHandler
   {
@@ -92,9 +104,16 @@ struct CodeAttribute : public AttributeInfo
     U16 HandlerPC;
     U16 CatchType;
   };
-  std::vector<ExceptionHandler> ExceptionTable;
+  std::pmr::vector<ExceptionHandler> ExceptionTable;
+
+  std::pmr::vector< CowPtr<AttributeInfo> > Attributes;
 
-  std::vector< std::unique_ptr<AttributeInfo> > Attributes;
+  std::unique_ptr<AttributeInfo> Clone() const override
+  {
+    auto copy = std::make_unique<CodeAttribute>(Code.get_allocator().resource());
+    *copy = *this;
+    return copy;
+  }
 
   U32 GetLength() const override 
   { 
@@ -124,14 +143,22 @@ struct CodeAttribute : public AttributeInfo
 
 struct ExceptionsAttribute : public AttributeInfo
 {
-  ExceptionsAttribute() : AttributeInfo(Type::Exceptions) {}
+  explicit ExceptionsAttribute(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : AttributeInfo(Type::Exceptions), ExceptionTable{resource} {}
   U32 GetLength() const override 
   { 
     return sizeof(U16) //number_of_exceptions field
       + (ExceptionTable.size() * sizeof(U16));
   }
 
-  std::vector<U16> ExceptionTable;
+  std::pmr::vector<U16> ExceptionTable;
+
+  std::unique_ptr<AttributeInfo> Clone() const override
+  {
+    auto copy = std::make_unique<ExceptionsAttribute>(ExceptionTable.get_allocator().resource());
+    *copy = *this;
+    return copy;
+  }
 };
 
 struct SourceFileAttribute : public AttributeInfo
@@ -139,12 +166,18 @@ struct SourceFileAttribute : public AttributeInfo
   SourceFileAttribute() : AttributeInfo(Type::SourceFile) {}
   U32 GetLength() const override { return 2;  }
 
+  std::unique_ptr<AttributeInfo> Clone() const override
+  {
+    return std::make_unique<SourceFileAttribute>(*this);
+  }
+
   U16 SourceFileIndex;
 };
 
 struct LineNumberTableAttribute : public AttributeInfo
 {
-  LineNumberTableAttribute() : AttributeInfo(Type::LineNumberTable) {}
+  explicit LineNumberTableAttribute(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : AttributeInfo(Type::LineNumberTable), LineNumberMap{resource} {}
 
   U32 GetLength() const override 
   {
@@ -157,17 +190,32 @@ struct LineNumberTableAttribute : public AttributeInfo
     U16 PC, LineNumber;
   };
 
-  std::vector<LineMapping> LineNumberMap;
+  std::pmr::vector<LineMapping> LineNumberMap;
+
+  std::unique_ptr<AttributeInfo> Clone() const override
+  {
+    auto copy = std::make_unique<LineNumberTableAttribute>(LineNumberMap.get_allocator().resource());
+    *copy = *this;
+    return copy;
+  }
 };
 
 
 //Non standard attribute type, used for parsing unknown or unimplemented attributes as a byte array
 struct RawAttribute : public AttributeInfo
 {
-  RawAttribute() : AttributeInfo(Type::Raw) {}
+  explicit RawAttribute(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : AttributeInfo(Type::Raw), Bytes{resource} {}
   U32 GetLength() const override { return static_cast<U32>(Bytes.size());  }
 
-  std::vector<U8> Bytes;
+  std::pmr::vector<U8> Bytes;
+
+  std::unique_ptr<AttributeInfo> Clone() const override
+  {
+    auto copy = std::make_unique<RawAttribute>(Bytes.get_allocator().resource());
+    *copy = *this;
+    return copy;
+  }
 };
 
 } //namespace ClassFile
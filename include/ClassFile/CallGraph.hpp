@@ -0,0 +1,134 @@
+#pragma once
+
+#include "ClassFile.hpp"
+#include "ClassHierarchy.hpp"
+#include "SymbolTable.hpp"
+#include "Error.hpp"
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ClassFile
+{
+
+//Options of CallGraph::Build()
+struct CallGraphOptions
+{
+  //0 = hardware concurrency
+  unsigned Threads{0};
+
+  //Names are interned into this table, it must outlive the graph
+  SymbolTable* Symbols{&SymbolTable::Global()};
+
+  //When set, calls are resolved against the hierarchy: a call to a method
+  //the owner inherits targets the nearest superclass declaring it, and
+  //virtual & interface calls get an extra edge to every override declared
+  //by a subtype of the resolved owner (class hierarchy analysis). The
+  //hierarchy must use the same symbol table.
+  const ClassHierarchy* Hierarchy{nullptr};
+};
+
+//Static call graph extracted from the invoke instructions of a set of classes.
+//
+//Methods are identified by their interned (owner, name, descriptor) triple and
+//mapped to dense MethodIds: methods with a body or declaration in one of the
+//scanned classes come first, methods that are only called (e.g. library code)
+//after them. Edges are stored in CSR form, the callees of method m being
+//Targets[Offsets[m] .. Offsets[m+1]) with the matching Kinds. Each caller
+//lists a (callee, kind) pair only once, no matter how many sites call it.
+//
+//invokedynamic sites have no static target and aren't part of the graph.
+//
+//A built graph is immutable, all queries are safe to call concurrently.
+class CallGraph
+{
+  public:
+    using MethodId = U32;
+    static constexpr MethodId InvalidId = ~MethodId{0};
+
+    enum class CallKind : U8
+    {
+      Virtual,
+      Special,
+      Static,
+      Interface,
+    };
+
+    struct MethodKey
+    {
+      const Symbol* Owner{nullptr};
+      const Symbol* Name{nullptr};
+      const Symbol* Descriptor{nullptr};
+
+      bool operator==(const MethodKey& other) const
+      {
+        return Owner == other.Owner && Name == other.Name &&
+          Descriptor == other.Descriptor;
+      }
+    };
+
+    using Options = CallGraphOptions;
+
+    //Parses each class file on Options::Threads threads and scans it right
+    //away, so only one parsed class per thread is alive at a time.
+    static ErrorOr<CallGraph> Build(const std::vector<std::string>& paths,
+        const Options& = {});
+
+    static ErrorOr<CallGraph> Build(const std::vector<const ClassFile*>& classes,
+        const Options& = {});
+
+    size_t GetMethodCount() const;
+    size_t GetEdgeCount() const;
+
+    //InvalidId if the method is neither declared nor called
+    MethodId Find(std::string_view owner, std::string_view name,
+        std::string_view descriptor) const;
+    MethodId Find(const MethodKey&) const;
+
+    const MethodKey& GetMethod(MethodId) const;
+
+    //False for methods that are only called by the scanned classes
+    bool IsDeclared(MethodId) const;
+
+    //Callees of a method and how they're called, both of the same length
+    const MethodId* CalleesBegin(MethodId) const;
+    const MethodId* CalleesEnd(MethodId) const;
+    const CallKind* CallKindsBegin(MethodId) const;
+
+    std::vector<MethodId> GetCallees(MethodId) const;
+
+    //Raw CSR arrays
+    const std::vector<U32>& GetOffsets() const { return m_offsets; }
+    const std::vector<MethodId>& GetTargets() const { return m_targets; }
+    const std::vector<CallKind>& GetKinds() const { return m_kinds; }
+
+  private:
+    struct MethodKeyHash
+    {
+      size_t operator()(const MethodKey&) const;
+    };
+
+    //Declared methods and call sites of one class, see extract()
+    struct ClassCalls;
+
+    CallGraph() = default;
+
+    static ErrorOr<ClassCalls> extract(const ClassFile&, SymbolTable&);
+    static CallGraph link(std::vector<ClassCalls>&, const Options&);
+
+    MethodId getOrAddId(const MethodKey&);
+
+    SymbolTable* m_symbols{nullptr};
+
+    std::vector<MethodKey> m_methods;
+    std::unordered_map<MethodKey, MethodId, MethodKeyHash> m_ids;
+    size_t m_nDeclared{0};
+
+    std::vector<U32> m_offsets;
+    std::vector<MethodId> m_targets;
+    std::vector<CallKind> m_kinds;
+};
+
+} //namespace ClassFile
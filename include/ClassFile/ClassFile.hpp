@@ -3,16 +3,22 @@
 #include "Defs.hpp"
 #include "ConstantPool.hpp"
 #include "Attribute.hpp"
+#include "Lazy.hpp"
+
+#include <unordered_map>
 
 namespace ClassFile
 {
 
 struct FieldMethodInfo
 {
+  FieldMethodInfo() = default;
+  explicit FieldMethodInfo(std::pmr::memory_resource* resource) : Attributes{resource} {}
+
   U16 AccessFlags;
   U16 NameIndex;
   U16 DescriptorIndex;
-  std::vector< std::unique_ptr<AttributeInfo> > Attributes;
+  std::pmr::vector< CowPtr<AttributeInfo> > Attributes;
 
   enum class AccessFlag : U16
   {
@@ -35,8 +41,51 @@ struct FieldMethodInfo
   std::vector<std::string_view> FlagsToStrs() const;
 };
 
+//Attributes are held through CowPtr, so copies of a member or class share
+//them until one side mutates one, see ClassFile::Clone().
+//
+//The containers of the model are std::pmr ones. Those of a default
+//constructed class use the default resource, pass a resource to the
+//constructors (or ParseOptions::Resource) to allocate them from it instead.
+//Attributes & constant pool entries are always heap allocated, only the
+//containers & strings they own use the resource. A class must not outlive
+//the resource it was built with.
 struct ClassFile 
 {
+  ClassFile() = default;
+
+  explicit ClassFile(std::pmr::memory_resource* resource)
+    : ConstPool{resource}, Interfaces{resource}, Fields{resource}, Methods{resource},
+      Attributes{resource} {}
+
+  //A copy in the same resource that shares every attribute & constant pool
+  //entry with this class. Only the member & attribute lists are copied, the
+  //shared parts are copied by whichever side mutates them first (through
+  //CowPtr::Mutate() & ConstantPool::Mutate()), so cloning a class for
+  //variants that each change a little costs about what they change.
+  ClassFile Clone() const;
+
+  //The member with that name & descriptor, nullptr if there is none. 
+  //
+  //Lookups go through a hash index of both lists that is built on first use
+  //and published like Lazy, so they're safe to call concurrently. Hits are
+  //checked against the member they point to. Adding & removing members
+  //through the functions below keeps the index up to date, after changing
+  //Fields or Methods directly or renaming members in place call
+  //InvalidateMemberIndex().
+  const FieldMethodInfo* FindField(std::string_view name, std::string_view descriptor) const;
+  const FieldMethodInfo* FindMethod(std::string_view name, std::string_view descriptor) const;
+  FieldMethodInfo* FindField(std::string_view name, std::string_view descriptor);
+  FieldMethodInfo* FindMethod(std::string_view name, std::string_view descriptor);
+
+  void InvalidateMemberIndex();
+
+  //Append a member, returning it, or erase the one at position
+  FieldMethodInfo& AddField(FieldMethodInfo field);
+  FieldMethodInfo& AddMethod(FieldMethodInfo method);
+  void RemoveField(size_t position);
+  void RemoveMethod(size_t position);
+
   U32 Magic;
   U16 MinorVersion;
   U16 MajorVersion;
@@ -44,10 +93,10 @@ struct ClassFile
   U16 AccessFlags;
   U16 ThisClass;
   U16 SuperClass;
-  std::vector<U16> Interfaces;
-  std::vector<FieldMethodInfo> Fields;
-  std::vector<FieldMethodInfo> Methods;
-  std::vector< std::unique_ptr<AttributeInfo> > Attributes;
+  std::pmr::vector<U16> Interfaces;
+  std::pmr::vector<FieldMethodInfo> Fields;
+  std::pmr::vector<FieldMethodInfo> Methods;
+  std::pmr::vector< CowPtr<AttributeInfo> > Attributes;
 
   enum class AccessFlag : U16
   {
@@ -64,6 +113,23 @@ struct ClassFile
   static const std::unordered_map<AccessFlag, std::string_view> FlagStrMap;
   static ErrorOr<std::string_view> FlagToStr(U16 flag);
   std::vector<std::string_view> FlagsToStrs() const;
+
+  private:
+    //positions in a member list by hash of name & descriptor
+    struct memberIndex
+    {
+      std::unordered_multimap<size_t, U32> Positions;
+    };
+
+    struct memberIndexes
+    {
+      memberIndex Fields;
+      memberIndex Methods;
+    };
+
+    const memberIndexes& getMemberIndexes() const;
+
+    Lazy<memberIndexes> m_memberIndexes;
 };
 
 } //namespace: ClassFile
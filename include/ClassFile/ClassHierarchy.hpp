@@ -0,0 +1,119 @@
+#pragma once
+
+#include "ClassFile.hpp"
+#include "SymbolTable.hpp"
+#include "Error.hpp"
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ClassFile
+{
+
+//Supertype & subtype relations between the classes of a classpath.
+//
+//Every class name is interned and mapped to a dense ClassId. Classes that are
+//only referenced (e.g. java/lang/Object when indexing an application) get an
+//id as well but aren't "defined". Edges are stored in CSR form: one offset
+//array per relation plus a flat array of ids.
+//
+//A built hierarchy is immutable, all queries are safe to call concurrently.
+class ClassHierarchy
+{
+  public:
+    using ClassId = U32;
+    static constexpr ClassId InvalidId = ~ClassId{0};
+
+    //What the hierarchy needs to know about a single class
+    struct Entry
+    {
+      const Symbol* Name{nullptr};
+      const Symbol* SuperName{nullptr}; //nullptr for java/lang/Object
+      std::vector<const Symbol*> Interfaces;
+      U16 AccessFlags{0};
+    };
+
+    //Contiguous view of ids as returned by the direct relation queries
+    struct Range
+    {
+      const ClassId* First;
+      const ClassId* Last;
+
+      const ClassId* begin() const { return First; }
+      const ClassId* end() const { return Last; }
+      size_t size() const { return static_cast<size_t>(Last - First); }
+      bool empty() const { return First == Last; }
+    };
+
+    //Parses only the header region (see Parser::ParseClassHeader) of each
+    //class file on nThreads threads (0 = hardware concurrency) and builds the
+    //hierarchy from them. Only the names of the classes & their supertypes
+    //are interned into symbols, which must outlive the hierarchy. If a class
+    //is defined by several files the first wins.
+    static ErrorOr<ClassHierarchy> Build(const std::vector<std::string>& paths,
+        unsigned nThreads = 0, SymbolTable& symbols = SymbolTable::Global());
+
+    //Extracts the entry of an already parsed class
+    static ErrorOr<Entry> MakeEntry(const ClassFile&, SymbolTable& symbols);
+
+    //A super class chain that leads back to a class already on it (only
+    //possible with a broken classpath) is cut at the class that closes the
+    //cycle, which is then treated as having no super class
+    static ClassHierarchy Build(const std::vector<Entry>& entries,
+        SymbolTable& symbols = SymbolTable::Global());
+
+    size_t GetClassCount() const;
+
+    //InvalidId if no class with that name is known
+    ClassId Find(std::string_view name) const;
+    ClassId Find(const Symbol* name) const;
+
+    const Symbol* GetSymbol(ClassId) const;
+    std::string_view GetName(ClassId) const;
+
+    //False for classes that are only referenced by the indexed classes
+    bool IsDefined(ClassId) const;
+    bool IsInterface(ClassId) const;
+    U16 GetAccessFlags(ClassId) const;
+
+    //InvalidId for java/lang/Object and classes that aren't defined
+    ClassId GetSuperClass(ClassId) const;
+
+    //Direct relations
+    Range GetInterfaces(ClassId) const;
+    Range GetSubtypes(ClassId) const; //subclasses & direct implementors
+
+    //Transitive closures, in breadth first order, excluding the class itself
+    std::vector<ClassId> GetAllSupertypes(ClassId) const;
+    std::vector<ClassId> GetAllSubtypes(ClassId) const;
+
+    //True if sub == super or super is a transitive supertype of sub
+    bool IsSubtypeOf(ClassId sub, ClassId super) const;
+
+  private:
+    ClassHierarchy() = default;
+
+    ClassId getOrAddId(const Symbol*);
+
+    template <typename NextFn>
+    std::vector<ClassId> closure(ClassId, NextFn&&) const;
+
+    SymbolTable* m_symbols{nullptr};
+
+    std::vector<const Symbol*> m_names;
+    std::unordered_map<const Symbol*, ClassId> m_ids;
+
+    std::vector<bool> m_defined;
+    std::vector<U16> m_accessFlags;
+    std::vector<ClassId> m_superClass;
+
+    std::vector<U32> m_interfaceOffsets;
+    std::vector<ClassId> m_interfaces;
+
+    std::vector<U32> m_subtypeOffsets;
+    std::vector<ClassId> m_subtypes;
+};
+
+} //namespace ClassFile
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "Error.hpp"
+
+#include <string>
+#include <vector>
+
+namespace ClassFile
+{
+namespace Classpath
+{
+
+//Recursively collects the paths of all ".class" files below root, sorted so
+//that the result doesn't depend on directory iteration order. If root is a 
+//file it is returned as the only entry.
+ErrorOr< std::vector<std::string> > ListClassFiles(const std::string& root);
+
+//Reads a whole file into memory
+ErrorOr< std::vector<U8> > ReadFile(const std::string& path);
+
+} //namespace Classpath
+} //namespace ClassFile
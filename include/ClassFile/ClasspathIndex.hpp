@@ -0,0 +1,118 @@
+#pragma once
+
+#include "ClassHierarchy.hpp"
+#include "Fingerprint.hpp"
+#include "SymbolTable.hpp"
+#include "Error.hpp"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace ClassFile
+{
+
+//Indexes of the class files below a directory that are kept up to date
+//incrementally: which file defines a class, which files refer to a class,
+//which files use a string literal, and the class hierarchy.
+//
+//For every file the size, modification time & content hash are recorded in a
+//manifest along with what the file contributed to the indexes. Refresh() only
+//stats files whose size & mtime still match, reads & hashes the others, and
+//skims just those whose content actually changed. The contributions of
+//removed & changed files are taken out of the indexes and those of added &
+//changed files put in, without touching the rest.
+class ClasspathIndex
+{
+  public:
+    struct RefreshStats
+    {
+      size_t Added{0};
+      size_t Changed{0};
+      size_t Removed{0};
+      size_t Unchanged{0};
+
+      //files that are indexed as empty because they couldn't be skimmed
+      std::vector<std::string> Errors;
+    };
+
+    //Loads the manifest if there is a valid one, otherwise the index starts
+    //out empty. Nothing is scanned until the first Refresh().
+    static ErrorOr<ClasspathIndex> Open(std::string root, std::string manifestPath,
+        unsigned nThreads = 0);
+
+    //Brings the indexes up to date with the files below the root & saves the
+    //manifest
+    ErrorOr<RefreshStats> Refresh();
+
+    ErrorOr<void> Save() const;
+
+    size_t GetFileCount() const;
+
+    //Built from the files' recorded headers, rebuilt on every Refresh() that
+    //changed anything. Uses the index's own symbol table.
+    const ClassHierarchy& GetHierarchy() const;
+    SymbolTable& GetSymbols() const;
+
+    //Paths of the files defining a class (more than one for duplicates)
+    std::vector<std::string> FindDefinitions(std::string_view className) const;
+
+    //Paths of the files with a Class constant naming className, array types
+    //are recorded as their element type
+    std::vector<std::string> FindClassReferences(std::string_view className) const;
+
+    //Paths of the files with a String constant equal to value
+    std::vector<std::string> FindStringReferences(std::string_view value) const;
+
+  private:
+    using FileId = U32;
+    using SymbolIndex = std::unordered_map< const Symbol*, std::unordered_set<FileId> >;
+
+    struct fileRecord
+    {
+      std::string Path;
+      U64 Size{0};
+      S64 ModifiedTime{0};
+      Fingerprint Hash;
+
+      bool Valid{false}; //false if the file couldn't be skimmed
+      ClassHierarchy::Entry Class;
+      std::vector<const Symbol*> ClassRefs;
+      std::vector<const Symbol*> Strings;
+    };
+
+    ClasspathIndex(std::string root, std::string manifestPath, unsigned nThreads);
+
+    ErrorOr<void> load();
+    static ErrorOr<fileRecord> skim(const std::vector<U8>& bytes, SymbolTable&);
+
+    FileId addFile(fileRecord&&);
+    void removeFile(FileId);
+    void link(FileId);
+    void unlink(FileId);
+    void rebuildHierarchy();
+
+    std::vector<std::string> lookup(const SymbolIndex&, std::string_view) const;
+
+    std::string m_root;
+    std::string m_manifestPath;
+    unsigned m_nThreads;
+
+    //stable address, the hierarchy & the records point into it
+    std::unique_ptr<SymbolTable> m_symbols;
+
+    std::vector<fileRecord> m_files; //removed files leave an empty Path
+    std::vector<FileId> m_freeIds;
+    std::unordered_map<std::string, FileId> m_fileIds;
+
+    SymbolIndex m_definitions;
+    SymbolIndex m_classRefs;
+    SymbolIndex m_strings;
+
+    std::unique_ptr<ClassHierarchy> m_hierarchy;
+};
+
+} //namespace ClassFile
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "Attribute.hpp"
+#include "ConstantPool.hpp"
+#include "Error.hpp"
+
+#include <vector>
+
+namespace ClassFile
+{
+
+//Batched editing of a CodeAttribute that keeps every pc in it consistent.
+//
+//Edits refer to the instructions by their index at the time the editor was
+//created (or last committed) and are only recorded until Commit() applies all
+//of them in one linear pass: the new instruction list is laid out, branch
+//offsets are recomputed and the exception table, LineNumberTable,
+//LocalVariableTable, LocalVariableTypeTable & StackMapTable are remapped.
+//Branches whose offset doesn't fit 16 bits anymore are widened: goto & jsr
+//become goto_w & jsr_w, an if becomes the inverted if jumping over a goto_w.
+//Only if a branch had to be widened is the layout done again.
+//
+//Each original instruction forms a group with the code inserted before &
+//after it. Whatever targeted the instruction (branches, handler ranges, line
+//numbers, frames) targets the start of its group afterwards, so code inserted
+//before an instruction runs wherever it would have run, while code inserted
+//after it is only reached by falling through the instruction. A handler range
+//ending at an instruction doesn't cover the code inserted before it.
+//
+//MaxStack & MaxLocals are left alone and no frames are added for new branch
+//targets, see ComputeMaxs() & ComputeFrames().
+class CodeEditor
+{
+  public:
+    //A branch target: an original instruction (GetLabel()) or a position in
+    //inserted code (NewLabel() bound with Sequence::Bind())
+    struct Label
+    {
+      U32 Id;
+    };
+
+    //Instructions to insert. Branches are added with their target label and
+    //get their offset on commit.
+    class Sequence
+    {
+      public:
+        void Add(Instruction instr);
+        void AddBranch(Instruction branch, Label target);
+
+        //Binds a label to the position of the next instruction added
+        void Bind(Label label);
+
+        size_t GetSize() const { return m_code.size(); }
+
+      private:
+        friend class CodeEditor;
+
+        static constexpr U32 noTarget = ~U32{0};
+
+        std::vector<Instruction> m_code;
+        std::vector<U32> m_targets; //a label id or noTarget per instruction
+        std::vector< std::pair<U32, size_t> > m_binds; //label id, position
+    };
+
+    //The pool is used to identify the attributes by name
+    CodeEditor(const ConstantPool&, CodeAttribute&);
+
+    Label NewLabel();
+
+    //The label of an original instruction. An index past the code gives a
+    //label Commit() rejects, rather than one aliasing a NewLabel().
+    Label GetLabel(size_t index) const;
+
+    //Code inserted at the same place by several calls keeps their order
+    void InsertBefore(size_t index, Sequence code);
+    void InsertAfter(size_t index, Sequence code);
+
+    //Replaces or removes an original instruction. Its group (see above)
+    //starts at the replacement, or at the next instruction if there's none.
+    void Replace(size_t index, Sequence code);
+    void Remove(size_t index);
+
+    bool HasEdits() const;
+
+    //Applies all recorded edits. Fails without touching the code for out of
+    //range indices, unbound labels, instructions that can't be relocated
+    //(see IsComplex()), code that grows beyond 65535 bytes or frames that
+    //would end up at the same pc. Indices refer to the new code afterwards.
+    ErrorOr<void> Commit();
+
+  private:
+    enum class editKind : U8 { Before, Replace, After };
+
+    struct edit
+    {
+      size_t Index;
+      editKind Kind;
+      Sequence Code;
+    };
+
+    //never bound, label ids stay below the code size plus the new labels
+    static constexpr U32 invalidLabel = ~U32{0} - 1;
+
+    const ConstantPool& m_constPool;
+    CodeAttribute& m_code;
+
+    std::vector<edit> m_edits;
+    U32 m_labelCount;
+};
+
+} //namespace ClassFile
@@ -2,11 +2,18 @@
 
 #include "Defs.hpp"
 #include "Error.hpp"
+#include "Lazy.hpp"
+#include "SymbolTable.hpp"
+#include "TypeTable.hpp"
 
 #include <vector>
 #include <memory>
+#include <memory_resource>
+#include <optional>
 #include <string>
 #include <string_view>
+#include <unordered_map>
+#include <functional>
 
 namespace ClassFile
 {
@@ -112,8 +119,20 @@ struct NameAndTypeInfo : public CPInfo
 
 struct UTF8Info : public CPInfo
 {
-  UTF8Info() : CPInfo(Type::UTF8) {}
-  std::string String;
+  explicit UTF8Info(std::pmr::memory_resource* resource = std::pmr::get_default_resource())
+    : CPInfo(Type::UTF8), String{resource} {}
+
+  //The value is either owned (String) or interned (Interned, String is left
+  //empty), see ParseOptions::Symbols. Use GetString() to read it either way.
+  //ConstantPool::Mutate() copies an interned value into String and clears
+  //Interned, so the entry it returns can be changed through String.
+  std::pmr::string String;
+  const Symbol* Interned{nullptr};
+
+  std::string_view GetString() const 
+  { 
+    return Interned ? Interned->GetString() : std::string_view{String}; 
+  }
 };
 
 struct MethodHandleInfo : public CPInfo
@@ -136,16 +155,87 @@ struct InvokeDynamicInfo : public CPInfo
   U16 NameAndTypeIndex;
 };
 
-//A list container of CPInfos that uses 1-based indexing
+//Calls fn for each field of info that holds a constant pool index, e.g. the
+//ClassIndex & NameAndTypeIndex of a Methodref. Fields holding anything else,
+//such as InvokeDynamic's BootstrapMethodAttrIndex, are not visited.
+void ForEachConstantRef(CPInfo& info, const std::function<void(U16&)>& fn);
+void ForEachConstantRef(const CPInfo& info, const std::function<void(U16)>& fn);
+
+//A Fieldref, Methodref, InterfaceMethodref or InvokeDynamic entry with every
+//index resolved, see ConstantPool::ResolveMemberRef()
+struct MemberRef
+{
+  CPInfo::Type Type;
+  std::string_view Owner; //the class name, empty for InvokeDynamic
+  std::string_view Name;
+  std::string_view Descriptor;
+};
+
+//A list container of CPInfos that uses 1-based indexing.
+//
+//Copies of a pool (see ClassFile::Clone()) share their entries, which is why
+//Get<T>() & operator[] only hand out const entries: an entry is modified
+//through Mutate<T>(), which first copies it if another pool still shares it.
 class ConstantPool
 {
   public:
     ConstantPool();
 
+    //The entry list (not the entries themselves, which are always heap
+    //allocated) & UTF8 entries added by FindOrAddUTF8() allocate from resource
+    explicit ConstantPool(std::pmr::memory_resource* resource);
+
     void Reserve(U16 n);
     void Add(std::unique_ptr<CPInfo>&& info);
     void Add(CPInfo* info);
 
+    //Returns the index of an existing entry with the same tag and payload as
+    //info, otherwise appends info (plus the unusable slot that must follow a
+    //Long or Double) and returns its index. 
+    //
+    //Lookups go through a hash index over (tag, payload) that is built on the
+    //first call and then kept up to date by Add() and FindOrAdd(). Entries
+    //are modified through Mutate<T>(), which drops the index so the next
+    //call rebuilds it.
+    ErrorOr<U16> FindOrAdd(std::unique_ptr<CPInfo>&& info);
+
+    //Typed versions of FindOrAdd(). The reference kinds take the values they 
+    //refer to and FindOrAdd every entry they depend on, so for example 
+    //FindOrAddMethodref() may add a UTF8, Class and NameAndType entry as well.
+    ErrorOr<U16> FindOrAddUTF8(std::string_view string);
+    ErrorOr<U16> FindOrAddClass(std::string_view name);
+    ErrorOr<U16> FindOrAddString(std::string_view string);
+    ErrorOr<U16> FindOrAddInteger(U32 bytes);
+    ErrorOr<U16> FindOrAddFloat(U32 bytes);
+    ErrorOr<U16> FindOrAddLong(U32 highBytes, U32 lowBytes);
+    ErrorOr<U16> FindOrAddDouble(U32 highBytes, U32 lowBytes);
+    ErrorOr<U16> FindOrAddNameAndType(std::string_view name, std::string_view descriptor);
+    ErrorOr<U16> FindOrAddFieldref(std::string_view className, 
+        std::string_view name, std::string_view descriptor);
+    ErrorOr<U16> FindOrAddMethodref(std::string_view className, 
+        std::string_view name, std::string_view descriptor);
+    ErrorOr<U16> FindOrAddInterfaceMethodref(std::string_view className, 
+        std::string_view name, std::string_view descriptor);
+    //Fails unless referenceKind is 1-9 & referenceIndex is a member ref of
+    //the type that kind needs
+    ErrorOr<U16> FindOrAddMethodHandle(U8 referenceKind, U16 referenceIndex);
+    ErrorOr<U16> FindOrAddMethodType(std::string_view descriptor);
+    ErrorOr<U16> FindOrAddInvokeDynamic(U16 bootstrapMethodAttrIndex, 
+        std::string_view name, std::string_view descriptor);
+
+    //Drops the FindOrAdd() index & the ResolveMemberRef() & LookupType()
+    //caches, they get rebuilt on their next use
+    void InvalidateIndex();
+
+    //Removes every entry whose index isn't set in keep (keep[0] is ignored) 
+    //and closes the gaps. References between the remaining entries are 
+    //rewritten, references from outside of the pool are the caller's job: the
+    //returned vector maps every old index to its new index, or to 0 for 
+    //removed entries. 
+    //
+    //Fails without modifying the pool if a kept entry refers to a removed one.
+    ErrorOr< std::vector<U16> > Compact(const std::vector<bool>& keep);
+
     //Succeeds if the index points to any CPInfo with a name or nameandtype index
     //OR is a UTF8Info or StringInfo itself
     ErrorOr<std::string_view> LookupString(U16 index) const;
@@ -153,14 +243,29 @@ class ConstantPool
     //Succeeds if the index points to any CPInfo with a descriptor or nameandtype index
     ErrorOr<std::string_view> LookupDescriptor(U16 index) const;
 
+    //Owner, name & descriptor of the member ref at index in one lookup. The 
+    //first call resolves every member ref of the pool into a table, later 
+    //calls are an array access. The table is published like Lazy, so
+    //concurrent calls on a const pool are safe, and it's dropped whenever 
+    //the pool is modified. The views are valid until then as well.
+    ErrorOr<MemberRef> ResolveMemberRef(U16 index) const;
+
+    //The type an entry stands for, interned into types: a UTF8 is taken as a
+    //field or method descriptor, a Class as the object or array type it 
+    //names, NameAndType, MethodType & member refs by their descriptor. The
+    //ids are cached per index for the first table passed in, so later calls
+    //with that table are an array access. Safe to call concurrently on a 
+    //const pool, the cache is dropped whenever the pool is modified.
+    ErrorOr<TypeTable::TypeId> LookupType(U16 index, TypeTable& types) const;
+
     template <class T = CPInfo>
-    ErrorOr<T*> Get(U16 index) const
+    ErrorOr<const T*> Get(U16 index) const
     {
       auto err = ensureValid(index);
       if(err.IsError())
         return err.GetError();
 
-      T* cast_ptr = dynamic_cast<T*>( m_pool[index].get() );
+      const T* cast_ptr = dynamic_cast<const T*>( m_pool[index].get() );
 
       if (!cast_ptr)
         return failedCastError(index, typeid(T).name());
@@ -168,19 +273,96 @@ class ConstantPool
       return cast_ptr;
     }
 
-    CPInfo* operator[](U16 index);
+    //Get<T>() for modifying the entry, copying it first if it's shared with
+    //a copy of the pool. Drops the FindOrAdd() index like InvalidateIndex().
+    //Lookups between this call & the write cache the old value, so write
+    //right away.
+    template <class T = CPInfo>
+    ErrorOr<T*> Mutate(U16 index)
+    {
+      auto err = ensureValid(index);
+      if(err.IsError())
+        return err.GetError();
+
+      T* cast_ptr = dynamic_cast<T*>( this->unshareForWrite(index) );
+
+      if (!cast_ptr)
+        return failedCastError(index, typeid(T).name());
+
+      this->InvalidateIndex();
+      return cast_ptr;
+    }
+
     const CPInfo* operator[](U16 index) const;
 
     U16 GetSize() const;
     U16 GetCount() const;
 
+    //The resource the pool was constructed with. Code that adds attributes
+    //or members to a class can allocate them from its pool's resource.
+    std::pmr::memory_resource* GetResource() const;
+
   private:
     ErrorOr<std::string_view> lookupStringOrUTF8(U16 index) const;
 
     ErrorOr<void> ensureValid(U16) const;
+
+    //makes the entry at index unique to this pool & returns it
+    CPInfo* unshare(U16 index);
+
+    //unshare() that also makes UTF8 entries own their value, for Mutate()
+    CPInfo* unshareForWrite(U16 index);
     Error failedCastError(U16, std::string_view) const;
 
-    std::vector< std::unique_ptr<CPInfo> > m_pool;
+    //Key of the FindOrAdd() index. Payload holds the packed numeric fields of
+    //an entry, String views the value of UTF8 entries. Entries are heap 
+    //allocated and symbols never move, so the view stays valid for as long as
+    //the entry is in the pool. Copying an entry to unshare it drops the index.
+    struct indexKey
+    {
+      CPInfo::Type Type;
+      U64 Payload;
+      std::string_view String;
+
+      bool operator==(const indexKey& other) const
+      {
+        return Type == other.Type && Payload == other.Payload && String == other.String;
+      }
+    };
+
+    struct indexKeyHash
+    {
+      size_t operator()(const indexKey& key) const;
+    };
+
+    static indexKey makeIndexKey(const CPInfo&);
+    void buildIndex();
+    void addToIndex(U16 index);
+
+    template <typename RefT>
+    ErrorOr<U16> findOrAddRef(std::string_view className, 
+        std::string_view name, std::string_view descriptor);
+
+    std::pmr::vector< std::shared_ptr<CPInfo> > m_pool;
+
+    std::unordered_map<indexKey, U16, indexKeyHash> m_index;
+    bool m_indexed{false};
+
+    //by index, empty for entries that aren't (valid) member refs
+    using memberRefTable = std::vector< std::optional<MemberRef> >;
+    memberRefTable resolveMemberRefs() const;
+
+    Lazy<memberRefTable> m_memberRefs;
+
+    struct typeCache
+    {
+      U64 Generation; //of the table the ids belong to
+      std::unique_ptr< std::atomic<TypeTable::TypeId>[] > Ids; //by index
+    };
+
+    ErrorOr<TypeTable::TypeId> lookupType(U16 index, TypeTable& types) const;
+
+    Lazy<typeCache> m_types;
 };
 
 }  //namespace ClassFile
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "Attribute.hpp"
+#include "Error.hpp"
+
+#include <vector>
+
+namespace ClassFile
+{
+
+//Basic blocks of a method's code along with its dominator tree and loops.
+//
+//Block b covers the instructions [GetStart(b), GetEnd(b)) of CodeAttribute::
+//Code, blocks are numbered in code order and block 0 is the entry. A block
+//starts at the first instruction, at every branch target, after every branch,
+//return, athrow & ret, and at the start, end & handler of every exception
+//handler range. Successors are kept in two CSR arrays:
+//
+// - normal successors: the fall through block first, then the branch target.
+//   A jsr has both, as the subroutine eventually returns after it, while ret
+//   has none since its target isn't known statically.
+// - exception successors: the handler blocks of every ExceptionHandler whose
+//   range covers the block, in ExceptionTable order without duplicates.
+//
+//Dominators are computed over both kinds of edges with the iterative
+//algorithm of Cooper, Harvey & Kennedy on the reverse post order. A loop
+//header is the target of a back edge, i.e. of an edge from a block it
+//dominates, so only the headers of reducible loops are reported.
+//
+//A graph is a standalone value that only refers to the CodeAttribute by
+//instruction index, building graphs for different methods concurrently is
+//safe.
+class ControlFlowGraph
+{
+  public:
+    using BlockId = U32;
+    static constexpr BlockId InvalidId = ~BlockId{0};
+
+    struct Range
+    {
+      const BlockId* First;
+      const BlockId* Last;
+
+      const BlockId* begin() const { return First; }
+      const BlockId* end() const { return Last; }
+      size_t size() const { return static_cast<size_t>(Last - First); }
+      bool empty() const { return First == Last; }
+    };
+
+    //Fails for empty code, complex instructions (see IsComplex()), and
+    //branch targets or handler ranges that aren't on an instruction boundary
+    static ErrorOr<ControlFlowGraph> Build(const CodeAttribute&);
+
+    size_t GetBlockCount() const;
+
+    //Instruction indices & the pc of the first instruction
+    U32 GetStart(BlockId) const;
+    U32 GetEnd(BlockId) const;
+    U32 GetStartPC(BlockId) const;
+
+    //The block containing an instruction index
+    BlockId GetBlockOf(size_t instruction) const;
+
+    Range GetSuccessors(BlockId) const;
+    Range GetExceptionSuccessors(BlockId) const;
+    Range GetPredecessors(BlockId) const; //over both kinds of edges
+
+    //Reachable blocks in reverse post order, starting with the entry
+    const std::vector<BlockId>& GetReversePostOrder() const;
+    bool IsReachable(BlockId) const;
+
+    //The entry is its own immediate dominator, unreachable blocks have none
+    //(InvalidId)
+    BlockId GetImmediateDominator(BlockId) const;
+
+    //True if every path from the entry to b passes through a, constant time.
+    //Every block dominates itself, unreachable blocks neither dominate nor
+    //are dominated.
+    bool Dominates(BlockId a, BlockId b) const;
+
+    bool IsLoopHeader(BlockId) const;
+    const std::vector<BlockId>& GetLoopHeaders() const; //in code order
+
+  private:
+    ControlFlowGraph() = default;
+
+    void computeOrder();
+    void computeDominators();
+    void computeLoops();
+
+    //per block, m_starts has an extra entry holding the instruction count
+    std::vector<U32> m_starts;
+    std::vector<U32> m_startPCs;
+
+    std::vector<U32> m_succOffsets;
+    std::vector<BlockId> m_succs;
+    std::vector<U32> m_excOffsets;
+    std::vector<BlockId> m_excSuccs;
+    std::vector<U32> m_predOffsets;
+    std::vector<BlockId> m_preds;
+
+    std::vector<BlockId> m_rpo;
+    std::vector<U32> m_rpoIndex; //InvalidId for unreachable blocks
+    std::vector<BlockId> m_idoms;
+
+    //dominator tree pre & post order numbers
+    std::vector<U32> m_preorder;
+    std::vector<U32> m_postorder;
+
+    std::vector<U8> m_isLoopHeader;
+    std::vector<BlockId> m_loopHeaders;
+};
+
+} //namespace ClassFile
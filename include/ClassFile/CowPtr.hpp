@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+namespace ClassFile
+{
+
+//Owning pointer to a T that copies of the pointer share until one of them is
+//mutated (copy on write), which is what makes ClassFile::Clone() cheap.
+//Reading goes through the const accessors & never copies. Mutate() first
+//makes the pointee unique to this pointer, copying it with T::Clone() if it's
+//still shared, and returns it for writing.
+//
+//A reference taken with Mutate() stays valid until the pointer is copied,
+//after that it refers to the pointee both copies share, so take a fresh one.
+template <typename T>
+class CowPtr
+{
+  public:
+    CowPtr() = default;
+    CowPtr(std::nullptr_t) {}
+
+    template <typename U, typename = std::enable_if_t<std::is_convertible_v<U*, T*>>>
+    CowPtr(std::unique_ptr<U>&& ptr) : m_ptr{std::move(ptr)} {}
+
+    const T* get() const { return m_ptr.get(); }
+    const T& operator*() const { return *m_ptr; }
+    const T* operator->() const { return m_ptr.get(); }
+
+    explicit operator bool() const { return m_ptr != nullptr; }
+    bool operator==(std::nullptr_t) const { return m_ptr == nullptr; }
+    bool operator!=(std::nullptr_t) const { return m_ptr != nullptr; }
+
+    T& Mutate()
+    {
+      if(m_ptr.use_count() > 1)
+        m_ptr = std::shared_ptr<T>{m_ptr->Clone()};
+
+      return *m_ptr;
+    }
+
+    bool IsShared() const { return m_ptr.use_count() > 1; }
+
+  private:
+    std::shared_ptr<T> m_ptr;
+};
+
+} //namespace ClassFile
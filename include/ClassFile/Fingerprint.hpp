@@ -0,0 +1,55 @@
+#pragma once
+
+#include "ClassFile.hpp"
+#include "Error.hpp"
+
+#include <string>
+
+namespace ClassFile
+{
+
+//128 bit hash of the content of a class
+struct Fingerprint
+{
+  U64 Low{0};
+  U64 High{0};
+
+  bool operator==(const Fingerprint& other) const { return Low == other.Low && High == other.High; }
+  bool operator!=(const Fingerprint& other) const { return !(*this == other); }
+  bool operator<(const Fingerprint& other) const
+  {
+    return High != other.High ? High < other.High : Low < other.Low;
+  }
+
+  //32 hex digits, high half first
+  std::string ToString() const;
+};
+
+struct FingerprintHash
+{
+  size_t operator()(const Fingerprint& fp) const { return static_cast<size_t>(fp.Low); }
+};
+
+struct FingerprintOptions
+{
+  //Leaves out the attributes that only carry debug information: SourceFile,
+  //SourceDebugExtension, LineNumberTable, LocalVariableTable and
+  //LocalVariableTypeTable
+  bool ExcludeDebugInfo{false};
+};
+
+//Hashes a canonical form of the class, so classes that only differ in how
+//they are encoded get the same fingerprint:
+//  - constant pool indices are replaced by the (recursively resolved) value
+//    of the constant they refer to, making the fingerprint independent of
+//    the order & duplicates of the constant pool
+//  - branch targets, code ranges (exception, line number & local variable
+//    tables) & stack map frame offsets are hashed as instruction indices and
+//    ldc_w as ldc, as those change when a constant moves below/above index 256
+//  - the order of attributes within an attribute table doesn't matter
+//
+//Members keep their declared order. Raw attributes of an unknown layout are
+//hashed as is, indices included.
+ErrorOr<Fingerprint> ComputeFingerprint(const ClassFile&, const FingerprintOptions& = {});
+
+} //namespace ClassFile
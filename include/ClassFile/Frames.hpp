@@ -0,0 +1,64 @@
+#pragma once
+
+#include "ClassFile.hpp"
+#include "ClassHierarchy.hpp"
+#include "Error.hpp"
+
+#include <string>
+#include <string_view>
+
+namespace ClassFile
+{
+
+//Answers the one question about classes outside of a method that computing
+//its frames can't answer itself: what two reference types merge to where
+//control flow joins.
+class HierarchyOracle
+{
+  public:
+    virtual ~HierarchyOracle() = default;
+
+    //The nearest common superclass of two distinct classes given by their
+    //internal names, never array types. Interfaces are expected to merge to
+    //java/lang/Object, as the verifier treats them as such.
+    virtual ErrorOr<std::string> GetCommonSuperClass(std::string_view a,
+        std::string_view b) const = 0;
+};
+
+//Oracle backed by a ClassHierarchy. Fails for classes whose superclass chain
+//leaves the hierarchy before the answer is found.
+class ClassHierarchyOracle : public HierarchyOracle
+{
+  public:
+    explicit ClassHierarchyOracle(const ClassHierarchy& hierarchy) : m_hierarchy{hierarchy} {}
+
+    ErrorOr<std::string> GetCommonSuperClass(std::string_view a,
+        std::string_view b) const override;
+
+  private:
+    const ClassHierarchy& m_hierarchy;
+};
+
+//Recomputes MaxStack & MaxLocals of a method's Code attribute from the stack
+//effect of every instruction, without inferring any types. Methods without
+//code are left untouched. Fails on stack underflow, inconsistent stack
+//heights at a join and instructions the parser doesn't support either.
+ErrorOr<void> ComputeMaxs(const ConstantPool&, FieldMethodInfo& method);
+
+//Recomputes MaxStack, MaxLocals & the StackMapTable of one of cf's methods,
+//like ASM's COMPUTE_FRAMES. The types of the locals & stack are inferred by a
+//worklist dataflow over the method's basic blocks, reference types meeting
+//at a join are merged through the oracle. Frames are written for every
+//branch target, exception handler & instruction following an unconditional
+//jump, using the smallest encoding, and the Class constants they name are
+//added to cf's constant pool.
+//
+//Unreachable code is replaced by nops ending in athrow (keeping every pc) so
+//that it verifies with an empty frame. Fails if such code is covered by an
+//exception handler, and for methods using jsr/ret, which can't have frames.
+ErrorOr<void> ComputeFrames(ClassFile& cf, FieldMethodInfo& method, const HierarchyOracle&);
+
+//ComputeFrames() for every method with code
+ErrorOr<void> ComputeFrames(ClassFile& cf, const HierarchyOracle&);
+
+} //namespace ClassFile
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "ClassFile.hpp"
+#include "Fingerprint.hpp"
+#include "Lazy.hpp"
+#include "Error.hpp"
+
+#include <memory>
+
+namespace ClassFile
+{
+
+//A class that can't be modified anymore, for sharing one parsed class between
+//any number of threads instead of copying it for each of them.
+//
+//Only const access to the class is handed out and the const parts of the
+//model never modify anything behind the caller's back: lookups in the
+//constant pool & attributes are plain reads, and whatever is memoized (like
+//the fingerprint below) is published with Lazy, without locks. So all
+//members are safe to call concurrently.
+//
+//A thread that needs to change the class Thaw()s a private copy. Copies share
+//attributes & constants with the frozen class, which keeps every shared part
+//referenced for as long as it's alive, so the copy's first write to a part
+//always copies it instead of racing with the readers (see CowPtr).
+class FrozenClass
+{
+  public:
+    static std::shared_ptr<const FrozenClass> Freeze(ClassFile&&);
+
+    const ClassFile& Get() const { return m_class; }
+    const ClassFile& operator*() const { return m_class; }
+    const ClassFile* operator->() const { return &m_class; }
+
+    //A copy for modifying, see ClassFile::Clone()
+    ClassFile Thaw() const;
+
+    //Computed on first use, with default FingerprintOptions
+    ErrorOr<Fingerprint> GetFingerprint() const;
+
+  private:
+    explicit FrozenClass(ClassFile&& cf) : m_class{std::move(cf)} {}
+
+    ClassFile m_class;
+    Lazy< ErrorOr<Fingerprint> > m_fingerprint;
+};
+
+} //namespace ClassFile
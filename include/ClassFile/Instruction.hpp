@@ -3,6 +3,7 @@
 #include "OpCodes.hpp"
 #include "Error.hpp"
 
+#include <array>
 #include <vector>
 #include <memory>
 #include <functional>
@@ -52,10 +53,19 @@ class Instruction
   ErrorOr<S32> GetOperand(size_t index) const;
   ErrorOr<void> SetOperand(size_t index, S32 value);
 
+  //Signed offset of a branch (see IsBranch()) relative to the instruction's 
+  //address. Setting fails if the offset doesn't fit the operand.
+  ErrorOr<S32> GetBranchOffset() const;
+  ErrorOr<void> SetBranchOffset(S32 offset);
+
   private:
   OpCode op;
   bool wide;
-  std::vector<U8> operandBytes;
+
+  //Stored inline so instructions never allocate. No operand list the model
+  //supports is longer than 4 bytes (e.g. goto_w or a wide iinc), the
+  //variable length switches aren't supported.
+  alignas(S32) std::array<U8, 4> operandBytes{};
 
   Instruction() = default;
 
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+namespace ClassFile
+{
+
+//A value computed on first use that any number of threads may ask for at the
+//same time. Every thread that finds it missing computes it, the first one to
+//finish publishes its result with a compare & swap and the others drop
+//theirs, so readers never lock and a published value never changes.
+//
+//This is how const parts of the model memoize: computing must only read what
+//the value depends on. Reset() isn't thread safe, it's for the owner to call
+//when what the value depends on is modified. Copies start out empty.
+template <typename T>
+class Lazy
+{
+  public:
+    Lazy() = default;
+    Lazy(const Lazy&) {}
+    Lazy(Lazy&& other) noexcept : m_value{other.m_value.exchange(nullptr)} {}
+
+    Lazy& operator=(const Lazy&)
+    {
+      this->Reset();
+      return *this;
+    }
+
+    Lazy& operator=(Lazy&& other) noexcept
+    {
+      if(this != &other)
+      {
+        this->Reset();
+        m_value = other.m_value.exchange(nullptr);
+      }
+
+      return *this;
+    }
+
+    ~Lazy() { this->Reset(); }
+
+    template <typename Compute>
+    const T& Get(Compute&& compute) const
+    {
+      if(const T* value = m_value.load(std::memory_order_acquire))
+        return *value;
+
+      auto computed = std::make_unique<T>(compute());
+      const T* published = nullptr;
+
+      if(m_value.compare_exchange_strong(published, computed.get(),
+            std::memory_order_acq_rel, std::memory_order_acquire))
+        return *computed.release();
+
+      return *published;
+    }
+
+    bool IsComputed() const { return m_value.load(std::memory_order_acquire) != nullptr; }
+
+    void Reset()
+    {
+      //cheap to call when nothing was computed, as the owner does on every change
+      if(const T* value = m_value.load(std::memory_order_acquire))
+      {
+        m_value.store(nullptr, std::memory_order_relaxed);
+        delete value;
+      }
+    }
+
+  private:
+    mutable std::atomic<const T*> m_value{nullptr};
+};
+
+} //namespace ClassFile
@@ -1,7 +1,10 @@
 #pragma once
 
+#include "./Defs.hpp"
 #include "./Error.hpp"
 
+#include <iterator>
+#include <string_view>
 #include <tuple>
 #include <vector>
 
@@ -55,4 +58,97 @@ struct MethodDescriptor
 
 ErrorOr<MethodDescriptor> DecodeMethodDescriptor(std::string_view) noexcept;
 
+//The functions above build type names for display. The ones below decode a
+//descriptor in place instead: they never allocate on success and return 
+//views into the descriptor passed to them, which must outlive the views.
+
+//One field descriptor (or the V return type) as found in the descriptor
+struct TypeView
+{
+  //of the element type for arrays
+  enum class Kind : U8
+  {
+    Byte, Char, Double, Float, Int, Long, Short, Boolean, Object, Void
+  };
+
+  Kind ElementKind;
+  U8 Dimensions;                //0 if the type isn't an array
+  std::string_view ClassName;   //internal name of the Object element type
+  std::string_view Descriptor;  //the whole type, e.g. "[Ljava/lang/String;"
+
+  bool IsArray() const { return Dimensions > 0; }
+  bool IsReference() const { return IsArray() || ElementKind == Kind::Object; }
+
+  //local variable & operand stack slots a value of the type takes
+  U32 GetSlots() const
+  {
+    if(IsArray())
+      return 1;
+
+    return ElementKind == Kind::Long || ElementKind == Kind::Double ? 2 :
+      ElementKind == Kind::Void ? 0 : 1;
+  }
+};
+
+//Decodes the field descriptor at the start of the string, its Descriptor
+//tells how many characters that took
+ErrorOr<TypeView> ViewFirstFieldDescriptor(std::string_view) noexcept;
+
+//Like ViewFirstFieldDescriptor() but fails unless the whole string is one type
+ErrorOr<TypeView> ViewFieldDescriptor(std::string_view) noexcept;
+
+//A method descriptor that was checked once by ViewMethodDescriptor(), so its
+//parameters can be iterated without checks or errors
+class MethodDescriptorView
+{
+  public:
+    //Decodes the parameters as it goes, so it yields TypeViews by value
+    class Iterator
+    {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = TypeView;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const TypeView*;
+        using reference = TypeView;
+
+        reference operator*() const { return m_current; }
+        pointer operator->() const { return &m_current; }
+
+        Iterator& operator++();
+        Iterator operator++(int) { Iterator prev = *this; ++*this; return prev; }
+
+        bool operator==(const Iterator& other) const { return m_rest.data() == other.m_rest.data(); }
+        bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+      private:
+        friend class MethodDescriptorView;
+        explicit Iterator(std::string_view rest);
+
+        std::string_view m_rest; //from the current parameter to the ')'
+        TypeView m_current{};
+    };
+
+    Iterator begin() const { return Iterator{m_parameters}; }
+    Iterator end() const { return Iterator{m_parameters.substr(m_parameters.size())}; }
+
+    size_t GetParameterCount() const { return m_parameterCount; }
+
+    //slots the parameters take, without the receiver of instance methods
+    U32 GetParameterSlots() const { return m_parameterSlots; }
+
+    const TypeView& GetReturnType() const { return m_returnType; }
+
+  private:
+    friend ErrorOr<MethodDescriptorView> ViewMethodDescriptor(std::string_view) noexcept;
+    MethodDescriptorView() = default;
+
+    std::string_view m_parameters;
+    size_t m_parameterCount{0};
+    U32 m_parameterSlots{0};
+    TypeView m_returnType{};
+};
+
+ErrorOr<MethodDescriptorView> ViewMethodDescriptor(std::string_view) noexcept;
+
 } //namespace ClassFile
@@ -244,4 +244,12 @@ size_t GetWideLength(OpCode);
 
 bool IsComplex(OpCode);
 
+//True for instructions whose first operand (operand index 0) is an index into
+//the constant pool, e.g. ldc, getfield, invokevirtual or new
+bool HasConstantPoolIndex(OpCode);
+
+//True for instructions whose only operand is a branch offset relative to the 
+//instruction's own address: the ifs, goto, jsr and their _w forms
+bool IsBranch(OpCode);
+
 } //namespace ClassFile
@@ -3,17 +3,96 @@
 #include "ClassFile.hpp"
 #include "Error.hpp"
 
+#include <atomic>
+#include <memory_resource>
+
 namespace ClassFile
 {
 namespace Parser
 {
 
-ErrorOr<ClassFile> ParseClassFile(std::istream&);
-ErrorOr<ConstantPool> ParseConstantPool(std::istream&);
-ErrorOr< std::unique_ptr<CPInfo> > ParseConstant(std::istream&);
+//Where the parser spends its time & what it finds. Phases nest: Members
+//includes the attributes of fields & methods, the Code attribute includes
+//Instructions, which covers only decoding the code array.
+template <typename Counter>
+struct BasicParseStats
+{
+  struct Phase
+  {
+    Counter Bytes{};
+    Counter Nanoseconds{};
+  };
+
+  Counter Classes{};
+
+  Phase ConstantPool;
+  Phase Members;
+  Phase Instructions;
+  Phase Attributes[static_cast<size_t>(AttributeInfo::Type::Raw) + 1]; //by type
+
+  Counter Constants[256]{}; //by tag
+  Counter OpCodes[256]{};
+
+  //attributes the parser has no type for, kept as Raw
+  Counter UnknownAttributes{};
+
+  //allocations whose size the parser took from the input, see
+  //ParseOptions::MaxAllocatedBytes
+  Counter Allocations{};
+  Counter AllocatedBytes{};
+};
+
+//A sink for ParseOptions::Stats that any number of threads may share. Every
+//parse counts into a local copy & adds it to the sink with relaxed atomic
+//adds when it's done, so threads never lock or contend while parsing.
+using ParseStats = BasicParseStats< std::atomic<U64> >;
+
+struct ParseOptions
+{
+  //When set, UTF8 constants are interned into this table instead of every 
+  //UTF8Info owning a copy of its string. The table must outlive the parsed 
+  //classes and may be shared by any number of threads parsing concurrently.
+  SymbolTable* Symbols{nullptr};
+
+  //Resource the containers & strings of the parsed model are allocated from,
+  //the default resource when null. Attributes & constants themselves are
+  //still heap allocated. The result must not outlive the resource.
+  std::pmr::memory_resource* Resource{nullptr};
+
+  //Limits for parsing untrusted input, 0 means unlimited. Every allocation
+  //whose size is read from the input (pool, members, attributes, strings,
+  //code) is charged against MaxAllocatedBytes before it's made, so a hostile
+  //count fails the parse instead of exhausting memory.
+  U64 MaxAllocatedBytes{0};
+
+  //How deep attributes may nest: those of a class or member are at depth 1,
+  //the attributes of their Code at depth 2.
+  U32 MaxNestingDepth{0};
+
+  //Rejects counts & lengths that claim more bytes than are left in the
+  //stream. Checked once per count, so it's cheap, but only done for streams
+  //that can seek.
+  bool CheckLengths{true};
+
+  //When set, the parser fills in statistics. Parsing without a sink runs a
+  //separate instantiation of the parser with every hook compiled out.
+  ParseStats* Stats{nullptr};
+};
+
+ErrorOr<ClassFile> ParseClassFile(std::istream&, const ParseOptions& = {});
+
+//Parses the start of a class file up to and including the interfaces table 
+//(magic, versions, constant pool, access flags, this & super class) and 
+//stops there, leaving Fields, Methods & Attributes of the result empty.
+ErrorOr<ClassFile> ParseClassHeader(std::istream&, const ParseOptions& = {});
+
+ErrorOr<ConstantPool> ParseConstantPool(std::istream&, const ParseOptions& = {});
+ErrorOr< std::unique_ptr<CPInfo> > ParseConstant(std::istream&, const ParseOptions& = {});
 
-ErrorOr<FieldMethodInfo> ParseFieldMethodInfo(std::istream&, const ConstantPool&);
-ErrorOr< std::unique_ptr<AttributeInfo> > ParseAttribute(std::istream&, const ConstantPool&);
+ErrorOr<FieldMethodInfo> ParseFieldMethodInfo(std::istream&, const ConstantPool&,
+    const ParseOptions& = {});
+ErrorOr< std::unique_ptr<AttributeInfo> > ParseAttribute(std::istream&, const ConstantPool&,
+    const ParseOptions& = {});
 
 ErrorOr<Instruction> ParseInstruction(std::istream&);
 
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "ClassFile.hpp"
+#include "Error.hpp"
+#include "Frames.hpp"
+
+namespace ClassFile
+{
+namespace Transform
+{
+
+//Removes the redundancies code generators tend to leave behind from a
+//method's code, using a fixed table of rules applied in a few linear passes
+//until nothing changes anymore:
+//
+//  - unreachable blocks are removed
+//  - nops & gotos to the next instruction are removed
+//  - ldc_w of an index below 256 becomes ldc
+//  - a side effect free push followed by pop/pop2 of it is removed
+//    (constants, loads, dup & dup2)
+//  - load x; store x is removed
+//  - store x; load x becomes dup; store x
+//
+//Pairs are only rewritten within a basic block. The exception table and the
+//line & local variable tables are kept consistent (see CodeEditor). Once
+//something changed, MaxStack & MaxLocals are recomputed and so is the
+//StackMapTable through the oracle if the method had one. The code is
+//rewritten in a copy of the Code attribute that replaces the method's once
+//everything succeeded, on failure the method keeps the code it had.
+//
+//Returns the number of rewrites applied. Fails for code the ControlFlowGraph
+//or CodeEditor reject.
+ErrorOr<size_t> OptimizePeephole(ClassFile& cf, FieldMethodInfo& method, const HierarchyOracle&);
+
+//OptimizePeephole() for every method with code
+ErrorOr<size_t> OptimizePeephole(ClassFile& cf, const HierarchyOracle&);
+
+} //namespace Transform
+} //namespace ClassFile
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "ConstantPool.hpp"
+#include "OpCodes.hpp"
+#include "Error.hpp"
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ClassFile
+{
+namespace RefScanner
+{
+
+//A constant to search for. Targets are matched by value, so the same target
+//finds its uses in any class regardless of where that class's pool keeps it.
+struct Target
+{
+  enum class Kind
+  {
+    Class,  //new, checkcast, instanceof, anewarray, multianewarray & ldc
+    String, //ldc of a string literal
+    Field,  //get/put field/static
+    Method, //invoke*, matches Methodrefs & InterfaceMethodrefs
+  };
+
+  Kind TargetKind;
+  std::string Owner;      //the class, or the string value of a String target
+  std::string Name;       //fields & methods only
+  std::string Descriptor; //fields & methods only
+
+  static Target Class(std::string name);
+  static Target String(std::string value);
+  static Target Field(std::string owner, std::string name, std::string descriptor);
+  static Target Method(std::string owner, std::string name, std::string descriptor);
+};
+
+//Set of constant pool indices, membership tests are a single bit test
+class IndexSet
+{
+  public:
+    IndexSet();
+
+    void Add(U16 index);
+    bool Contains(U16 index) const;
+
+    bool Empty() const;
+    const std::vector<U16>& GetIndices() const;
+
+  private:
+    std::vector<U64> m_bits;
+    std::vector<U16> m_indices;
+};
+
+//Calls onSite(pc, op, index) for every instruction of a raw code array (the
+//code[] of a Code attribute) whose constant pool operand is in indices.
+//
+//The code is walked using the opcode length table without building
+//Instructions. Before that the bytes are searched, using SSE2 where
+//available, for the byte patterns a matching operand would produce, and code
+//that doesn't contain any of them is skipped without walking it.
+ErrorOr<void> ScanCode(const U8* code, size_t len, const IndexSet& indices,
+    const std::function<void(U32 pc, OpCode, U16 index)>& onSite);
+
+//An instruction referring to one of the targets
+struct Site
+{
+  size_t Target; //index into the searched targets
+  U16 Method;    //index into the class's methods
+  U32 PC;
+  OpCode Op;
+  U16 Index;     //constant pool index of the target in this class
+
+  //point into the searched class file bytes
+  std::string_view MethodName;
+  std::string_view MethodDescriptor;
+};
+
+//Indices of the constants in a raw class file's pool that match targets,
+//one set per target. Only looks at the constant pool.
+ErrorOr< std::vector<IndexSet> > FindConstants(const U8* classBytes, size_t len,
+    const std::vector<Target>& targets);
+
+//Finds every instruction of a raw class file that refers to one of targets,
+//with a site for each target the instruction refers to.
+//The constant pool is searched first and the method bodies are only scanned
+//if it contains at least one of the targets, so for most classes a query is
+//little more than a pass over the pool.
+ErrorOr< std::vector<Site> > FindReferences(const U8* classBytes, size_t len,
+    const std::vector<Target>& targets);
+
+} //namespace RefScanner
+} //namespace ClassFile
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "ClassFile.hpp"
+#include "Error.hpp"
+
+#include <string>
+#include <vector>
+
+namespace ClassFile
+{
+
+//Which attributes StripAttributes() removes
+struct StripOptions
+{
+  bool LineNumbers{true};       //LineNumberTable
+  bool SourceFile{true};        //SourceFile & SourceDebugExtension
+  bool LocalVariables{true};    //LocalVariableTable & LocalVariableTypeTable
+
+  //attributes the JVM specification doesn't define, e.g. vendor specific ones
+  bool UnknownAttributes{true};
+
+  //further attributes to remove by name
+  std::vector<std::string> Names;
+};
+
+struct ShrinkOptions
+{
+  StripOptions Strip;
+
+  //compacts the constant pool once the attributes are gone, see
+  //Transform::CompactConstantPool()
+  bool CompactConstantPool{true};
+
+  //0 picks the hardware concurrency
+  unsigned Threads{0};
+};
+
+struct ShrinkStats
+{
+  size_t Classes{0};
+  size_t AttributesRemoved{0};
+  size_t ConstantsRemoved{0};
+  U64 BytesIn{0};
+  U64 BytesOut{0};
+};
+
+namespace Transform
+{
+
+//Removes the attributes selected by options from the class, its fields &
+//methods and their Code attributes. Returns the number of attributes removed.
+//The constants they referred to stay in the pool until it's compacted.
+ErrorOr<size_t> StripAttributes(ClassFile&, const StripOptions& = {});
+
+//Strips & compacts one class in place
+ErrorOr<void> Shrink(ClassFile&, const ShrinkOptions& = {}, ShrinkStats* stats = nullptr);
+
+//Parses every class file below inputRoot, shrinks it & writes it to the same
+//relative path below outputRoot, spreading the classes over options.Threads
+//threads. inputRoot may be a single class file, in which case outputRoot is
+//the path it's written to. Fails on the first class (in path order) that
+//couldn't be read, shrunk or written, classes that were written stay.
+ErrorOr<ShrinkStats> ShrinkClasspath(const std::string& inputRoot,
+    const std::string& outputRoot, const ShrinkOptions& = {});
+
+} //namespace Transform
+} //namespace ClassFile
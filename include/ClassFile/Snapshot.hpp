@@ -0,0 +1,198 @@
+#pragma once
+
+#include "ClassFile.hpp"
+#include "Fingerprint.hpp"
+#include "Parser.hpp"
+#include "Error.hpp"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ClassFile
+{
+
+//A snapshot is a single file holding any number of classes in a form that is
+//used in place once the file is mapped into memory: every class is stored as
+//its original class file bytes plus precomputed tables (constant offsets,
+//member & attribute records) that locate everything inside of those bytes.
+//Records refer to each other by offset, never by pointer, so nothing needs to
+//be relocated or decoded when a snapshot is loaded.
+//
+//Snapshots are meant as a machine local cache: they are written in the byte
+//order of the host and rejected by hosts of the other byte order.
+//
+//Views are cheap to copy & valid as long as the Snapshot they came from.
+class ClassView;
+
+class AttributeView
+{
+  public:
+    U16 GetNameIndex() const;
+
+    //the attribute payload in class file form (following attribute_length)
+    const U8* GetBytes() const;
+    U32 GetLength() const;
+
+  private:
+    friend class MemberView;
+    friend class ClassView;
+    AttributeView(const U8* classBytes, const U8* record) : m_classBytes{classBytes}, m_record{record} {}
+
+    const U8* m_classBytes;
+    const U8* m_record;
+};
+
+class MemberView
+{
+  public:
+    U16 GetAccessFlags() const;
+    U16 GetNameIndex() const;
+    U16 GetDescriptorIndex() const;
+
+    std::string_view GetName() const;
+    std::string_view GetDescriptor() const;
+
+    U16 GetAttributeCount() const;
+    AttributeView GetAttribute(U16 index) const;
+
+    //code[] of the Code attribute, nullptr & 0 for methods without one
+    const U8* GetCode() const;
+    U32 GetCodeLength() const;
+
+  private:
+    friend class ClassView;
+    MemberView(const U8* base, const U8* classRecord, const U8* record)
+      : m_base{base}, m_class{classRecord}, m_record{record} {}
+
+    ClassView getClass() const;
+
+    const U8* m_base;
+    const U8* m_class;
+    const U8* m_record;
+};
+
+class ClassView
+{
+  public:
+    U16 GetMinorVersion() const;
+    U16 GetMajorVersion() const;
+    U16 GetAccessFlags() const;
+    U16 GetThisClass() const;
+    U16 GetSuperClass() const;
+
+    std::string_view GetName() const;
+    std::string_view GetSuperName() const; //empty for java/lang/Object
+
+    //Constant pool, read in place. Indices that don't hold a constant have a
+    //tag of 0.
+    U16 GetConstCount() const;
+    U8 GetTag(U16 index) const;
+    U16 GetConstField(U16 index, size_t n) const; //n-th U16 after the tag
+
+    //empty unless index is a UTF8, or a Class, String or MethodType whose
+    //name/descriptor is one
+    std::string_view GetUTF8(U16 index) const;
+
+    U16 GetInterfaceCount() const;
+    U16 GetInterface(U16 index) const;
+
+    U16 GetFieldCount() const;
+    U16 GetMethodCount() const;
+    MemberView GetField(U16 index) const;
+    MemberView GetMethod(U16 index) const;
+
+    U16 GetAttributeCount() const;
+    AttributeView GetAttribute(U16 index) const;
+
+    //the original class file
+    const U8* GetBytes() const;
+    U32 GetLength() const;
+
+    //Fully parses the class, for when the views aren't enough
+    ErrorOr<ClassFile> Parse(const Parser::ParseOptions& = {}) const;
+
+  private:
+    friend class Snapshot;
+    friend class MemberView;
+    ClassView(const U8* base, const U8* record);
+
+    const U8* m_base;
+    const U8* m_record;
+    const U8* m_bytes;
+};
+
+class Snapshot
+{
+  public:
+    static constexpr U32 Version = 1;
+
+    //Maps the file into memory (or reads it where mapping isn't available)
+    //and checks that all of its records stay within bounds
+    static ErrorOr<Snapshot> Open(const std::string& path);
+
+    //The key the snapshot was written with, see SnapshotCache
+    Fingerprint GetKey() const;
+
+    U32 GetClassCount() const;
+    ClassView GetClass(U32 index) const;
+
+    //Binary search over the class names, ~0 if there is no such class
+    U32 Find(std::string_view className) const;
+
+  private:
+    struct storage;
+
+    Snapshot() = default;
+    ErrorOr<void> validate() const;
+
+    std::shared_ptr<const storage> m_storage;
+    const U8* m_base{nullptr};
+    size_t m_size{0};
+};
+
+//Collects classes & writes them as a snapshot
+class SnapshotWriter
+{
+  public:
+    //The bytes are copied, only their structure is checked
+    ErrorOr<void> Add(const U8* classBytes, size_t len);
+    ErrorOr<void> Add(const ClassFile&);
+
+    size_t GetClassCount() const;
+
+    //Writes to a temporary file next to path that is renamed to path when
+    //complete, so readers never see a partially written snapshot. Each call
+    //uses its own temporary file, writers racing on path are fine.
+    ErrorOr<void> Write(const std::string& path, const Fingerprint& key) const;
+
+  private:
+    std::vector< std::vector<U8> > m_classes;
+    std::vector<std::string> m_names;
+};
+
+//A directory of snapshots named after the hash of their contents
+class SnapshotCache
+{
+  public:
+    explicit SnapshotCache(std::string directory);
+
+    //Hash over the contents of the files, in order
+    static ErrorOr<Fingerprint> HashFiles(const std::vector<std::string>& paths);
+
+    std::string GetPath(const Fingerprint& key) const;
+
+    //Fails if there's no valid snapshot for key
+    ErrorOr<Snapshot> Load(const Fingerprint& key) const;
+    ErrorOr<Snapshot> Store(const Fingerprint& key, const SnapshotWriter&) const;
+
+    //Loads the snapshot of the class files at paths, building & storing it
+    //first if it doesn't exist yet
+    ErrorOr<Snapshot> LoadOrBuild(const std::vector<std::string>& paths) const;
+
+  private:
+    std::string m_directory;
+};
+
+} //namespace ClassFile
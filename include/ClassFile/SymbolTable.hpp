@@ -0,0 +1,82 @@
+#pragma once
+
+#include "Defs.hpp"
+
+#include <atomic>
+#include <memory>
+#include <string_view>
+
+namespace ClassFile
+{
+
+//An interned, immutable string owned by a SymbolTable. A table never holds 
+//two symbols with the same contents, so symbols of the same table are equal 
+//if and only if their addresses are and can be compared & hashed by pointer.
+class Symbol
+{
+  public:
+    std::string_view GetString() const 
+    { 
+      return {reinterpret_cast<const char*>(this + 1), m_length}; 
+    }
+
+    size_t GetHash() const { return m_hash; }
+
+    Symbol(const Symbol&) = delete;
+    Symbol& operator=(const Symbol&) = delete;
+
+  private:
+    friend class SymbolTable;
+    Symbol(size_t hash, size_t length) : m_hash{hash}, m_length{length} {}
+
+    //the characters are stored right behind the object in the same allocation
+    const Symbol* m_next{nullptr};
+    size_t m_hash;
+    size_t m_length;
+};
+
+//A string interner that any number of threads can use concurrently.
+//
+//Symbols are kept in a fixed array of buckets, each bucket being a linked
+//list that only ever grows at its head. Lookups are plain atomic loads and 
+//inserts a single compare-and-swap on the bucket head, so no locks are taken
+//and readers never wait for writers. Symbols are never removed, they live
+//until the table is destroyed.
+//
+//The bucket count is fixed at construction, lookups degrade gracefully 
+//(longer chains) once the table holds a lot more symbols than it has buckets.
+class SymbolTable
+{
+  public:
+    explicit SymbolTable(size_t bucketCount = 1 << 16);
+    ~SymbolTable();
+
+    SymbolTable(const SymbolTable&) = delete;
+    SymbolTable& operator=(const SymbolTable&) = delete;
+
+    //Returns the symbol for string, creating it if it doesn't exist yet
+    const Symbol* Intern(std::string_view string);
+
+    //Returns the symbol for string or nullptr if it was never interned
+    const Symbol* Find(std::string_view string) const;
+
+    size_t GetCount() const;
+
+    //Total bytes allocated for symbols, including the per-symbol header
+    size_t GetMemoryUsage() const;
+
+    //A process wide table, created on first use
+    static SymbolTable& Global();
+
+  private:
+    const Symbol* findInChain(const Symbol* head, const Symbol* end, 
+        std::string_view string, size_t hash) const;
+
+    std::unique_ptr< std::atomic<const Symbol*>[] > m_buckets;
+    size_t m_mask;
+
+    std::atomic<size_t> m_count{0};
+    std::atomic<size_t> m_memoryUsage{0};
+};
+
+} //namespace ClassFile
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "ClassFile.hpp"
+#include "Error.hpp"
+
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+namespace ClassFile
+{
+
+//What Synthetic::Generate() puts into a class. Everything derived from random
+//numbers (constant values, code, descriptors) comes from Seed, so equal
+//options generate byte for byte equal classes.
+struct SyntheticOptions
+{
+  std::string Name{"synthetic/Generated"};
+  U64 Seed{0};
+
+  U32 Fields{0};
+
+  //static methods with straight line code of CodeLength bytes each (at least
+  //32, at most 65535) that keeps the stack balanced
+  U32 Methods{0};
+  U32 CodeLength{64};
+
+  //adds a method with every opcode the model supports, in its plain & wide
+  //forms. The code is well formed but not meant to verify.
+  bool AllOpCodes{false};
+
+  //nesting of the annotation put on the class, 0 for none
+  U32 AnnotationDepth{0};
+
+  //pads the constant pool with Integers to the 65534 usable entries
+  bool FillConstantPool{false};
+
+  //resource the class is built with, the default resource when null
+  std::pmr::memory_resource* Resource{nullptr};
+};
+
+namespace Synthetic
+{
+
+//Classes at the limits of the class file format
+enum class Shape
+{
+  MaxConstantPool,
+  MaxCode,          //methods of 65535 bytes
+  ManyMembers,      //5000 fields & 5000 methods
+  DeepAttributes,   //annotations nested 1000 levels deep
+  AllOpCodes,
+};
+
+SyntheticOptions GetPreset(Shape, U64 seed = 0);
+
+ErrorOr<ClassFile> Generate(const SyntheticOptions&);
+
+//Generates & serializes one class per Shape into dir, named after the shape
+//(e.g. "MaxCode.class"). Returns the paths written.
+ErrorOr< std::vector<std::string> > WriteCorpus(const std::string& dir, U64 seed = 0);
+
+} //namespace Synthetic
+} //namespace ClassFile
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "ClassFile.hpp"
+#include "Error.hpp"
+
+namespace ClassFile
+{
+namespace Transform
+{
+
+//Removes every constant pool entry that isn't reachable from the rest of the
+//class (members, attributes at every level and instruction operands) and 
+//rewrites all indices to match the compacted pool. Entries only referenced by
+//other unreachable entries are removed as well.
+//
+//Raw attributes are searched for indices using their standard layout. The 
+//pass fails without modifying the class if a raw attribute's layout is 
+//unknown, as any of its bytes could be a constant pool index.
+//
+//On success returns the number of pool slots that were freed.
+ErrorOr<U16> CompactConstantPool(ClassFile&);
+
+} //namespace Transform
+} //namespace ClassFile
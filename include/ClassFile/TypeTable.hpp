@@ -0,0 +1,138 @@
+#pragma once
+
+#include "Defs.hpp"
+#include "Error.hpp"
+#include "SymbolTable.hpp"
+
+#include <atomic>
+#include <memory>
+#include <shared_mutex>
+#include <string_view>
+#include <unordered_map>
+
+namespace ClassFile
+{
+
+//Interns field & method descriptors as dense integer ids, so types compare
+//& hash as integers and their structure is decoded once per table.
+//
+//Types are shared structurally: an array type refers to the id of its
+//component type (the type with one dimension less) and a method type to the
+//ids of its parameter & return types. Object types carry the interned
+//symbol of their class name, which is what ClassHierarchy::Find() takes, so
+//subtype queries go from a type id to a class id without any string work.
+//
+//The primitive types & void have the same fixed ids in every table, see
+//GetPrimitive(). Ids are handed out in interning order.
+//
+//Any number of threads may intern & query concurrently. Queries by id never
+//lock: types are immutable once interned and are stored in chunks that never
+//move. Looking up a descriptor (Find() & Intern()) takes a shared lock, and
+//interning one that isn't known yet an exclusive lock to insert it.
+class TypeTable
+{
+  public:
+    using TypeId = U32;
+    static constexpr TypeId InvalidId = ~TypeId{0};
+
+    //The first ten kinds match TypeView::Kind
+    enum class Kind : U8
+    {
+      Byte, Char, Double, Float, Int, Long, Short, Boolean, Object, Void,
+      Array, Method
+    };
+
+    //Contiguous view of ids, as returned by GetParameters()
+    struct Range
+    {
+      const TypeId* First;
+      const TypeId* Last;
+
+      const TypeId* begin() const { return First; }
+      const TypeId* end() const { return Last; }
+      size_t size() const { return static_cast<size_t>(Last - First); }
+      bool empty() const { return First == Last; }
+    };
+
+    //Descriptors & class names are interned into symbols, which must outlive
+    //the table
+    explicit TypeTable(SymbolTable& symbols = SymbolTable::Global());
+    ~TypeTable();
+
+    TypeTable(const TypeTable&) = delete;
+    TypeTable& operator=(const TypeTable&) = delete;
+
+    //Id of Byte through Boolean or Void, InvalidId for the kinds that have
+    //no fixed id (Object, Array & Method)
+    static constexpr TypeId GetPrimitive(Kind kind)
+    {
+      switch(kind)
+      {
+        case Kind::Object: case Kind::Array: case Kind::Method: return InvalidId;
+        case Kind::Void: return 8;
+        default: return static_cast<TypeId>(kind);
+      }
+    }
+
+    //Returns the id of a field or method descriptor, interning it and the
+    //types it's made of if they're new. Fails if the descriptor is invalid.
+    ErrorOr<TypeId> Intern(std::string_view descriptor);
+
+    //The array type with one more dimension than component
+    ErrorOr<TypeId> InternArray(TypeId component);
+
+    //InvalidId if the descriptor was never interned
+    TypeId Find(std::string_view descriptor) const;
+
+    size_t GetCount() const;
+    SymbolTable& GetSymbols() const { return m_symbols; }
+
+    //Unique for every table created by the process, unlike its address which
+    //a later table may reuse. Lets caches of ids tell tables apart.
+    U64 GetGeneration() const { return m_generation; }
+
+    //The queries below take ids of this table
+    Kind GetKind(TypeId) const;
+    const Symbol* GetDescriptor(TypeId) const;
+
+    //Local variable & operand stack slots a value takes, 0 for void & methods
+    U32 GetSlots(TypeId) const;
+
+    //Object types & arrays of them: the class name, nullptr for others
+    const Symbol* GetClassName(TypeId) const;
+
+    //Arrays: the type with one dimension less (GetComponent()), the type
+    //without any (GetElement()) and the number of dimensions, which is 0
+    //for anything that isn't an array. InvalidId for non arrays.
+    TypeId GetComponent(TypeId) const;
+    TypeId GetElement(TypeId) const;
+    U8 GetDimensions(TypeId) const;
+
+    //Methods: parameter & return types, the slots the parameters take
+    //(without the receiver). Empty & InvalidId for other types.
+    Range GetParameters(TypeId) const;
+    TypeId GetReturnType(TypeId) const;
+    U32 GetParameterSlots(TypeId) const;
+
+  private:
+    struct entry;
+
+    static constexpr U32 chunkBits = 12;
+    static constexpr U32 chunkSize = 1 << chunkBits;
+    static constexpr U32 maxChunks = 1 << 12;
+
+    const entry& get(TypeId) const;
+    TypeId findSymbol(const Symbol* descriptor) const;
+    TypeId insert(entry&&);
+
+    SymbolTable& m_symbols;
+    U64 m_generation;
+
+    std::unique_ptr< std::atomic<entry*>[] > m_chunks;
+    std::atomic<TypeId> m_count{0};
+
+    mutable std::shared_mutex m_mutex;
+    std::unordered_map<const Symbol*, TypeId> m_ids;
+};
+
+} //namespace ClassFile
@@ -0,0 +1,448 @@
+#include "ClassFile/CallGraph.hpp"
+#include "ClassFile/Parser.hpp"
+
+#include <fmt/core.h>
+
+#include "Util/Error.hpp"
+#include "Util/Parallel.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <tuple>
+#include <cassert>
+
+namespace ClassFile
+{
+
+struct CallGraph::ClassCalls
+{
+  //one per method of the class, in declaration order
+  std::vector<MethodKey> Declared;
+  std::vector<U16> DeclaredFlags;
+
+  //every distinct method ref called by the class, resolved once
+  std::vector<MethodKey> Refs;
+
+  struct Site
+  {
+    U32 Caller; //index into Declared
+    U32 Ref;    //index into Refs
+    CallKind Kind;
+  };
+  std::vector<Site> Sites;
+};
+
+size_t CallGraph::MethodKeyHash::operator()(const MethodKey& key) const
+{
+  //symbols are unique per string, so hashing the pointers is enough
+  std::hash<const void*> hash;
+  size_t h = hash(key.Owner);
+  h ^= hash(key.Name) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+  h ^= hash(key.Descriptor) + 0x9e3779b97f4a7c15ull + (h << 6) + (h >> 2);
+  return h;
+}
+
+static bool getCallKind(OpCode op, CallGraph::CallKind& kind)
+{
+  switch(op)
+  {
+    case OpCode::INVOKEVIRTUAL:   kind = CallGraph::CallKind::Virtual;   return true;
+    case OpCode::INVOKESPECIAL:   kind = CallGraph::CallKind::Special;   return true;
+    case OpCode::INVOKESTATIC:    kind = CallGraph::CallKind::Static;    return true;
+    case OpCode::INVOKEINTERFACE: kind = CallGraph::CallKind::Interface; return true;
+    default: break;
+  }
+
+  return false;
+}
+
+static ErrorOr<CallGraph::MethodKey> resolveMethodRef(const ConstantPool& cp, U16 index,
+    SymbolTable& symbols)
+{
+  auto errOrRef = cp.ResolveMemberRef(index);
+  VERIFY(errOrRef);
+
+  const MemberRef& ref = errOrRef.Get();
+
+  //invokestatic & invokespecial may refer to interface methods as well
+  if(ref.Type != CPInfo::Type::Methodref && ref.Type != CPInfo::Type::InterfaceMethodref)
+  {
+    return Error{fmt::format("invoke operand #{} is a {}, not a method ref",
+        index, CPInfo::GetTypeName(ref.Type))};
+  }
+
+  return CallGraph::MethodKey{symbols.Intern(ref.Owner),
+    symbols.Intern(ref.Name), symbols.Intern(ref.Descriptor)};
+}
+
+ErrorOr<CallGraph::ClassCalls> CallGraph::extract(const ClassFile& cf, SymbolTable& symbols)
+{
+  ClassCalls calls;
+
+  auto errOrOwner = cf.ConstPool.LookupString(cf.ThisClass);
+  VERIFY(errOrOwner, "failed to lookup this_class name");
+  const Symbol* owner = symbols.Intern(errOrOwner.Get());
+
+  //maps a constant pool index to its entry in calls.Refs, so every method ref
+  //is looked up & interned once per class rather than once per call site
+  constexpr U32 unresolved = ~U32{0};
+  std::vector<U32> refCache(cf.ConstPool.GetCount(), unresolved);
+
+  calls.Declared.reserve(cf.Methods.size());
+  calls.DeclaredFlags.reserve(cf.Methods.size());
+
+  for(const FieldMethodInfo& method : cf.Methods)
+  {
+    auto errOrName = cf.ConstPool.LookupString(method.NameIndex);
+    VERIFY(errOrName, "failed to lookup method name");
+    auto errOrDescriptor = cf.ConstPool.LookupString(method.DescriptorIndex);
+    VERIFY(errOrDescriptor, "failed to lookup method descriptor");
+
+    U32 caller = static_cast<U32>(calls.Declared.size());
+    calls.Declared.push_back({owner, symbols.Intern(errOrName.Get()),
+        symbols.Intern(errOrDescriptor.Get())});
+    calls.DeclaredFlags.push_back(method.AccessFlags);
+
+    for(const auto& attr : method.Attributes)
+    {
+      if(attr->GetType() != AttributeInfo::Type::Code)
+        continue;
+
+      for(const Instruction& instr : static_cast<const CodeAttribute&>(*attr).Code)
+      {
+        CallKind kind;
+        if(!getCallKind(instr.GetOpCode(), kind))
+          continue;
+
+        auto errOrIndex = instr.GetOperand(0);
+        VERIFY(errOrIndex);
+        U16 index = static_cast<U16>(errOrIndex.Get());
+
+        if(index >= refCache.size())
+        {
+          return Error{fmt::format("{} operand #{} is out of bounds",
+              instr.GetMnemonic(), index)};
+        }
+
+        if(refCache[index] == unresolved)
+        {
+          auto errOrKey = resolveMethodRef(cf.ConstPool, index, symbols);
+          VERIFY(errOrKey);
+
+          refCache[index] = static_cast<U32>(calls.Refs.size());
+          calls.Refs.push_back(errOrKey.Get());
+        }
+
+        calls.Sites.push_back({caller, refCache[index], kind});
+      }
+    }
+  }
+
+  return calls;
+}
+
+ErrorOr<CallGraph> CallGraph::Build(const std::vector<std::string>& paths, const Options& options)
+{
+  std::vector<ClassCalls> calls(paths.size());
+  std::vector<Error> errors(paths.size());
+  std::vector<U8> failed(paths.size(), false); //not vector<bool>, threads write it
+
+  Parser::ParseOptions parseOptions;
+  parseOptions.Symbols = options.Symbols;
+
+  ParallelFor(paths.size(), options.Threads, [&](size_t i)
+  {
+    std::ifstream stream{paths[i], std::ios::binary};
+
+    auto errOrClass = Parser::ParseClassFile(stream, parseOptions);
+    auto errOrCalls = errOrClass.IsError() ? ErrorOr<ClassCalls>{errOrClass.GetError()}
+                                           : extract(errOrClass.Get(), *options.Symbols);
+
+    if(errOrCalls.IsError())
+    {
+      failed[i] = true;
+      errors[i] = errOrCalls.GetError();
+      return;
+    }
+
+    calls[i] = errOrCalls.Release();
+  });
+
+  //reported in input order so the error doesn't depend on thread scheduling
+  for(size_t i = 0; i < paths.size(); i++)
+  {
+    if(failed[i])
+    {
+      return Error{fmt::format("CallGraph::Build(): failed to scan "
+          "\"{}\":\n  {}", paths[i], errors[i].What)};
+    }
+  }
+
+  return link(calls, options);
+}
+
+ErrorOr<CallGraph> CallGraph::Build(const std::vector<const ClassFile*>& classes,
+    const Options& options)
+{
+  std::vector<ClassCalls> calls(classes.size());
+  std::vector<Error> errors(classes.size());
+  std::vector<U8> failed(classes.size(), false);
+
+  ParallelFor(classes.size(), options.Threads, [&](size_t i)
+  {
+    auto errOrCalls = extract(*classes[i], *options.Symbols);
+
+    if(errOrCalls.IsError())
+    {
+      failed[i] = true;
+      errors[i] = errOrCalls.GetError();
+      return;
+    }
+
+    calls[i] = errOrCalls.Release();
+  });
+
+  for(size_t i = 0; i < classes.size(); i++)
+  {
+    if(failed[i])
+    {
+      return Error{fmt::format("CallGraph::Build(): failed to scan class #{}:"
+          "\n  {}", i, errors[i].What)};
+    }
+  }
+
+  return link(calls, options);
+}
+
+CallGraph::MethodId CallGraph::getOrAddId(const MethodKey& key)
+{
+  auto [itr, added] = m_ids.emplace(key, static_cast<MethodId>(m_methods.size()));
+
+  if(added)
+    m_methods.push_back(key);
+
+  return itr->second;
+}
+
+CallGraph CallGraph::link(std::vector<ClassCalls>& classes, const Options& options)
+{
+  CallGraph g;
+  g.m_symbols = options.Symbols;
+
+  const ClassHierarchy* hierarchy = options.Hierarchy;
+
+  //declared methods get the ids [0, nDeclared), the first declaration wins if
+  //a class is defined more than once
+  std::vector<U16> flags;
+  std::vector< std::vector<MethodId> > callerIds(classes.size());
+
+  for(size_t c = 0; c < classes.size(); c++)
+  {
+    callerIds[c].reserve(classes[c].Declared.size());
+
+    for(size_t i = 0; i < classes[c].Declared.size(); i++)
+    {
+      MethodId id = g.getOrAddId(classes[c].Declared[i]);
+
+      if(id == flags.size())
+        flags.push_back(classes[c].DeclaredFlags[i]);
+
+      callerIds[c].push_back(id);
+    }
+  }
+
+  g.m_nDeclared = g.m_methods.size();
+
+  auto findDeclared = [&](const MethodKey& key)
+  {
+    auto itr = g.m_ids.find(key);
+    return itr != g.m_ids.end() && itr->second < g.m_nDeclared ? itr->second : InvalidId;
+  };
+
+  //a ref to a method the owner only inherits resolves to the nearest
+  //superclass that declares it
+  auto resolve = [&](const MethodKey& key)
+  {
+    if(hierarchy && findDeclared(key) == InvalidId)
+    {
+      ClassHierarchy::ClassId owner = hierarchy->Find(key.Owner);
+
+      for(ClassHierarchy::ClassId c = owner == ClassHierarchy::InvalidId ? owner
+          : hierarchy->GetSuperClass(owner); c != ClassHierarchy::InvalidId;
+          c = hierarchy->GetSuperClass(c))
+      {
+        MethodId id = findDeclared({hierarchy->GetSymbol(c), key.Name, key.Descriptor});
+
+        if(id != InvalidId)
+          return id;
+      }
+    }
+
+    return g.getOrAddId(key);
+  };
+
+  //overrides of a resolved target declared by subtypes of its owner, memoized
+  //as popular virtual methods are called from many places
+  constexpr U16 notOverridable =
+    static_cast<U16>(FieldMethodInfo::AccessFlag::STATIC) |
+    static_cast<U16>(FieldMethodInfo::AccessFlag::PRIVATE);
+
+  std::unordered_map< MethodId, std::vector<MethodId> > overrides;
+
+  auto getOverrides = [&](MethodId target) -> const std::vector<MethodId>&
+  {
+    auto [itr, added] = overrides.try_emplace(target);
+
+    if(!added)
+      return itr->second;
+
+    MethodKey key = g.m_methods[target];
+    ClassHierarchy::ClassId owner = hierarchy->Find(key.Owner);
+
+    if(owner == ClassHierarchy::InvalidId)
+      return itr->second;
+
+    for(ClassHierarchy::ClassId sub : hierarchy->GetAllSubtypes(owner))
+    {
+      MethodId id = findDeclared({hierarchy->GetSymbol(sub), key.Name, key.Descriptor});
+
+      if(id != InvalidId && !(flags[id] & notOverridable))
+        itr->second.push_back(id);
+    }
+
+    return itr->second;
+  };
+
+  struct Edge
+  {
+    MethodId Caller;
+    MethodId Target;
+    CallKind Kind;
+
+    bool operator<(const Edge& other) const
+    {
+      return std::tie(Caller, Target, Kind) < std::tie(other.Caller, other.Target, other.Kind);
+    }
+
+    bool operator==(const Edge& other) const
+    {
+      return Caller == other.Caller && Target == other.Target && Kind == other.Kind;
+    }
+  };
+
+  std::vector<Edge> edges;
+  std::vector<MethodId> refIds;
+
+  for(size_t c = 0; c < classes.size(); c++)
+  {
+    const ClassCalls& calls = classes[c];
+
+    refIds.clear();
+    for(const MethodKey& ref : calls.Refs)
+      refIds.push_back(resolve(ref));
+
+    for(const ClassCalls::Site& site : calls.Sites)
+    {
+      MethodId caller = callerIds[c][site.Caller];
+      MethodId target = refIds[site.Ref];
+      edges.push_back({caller, target, site.Kind});
+
+      bool dispatched = site.Kind == CallKind::Virtual || site.Kind == CallKind::Interface;
+
+      if(hierarchy && dispatched)
+      {
+        for(MethodId override : getOverrides(target))
+          edges.push_back({caller, override, site.Kind});
+      }
+    }
+
+    //the keys aren't needed anymore, free them as we go
+    classes[c] = ClassCalls{};
+  }
+
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+  size_t n = g.m_methods.size();
+
+  g.m_offsets.assign(n + 1, 0);
+  g.m_targets.reserve(edges.size());
+  g.m_kinds.reserve(edges.size());
+
+  for(const Edge& edge : edges)
+  {
+    g.m_offsets[edge.Caller + 1]++;
+    g.m_targets.push_back(edge.Target);
+    g.m_kinds.push_back(edge.Kind);
+  }
+
+  for(size_t i = 0; i < n; i++)
+    g.m_offsets[i + 1] += g.m_offsets[i];
+
+  return g;
+}
+
+size_t CallGraph::GetMethodCount() const
+{
+  return m_methods.size();
+}
+
+size_t CallGraph::GetEdgeCount() const
+{
+  return m_targets.size();
+}
+
+CallGraph::MethodId CallGraph::Find(std::string_view owner, std::string_view name,
+    std::string_view descriptor) const
+{
+  MethodKey key{m_symbols->Find(owner), m_symbols->Find(name), m_symbols->Find(descriptor)};
+
+  if(!key.Owner || !key.Name || !key.Descriptor)
+    return InvalidId;
+
+  return Find(key);
+}
+
+CallGraph::MethodId CallGraph::Find(const MethodKey& key) const
+{
+  auto itr = m_ids.find(key);
+  return itr == m_ids.end() ? InvalidId : itr->second;
+}
+
+const CallGraph::MethodKey& CallGraph::GetMethod(MethodId id) const
+{
+  assert(id < m_methods.size());
+  return m_methods[id];
+}
+
+bool CallGraph::IsDeclared(MethodId id) const
+{
+  assert(id < m_methods.size());
+  return id < m_nDeclared;
+}
+
+const CallGraph::MethodId* CallGraph::CalleesBegin(MethodId id) const
+{
+  assert(id < m_methods.size());
+  return m_targets.data() + m_offsets[id];
+}
+
+const CallGraph::MethodId* CallGraph::CalleesEnd(MethodId id) const
+{
+  assert(id < m_methods.size());
+  return m_targets.data() + m_offsets[id + 1];
+}
+
+const CallGraph::CallKind* CallGraph::CallKindsBegin(MethodId id) const
+{
+  assert(id < m_methods.size());
+  return m_kinds.data() + m_offsets[id];
+}
+
+std::vector<CallGraph::MethodId> CallGraph::GetCallees(MethodId id) const
+{
+  return {CalleesBegin(id), CalleesEnd(id)};
+}
+
+} //namespace ClassFile
@@ -1,5 +1,8 @@
 #include "ClassFile/ClassFile.hpp"
 
+#include <functional>
+#include <utility>
+
 namespace ClassFile
 {
 
@@ -70,6 +73,156 @@ ErrorOr<std::string_view> ClassFile::FlagToStr(U16 flag)
   return Error{"ClassFile::FlagToStr(): undefined flag value."};
 }
 
+ClassFile ClassFile::Clone() const
+{
+  std::pmr::memory_resource* resource = ConstPool.GetResource();
+
+  ClassFile copy{resource};
+  copy.Magic = Magic;
+  copy.MinorVersion = MinorVersion;
+  copy.MajorVersion = MajorVersion;
+  copy.ConstPool = ConstPool;
+  copy.AccessFlags = AccessFlags;
+  copy.ThisClass = ThisClass;
+  copy.SuperClass = SuperClass;
+  copy.Interfaces = Interfaces;
+  copy.Attributes = Attributes;
+
+  for(auto [from, to] : {std::pair{&Fields, &copy.Fields}, std::pair{&Methods, &copy.Methods}})
+  {
+    to->reserve(from->size());
+
+    for(const FieldMethodInfo& member : *from)
+    {
+      FieldMethodInfo& added = to->emplace_back(resource);
+      added.AccessFlags = member.AccessFlags;
+      added.NameIndex = member.NameIndex;
+      added.DescriptorIndex = member.DescriptorIndex;
+      added.Attributes = member.Attributes;
+    }
+  }
+
+  return copy;
+}
+
+static size_t hashMember(std::string_view name, std::string_view descriptor)
+{
+  std::hash<std::string_view> hash;
+  return hash(name) ^ (hash(descriptor) * 0x9E3779B97F4A7C15ull);
+}
+
+static bool isMember(const ConstantPool& cp, const FieldMethodInfo& member,
+    std::string_view name, std::string_view descriptor)
+{
+  auto errOrName = cp.LookupString(member.NameIndex);
+  if(errOrName.IsError() || errOrName.Get() != name)
+    return false;
+
+  auto errOrDescriptor = cp.LookupString(member.DescriptorIndex);
+  return !errOrDescriptor.IsError() && errOrDescriptor.Get() == descriptor;
+}
+
+template <typename MemberList, typename Index>
+static const FieldMethodInfo* findMember(const ConstantPool& cp, const MemberList& members,
+    const Index& index, std::string_view name, std::string_view descriptor)
+{
+  auto [first, last] = index.Positions.equal_range(hashMember(name, descriptor));
+
+  if(first == last)
+    return nullptr;
+
+  for(auto itr = first; itr != last; ++itr)
+  {
+    if(itr->second < members.size() && isMember(cp, members[itr->second], name, descriptor))
+      return &members[itr->second];
+  }
+
+  //a candidate that moved, fall back to the scan
+  for(const FieldMethodInfo& member : members)
+  {
+    if(isMember(cp, member, name, descriptor))
+      return &member;
+  }
+
+  return nullptr;
+}
+
+const ClassFile::memberIndexes& ClassFile::getMemberIndexes() const
+{
+  return m_memberIndexes.Get([this]()
+  {
+    memberIndexes indexes;
+
+    for(auto [list, index] : {std::pair{&Fields, &indexes.Fields}, std::pair{&Methods, &indexes.Methods}})
+    {
+      index->Positions.reserve(list->size());
+
+      for(size_t i = 0; i < list->size(); i++)
+      {
+        auto errOrName = ConstPool.LookupString((*list)[i].NameIndex);
+        auto errOrDescriptor = ConstPool.LookupString((*list)[i].DescriptorIndex);
+
+        //a broken member is never found
+        if(errOrName.IsError() || errOrDescriptor.IsError())
+          continue;
+
+        index->Positions.emplace(hashMember(errOrName.Get(), errOrDescriptor.Get()), static_cast<U32>(i));
+      }
+    }
+
+    return indexes;
+  });
+}
+
+const FieldMethodInfo* ClassFile::FindField(std::string_view name, std::string_view descriptor) const
+{
+  return findMember(ConstPool, Fields, this->getMemberIndexes().Fields, name, descriptor);
+}
+
+const FieldMethodInfo* ClassFile::FindMethod(std::string_view name, std::string_view descriptor) const
+{
+  return findMember(ConstPool, Methods, this->getMemberIndexes().Methods, name, descriptor);
+}
+
+FieldMethodInfo* ClassFile::FindField(std::string_view name, std::string_view descriptor)
+{
+  return const_cast<FieldMethodInfo*>(std::as_const(*this).FindField(name, descriptor));
+}
+
+FieldMethodInfo* ClassFile::FindMethod(std::string_view name, std::string_view descriptor)
+{
+  return const_cast<FieldMethodInfo*>(std::as_const(*this).FindMethod(name, descriptor));
+}
+
+void ClassFile::InvalidateMemberIndex()
+{
+  m_memberIndexes.Reset();
+}
+
+FieldMethodInfo& ClassFile::AddField(FieldMethodInfo field)
+{
+  m_memberIndexes.Reset();
+  return Fields.emplace_back(std::move(field));
+}
+
+FieldMethodInfo& ClassFile::AddMethod(FieldMethodInfo method)
+{
+  m_memberIndexes.Reset();
+  return Methods.emplace_back(std::move(method));
+}
+
+void ClassFile::RemoveField(size_t position)
+{
+  m_memberIndexes.Reset();
+  Fields.erase(Fields.begin() + static_cast<std::ptrdiff_t>(position));
+}
+
+void ClassFile::RemoveMethod(size_t position)
+{
+  m_memberIndexes.Reset();
+  Methods.erase(Methods.begin() + static_cast<std::ptrdiff_t>(position));
+}
+
 std::vector<std::string_view> ClassFile::FlagsToStrs() const
 {
   std::vector<std::string_view> flags;
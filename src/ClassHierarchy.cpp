@@ -0,0 +1,331 @@
+#include "ClassFile/ClassHierarchy.hpp"
+#include "ClassFile/Parser.hpp"
+
+#include <fmt/core.h>
+
+#include "Util/Error.hpp"
+#include "Util/Parallel.hpp"
+
+#include <fstream>
+#include <cassert>
+
+namespace ClassFile
+{
+
+ErrorOr<ClassHierarchy::Entry> ClassHierarchy::MakeEntry(const ClassFile& cf, SymbolTable& symbols)
+{
+  Entry entry;
+  entry.AccessFlags = cf.AccessFlags;
+
+  auto errOrName = cf.ConstPool.LookupString(cf.ThisClass);
+  VERIFY(errOrName, "failed to lookup this_class name");
+  entry.Name = symbols.Intern(errOrName.Get());
+
+  if(cf.SuperClass != 0)
+  {
+    auto errOrSuper = cf.ConstPool.LookupString(cf.SuperClass);
+    VERIFY(errOrSuper, "failed to lookup super_class name");
+    entry.SuperName = symbols.Intern(errOrSuper.Get());
+  }
+
+  entry.Interfaces.reserve(cf.Interfaces.size());
+  for(U16 interface : cf.Interfaces)
+  {
+    auto errOrInterface = cf.ConstPool.LookupString(interface);
+    VERIFY(errOrInterface, "failed to lookup interface name");
+    entry.Interfaces.push_back(symbols.Intern(errOrInterface.Get()));
+  }
+
+  return entry;
+}
+
+ErrorOr<ClassHierarchy> ClassHierarchy::Build(const std::vector<std::string>& paths,
+    unsigned nThreads, SymbolTable& symbols)
+{
+  std::vector<Entry> entries(paths.size());
+  std::vector<Error> errors(paths.size());
+  std::vector<U8> failed(paths.size(), false); //not vector<bool>, threads write it
+
+  ParallelFor(paths.size(), nThreads, [&](size_t i)
+  {
+    std::ifstream stream{paths[i], std::ios::binary};
+
+    //the pool isn't interned, only the names MakeEntry() picks from it are
+    auto errOrHeader = Parser::ParseClassHeader(stream);
+    auto errOrEntry = errOrHeader.IsError() ? ErrorOr<Entry>{errOrHeader.GetError()}
+                                            : MakeEntry(errOrHeader.Get(), symbols);
+
+    if(!stream.good() || errOrEntry.IsError())
+    {
+      failed[i] = true;
+      errors[i] = stream.good() ? errOrEntry.GetError() : Error{"unable to read file"};
+      return;
+    }
+
+    entries[i] = errOrEntry.Release();
+  });
+
+  //reported in input order so the error doesn't depend on thread scheduling
+  for(size_t i = 0; i < paths.size(); i++)
+  {
+    if(failed[i])
+    {
+      return Error{fmt::format("ClassHierarchy::Build(): failed to parse "
+          "\"{}\":\n  {}", paths[i], errors[i].What)};
+    }
+  }
+
+  return Build(entries, symbols);
+}
+
+ClassHierarchy::ClassId ClassHierarchy::getOrAddId(const Symbol* name)
+{
+  auto [itr, added] = m_ids.emplace(name, static_cast<ClassId>(m_names.size()));
+
+  if(added)
+    m_names.push_back(name);
+
+  return itr->second;
+}
+
+ClassHierarchy ClassHierarchy::Build(const std::vector<Entry>& entries, SymbolTable& symbols)
+{
+  ClassHierarchy h;
+  h.m_symbols = &symbols;
+  h.m_ids.reserve(entries.size() * 2);
+
+  //defined classes get the ids [0, nDefined) in input order
+  std::vector<const Entry*> defined;
+  defined.reserve(entries.size());
+
+  for(const Entry& entry : entries)
+  {
+    size_t before = h.m_names.size();
+    h.getOrAddId(entry.Name);
+
+    if(h.m_names.size() != before)
+      defined.push_back(&entry);
+  }
+
+  size_t nDefined = defined.size();
+
+  h.m_interfaceOffsets.reserve(nDefined + 1);
+  h.m_interfaceOffsets.push_back(0);
+
+  std::vector<ClassId> superClass(nDefined, InvalidId);
+
+  for(size_t id = 0; id < nDefined; id++)
+  {
+    const Entry& entry = *defined[id];
+
+    if(entry.SuperName)
+      superClass[id] = h.getOrAddId(entry.SuperName);
+
+    for(const Symbol* interface : entry.Interfaces)
+      h.m_interfaces.push_back(h.getOrAddId(interface));
+
+    h.m_interfaceOffsets.push_back(static_cast<U32>(h.m_interfaces.size()));
+  }
+
+  size_t n = h.m_names.size();
+
+  h.m_defined.assign(n, false);
+  h.m_accessFlags.assign(n, 0);
+  h.m_superClass.assign(n, InvalidId);
+
+  for(size_t id = 0; id < nDefined; id++)
+  {
+    h.m_defined[id] = true;
+    h.m_accessFlags[id] = defined[id]->AccessFlags;
+    h.m_superClass[id] = superClass[id];
+  }
+
+  //a broken classpath can have a class extend itself, directly or through
+  //others. The edge that closes such a cycle is cut, so every walk up the
+  //super class chain ends.
+  enum : U8 { unvisited, onChain, done };
+  std::vector<U8> state(n, unvisited);
+
+  for(ClassId start = 0; start < nDefined; start++)
+  {
+    for(ClassId id = start; id != InvalidId && state[id] == unvisited; id = h.m_superClass[id])
+    {
+      state[id] = onChain;
+
+      ClassId super = h.m_superClass[id];
+      if(super != InvalidId && state[super] == onChain)
+        h.m_superClass[id] = InvalidId;
+    }
+
+    for(ClassId id = start; id != InvalidId && state[id] == onChain; id = h.m_superClass[id])
+      state[id] = done;
+  }
+
+  //referenced-only classes have no interfaces
+  h.m_interfaceOffsets.resize(n + 1, h.m_interfaceOffsets.back());
+
+  //subtypes are the inverted super class & interface edges, built with a
+  //counting sort so each list ends up ordered by subtype id
+  h.m_subtypeOffsets.assign(n + 1, 0);
+
+  auto forEachEdge = [&](auto&& fn)
+  {
+    for(ClassId id = 0; id < nDefined; id++)
+    {
+      if(h.m_superClass[id] != InvalidId)
+        fn(id, h.m_superClass[id]);
+
+      for(ClassId interface : h.GetInterfaces(id))
+        fn(id, interface);
+    }
+  };
+
+  forEachEdge([&](ClassId, ClassId super){ h.m_subtypeOffsets[super + 1]++; });
+
+  for(size_t i = 0; i < n; i++)
+    h.m_subtypeOffsets[i + 1] += h.m_subtypeOffsets[i];
+
+  std::vector<U32> fill(h.m_subtypeOffsets.begin(), h.m_subtypeOffsets.end() - 1);
+  h.m_subtypes.resize(h.m_subtypeOffsets.back());
+
+  forEachEdge([&](ClassId sub, ClassId super){ h.m_subtypes[fill[super]++] = sub; });
+
+  return h;
+}
+
+size_t ClassHierarchy::GetClassCount() const
+{
+  return m_names.size();
+}
+
+ClassHierarchy::ClassId ClassHierarchy::Find(std::string_view name) const
+{
+  return Find(m_symbols->Find(name));
+}
+
+ClassHierarchy::ClassId ClassHierarchy::Find(const Symbol* name) const
+{
+  auto itr = m_ids.find(name);
+  return itr == m_ids.end() ? InvalidId : itr->second;
+}
+
+const Symbol* ClassHierarchy::GetSymbol(ClassId id) const
+{
+  assert(id < m_names.size());
+  return m_names[id];
+}
+
+std::string_view ClassHierarchy::GetName(ClassId id) const
+{
+  return GetSymbol(id)->GetString();
+}
+
+bool ClassHierarchy::IsDefined(ClassId id) const
+{
+  assert(id < m_names.size());
+  return m_defined[id];
+}
+
+bool ClassHierarchy::IsInterface(ClassId id) const
+{
+  return GetAccessFlags(id) & static_cast<U16>(ClassFile::AccessFlag::INTERFACE);
+}
+
+U16 ClassHierarchy::GetAccessFlags(ClassId id) const
+{
+  assert(id < m_names.size());
+  return m_accessFlags[id];
+}
+
+ClassHierarchy::ClassId ClassHierarchy::GetSuperClass(ClassId id) const
+{
+  assert(id < m_names.size());
+  return m_superClass[id];
+}
+
+ClassHierarchy::Range ClassHierarchy::GetInterfaces(ClassId id) const
+{
+  assert(id < m_names.size());
+  const ClassId* base = m_interfaces.data();
+  return {base + m_interfaceOffsets[id], base + m_interfaceOffsets[id + 1]};
+}
+
+ClassHierarchy::Range ClassHierarchy::GetSubtypes(ClassId id) const
+{
+  assert(id < m_names.size());
+  const ClassId* base = m_subtypes.data();
+  return {base + m_subtypeOffsets[id], base + m_subtypeOffsets[id + 1]};
+}
+
+template <typename NextFn>
+std::vector<ClassHierarchy::ClassId> ClassHierarchy::closure(ClassId id, NextFn&& forEachNext) const
+{
+  std::vector<ClassId> result;
+  std::vector<bool> visited(m_names.size(), false);
+  visited[id] = true;
+
+  auto visit = [&](ClassId next)
+  {
+    if(visited[next])
+      return;
+
+    visited[next] = true;
+    result.push_back(next);
+  };
+
+  forEachNext(id, visit);
+
+  //result doubles as the breadth first queue
+  for(size_t i = 0; i < result.size(); i++)
+    forEachNext(result[i], visit);
+
+  return result;
+}
+
+std::vector<ClassHierarchy::ClassId> ClassHierarchy::GetAllSupertypes(ClassId id) const
+{
+  return closure(id, [&](ClassId current, auto&& visit)
+  {
+    if(m_superClass[current] != InvalidId)
+      visit(m_superClass[current]);
+
+    for(ClassId interface : GetInterfaces(current))
+      visit(interface);
+  });
+}
+
+std::vector<ClassHierarchy::ClassId> ClassHierarchy::GetAllSubtypes(ClassId id) const
+{
+  return closure(id, [&](ClassId current, auto&& visit)
+  {
+    for(ClassId sub : GetSubtypes(current))
+      visit(sub);
+  });
+}
+
+bool ClassHierarchy::IsSubtypeOf(ClassId sub, ClassId super) const
+{
+  if(sub == super)
+    return true;
+
+  //walking the super class chain first answers the common case without
+  //allocating, interfaces need the full closure
+  for(ClassId c = m_superClass[sub]; c != InvalidId; c = m_superClass[c])
+  {
+    if(c == super)
+      return true;
+  }
+
+  if(IsDefined(super) && !IsInterface(super))
+    return false;
+
+  for(ClassId c : GetAllSupertypes(sub))
+  {
+    if(c == super)
+      return true;
+  }
+
+  return false;
+}
+
+} //namespace ClassFile
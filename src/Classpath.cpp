@@ -0,0 +1,60 @@
+#include "ClassFile/Classpath.hpp"
+
+#include <fmt/core.h>
+
+#include <filesystem>
+#include <fstream>
+#include <algorithm>
+
+namespace ClassFile
+{
+
+ErrorOr< std::vector<std::string> > Classpath::ListClassFiles(const std::string& root)
+{
+  namespace fs = std::filesystem;
+
+  std::error_code ec;
+  std::vector<std::string> paths;
+
+  if(fs::is_regular_file(root, ec))
+  {
+    paths.push_back(root);
+    return paths;
+  }
+
+  fs::recursive_directory_iterator itr{root, ec};
+
+  for(; !ec && itr != fs::recursive_directory_iterator{}; itr.increment(ec))
+  {
+    if(itr->is_regular_file(ec) && itr->path().extension() == ".class")
+      paths.push_back(itr->path().string());
+  }
+
+  if(ec)
+  {
+    return Error{fmt::format("Classpath::ListClassFiles(): failed to list "
+        "\"{}\": {}", root, ec.message())};
+  }
+
+  std::sort(paths.begin(), paths.end());
+  return paths;
+}
+
+ErrorOr< std::vector<U8> > Classpath::ReadFile(const std::string& path)
+{
+  std::ifstream stream{path, std::ios::binary | std::ios::ate};
+
+  if(!stream.good())
+    return Error{fmt::format("Classpath::ReadFile(): unable to open \"{}\"", path)};
+
+  std::vector<U8> bytes(static_cast<size_t>(stream.tellg()));
+  stream.seekg(0);
+  stream.read(reinterpret_cast<char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+
+  if(!stream.good())
+    return Error{fmt::format("Classpath::ReadFile(): failed to read \"{}\"", path)};
+
+  return bytes;
+}
+
+} //namespace ClassFile
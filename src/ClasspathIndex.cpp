@@ -0,0 +1,580 @@
+#include "ClassFile/ClasspathIndex.hpp"
+#include "ClassFile/Classpath.hpp"
+
+#include <fmt/core.h>
+
+#include "Util/Error.hpp"
+#include "Util/Hash128.hpp"
+#include "Util/IO.hpp"
+#include "Util/Parallel.hpp"
+#include "Util/RawClass.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace ClassFile
+{
+
+static constexpr char manifestMagic[8] = {'C','F','I','N','D','E','X','\n'};
+static constexpr U32 manifestVersion = 1;
+
+ClasspathIndex::ClasspathIndex(std::string root, std::string manifestPath, unsigned nThreads)
+  : m_root{std::move(root)}, m_manifestPath{std::move(manifestPath)}, m_nThreads{nThreads},
+    m_symbols{std::make_unique<SymbolTable>()} {}
+
+ErrorOr<ClasspathIndex> ClasspathIndex::Open(std::string root, std::string manifestPath,
+    unsigned nThreads)
+{
+  ClasspathIndex index{std::move(root), std::move(manifestPath), nThreads};
+
+  //a missing or unreadable manifest only means that everything gets indexed
+  if(index.load().IsError())
+  {
+    ClasspathIndex empty{std::move(index.m_root), std::move(index.m_manifestPath), nThreads};
+    empty.rebuildHierarchy();
+    return empty;
+  }
+
+  index.rebuildHierarchy();
+  return index;
+}
+
+size_t ClasspathIndex::GetFileCount() const
+{
+  return m_fileIds.size();
+}
+
+const ClassHierarchy& ClasspathIndex::GetHierarchy() const
+{
+  return *m_hierarchy;
+}
+
+SymbolTable& ClasspathIndex::GetSymbols() const
+{
+  return *m_symbols;
+}
+
+//Class constants of array types name the array, e.g. "[Ljava/lang/String;",
+//those are recorded as their element class. Arrays of primitives are empty.
+static std::string_view getElementClass(std::string_view name)
+{
+  if(name.empty() || name[0] != '[')
+    return name;
+
+  name.remove_prefix(name.find_first_not_of('['));
+
+  if(name.size() < 2 || name.front() != 'L' || name.back() != ';')
+    return {};
+
+  return name.substr(1, name.size() - 2);
+}
+
+static void sortUnique(std::vector<const Symbol*>& symbols)
+{
+  std::sort(symbols.begin(), symbols.end());
+  symbols.erase(std::unique(symbols.begin(), symbols.end()), symbols.end());
+}
+
+ErrorOr<ClasspathIndex::fileRecord> ClasspathIndex::skim(const std::vector<U8>& bytes,
+    SymbolTable& symbols)
+{
+  auto errOrSkim = RawClass::SkimClass(bytes.data(), bytes.size());
+  VERIFY(errOrSkim);
+
+  const RawClass::Skim& skim = errOrSkim.Get();
+
+  auto getClassName = [&](U16 index) -> ErrorOr<const Symbol*>
+  {
+    auto name = skim.Is(index, CPInfo::Type::Class) ? skim.GetIndirectUTF8(index) : std::nullopt;
+
+    if(!name)
+      return Error{fmt::format("#{} isn't a valid Class constant", index)};
+
+    return symbols.Intern(*name);
+  };
+
+  fileRecord record;
+  record.Valid = true;
+  record.Class.AccessFlags = skim.AccessFlags;
+
+  auto errOrName = getClassName(skim.ThisClass);
+  VERIFY(errOrName, "failed to lookup this_class");
+  record.Class.Name = errOrName.Get();
+
+  if(skim.SuperClass != 0)
+  {
+    auto errOrSuper = getClassName(skim.SuperClass);
+    VERIFY(errOrSuper, "failed to lookup super_class");
+    record.Class.SuperName = errOrSuper.Get();
+  }
+
+  for(U16 i = 0; i < skim.InterfaceCount; i++)
+  {
+    auto errOrInterface = getClassName(skim.ReadU16(skim.InterfacesOffset + 2*i));
+    VERIFY(errOrInterface, "failed to lookup interface");
+    record.Class.Interfaces.push_back(errOrInterface.Get());
+  }
+
+  for(U16 i = 1; i < skim.GetConstCount(); i++)
+  {
+    if(skim.Is(i, CPInfo::Type::Class))
+    {
+      auto name = skim.GetIndirectUTF8(i);
+      std::string_view element = name ? getElementClass(*name) : std::string_view{};
+
+      if(!element.empty() && element != record.Class.Name->GetString())
+        record.ClassRefs.push_back(symbols.Intern(element));
+    }
+    else if(skim.Is(i, CPInfo::Type::String))
+    {
+      if(auto value = skim.GetIndirectUTF8(i))
+        record.Strings.push_back(symbols.Intern(*value));
+    }
+  }
+
+  sortUnique(record.ClassRefs);
+  sortUnique(record.Strings);
+
+  return record;
+}
+
+void ClasspathIndex::link(FileId id)
+{
+  const fileRecord& record = m_files[id];
+
+  if(!record.Valid)
+    return;
+
+  m_definitions[record.Class.Name].insert(id);
+
+  for(const Symbol* ref : record.ClassRefs)
+    m_classRefs[ref].insert(id);
+
+  for(const Symbol* string : record.Strings)
+    m_strings[string].insert(id);
+}
+
+static void eraseFrom(std::unordered_map< const Symbol*, std::unordered_set<U32> >& index,
+    const Symbol* key, U32 id)
+{
+  auto itr = index.find(key);
+
+  if(itr == index.end())
+    return;
+
+  itr->second.erase(id);
+
+  if(itr->second.empty())
+    index.erase(itr);
+}
+
+void ClasspathIndex::unlink(FileId id)
+{
+  const fileRecord& record = m_files[id];
+
+  if(!record.Valid)
+    return;
+
+  eraseFrom(m_definitions, record.Class.Name, id);
+
+  for(const Symbol* ref : record.ClassRefs)
+    eraseFrom(m_classRefs, ref, id);
+
+  for(const Symbol* string : record.Strings)
+    eraseFrom(m_strings, string, id);
+}
+
+ClasspathIndex::FileId ClasspathIndex::addFile(fileRecord&& record)
+{
+  FileId id;
+
+  if(!m_freeIds.empty())
+  {
+    id = m_freeIds.back();
+    m_freeIds.pop_back();
+    m_files[id] = std::move(record);
+  }
+  else
+  {
+    id = static_cast<FileId>(m_files.size());
+    m_files.push_back(std::move(record));
+  }
+
+  m_fileIds[m_files[id].Path] = id;
+  link(id);
+  return id;
+}
+
+void ClasspathIndex::removeFile(FileId id)
+{
+  unlink(id);
+  m_fileIds.erase(m_files[id].Path);
+
+  m_files[id] = fileRecord{};
+  m_freeIds.push_back(id);
+}
+
+void ClasspathIndex::rebuildHierarchy()
+{
+  std::vector<ClassHierarchy::Entry> entries;
+  entries.reserve(m_fileIds.size());
+
+  for(const fileRecord& record : m_files)
+  {
+    if(!record.Path.empty() && record.Valid)
+      entries.push_back(record.Class);
+  }
+
+  m_hierarchy = std::make_unique<ClassHierarchy>(ClassHierarchy::Build(entries, *m_symbols));
+}
+
+static S64 getModifiedTime(const std::filesystem::path& path, std::error_code& ec)
+{
+  return static_cast<S64>(std::filesystem::last_write_time(path, ec).time_since_epoch().count());
+}
+
+static Fingerprint hashBytes(const std::vector<U8>& bytes)
+{
+  Hasher128 hasher;
+  hasher.Update(bytes.data(), bytes.size());
+
+  auto [low, high] = hasher.Finish();
+  return Fingerprint{low, high};
+}
+
+ErrorOr<ClasspathIndex::RefreshStats> ClasspathIndex::Refresh()
+{
+  auto errOrPaths = Classpath::ListClassFiles(m_root);
+  VERIFY(errOrPaths);
+
+  const std::vector<std::string>& paths = errOrPaths.Get();
+
+  enum class status : U8 { Unchanged, Touched, Modified, Failed };
+
+  struct scan
+  {
+    status Status{status::Unchanged};
+    fileRecord Record; //Size & ModifiedTime for Touched, all of it for Modified
+    std::string Error;
+  };
+
+  std::vector<scan> scans(paths.size());
+
+  //only reads the maps, the records are updated after all threads are done
+  ParallelFor(paths.size(), m_nThreads, [&](size_t i)
+  {
+    scan& s = scans[i];
+    std::error_code ec;
+
+    U64 size = static_cast<U64>(std::filesystem::file_size(paths[i], ec));
+    S64 modifiedTime = ec ? 0 : getModifiedTime(paths[i], ec);
+
+    auto itr = m_fileIds.find(paths[i]);
+    const fileRecord* known = itr == m_fileIds.end() ? nullptr : &m_files[itr->second];
+
+    if(!ec && known && known->Size == size && known->ModifiedTime == modifiedTime)
+      return;
+
+    auto errOrBytes = Classpath::ReadFile(paths[i]);
+
+    if(errOrBytes.IsError())
+    {
+      s.Status = status::Failed;
+      s.Error = errOrBytes.GetError().What;
+      return;
+    }
+
+    s.Record.Size = size;
+    s.Record.ModifiedTime = modifiedTime;
+    s.Record.Hash = hashBytes(errOrBytes.Get());
+
+    //e.g. rebuilt with identical output
+    if(known && known->Hash == s.Record.Hash)
+    {
+      s.Status = status::Touched;
+      return;
+    }
+
+    s.Status = status::Modified;
+
+    auto errOrRecord = skim(errOrBytes.Get(), *m_symbols);
+
+    if(errOrRecord.IsError())
+    {
+      s.Error = errOrRecord.GetError().What;
+    }
+    else
+    {
+      fileRecord record = errOrRecord.Release();
+      record.Size = s.Record.Size;
+      record.ModifiedTime = s.Record.ModifiedTime;
+      record.Hash = s.Record.Hash;
+      s.Record = std::move(record);
+    }
+
+    s.Record.Path = paths[i];
+  });
+
+  RefreshStats stats;
+  std::vector<U8> seen(m_files.size(), false);
+
+  for(size_t i = 0; i < paths.size(); i++)
+  {
+    scan& s = scans[i];
+    auto itr = m_fileIds.find(paths[i]);
+
+    if(!s.Error.empty())
+      stats.Errors.push_back(fmt::format("\"{}\": {}", paths[i], s.Error));
+
+    switch(s.Status)
+    {
+      case status::Unchanged:
+        seen[itr->second] = true;
+        stats.Unchanged++;
+        break;
+
+      case status::Touched:
+        m_files[itr->second].Size = s.Record.Size;
+        m_files[itr->second].ModifiedTime = s.Record.ModifiedTime;
+        seen[itr->second] = true;
+        stats.Unchanged++;
+        break;
+
+      case status::Modified:
+        if(itr != m_fileIds.end())
+        {
+          FileId id = itr->second;
+          unlink(id);
+          m_files[id] = std::move(s.Record);
+          link(id);
+          seen[id] = true;
+          stats.Changed++;
+        }
+        else
+        {
+          addFile(std::move(s.Record));
+          stats.Added++;
+        }
+        break;
+
+      //unreadable files are treated as removed & picked up again once readable
+      case status::Failed:
+        break;
+    }
+  }
+
+  for(FileId id = 0; id < seen.size(); id++)
+  {
+    if(!seen[id] && !m_files[id].Path.empty())
+    {
+      removeFile(id);
+      stats.Removed++;
+    }
+  }
+
+  if(stats.Added + stats.Changed + stats.Removed > 0)
+    rebuildHierarchy();
+
+  TRY(Save());
+  return stats;
+}
+
+std::vector<std::string> ClasspathIndex::lookup(const SymbolIndex& index, std::string_view key) const
+{
+  std::vector<std::string> paths;
+
+  const Symbol* symbol = m_symbols->Find(key);
+  auto itr = symbol ? index.find(symbol) : index.end();
+
+  if(itr == index.end())
+    return paths;
+
+  for(FileId id : itr->second)
+    paths.push_back(m_files[id].Path);
+
+  std::sort(paths.begin(), paths.end());
+  return paths;
+}
+
+std::vector<std::string> ClasspathIndex::FindDefinitions(std::string_view className) const
+{
+  return lookup(m_definitions, className);
+}
+
+std::vector<std::string> ClasspathIndex::FindClassReferences(std::string_view className) const
+{
+  return lookup(m_classRefs, className);
+}
+
+std::vector<std::string> ClasspathIndex::FindStringReferences(std::string_view value) const
+{
+  return lookup(m_strings, value);
+}
+
+//Manifest: magic, version, file count & a record per file, little endian.
+//Strings are a U32 length followed by their bytes.
+
+static ErrorOr<void> writeString(std::ostream& stream, std::string_view string)
+{
+  TRY(Write<LittleEndian>(stream, static_cast<U32>(string.size())));
+  stream.write(string.data(), static_cast<std::streamsize>(string.size()));
+  return NoError{};
+}
+
+static ErrorOr<void> writeSymbols(std::ostream& stream, const std::vector<const Symbol*>& symbols)
+{
+  TRY(Write<LittleEndian>(stream, static_cast<U32>(symbols.size())));
+
+  for(const Symbol* symbol : symbols)
+    TRY(writeString(stream, symbol->GetString()));
+
+  return NoError{};
+}
+
+ErrorOr<void> ClasspathIndex::Save() const
+{
+  std::string tmpPath = m_manifestPath + ".tmp";
+  std::ofstream stream{tmpPath, std::ios::binary | std::ios::trunc};
+
+  if(!stream.good())
+    return Error{fmt::format("ClasspathIndex::Save(): unable to create \"{}\"", tmpPath)};
+
+  stream.write(manifestMagic, sizeof(manifestMagic));
+  TRY(Write<LittleEndian>(stream, manifestVersion, static_cast<U32>(m_fileIds.size())));
+
+  for(const fileRecord& record : m_files)
+  {
+    if(record.Path.empty())
+      continue;
+
+    TRY(writeString(stream, record.Path));
+    TRY(Write<LittleEndian>(stream, record.Size, record.ModifiedTime,
+          record.Hash.Low, record.Hash.High, static_cast<U8>(record.Valid)));
+
+    if(!record.Valid)
+      continue;
+
+    const ClassHierarchy::Entry& entry = record.Class;
+
+    TRY(writeString(stream, entry.Name->GetString()));
+    TRY(writeString(stream, entry.SuperName ? entry.SuperName->GetString() : std::string_view{}));
+    TRY(Write<LittleEndian>(stream, entry.AccessFlags));
+    TRY(writeSymbols(stream, entry.Interfaces));
+    TRY(writeSymbols(stream, record.ClassRefs));
+    TRY(writeSymbols(stream, record.Strings));
+  }
+
+  stream.close();
+
+  if(!stream.good())
+    return Error{fmt::format("ClasspathIndex::Save(): failed to write \"{}\"", tmpPath)};
+
+  std::error_code ec;
+  std::filesystem::rename(tmpPath, m_manifestPath, ec);
+
+  if(ec)
+  {
+    return Error{fmt::format("ClasspathIndex::Save(): failed to move \"{}\" to "
+        "\"{}\": {}", tmpPath, m_manifestPath, ec.message())};
+  }
+
+  return NoError{};
+}
+
+static ErrorOr<std::string> readString(std::istream& stream)
+{
+  U32 len;
+  TRY(Read<LittleEndian>(stream, len));
+
+  //guards the allocation against garbage lengths
+  if(!stream.good() || len > (1u << 24))
+    return Error{"truncated or corrupt string"};
+
+  std::string string(len, '\0');
+  stream.read(string.data(), len);
+
+  if(!stream.good())
+    return Error{"truncated string"};
+
+  return string;
+}
+
+static ErrorOr<void> readSymbols(std::istream& stream, SymbolTable& symbols,
+    std::vector<const Symbol*>& out)
+{
+  U32 count;
+  TRY(Read<LittleEndian>(stream, count));
+
+  if(!stream.good())
+    return Error{"truncated symbol list"};
+
+  for(U32 i = 0; i < count; i++)
+  {
+    auto errOrString = readString(stream);
+    VERIFY(errOrString);
+    out.push_back(symbols.Intern(errOrString.Get()));
+  }
+
+  return NoError{};
+}
+
+ErrorOr<void> ClasspathIndex::load()
+{
+  std::ifstream stream{m_manifestPath, std::ios::binary};
+
+  if(!stream.good())
+    return Error{fmt::format("ClasspathIndex::load(): unable to open \"{}\"", m_manifestPath)};
+
+  char magic[sizeof(manifestMagic)];
+  stream.read(magic, sizeof(magic));
+
+  U32 version, count;
+  TRY(Read<LittleEndian>(stream, version, count));
+
+  if(!stream.good() || std::memcmp(magic, manifestMagic, sizeof(magic)) != 0 ||
+     version != manifestVersion)
+  {
+    return Error{"ClasspathIndex::load(): not a manifest of this version"};
+  }
+
+  for(U32 i = 0; i < count; i++)
+  {
+    fileRecord record;
+
+    auto errOrPath = readString(stream);
+    VERIFY(errOrPath);
+    record.Path = errOrPath.Release();
+
+    U8 valid;
+    TRY(Read<LittleEndian>(stream, record.Size, record.ModifiedTime,
+          record.Hash.Low, record.Hash.High, valid));
+    record.Valid = valid != 0;
+
+    if(record.Valid)
+    {
+      auto errOrName = readString(stream);
+      VERIFY(errOrName);
+      auto errOrSuper = readString(stream);
+      VERIFY(errOrSuper);
+
+      record.Class.Name = m_symbols->Intern(errOrName.Get());
+      record.Class.SuperName = errOrSuper.Get().empty() ? nullptr : m_symbols->Intern(errOrSuper.Get());
+
+      TRY(Read<LittleEndian>(stream, record.Class.AccessFlags));
+      TRY(readSymbols(stream, *m_symbols, record.Class.Interfaces));
+      TRY(readSymbols(stream, *m_symbols, record.ClassRefs));
+      TRY(readSymbols(stream, *m_symbols, record.Strings));
+    }
+
+    if(!stream.good())
+      return Error{"ClasspathIndex::load(): manifest is truncated"};
+
+    addFile(std::move(record));
+  }
+
+  return NoError{};
+}
+
+} //namespace ClassFile
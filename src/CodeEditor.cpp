@@ -0,0 +1,587 @@
+#include "ClassFile/CodeEditor.hpp"
+
+#include <fmt/core.h>
+
+#include "Util/Error.hpp"
+#include "Util/RawAttributes.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <utility>
+
+namespace ClassFile
+{
+
+void CodeEditor::Sequence::Add(Instruction instr)
+{
+  m_code.push_back(std::move(instr));
+  m_targets.push_back(noTarget);
+}
+
+void CodeEditor::Sequence::AddBranch(Instruction branch, Label target)
+{
+  m_code.push_back(std::move(branch));
+  m_targets.push_back(target.Id);
+}
+
+void CodeEditor::Sequence::Bind(Label label)
+{
+  m_binds.push_back({label.Id, m_code.size()});
+}
+
+CodeEditor::CodeEditor(const ConstantPool& constPool, CodeAttribute& code)
+  : m_constPool{constPool}, m_code{code}, m_labelCount{static_cast<U32>(code.Code.size())} {}
+
+CodeEditor::Label CodeEditor::NewLabel()
+{
+  return Label{m_labelCount++};
+}
+
+CodeEditor::Label CodeEditor::GetLabel(size_t index) const
+{
+  assert(index < m_code.Code.size() && "GetLabel() takes the index of an original instruction");
+
+  if(index >= m_code.Code.size())
+    return Label{invalidLabel};
+
+  return Label{static_cast<U32>(index)};
+}
+
+void CodeEditor::InsertBefore(size_t index, Sequence code)
+{
+  m_edits.push_back({index, editKind::Before, std::move(code)});
+}
+
+void CodeEditor::InsertAfter(size_t index, Sequence code)
+{
+  m_edits.push_back({index, editKind::After, std::move(code)});
+}
+
+void CodeEditor::Replace(size_t index, Sequence code)
+{
+  m_edits.push_back({index, editKind::Replace, std::move(code)});
+}
+
+void CodeEditor::Remove(size_t index)
+{
+  Replace(index, Sequence{});
+}
+
+bool CodeEditor::HasEdits() const
+{
+  return !m_edits.empty();
+}
+
+static OpCode invertCondition(OpCode op)
+{
+  if(op >= IFNULL)
+    return static_cast<OpCode>(((op - IFNULL) ^ 1) + IFNULL);
+
+  //ifeq/ifne, iflt/ifge, ... if_acmpeq/if_acmpne come in pairs
+  return static_cast<OpCode>(((op - IFEQ) ^ 1) + IFEQ);
+}
+
+//Maps an old pc to its new pc, fails for pcs that aren't an instruction
+//boundary
+using pcMapper = std::function<ErrorOr<U32>(U32)>;
+
+//The remapped attributes are allocated like the ones they replace, so that
+//moving them in place can't fail
+static ErrorOr< std::pmr::vector<U8> > remapLocalVariables(const std::pmr::vector<U8>& bytes,
+    const pcMapper& toNew)
+{
+  std::pmr::vector<U8> out{bytes, bytes.get_allocator()};
+  RawAttributes::Reader r{bytes.data(), bytes.size()};
+
+  auto errOrCount = r.U2();
+  VERIFY(errOrCount);
+
+  for(U16 i = 0; i < errOrCount.Get(); i++)
+  {
+    size_t pos = r.Pos;
+
+    auto errOrStart = r.U2();
+    VERIFY(errOrStart);
+    auto errOrLength = r.U2();
+    VERIFY(errOrLength);
+    TRY(r.Skip(6)); //name, descriptor, index
+
+    auto errOrNewStart = toNew(errOrStart.Get());
+    VERIFY(errOrNewStart);
+    auto errOrNewEnd = toNew(U32{errOrStart.Get()} + errOrLength.Get());
+    VERIFY(errOrNewEnd);
+
+    RawAttributes::WriteIndex(out.data(), pos, static_cast<U16>(errOrNewStart.Get()));
+    RawAttributes::WriteIndex(out.data(), pos + 2,
+        static_cast<U16>(errOrNewEnd.Get() - errOrNewStart.Get()));
+  }
+
+  return out;
+}
+
+//Re-encodes the frames with their new offset deltas, switching between the
+//short & extended forms as needed, and remaps Uninitialized types
+static ErrorOr< std::pmr::vector<U8> > remapFrames(const std::pmr::vector<U8>& bytes,
+    const pcMapper& toNewStart, const pcMapper& toNewInstruction)
+{
+  RawAttributes::Reader r{bytes.data(), bytes.size()};
+  std::pmr::vector<U8> out{bytes.get_allocator()};
+  out.reserve(bytes.size() + 16);
+
+  auto write16 = [&](U32 value)
+  {
+    out.push_back(static_cast<U8>(value >> 8));
+    out.push_back(static_cast<U8>(value));
+  };
+
+  auto copyTypes = [&](size_t n) -> ErrorOr<void>
+  {
+    for(size_t i = 0; i < n; i++)
+    {
+      auto errOrTag = r.U1();
+      VERIFY(errOrTag);
+      out.push_back(errOrTag.Get());
+
+      if(errOrTag.Get() < 7)
+        continue;
+
+      auto errOrValue = r.U2();
+      VERIFY(errOrValue);
+
+      U32 value = errOrValue.Get();
+
+      if(errOrTag.Get() == 8) //Uninitialized(offset of the new instruction)
+      {
+        auto errOrNew = toNewInstruction(value);
+        VERIFY(errOrNew);
+        value = errOrNew.Get();
+      }
+
+      write16(value);
+    }
+
+    return NoError{};
+  };
+
+  auto errOrCount = r.U2();
+  VERIFY(errOrCount);
+  write16(errOrCount.Get());
+
+  S64 prevOld = -1, prevNew = -1;
+
+  for(U16 i = 0; i < errOrCount.Get(); i++)
+  {
+    auto errOrType = r.U1();
+    VERIFY(errOrType);
+    U8 type = errOrType.Get();
+
+    if(type >= 128 && type < 247)
+      return Error{fmt::format("remapFrames(): reserved frame type {}", type)};
+
+    U32 delta = type < 64 ? type : type < 128 ? type - 64 : 0;
+
+    if(type >= 247)
+    {
+      auto errOrDelta = r.U2();
+      VERIFY(errOrDelta);
+      delta = errOrDelta.Get();
+    }
+
+    S64 oldPC = prevOld + delta + 1;
+    auto errOrNewPC = toNewStart(static_cast<U32>(oldPC));
+    VERIFY(errOrNewPC);
+
+    S64 newPC = errOrNewPC.Get();
+
+    if(newPC <= prevNew)
+      return Error{fmt::format("remapFrames(): the frames at pc {} & {} collide", prevOld, oldPC)};
+
+    U32 newDelta = static_cast<U32>(newPC - prevNew - 1);
+    prevOld = oldPC;
+    prevNew = newPC;
+
+    bool isSame = type < 64 || type == 251;
+    bool isSameLocals1 = (type >= 64 && type < 128) || type == 247;
+
+    if(isSame || isSameLocals1)
+    {
+      U8 base = isSame ? 0 : 64;
+      U8 extended = isSame ? 251 : 247;
+
+      if(newDelta < 64)
+      {
+        out.push_back(static_cast<U8>(base + newDelta));
+      }
+      else
+      {
+        out.push_back(extended);
+        write16(newDelta);
+      }
+
+      TRY(copyTypes(isSame ? 0 : 1));
+      continue;
+    }
+
+    out.push_back(type);
+    write16(newDelta);
+
+    if(type < 251) //chop
+      continue;
+
+    if(type < 255) //append
+    {
+      TRY(copyTypes(type - 251));
+      continue;
+    }
+
+    for(int list = 0; list < 2; list++) //full_frame locals & stack
+    {
+      auto errOrN = r.U2();
+      VERIFY(errOrN);
+      write16(errOrN.Get());
+      TRY(copyTypes(errOrN.Get()));
+    }
+  }
+
+  return out;
+}
+
+ErrorOr<void> CodeEditor::Commit()
+{
+  static constexpr U32 invalid = ~U32{0};
+
+  const std::pmr::vector<Instruction>& code = m_code.Code;
+  const size_t n = code.size();
+
+  //original layout
+  std::vector<U32> pcs(n + 1);
+  U32 pc = 0;
+
+  for(size_t i = 0; i < n; i++)
+  {
+    if(code[i].IsComplex())
+    {
+      return Error{fmt::format("CodeEditor::Commit(): {} at pc {} can't be relocated",
+          code[i].GetMnemonic(), pc)};
+    }
+
+    pcs[i] = pc;
+    pc += static_cast<U32>(code[i].GetLength());
+  }
+
+  pcs[n] = pc;
+
+  std::vector<U32> pcToIndex(pcs[n] + 1, invalid);
+
+  for(size_t i = 0; i <= n; i++)
+    pcToIndex[pcs[i]] = static_cast<U32>(i);
+
+  auto toIndex = [&](S64 target) -> U32
+  {
+    return target < 0 || target > pcs[n] ? invalid : pcToIndex[target];
+  };
+
+  std::stable_sort(m_edits.begin(), m_edits.end(), [](const edit& a, const edit& b)
+  {
+    return a.Index != b.Index ? a.Index < b.Index : a.Kind < b.Kind;
+  });
+
+  if(!m_edits.empty() && m_edits.back().Index >= n)
+  {
+    return Error{fmt::format("CodeEditor::Commit(): instruction {} is out of range",
+        m_edits.back().Index)};
+  }
+
+  //the new code as a list of items pointing to the original & inserted
+  //instructions, nothing is copied before the layout is known to work
+  struct item
+  {
+    const Instruction* Instr;
+    U32 Target; //label id or invalid
+    bool Wide;
+  };
+
+  std::vector<item> items;
+  items.reserve(n + m_edits.size());
+
+  std::vector<U32> labelItems(m_labelCount, invalid); //original labels: group starts
+  std::vector<U32> originItems(n);
+
+  auto append = [&](const Sequence& seq) -> ErrorOr<void>
+  {
+    for(auto [label, pos] : seq.m_binds)
+    {
+      if(label < n || label >= m_labelCount || labelItems[label] != invalid)
+        return Error{fmt::format("CodeEditor::Commit(): label {} can't be bound here", label)};
+
+      labelItems[label] = static_cast<U32>(items.size() + pos);
+    }
+
+    for(size_t k = 0; k < seq.m_code.size(); k++)
+      items.push_back({&seq.m_code[k], seq.m_targets[k], false});
+
+    return NoError{};
+  };
+
+  auto e = m_edits.begin();
+
+  for(size_t i = 0; i < n; i++)
+  {
+    labelItems[i] = static_cast<U32>(items.size());
+
+    for(; e != m_edits.end() && e->Index == i && e->Kind == editKind::Before; e++)
+      TRY(append(e->Code));
+
+    originItems[i] = static_cast<U32>(items.size());
+
+    if(e != m_edits.end() && e->Index == i && e->Kind == editKind::Replace)
+    {
+      TRY(append(e->Code));
+      e++;
+
+      if(e != m_edits.end() && e->Index == i && e->Kind == editKind::Replace)
+        return Error{fmt::format("CodeEditor::Commit(): instruction {} is replaced twice", i)};
+    }
+    else
+    {
+      U32 target = Sequence::noTarget;
+
+      if(IsBranch(code[i].GetOpCode()))
+      {
+        auto errOrOffset = code[i].GetBranchOffset();
+        VERIFY(errOrOffset);
+
+        target = toIndex(S64{pcs[i]} + errOrOffset.Get());
+
+        if(target == invalid || target == n)
+        {
+          return Error{fmt::format("CodeEditor::Commit(): {} at pc {} has an "
+              "invalid target", code[i].GetMnemonic(), pcs[i])};
+        }
+      }
+
+      items.push_back({&code[i], target, false});
+    }
+
+    for(; e != m_edits.end() && e->Index == i && e->Kind == editKind::After; e++)
+      TRY(append(e->Code));
+  }
+
+  for(size_t k = 0; k < items.size(); k++)
+  {
+    U32 target = items[k].Target;
+
+    if(target == Sequence::noTarget)
+      continue;
+
+    if(!IsBranch(items[k].Instr->GetOpCode()))
+    {
+      return Error{fmt::format("CodeEditor::Commit(): {} was given a target but "
+          "isn't a branch", items[k].Instr->GetMnemonic())};
+    }
+
+    if(target >= m_labelCount || labelItems[target] == invalid || labelItems[target] >= items.size())
+      return Error{fmt::format("CodeEditor::Commit(): label {} isn't bound to an instruction", target)};
+  }
+
+  //layout, widening branches until every offset fits
+  std::vector<U32> itemPCs(items.size() + 1);
+
+  auto getLength = [](const item& it) -> U32
+  {
+    if(!it.Wide)
+      return static_cast<U32>(it.Instr->GetLength());
+
+    OpCode op = it.Instr->GetOpCode();
+    return op == GOTO || op == JSR ? 5 : 8; //if<!cond> +8 & goto_w
+  };
+
+  auto getOffset = [&](size_t k)
+  {
+    return S64{itemPCs[labelItems[items[k].Target]]} - itemPCs[k];
+  };
+
+  for(bool changed = true; changed; )
+  {
+    changed = false;
+    pc = 0;
+
+    for(size_t k = 0; k < items.size(); k++)
+    {
+      itemPCs[k] = pc;
+      pc += getLength(items[k]);
+    }
+
+    itemPCs.back() = pc;
+
+    if(pc > 0xFFFF)
+      return Error{fmt::format("CodeEditor::Commit(): code would be {} bytes long", pc)};
+
+    for(size_t k = 0; k < items.size(); k++)
+    {
+      item& it = items[k];
+
+      if(it.Target == Sequence::noTarget || it.Wide || it.Instr->GetOperandSize(0) == sizeof(S32))
+        continue;
+
+      S64 offset = getOffset(k);
+
+      if(offset < INT16_MIN || offset > INT16_MAX)
+      {
+        it.Wide = true;
+        changed = true;
+      }
+    }
+  }
+
+  const U32 newLength = itemPCs.back();
+
+  auto toNewStart = [&](U32 oldPC) -> ErrorOr<U32>
+  {
+    U32 index = toIndex(oldPC);
+
+    if(index == invalid)
+      return Error{fmt::format("CodeEditor::Commit(): pc {} isn't an instruction boundary", oldPC)};
+
+    return index == n ? newLength : itemPCs[labelItems[index]];
+  };
+
+  auto toNewInstruction = [&](U32 oldPC) -> ErrorOr<U32>
+  {
+    U32 index = toIndex(oldPC);
+
+    if(index == invalid || index == n)
+      return Error{fmt::format("CodeEditor::Commit(): pc {} isn't an instruction", oldPC)};
+
+    return itemPCs[originItems[index]];
+  };
+
+  //build the new code & tables, with the allocators of the ones they replace
+  std::pmr::vector<Instruction> newCode{m_code.Code.get_allocator()};
+  newCode.reserve(items.size());
+
+  for(size_t k = 0; k < items.size(); k++)
+  {
+    const item& it = items[k];
+    Instruction instr = *it.Instr;
+
+    if(it.Target == Sequence::noTarget)
+    {
+      newCode.push_back(std::move(instr));
+      continue;
+    }
+
+    S32 offset = static_cast<S32>(getOffset(k));
+    OpCode op = instr.GetOpCode();
+
+    if(!it.Wide)
+    {
+      TRY(instr.SetBranchOffset(offset));
+      newCode.push_back(std::move(instr));
+    }
+    else if(op == GOTO || op == JSR)
+    {
+      auto errOrWide = Instruction::MakeInstruction(op == GOTO ? GOTO_W : JSR_W);
+      VERIFY(errOrWide);
+      TRY(errOrWide.Get().SetBranchOffset(offset));
+      newCode.push_back(errOrWide.Release());
+    }
+    else
+    {
+      auto errOrInverted = Instruction::MakeInstruction(invertCondition(op));
+      VERIFY(errOrInverted);
+      TRY(errOrInverted.Get().SetBranchOffset(8));
+      newCode.push_back(errOrInverted.Release());
+
+      auto errOrGoto = Instruction::MakeInstruction(GOTO_W);
+      VERIFY(errOrGoto);
+      TRY(errOrGoto.Get().SetBranchOffset(offset - 3));
+      newCode.push_back(errOrGoto.Release());
+    }
+  }
+
+  std::pmr::vector<CodeAttribute::ExceptionHandler> exceptionTable{m_code.ExceptionTable.get_allocator()};
+  exceptionTable.reserve(m_code.ExceptionTable.size());
+
+  for(const CodeAttribute::ExceptionHandler& handler : m_code.ExceptionTable)
+  {
+    auto errOrStart = toNewStart(handler.StartPC);
+    VERIFY(errOrStart);
+    auto errOrEnd = toNewStart(handler.EndPC);
+    VERIFY(errOrEnd);
+    auto errOrHandler = toNewStart(handler.HandlerPC);
+    VERIFY(errOrHandler);
+
+    //the range lost all of its code
+    if(errOrStart.Get() >= errOrEnd.Get())
+      continue;
+
+    exceptionTable.push_back({static_cast<U16>(errOrStart.Get()), static_cast<U16>(errOrEnd.Get()),
+        static_cast<U16>(errOrHandler.Get()), handler.CatchType});
+  }
+
+  std::vector< std::pair<LineNumberTableAttribute*, std::pmr::vector<LineNumberTableAttribute::LineMapping>> > lines;
+  std::vector< std::pair<RawAttribute*, std::pmr::vector<U8>> > raws;
+
+  for(auto& attr : m_code.Attributes)
+  {
+    if(attr->GetType() == AttributeInfo::Type::LineNumberTable)
+    {
+      auto& table = static_cast<LineNumberTableAttribute&>(attr.Mutate());
+      std::pmr::vector<LineNumberTableAttribute::LineMapping> map{table.LineNumberMap.get_allocator()};
+
+      for(const LineNumberTableAttribute::LineMapping& mapping : table.LineNumberMap)
+      {
+        auto errOrPC = toNewStart(mapping.PC);
+        VERIFY(errOrPC);
+
+        //lines of removed code at the end
+        if(errOrPC.Get() < newLength)
+          map.push_back({static_cast<U16>(errOrPC.Get()), mapping.LineNumber});
+      }
+
+      lines.push_back({&table, std::move(map)});
+      continue;
+    }
+
+    if(attr->GetType() != AttributeInfo::Type::Raw)
+      continue;
+
+    auto errOrName = m_constPool.LookupString(attr->NameIndex);
+    VERIFY(errOrName, "failed to lookup attribute name");
+
+    auto& raw = static_cast<RawAttribute&>(attr.Mutate());
+    std::string_view name = errOrName.Get();
+
+    if(name == "LocalVariableTable" || name == "LocalVariableTypeTable")
+    {
+      auto errOrBytes = remapLocalVariables(raw.Bytes, toNewStart);
+      VERIFY(errOrBytes);
+      raws.push_back({&raw, errOrBytes.Release()});
+    }
+    else if(name == "StackMapTable")
+    {
+      auto errOrBytes = remapFrames(raw.Bytes, toNewStart, toNewInstruction);
+      VERIFY(errOrBytes);
+      raws.push_back({&raw, errOrBytes.Release()});
+    }
+  }
+
+  //nothing can fail anymore
+  m_code.Code = std::move(newCode);
+  m_code.ExceptionTable = std::move(exceptionTable);
+
+  for(auto& [table, map] : lines)
+    table->LineNumberMap = std::move(map);
+
+  for(auto& [raw, bytes] : raws)
+    raw->Bytes = std::move(bytes);
+
+  m_edits.clear();
+  m_labelCount = static_cast<U32>(m_code.Code.size());
+
+  return NoError{};
+}
+
+} //namespace ClassFile
@@ -5,6 +5,8 @@
 
 #include <map>
 #include <cassert>
+#include <functional>
+#include <type_traits>
 
 namespace ClassFile
 {
@@ -48,10 +50,21 @@ CPInfo::Type CPInfo::GetType() const
 }
 
 ConstantPool::ConstantPool()
+  : ConstantPool(std::pmr::get_default_resource())
+{
+}
+
+ConstantPool::ConstantPool(std::pmr::memory_resource* resource)
+  : m_pool{resource}
 {
   m_pool.emplace_back( std::unique_ptr<CPInfo>(nullptr) );
 }
 
+std::pmr::memory_resource* ConstantPool::GetResource() const
+{
+  return m_pool.get_allocator().resource();
+}
+
 void ConstantPool::Reserve(U16 n) 
 {
   m_pool.reserve(n);
@@ -166,14 +179,535 @@ ErrorOr<std::string_view> ConstantPool::LookupDescriptor(U16 index) const
       index, m_pool[index]->GetName())};
 }
 
+template <typename T>
+static ErrorOr<MemberRef> resolveMemberRef(U16 index, const ConstantPool& cp)
+{
+  auto errOrPtr = cp.Get<T>(index);
+  VERIFY(errOrPtr);
+
+  MemberRef ref{errOrPtr.Get()->GetType(), {}, {}, {}};
+
+  if constexpr(!std::is_same_v<T, InvokeDynamicInfo>)
+  {
+    auto errOrOwner = cp.LookupString(errOrPtr.Get()->ClassIndex);
+    VERIFY(errOrOwner);
+    ref.Owner = errOrOwner.Get();
+  }
+
+  auto errOrName = getName<NameAndTypeInfo>(errOrPtr.Get()->NameAndTypeIndex, cp);
+  VERIFY(errOrName);
+  ref.Name = errOrName.Get();
+
+  auto errOrDescriptor = getDescriptor<NameAndTypeInfo>(errOrPtr.Get()->NameAndTypeIndex, cp);
+  VERIFY(errOrDescriptor);
+  ref.Descriptor = errOrDescriptor.Get();
+
+  return ref;
+}
+
+static ErrorOr<MemberRef> resolveMemberRef(U16 index, const ConstantPool& cp)
+{
+  auto errOrInfo = cp.Get(index);
+  VERIFY(errOrInfo);
+
+  switch(errOrInfo.Get()->GetType())
+  {
+    case CPInfo::Type::Fieldref:
+      return resolveMemberRef<FieldrefInfo>(index, cp);
+    case CPInfo::Type::Methodref:
+      return resolveMemberRef<MethodrefInfo>(index, cp);
+    case CPInfo::Type::InterfaceMethodref:
+      return resolveMemberRef<InterfaceMethodrefInfo>(index, cp);
+    case CPInfo::Type::InvokeDynamic:
+      return resolveMemberRef<InvokeDynamicInfo>(index, cp);
+
+    default: break;
+  }
+
+  return Error{fmt::format("ConstantPool: entry at index {} is a {}, "
+      "not a member ref", index, errOrInfo.Get()->GetName())};
+}
+
+ConstantPool::memberRefTable ConstantPool::resolveMemberRefs() const
+{
+  memberRefTable table(m_pool.size());
+
+  for(size_t i = 1; i < m_pool.size(); i++)
+  {
+    if(m_pool[i] == nullptr)
+      continue;
+
+    switch(m_pool[i]->GetType())
+    {
+      case CPInfo::Type::Fieldref:
+      case CPInfo::Type::Methodref:
+      case CPInfo::Type::InterfaceMethodref:
+      case CPInfo::Type::InvokeDynamic:
+      {
+        auto errOrRef = resolveMemberRef(static_cast<U16>(i), *this);
+        if(!errOrRef.IsError())
+          table[i] = errOrRef.Get();
+        break;
+      }
+
+      default: break;
+    }
+  }
+
+  return table;
+}
+
+ErrorOr<MemberRef> ConstantPool::ResolveMemberRef(U16 index) const
+{
+  const memberRefTable& table = m_memberRefs.Get([this]() { return this->resolveMemberRefs(); });
+
+  if(index < table.size() && table[index])
+    return *table[index];
+
+  //not a member ref or a broken one, resolve it again for the error
+  return resolveMemberRef(index, *this);
+}
+
+ErrorOr<TypeTable::TypeId> ConstantPool::lookupType(U16 index, TypeTable& types) const
+{
+  auto errOrInfo = this->Get(index);
+  VERIFY(errOrInfo);
+
+  switch(errOrInfo.Get()->GetType())
+  {
+    case CPInfo::Type::UTF8:
+    {
+      auto errOrDescriptor = this->LookupString(index);
+      VERIFY(errOrDescriptor);
+      return types.Intern(errOrDescriptor.Get());
+    }
+
+    //names classes by internal name & arrays by descriptor
+    case CPInfo::Type::Class:
+    {
+      auto errOrName = this->LookupString(index);
+      VERIFY(errOrName);
+
+      std::string_view name = errOrName.Get();
+
+      if(!name.empty() && name[0] == '[')
+        return types.Intern(name);
+
+      return types.Intern(fmt::format("L{};", name));
+    }
+
+    case CPInfo::Type::NameAndType:
+    case CPInfo::Type::MethodType:
+    case CPInfo::Type::Fieldref:
+    case CPInfo::Type::Methodref:
+    case CPInfo::Type::InterfaceMethodref:
+    case CPInfo::Type::InvokeDynamic:
+    {
+      auto errOrDescriptor = this->LookupDescriptor(index);
+      VERIFY(errOrDescriptor);
+      return types.Intern(errOrDescriptor.Get());
+    }
+
+    default: break;
+  }
+
+  return Error{fmt::format("ConstantPool: entry at index {} is a {}, "
+      "which has no type", index, errOrInfo.Get()->GetName())};
+}
+
+ErrorOr<TypeTable::TypeId> ConstantPool::LookupType(U16 index, TypeTable& types) const
+{
+  const typeCache& cache = m_types.Get([&]()
+  {
+    typeCache created{types.GetGeneration(), std::make_unique< std::atomic<TypeTable::TypeId>[] >(m_pool.size())};
+
+    for(size_t i = 0; i < m_pool.size(); i++)
+      created.Ids[i].store(TypeTable::InvalidId, std::memory_order_relaxed);
+
+    return created;
+  });
+
+  if(cache.Generation != types.GetGeneration() || index >= m_pool.size())
+    return this->lookupType(index, types);
+
+  //a type's entry is complete before its id is published (see TypeTable), 
+  //which the acquire & release here pass on to the threads reading the id
+  TypeTable::TypeId id = cache.Ids[index].load(std::memory_order_acquire);
+
+  if(id != TypeTable::InvalidId)
+    return id;
+
+  auto errOrId = this->lookupType(index, types);
+  VERIFY(errOrId);
+
+  cache.Ids[index].store(errOrId.Get(), std::memory_order_release);
+  return errOrId.Get();
+}
+
 void ConstantPool::Add(std::unique_ptr<CPInfo>&& info) 
 {
   m_pool.emplace_back(std::move(info));
+  m_memberRefs.Reset();
+  m_types.Reset();
+
+  if(m_indexed)
+    addToIndex(static_cast<U16>(m_pool.size()-1));
 }
 
 void ConstantPool::Add(CPInfo* info) 
 {
-  m_pool.emplace_back( std::unique_ptr<CPInfo>{info} ); 
+  this->Add( std::unique_ptr<CPInfo>{info} ); 
+}
+
+ErrorOr<U16> ConstantPool::FindOrAdd(std::unique_ptr<CPInfo>&& info)
+{
+  assert(info != nullptr);
+
+  if(!m_indexed)
+    buildIndex();
+
+  auto itr = m_index.find(makeIndexKey(*info));
+
+  if(itr != m_index.end())
+    return itr->second;
+
+  CPInfo::Type type = info->GetType();
+  bool isWide = type == CPInfo::Type::Long || type == CPInfo::Type::Double;
+
+  //the highest valid index is 65534 as the serialized count is a U16
+  if(m_pool.size() + (isWide ? 2 : 1) > 0xFFFF)
+  {
+    return Error{fmt::format("ConstantPool: unable to add {} entry, "
+        "pool is full ({} entries)", info->GetName(), this->GetSize())};
+  }
+
+  U16 index = static_cast<U16>(m_pool.size());
+  this->Add(std::move(info));
+
+  //Long & Double constants require the next index into the constant pool
+  //after them be invalid.
+  if(isWide)
+    this->Add(nullptr);
+
+  return index;
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddUTF8(std::string_view string)
+{
+  auto info = std::make_unique<UTF8Info>(this->GetResource());
+  info->String = string;
+  return this->FindOrAdd(std::move(info));
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddClass(std::string_view name)
+{
+  auto errOrName = this->FindOrAddUTF8(name);
+  VERIFY(errOrName);
+
+  auto info = std::make_unique<ClassInfo>();
+  info->NameIndex = errOrName.Get();
+  return this->FindOrAdd(std::move(info));
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddString(std::string_view string)
+{
+  auto errOrString = this->FindOrAddUTF8(string);
+  VERIFY(errOrString);
+
+  auto info = std::make_unique<StringInfo>();
+  info->StringIndex = errOrString.Get();
+  return this->FindOrAdd(std::move(info));
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddInteger(U32 bytes)
+{
+  auto info = std::make_unique<IntegerInfo>();
+  info->Bytes = bytes;
+  return this->FindOrAdd(std::move(info));
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddFloat(U32 bytes)
+{
+  auto info = std::make_unique<FloatInfo>();
+  info->Bytes = bytes;
+  return this->FindOrAdd(std::move(info));
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddLong(U32 highBytes, U32 lowBytes)
+{
+  auto info = std::make_unique<LongInfo>();
+  info->HighBytes = highBytes;
+  info->LowBytes  = lowBytes;
+  return this->FindOrAdd(std::move(info));
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddDouble(U32 highBytes, U32 lowBytes)
+{
+  auto info = std::make_unique<DoubleInfo>();
+  info->HighBytes = highBytes;
+  info->LowBytes  = lowBytes;
+  return this->FindOrAdd(std::move(info));
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddNameAndType(std::string_view name, 
+    std::string_view descriptor)
+{
+  auto errOrName = this->FindOrAddUTF8(name);
+  VERIFY(errOrName);
+
+  auto errOrDesc = this->FindOrAddUTF8(descriptor);
+  VERIFY(errOrDesc);
+
+  auto info = std::make_unique<NameAndTypeInfo>();
+  info->NameIndex       = errOrName.Get();
+  info->DescriptorIndex = errOrDesc.Get();
+  return this->FindOrAdd(std::move(info));
+}
+
+template <typename RefT>
+ErrorOr<U16> ConstantPool::findOrAddRef(std::string_view className, 
+    std::string_view name, std::string_view descriptor)
+{
+  auto errOrClass = this->FindOrAddClass(className);
+  VERIFY(errOrClass);
+
+  auto errOrNameAndType = this->FindOrAddNameAndType(name, descriptor);
+  VERIFY(errOrNameAndType);
+
+  auto info = std::make_unique<RefT>();
+  info->ClassIndex       = errOrClass.Get();
+  info->NameAndTypeIndex = errOrNameAndType.Get();
+  return this->FindOrAdd(std::move(info));
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddFieldref(std::string_view className, 
+    std::string_view name, std::string_view descriptor)
+{
+  return findOrAddRef<FieldrefInfo>(className, name, descriptor);
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddMethodref(std::string_view className, 
+    std::string_view name, std::string_view descriptor)
+{
+  return findOrAddRef<MethodrefInfo>(className, name, descriptor);
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddInterfaceMethodref(std::string_view className, 
+    std::string_view name, std::string_view descriptor)
+{
+  return findOrAddRef<InterfaceMethodrefInfo>(className, name, descriptor);
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddMethodHandle(U8 referenceKind, U16 referenceIndex)
+{
+  TRY(ensureValid(referenceIndex));
+
+  //JVMS 4.4.8: kinds 1-4 (get/put field & static) take a Fieldref, 5 & 8
+  //(invokevirtual, newinvokespecial) a Methodref, 9 (invokeinterface) an
+  //InterfaceMethodref & 6/7 (invokestatic, invokespecial) either method ref
+  CPInfo::Type type = m_pool[referenceIndex]->GetType();
+  bool matches = false;
+  switch(referenceKind)
+  {
+    case 1: case 2: case 3: case 4:
+      matches = type == CPInfo::Type::Fieldref;
+      break;
+    case 5: case 8:
+      matches = type == CPInfo::Type::Methodref;
+      break;
+    case 6: case 7:
+      matches = type == CPInfo::Type::Methodref ||
+                type == CPInfo::Type::InterfaceMethodref;
+      break;
+    case 9:
+      matches = type == CPInfo::Type::InterfaceMethodref;
+      break;
+
+    default:
+      return Error{fmt::format("ConstantPool::FindOrAddMethodHandle(): "
+          "invalid reference kind {}", referenceKind)};
+  }
+
+  if(!matches)
+    return Error{fmt::format("ConstantPool::FindOrAddMethodHandle(): entry at "
+        "index {} is a {}, which reference kind {} can't refer to",
+        referenceIndex, m_pool[referenceIndex]->GetName(), referenceKind)};
+
+  auto info = std::make_unique<MethodHandleInfo>();
+  info->ReferenceKind  = referenceKind;
+  info->ReferenceIndex = referenceIndex;
+  return this->FindOrAdd(std::move(info));
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddMethodType(std::string_view descriptor)
+{
+  auto errOrDesc = this->FindOrAddUTF8(descriptor);
+  VERIFY(errOrDesc);
+
+  auto info = std::make_unique<MethodTypeInfo>();
+  info->DescriptorIndex = errOrDesc.Get();
+  return this->FindOrAdd(std::move(info));
+}
+
+ErrorOr<U16> ConstantPool::FindOrAddInvokeDynamic(U16 bootstrapMethodAttrIndex, 
+    std::string_view name, std::string_view descriptor)
+{
+  auto errOrNameAndType = this->FindOrAddNameAndType(name, descriptor);
+  VERIFY(errOrNameAndType);
+
+  auto info = std::make_unique<InvokeDynamicInfo>();
+  info->BootstrapMethodAttrIndex = bootstrapMethodAttrIndex;
+  info->NameAndTypeIndex         = errOrNameAndType.Get();
+  return this->FindOrAdd(std::move(info));
+}
+
+ErrorOr< std::vector<U16> > ConstantPool::Compact(const std::vector<bool>& keep)
+{
+  auto isKept = [&](size_t i){ return i < keep.size() && keep[i] && m_pool[i] != nullptr; };
+
+  std::vector<U16> remap(m_pool.size(), 0);
+
+  U16 next = 1;
+  for(size_t i = 1; i < m_pool.size(); i++)
+  {
+    if(!isKept(i))
+      continue;
+
+    remap[i] = next++;
+
+    CPInfo::Type type = m_pool[i]->GetType();
+    if(type == CPInfo::Type::Long || type == CPInfo::Type::Double)
+      next++;
+  }
+
+  for(size_t i = 1; i < m_pool.size(); i++)
+  {
+    if(!isKept(i))
+      continue;
+
+    Error err;
+    bool dangling = false;
+
+    ForEachConstantRef(static_cast<const CPInfo&>(*m_pool[i]), [&](U16 ref)
+    {
+      if(!dangling && (ref >= remap.size() || remap[ref] == 0))
+      {
+        dangling = true;
+        err = Error{fmt::format("ConstantPool::Compact(): kept entry at index {} "
+            "(type: {}) refers to removed entry at index {}", i, m_pool[i]->GetName(), ref)};
+      }
+    });
+
+    if(dangling)
+      return err;
+  }
+
+  std::pmr::vector< std::shared_ptr<CPInfo> > pool{m_pool.get_allocator()};
+  pool.reserve(next);
+  pool.emplace_back(nullptr);
+
+  for(size_t i = 1; i < m_pool.size(); i++)
+  {
+    if(!isKept(i))
+      continue;
+
+    //entries shared with a copy of the pool are only copied if they change
+    bool moved = false;
+    ForEachConstantRef(static_cast<const CPInfo&>(*m_pool[i]), [&](U16 ref)
+    {
+      moved = moved || remap[ref] != ref;
+    });
+
+    if(moved)
+      ForEachConstantRef(*this->unshare(static_cast<U16>(i)), [&](U16& ref){ ref = remap[ref]; });
+
+    CPInfo::Type type = m_pool[i]->GetType();
+    pool.emplace_back(std::move(m_pool[i]));
+
+    if(type == CPInfo::Type::Long || type == CPInfo::Type::Double)
+      pool.emplace_back(nullptr);
+  }
+
+  m_pool = std::move(pool);
+  this->InvalidateIndex();
+
+  return remap;
+}
+
+//A copy of info allocated like the pool's own entries
+static std::shared_ptr<CPInfo> copyEntry(const CPInfo& info, std::pmr::memory_resource* resource)
+{
+  switch(info.GetType())
+  {
+    using Type = CPInfo::Type;
+    case Type::Class:       return std::make_shared<ClassInfo>(static_cast<const ClassInfo&>(info));
+    case Type::Fieldref:    return std::make_shared<FieldrefInfo>(static_cast<const FieldrefInfo&>(info));
+    case Type::Methodref:   return std::make_shared<MethodrefInfo>(static_cast<const MethodrefInfo&>(info));
+    case Type::InterfaceMethodref:
+      return std::make_shared<InterfaceMethodrefInfo>(static_cast<const InterfaceMethodrefInfo&>(info));
+    case Type::String:      return std::make_shared<StringInfo>(static_cast<const StringInfo&>(info));
+    case Type::Integer:     return std::make_shared<IntegerInfo>(static_cast<const IntegerInfo&>(info));
+    case Type::Float:       return std::make_shared<FloatInfo>(static_cast<const FloatInfo&>(info));
+    case Type::Long:        return std::make_shared<LongInfo>(static_cast<const LongInfo&>(info));
+    case Type::Double:      return std::make_shared<DoubleInfo>(static_cast<const DoubleInfo&>(info));
+    case Type::NameAndType: return std::make_shared<NameAndTypeInfo>(static_cast<const NameAndTypeInfo&>(info));
+    case Type::MethodHandle:
+      return std::make_shared<MethodHandleInfo>(static_cast<const MethodHandleInfo&>(info));
+    case Type::MethodType:  return std::make_shared<MethodTypeInfo>(static_cast<const MethodTypeInfo&>(info));
+    case Type::InvokeDynamic:
+      return std::make_shared<InvokeDynamicInfo>(static_cast<const InvokeDynamicInfo&>(info));
+
+    case Type::UTF8:
+    {
+      const auto& utf8 = static_cast<const UTF8Info&>(info);
+      auto copy = std::make_shared<UTF8Info>(resource);
+      copy->String = utf8.String;
+      copy->Interned = utf8.Interned;
+      return copy;
+    }
+  }
+
+  assert(false && "unknown constant type");
+  return nullptr;
+}
+
+CPInfo* ConstantPool::unshare(U16 index)
+{
+  std::shared_ptr<CPInfo>& entry = m_pool[index];
+
+  if(entry.use_count() > 1)
+  {
+    entry = copyEntry(*entry, this->GetResource());
+    this->InvalidateIndex();
+  }
+
+  return entry.get();
+}
+
+CPInfo* ConstantPool::unshareForWrite(U16 index)
+{
+  CPInfo* entry = this->unshare(index);
+
+  if(entry->GetType() == CPInfo::Type::UTF8)
+  {
+    auto& utf8 = static_cast<UTF8Info&>(*entry);
+
+    if(utf8.Interned)
+    {
+      utf8.String = utf8.Interned->GetString();
+      utf8.Interned = nullptr;
+    }
+  }
+
+  return entry;
+}
+
+void ConstantPool::InvalidateIndex()
+{
+  m_index.clear();
+  m_indexed = false;
+  m_memberRefs.Reset();
+  m_types.Reset();
 }
 
 U16 ConstantPool::GetSize() const
@@ -187,11 +721,6 @@ U16 ConstantPool::GetCount() const
   return this->GetSize() + 1;
 }
 
-CPInfo* ConstantPool::operator[](U16 index) 
-{
-  return m_pool[index].get();
-}
-
 const CPInfo* ConstantPool::operator[](U16 index) const
 {
   return m_pool[index].get();
@@ -208,7 +737,7 @@ ErrorOr<std::string_view> ConstantPool::lookupStringOrUTF8(U16 index) const
   VERIFY(errOrPtr, fmt::format("ConstantPool: Failed to lookup string value for "
         "constant info entry at index {} (type: {})", index, m_pool[index]->GetName()));
 
-  return std::string_view{errOrPtr.Get()->String};
+  return errOrPtr.Get()->GetString();
 }
 
 ErrorOr<void> ConstantPool::ensureValid(U16 index) const
@@ -226,6 +755,163 @@ ErrorOr<void> ConstantPool::ensureValid(U16 index) const
   return NoError{};
 }
 
+//InfoT is either CPInfo or const CPInfo, the matching const-ness gets 
+//forwarded to the derived types so the same switch serves both overloads
+template <typename Derived, typename InfoT>
+using constLike = std::conditional_t<std::is_const_v<InfoT>, const Derived, Derived>;
+
+template <typename InfoT, typename Fn>
+static void forEachRef(InfoT& info, Fn&& fn)
+{
+  using Type = CPInfo::Type;
+
+  switch(info.GetType())
+  {
+    case Type::Class:
+      fn(static_cast<constLike<ClassInfo, InfoT>&>(info).NameIndex); break;
+    case Type::Fieldref:
+    {
+      auto& ref = static_cast<constLike<FieldrefInfo, InfoT>&>(info);
+      fn(ref.ClassIndex); fn(ref.NameAndTypeIndex); break;
+    }
+    case Type::Methodref:
+    {
+      auto& ref = static_cast<constLike<MethodrefInfo, InfoT>&>(info);
+      fn(ref.ClassIndex); fn(ref.NameAndTypeIndex); break;
+    }
+    case Type::InterfaceMethodref:
+    {
+      auto& ref = static_cast<constLike<InterfaceMethodrefInfo, InfoT>&>(info);
+      fn(ref.ClassIndex); fn(ref.NameAndTypeIndex); break;
+    }
+    case Type::String:
+      fn(static_cast<constLike<StringInfo, InfoT>&>(info).StringIndex); break;
+    case Type::NameAndType:
+    {
+      auto& nat = static_cast<constLike<NameAndTypeInfo, InfoT>&>(info);
+      fn(nat.NameIndex); fn(nat.DescriptorIndex); break;
+    }
+    case Type::MethodHandle:
+      fn(static_cast<constLike<MethodHandleInfo, InfoT>&>(info).ReferenceIndex); break;
+    case Type::MethodType:
+      fn(static_cast<constLike<MethodTypeInfo, InfoT>&>(info).DescriptorIndex); break;
+    case Type::InvokeDynamic:
+      fn(static_cast<constLike<InvokeDynamicInfo, InfoT>&>(info).NameAndTypeIndex); break;
+
+    //numeric & UTF8 constants don't refer to other entries
+    default: break;
+  }
+}
+
+void ForEachConstantRef(CPInfo& info, const std::function<void(U16&)>& fn)
+{
+  forEachRef(info, fn);
+}
+
+void ForEachConstantRef(const CPInfo& info, const std::function<void(U16)>& fn)
+{
+  forEachRef(info, fn);
+}
+
+static U64 pack(U64 high, U64 low)
+{
+  return (high << 32) | low;
+}
+
+ConstantPool::indexKey ConstantPool::makeIndexKey(const CPInfo& info)
+{
+  using Type = CPInfo::Type;
+
+  indexKey key{info.GetType(), 0, {}};
+
+  switch(info.GetType())
+  {
+    case Type::Class:
+      key.Payload = static_cast<const ClassInfo&>(info).NameIndex; break;
+    case Type::Fieldref:
+    {
+      const auto& ref = static_cast<const FieldrefInfo&>(info);
+      key.Payload = pack(ref.ClassIndex, ref.NameAndTypeIndex); break;
+    }
+    case Type::Methodref:
+    {
+      const auto& ref = static_cast<const MethodrefInfo&>(info);
+      key.Payload = pack(ref.ClassIndex, ref.NameAndTypeIndex); break;
+    }
+    case Type::InterfaceMethodref:
+    {
+      const auto& ref = static_cast<const InterfaceMethodrefInfo&>(info);
+      key.Payload = pack(ref.ClassIndex, ref.NameAndTypeIndex); break;
+    }
+    case Type::String:
+      key.Payload = static_cast<const StringInfo&>(info).StringIndex; break;
+    case Type::Integer:
+      key.Payload = static_cast<const IntegerInfo&>(info).Bytes; break;
+    case Type::Float:
+      key.Payload = static_cast<const FloatInfo&>(info).Bytes; break;
+    case Type::Long:
+    {
+      const auto& num = static_cast<const LongInfo&>(info);
+      key.Payload = pack(num.HighBytes, num.LowBytes); break;
+    }
+    case Type::Double:
+    {
+      const auto& num = static_cast<const DoubleInfo&>(info);
+      key.Payload = pack(num.HighBytes, num.LowBytes); break;
+    }
+    case Type::NameAndType:
+    {
+      const auto& nat = static_cast<const NameAndTypeInfo&>(info);
+      key.Payload = pack(nat.NameIndex, nat.DescriptorIndex); break;
+    }
+    case Type::UTF8:
+      key.String = static_cast<const UTF8Info&>(info).GetString(); break;
+    case Type::MethodHandle:
+    {
+      const auto& handle = static_cast<const MethodHandleInfo&>(info);
+      key.Payload = pack(handle.ReferenceKind, handle.ReferenceIndex); break;
+    }
+    case Type::MethodType:
+      key.Payload = static_cast<const MethodTypeInfo&>(info).DescriptorIndex; break;
+    case Type::InvokeDynamic:
+    {
+      const auto& indy = static_cast<const InvokeDynamicInfo&>(info);
+      key.Payload = pack(indy.BootstrapMethodAttrIndex, indy.NameAndTypeIndex); break;
+    }
+  }
+
+  return key;
+}
+
+size_t ConstantPool::indexKeyHash::operator()(const indexKey& key) const
+{
+  size_t hash = std::hash<std::string_view>{}(key.String);
+  hash ^= std::hash<U64>{}(key.Payload) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+  hash ^= static_cast<size_t>(key.Type) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+  return hash;
+}
+
+void ConstantPool::buildIndex()
+{
+  m_index.clear();
+  m_index.reserve(m_pool.size());
+
+  for(size_t i = 1; i < m_pool.size(); i++)
+    addToIndex(static_cast<U16>(i));
+
+  m_indexed = true;
+}
+
+void ConstantPool::addToIndex(U16 index)
+{
+  //skips the unusable slots following Long & Double entries
+  if(m_pool[index] == nullptr)
+    return;
+
+  //on duplicates the first entry wins, same as a linear scan would
+  m_index.emplace(makeIndexKey(*m_pool[index]), index);
+}
+
 Error ConstantPool::failedCastError(U16 index, std::string_view castToName) const
 {
   return Error{fmt::format("ConstantPool: " 
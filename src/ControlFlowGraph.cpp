@@ -0,0 +1,446 @@
+#include "ClassFile/ControlFlowGraph.hpp"
+
+#include <fmt/core.h>
+
+#include "Util/Error.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace ClassFile
+{
+
+//instructions after which control never reaches the next one
+static bool endsFlow(OpCode op)
+{
+  switch(op)
+  {
+    case GOTO: case GOTO_W: case RET: case ATHROW:
+    case IRETURN: case LRETURN: case FRETURN: case DRETURN: case ARETURN: case RETURN:
+      return true;
+
+    default:
+      return false;
+  }
+}
+
+//Turns per block lists into CSR arrays
+template <typename ListsT>
+static void flatten(const ListsT& lists, std::vector<U32>& offsets,
+    std::vector<ControlFlowGraph::BlockId>& values)
+{
+  offsets.assign(1, 0);
+  offsets.reserve(lists.size() + 1);
+
+  for(const auto& list : lists)
+  {
+    values.insert(values.end(), list.begin(), list.end());
+    offsets.push_back(static_cast<U32>(values.size()));
+  }
+}
+
+ErrorOr<ControlFlowGraph> ControlFlowGraph::Build(const CodeAttribute& attr)
+{
+  const std::pmr::vector<Instruction>& code = attr.Code;
+  const size_t n = code.size();
+
+  if(n == 0)
+    return Error{"ControlFlowGraph::Build(): code is empty"};
+
+  //pcs[i] is the address of instruction i, pcs[n] the code length
+  std::vector<U32> pcs(n + 1);
+  U32 pc = 0;
+
+  for(size_t i = 0; i < n; i++)
+  {
+    if(code[i].IsComplex())
+    {
+      return Error{fmt::format("ControlFlowGraph::Build(): {} at pc {} is not supported",
+          code[i].GetMnemonic(), pc)};
+    }
+
+    pcs[i] = pc;
+    pc += static_cast<U32>(code[i].GetLength());
+  }
+
+  pcs[n] = pc;
+
+  //instruction index at a pc, n for the end of the code, InvalidId if pc
+  //isn't an instruction boundary
+  auto indexOf = [&](S64 target) -> U32
+  {
+    if(target < 0 || target > pcs[n])
+      return InvalidId;
+
+    auto itr = std::lower_bound(pcs.begin(), pcs.end(), static_cast<U32>(target));
+    return *itr == target ? static_cast<U32>(itr - pcs.begin()) : InvalidId;
+  };
+
+  std::vector<U8> isLeader(n + 1, false);
+  std::vector<U32> targets(n, InvalidId);
+  isLeader[0] = true;
+
+  for(size_t i = 0; i < n; i++)
+  {
+    OpCode op = code[i].GetOpCode();
+
+    if(IsBranch(op))
+    {
+      auto errOrOffset = code[i].GetBranchOffset();
+      VERIFY(errOrOffset);
+
+      U32 target = indexOf(S64{pcs[i]} + errOrOffset.Get());
+
+      if(target == InvalidId || target == n)
+      {
+        return Error{fmt::format("ControlFlowGraph::Build(): {} at pc {} branches to "
+            "invalid pc {}", code[i].GetMnemonic(), pcs[i], S64{pcs[i]} + errOrOffset.Get())};
+      }
+
+      targets[i] = target;
+      isLeader[target] = true;
+      isLeader[i + 1] = true;
+    }
+    else if(endsFlow(op))
+    {
+      isLeader[i + 1] = true;
+    }
+  }
+
+  struct handlerRange { U32 Start, End, Handler; };
+  std::vector<handlerRange> handlers;
+  handlers.reserve(attr.ExceptionTable.size());
+
+  for(const CodeAttribute::ExceptionHandler& handler : attr.ExceptionTable)
+  {
+    handlerRange range{indexOf(handler.StartPC), indexOf(handler.EndPC), indexOf(handler.HandlerPC)};
+
+    if(range.Start == InvalidId || range.End == InvalidId || range.Handler == InvalidId ||
+       range.Start >= range.End || range.Handler == n)
+    {
+      return Error{fmt::format("ControlFlowGraph::Build(): invalid exception handler "
+          "[{}, {}) -> {}", handler.StartPC, handler.EndPC, handler.HandlerPC)};
+    }
+
+    isLeader[range.Start] = isLeader[range.End] = isLeader[range.Handler] = true;
+    handlers.push_back(range);
+  }
+
+  ControlFlowGraph cfg;
+  std::vector<BlockId> blockOf(n);
+
+  for(size_t i = 0; i < n; i++)
+  {
+    if(isLeader[i])
+    {
+      cfg.m_starts.push_back(static_cast<U32>(i));
+      cfg.m_startPCs.push_back(pcs[i]);
+    }
+
+    blockOf[i] = static_cast<BlockId>(cfg.m_starts.size() - 1);
+  }
+
+  const size_t nBlocks = cfg.m_starts.size();
+  cfg.m_starts.push_back(static_cast<U32>(n));
+
+  //normal successors, at most two per block
+  cfg.m_succOffsets.reserve(nBlocks + 1);
+  cfg.m_succOffsets.push_back(0);
+
+  for(BlockId b = 0; b < nBlocks; b++)
+  {
+    U32 last = cfg.m_starts[b + 1] - 1;
+    OpCode op = code[last].GetOpCode();
+
+    bool fallsThrough = !endsFlow(op) && last + 1 < n;
+
+    if(fallsThrough)
+      cfg.m_succs.push_back(b + 1);
+
+    if(targets[last] != InvalidId && !(fallsThrough && blockOf[targets[last]] == b + 1))
+      cfg.m_succs.push_back(blockOf[targets[last]]);
+
+    cfg.m_succOffsets.push_back(static_cast<U32>(cfg.m_succs.size()));
+  }
+
+  //exception successors
+  std::vector< std::vector<BlockId> > excSuccs(nBlocks);
+
+  for(const handlerRange& range : handlers)
+  {
+    BlockId handler = blockOf[range.Handler];
+
+    for(BlockId b = blockOf[range.Start]; b < nBlocks && cfg.m_starts[b] < range.End; b++)
+    {
+      if(std::find(excSuccs[b].begin(), excSuccs[b].end(), handler) == excSuccs[b].end())
+        excSuccs[b].push_back(handler);
+    }
+  }
+
+  flatten(excSuccs, cfg.m_excOffsets, cfg.m_excSuccs);
+
+  //predecessors, by counting
+  cfg.m_predOffsets.assign(nBlocks + 1, 0);
+
+  for(BlockId s : cfg.m_succs)
+    cfg.m_predOffsets[s + 1]++;
+  for(BlockId s : cfg.m_excSuccs)
+    cfg.m_predOffsets[s + 1]++;
+
+  for(size_t b = 0; b < nBlocks; b++)
+    cfg.m_predOffsets[b + 1] += cfg.m_predOffsets[b];
+
+  cfg.m_preds.resize(cfg.m_predOffsets.back());
+  std::vector<U32> fill(cfg.m_predOffsets.begin(), cfg.m_predOffsets.end() - 1);
+
+  for(BlockId b = 0; b < nBlocks; b++)
+  {
+    for(BlockId s : cfg.GetSuccessors(b))
+      cfg.m_preds[fill[s]++] = b;
+    for(BlockId s : cfg.GetExceptionSuccessors(b))
+      cfg.m_preds[fill[s]++] = b;
+  }
+
+  cfg.computeOrder();
+  cfg.computeDominators();
+  cfg.computeLoops();
+
+  return cfg;
+}
+
+void ControlFlowGraph::computeOrder()
+{
+  const size_t nBlocks = GetBlockCount();
+
+  m_rpoIndex.assign(nBlocks, InvalidId);
+  m_rpo.clear();
+  m_rpo.reserve(nBlocks);
+
+  //iterative DFS, the second member counts the successors visited so far
+  //with the exception successors following the normal ones
+  std::vector< std::pair<BlockId, U32> > stack;
+  std::vector<U8> visited(nBlocks, false);
+
+  stack.push_back({0, 0});
+  visited[0] = true;
+
+  while(!stack.empty())
+  {
+    auto& [b, next] = stack.back();
+
+    Range succs = GetSuccessors(b);
+    Range excSuccs = GetExceptionSuccessors(b);
+
+    if(next < succs.size() + excSuccs.size())
+    {
+      BlockId s = next < succs.size() ? succs.First[next] : excSuccs.First[next - succs.size()];
+      next++;
+
+      if(!visited[s])
+      {
+        visited[s] = true;
+        stack.push_back({s, 0});
+      }
+
+      continue;
+    }
+
+    m_rpo.push_back(b); //post order for now
+    stack.pop_back();
+  }
+
+  std::reverse(m_rpo.begin(), m_rpo.end());
+
+  for(U32 i = 0; i < m_rpo.size(); i++)
+    m_rpoIndex[m_rpo[i]] = i;
+}
+
+void ControlFlowGraph::computeDominators()
+{
+  const size_t nBlocks = GetBlockCount();
+
+  m_idoms.assign(nBlocks, InvalidId);
+  m_idoms[0] = 0;
+
+  auto intersect = [&](BlockId a, BlockId b)
+  {
+    while(a != b)
+    {
+      while(m_rpoIndex[a] > m_rpoIndex[b])
+        a = m_idoms[a];
+      while(m_rpoIndex[b] > m_rpoIndex[a])
+        b = m_idoms[b];
+    }
+
+    return a;
+  };
+
+  for(bool changed = true; changed; )
+  {
+    changed = false;
+
+    for(size_t i = 1; i < m_rpo.size(); i++)
+    {
+      BlockId b = m_rpo[i];
+      BlockId idom = InvalidId;
+
+      //unreachable & not yet processed predecessors have no idom yet
+      for(BlockId p : GetPredecessors(b))
+      {
+        if(m_idoms[p] != InvalidId)
+          idom = idom == InvalidId ? p : intersect(p, idom);
+      }
+
+      if(m_idoms[b] != idom)
+      {
+        m_idoms[b] = idom;
+        changed = true;
+      }
+    }
+  }
+
+  //number the dominator tree so that Dominates() is a range check
+  std::vector<U32> childOffsets(nBlocks + 1, 0);
+
+  for(BlockId b : m_rpo)
+  {
+    if(b != 0)
+      childOffsets[m_idoms[b] + 1]++;
+  }
+
+  for(size_t b = 0; b < nBlocks; b++)
+    childOffsets[b + 1] += childOffsets[b];
+
+  std::vector<BlockId> children(childOffsets.back());
+  std::vector<U32> fill(childOffsets.begin(), childOffsets.end() - 1);
+
+  for(BlockId b : m_rpo)
+  {
+    if(b != 0)
+      children[fill[m_idoms[b]]++] = b;
+  }
+
+  m_preorder.assign(nBlocks, InvalidId);
+  m_postorder.assign(nBlocks, InvalidId);
+
+  U32 pre = 0, post = 0;
+  std::vector< std::pair<BlockId, U32> > stack{{0, childOffsets[0]}};
+  m_preorder[0] = pre++;
+
+  while(!stack.empty())
+  {
+    auto& [b, next] = stack.back();
+
+    if(next < childOffsets[b + 1])
+    {
+      BlockId child = children[next++];
+      m_preorder[child] = pre++;
+      stack.push_back({child, childOffsets[child]});
+      continue;
+    }
+
+    m_postorder[b] = post++;
+    stack.pop_back();
+  }
+}
+
+void ControlFlowGraph::computeLoops()
+{
+  const size_t nBlocks = GetBlockCount();
+  m_isLoopHeader.assign(nBlocks, false);
+
+  for(BlockId b : m_rpo)
+  {
+    for(BlockId s : GetSuccessors(b))
+      m_isLoopHeader[s] |= Dominates(s, b);
+    for(BlockId s : GetExceptionSuccessors(b))
+      m_isLoopHeader[s] |= Dominates(s, b);
+  }
+
+  m_loopHeaders.clear();
+
+  for(BlockId b = 0; b < nBlocks; b++)
+  {
+    if(m_isLoopHeader[b])
+      m_loopHeaders.push_back(b);
+  }
+}
+
+size_t ControlFlowGraph::GetBlockCount() const
+{
+  return m_startPCs.size();
+}
+
+U32 ControlFlowGraph::GetStart(BlockId b) const
+{
+  return m_starts[b];
+}
+
+U32 ControlFlowGraph::GetEnd(BlockId b) const
+{
+  return m_starts[b + 1];
+}
+
+U32 ControlFlowGraph::GetStartPC(BlockId b) const
+{
+  return m_startPCs[b];
+}
+
+ControlFlowGraph::BlockId ControlFlowGraph::GetBlockOf(size_t instruction) const
+{
+  if(instruction >= m_starts.back())
+    return InvalidId;
+
+  auto itr = std::upper_bound(m_starts.begin(), m_starts.end(), instruction);
+  return static_cast<BlockId>(itr - m_starts.begin() - 1);
+}
+
+ControlFlowGraph::Range ControlFlowGraph::GetSuccessors(BlockId b) const
+{
+  return {m_succs.data() + m_succOffsets[b], m_succs.data() + m_succOffsets[b + 1]};
+}
+
+ControlFlowGraph::Range ControlFlowGraph::GetExceptionSuccessors(BlockId b) const
+{
+  return {m_excSuccs.data() + m_excOffsets[b], m_excSuccs.data() + m_excOffsets[b + 1]};
+}
+
+ControlFlowGraph::Range ControlFlowGraph::GetPredecessors(BlockId b) const
+{
+  return {m_preds.data() + m_predOffsets[b], m_preds.data() + m_predOffsets[b + 1]};
+}
+
+const std::vector<ControlFlowGraph::BlockId>& ControlFlowGraph::GetReversePostOrder() const
+{
+  return m_rpo;
+}
+
+bool ControlFlowGraph::IsReachable(BlockId b) const
+{
+  return m_rpoIndex[b] != InvalidId;
+}
+
+ControlFlowGraph::BlockId ControlFlowGraph::GetImmediateDominator(BlockId b) const
+{
+  return m_idoms[b];
+}
+
+bool ControlFlowGraph::Dominates(BlockId a, BlockId b) const
+{
+  if(!IsReachable(a) || !IsReachable(b))
+    return false;
+
+  return m_preorder[a] <= m_preorder[b] && m_postorder[b] <= m_postorder[a];
+}
+
+bool ControlFlowGraph::IsLoopHeader(BlockId b) const
+{
+  return m_isLoopHeader[b];
+}
+
+const std::vector<ControlFlowGraph::BlockId>& ControlFlowGraph::GetLoopHeaders() const
+{
+  return m_loopHeaders;
+}
+
+} //namespace ClassFile
@@ -0,0 +1,571 @@
+#include "ClassFile/Fingerprint.hpp"
+
+#include <fmt/core.h>
+
+#include "Util/Error.hpp"
+#include "Util/Hash128.hpp"
+#include "Util/RawAttributes.hpp"
+
+#include <algorithm>
+#include <string_view>
+#include <vector>
+
+namespace ClassFile
+{
+
+std::string Fingerprint::ToString() const
+{
+  return fmt::format("{:016x}{:016x}", High, Low);
+}
+
+static Fingerprint finish(const Hasher128& hasher)
+{
+  auto [low, high] = hasher.Finish();
+  return Fingerprint{low, high};
+}
+
+static void update(Hasher128& hasher, const Fingerprint& fp)
+{
+  hasher.Update(fp.Low);
+  hasher.Update(fp.High);
+}
+
+static void update(Hasher128& hasher, std::string_view string)
+{
+  hasher.Update(static_cast<U32>(string.size()));
+  hasher.Update(string.data(), string.size());
+}
+
+static bool isDebugAttribute(std::string_view name)
+{
+  return name == "SourceFile" || name == "SourceDebugExtension" ||
+         name == "LineNumberTable" || name == "LocalVariableTable" ||
+         name == "LocalVariableTypeTable";
+}
+
+//Maps the byte offsets of a Code attribute to instruction indices
+class pcMap
+{
+  public:
+    explicit pcMap(const CodeAttribute& code)
+    {
+      U32 pc = 0;
+      m_offsets.reserve(code.Code.size() + 1);
+
+      for(const Instruction& instr : code.Code)
+      {
+        m_offsets.push_back(pc);
+        pc += static_cast<U32>(instr.GetLength());
+      }
+
+      m_offsets.push_back(pc); //the end of the code is a valid range end
+    }
+
+    U32 GetOffset(size_t index) const { return m_offsets[index]; }
+
+    //offsets in the middle of an instruction can't be mapped, those are made
+    //distinct from every index by setting the high bit
+    U32 ToIndex(S64 pc) const
+    {
+      auto itr = std::lower_bound(m_offsets.begin(), m_offsets.end(), pc);
+
+      if(itr == m_offsets.end() || *itr != pc)
+        return 0x80000000u | static_cast<U32>(pc);
+
+      return static_cast<U32>(itr - m_offsets.begin());
+    }
+
+  private:
+    std::vector<U32> m_offsets;
+};
+
+class fingerprinter
+{
+  public:
+    fingerprinter(const ClassFile& cf, const FingerprintOptions& options)
+      : m_cf{cf}, m_cp{cf.ConstPool}, m_options{options},
+        m_memo(cf.ConstPool.GetCount()), m_state(cf.ConstPool.GetCount(), notVisited) {}
+
+    ErrorOr<Fingerprint> Run()
+    {
+      Hasher128 hasher;
+
+      hasher.Update(m_cf.MinorVersion);
+      hasher.Update(m_cf.MajorVersion);
+      hasher.Update(m_cf.AccessFlags);
+      TRY(updateConst(hasher, m_cf.ThisClass));
+      TRY(updateConst(hasher, m_cf.SuperClass));
+
+      hasher.Update(static_cast<U32>(m_cf.Interfaces.size()));
+      for(U16 interface : m_cf.Interfaces)
+        TRY(updateConst(hasher, interface));
+
+      TRY(updateMembers(hasher, m_cf.Fields));
+      TRY(updateMembers(hasher, m_cf.Methods));
+      TRY(updateAttributes(hasher, m_cf.Attributes, nullptr));
+
+      return finish(hasher);
+    }
+
+  private:
+    enum : U8 { notVisited, inProgress, done };
+
+    //Writes the hash of the value of a constant, 0 stands for "no constant"
+    ErrorOr<void> updateConst(Hasher128& hasher, U16 index)
+    {
+      if(index == 0)
+      {
+        update(hasher, Fingerprint{});
+        return NoError{};
+      }
+
+      auto errOrFp = hashConst(index);
+      VERIFY(errOrFp);
+
+      update(hasher, errOrFp.Get());
+      return NoError{};
+    }
+
+    //Every constant is resolved once, referring constants reuse the hash
+    ErrorOr<Fingerprint> hashConst(U16 index)
+    {
+      if(index >= m_state.size())
+      {
+        return Error{fmt::format("ComputeFingerprint(): constant pool index {} "
+            "is out of bounds", index)};
+      }
+
+      if(m_state[index] == done)
+        return m_memo[index];
+
+      if(m_state[index] == inProgress)
+      {
+        return Error{fmt::format("ComputeFingerprint(): constant pool entry #{} "
+            "refers to itself", index)};
+      }
+
+      m_state[index] = inProgress;
+
+      auto errOrInfo = m_cp.Get(index);
+      VERIFY(errOrInfo);
+
+      const CPInfo& info = *errOrInfo.Get();
+
+      Hasher128 hasher;
+      hasher.Update(static_cast<U8>(info.GetType()));
+
+      switch(info.GetType())
+      {
+        case CPInfo::Type::UTF8:
+          update(hasher, static_cast<const UTF8Info&>(info).GetString());
+          break;
+
+        case CPInfo::Type::Integer:
+          hasher.Update(static_cast<const IntegerInfo&>(info).Bytes);
+          break;
+        case CPInfo::Type::Float:
+          hasher.Update(static_cast<const FloatInfo&>(info).Bytes);
+          break;
+        case CPInfo::Type::Long:
+          hasher.Update(static_cast<const LongInfo&>(info).HighBytes);
+          hasher.Update(static_cast<const LongInfo&>(info).LowBytes);
+          break;
+        case CPInfo::Type::Double:
+          hasher.Update(static_cast<const DoubleInfo&>(info).HighBytes);
+          hasher.Update(static_cast<const DoubleInfo&>(info).LowBytes);
+          break;
+
+        case CPInfo::Type::MethodHandle:
+          hasher.Update(static_cast<const MethodHandleInfo&>(info).ReferenceKind);
+          TRY(updateConst(hasher, static_cast<const MethodHandleInfo&>(info).ReferenceIndex));
+          break;
+
+        case CPInfo::Type::InvokeDynamic:
+          //an index into BootstrapMethods, not the constant pool
+          hasher.Update(static_cast<const InvokeDynamicInfo&>(info).BootstrapMethodAttrIndex);
+          TRY(updateConst(hasher, static_cast<const InvokeDynamicInfo&>(info).NameAndTypeIndex));
+          break;
+
+        default:
+        {
+          ErrorOr<void> errOrRefs{NoError{}};
+
+          ForEachConstantRef(info, [&](U16 ref)
+          {
+            if(!errOrRefs.IsError())
+              errOrRefs = updateConst(hasher, ref);
+          });
+
+          VERIFY(errOrRefs);
+          break;
+        }
+      }
+
+      m_memo[index] = finish(hasher);
+      m_state[index] = done;
+      return m_memo[index];
+    }
+
+    template <typename Members>
+    ErrorOr<void> updateMembers(Hasher128& hasher, const Members& members)
+    {
+      hasher.Update(static_cast<U32>(members.size()));
+
+      for(const FieldMethodInfo& member : members)
+      {
+        hasher.Update(member.AccessFlags);
+        TRY(updateConst(hasher, member.NameIndex));
+        TRY(updateConst(hasher, member.DescriptorIndex));
+        TRY(updateAttributes(hasher, member.Attributes, nullptr));
+      }
+
+      return NoError{};
+    }
+
+    //Attributes are hashed one by one and their hashes sorted, so the order of
+    //the table doesn't matter. pcs is set for the attributes of a Code.
+    template <typename Attributes>
+    ErrorOr<void> updateAttributes(Hasher128& hasher, const Attributes& attrs, const pcMap* pcs)
+    {
+      std::vector<Fingerprint> fps;
+      fps.reserve(attrs.size());
+
+      for(const auto& attr : attrs)
+      {
+        auto errOrName = m_cp.LookupString(attr->NameIndex);
+        VERIFY(errOrName, "failed to lookup attribute name");
+
+        if(m_options.ExcludeDebugInfo && isDebugAttribute(errOrName.Get()))
+          continue;
+
+        Hasher128 attrHasher;
+        update(attrHasher, errOrName.Get());
+        TRY(updateAttribute(attrHasher, errOrName.Get(), *attr, pcs));
+
+        fps.push_back(finish(attrHasher));
+      }
+
+      std::sort(fps.begin(), fps.end());
+
+      hasher.Update(static_cast<U32>(fps.size()));
+      for(const Fingerprint& fp : fps)
+        update(hasher, fp);
+
+      return NoError{};
+    }
+
+    ErrorOr<void> updateAttribute(Hasher128& hasher, std::string_view name,
+        const AttributeInfo& attr, const pcMap* pcs)
+    {
+      switch(attr.GetType())
+      {
+        case AttributeInfo::Type::ConstantValue:
+          return updateConst(hasher, static_cast<const ConstantValueAttribute&>(attr).Index);
+
+        case AttributeInfo::Type::Code:
+          return updateCode(hasher, static_cast<const CodeAttribute&>(attr));
+
+        case AttributeInfo::Type::Exceptions:
+        {
+          const auto& exceptions = static_cast<const ExceptionsAttribute&>(attr);
+
+          hasher.Update(static_cast<U32>(exceptions.ExceptionTable.size()));
+          for(U16 exception : exceptions.ExceptionTable)
+            TRY(updateConst(hasher, exception));
+
+          return NoError{};
+        }
+
+        case AttributeInfo::Type::SourceFile:
+          return updateConst(hasher, static_cast<const SourceFileAttribute&>(attr).SourceFileIndex);
+
+        case AttributeInfo::Type::LineNumberTable:
+        {
+          const auto& lines = static_cast<const LineNumberTableAttribute&>(attr);
+
+          hasher.Update(static_cast<U32>(lines.LineNumberMap.size()));
+          for(const auto& mapping : lines.LineNumberMap)
+          {
+            hasher.Update(pcs ? pcs->ToIndex(mapping.PC) : U32{mapping.PC});
+            hasher.Update(mapping.LineNumber);
+          }
+
+          return NoError{};
+        }
+
+        case AttributeInfo::Type::Raw:
+        {
+          const auto& raw = static_cast<const RawAttribute&>(attr);
+
+          //the attributes of a Code that hold pcs, those that don't decode
+          //are hashed as is
+          if(pcs && (name == "StackMapTable" || name == "LocalVariableTable" ||
+                     name == "LocalVariableTypeTable"))
+          {
+            Hasher128 decoded;
+            auto result = name == "StackMapTable" ? updateStackMapTable(decoded, raw, *pcs)
+                                                  : updateLocalVariableTable(decoded, raw, *pcs);
+
+            if(!result.IsError())
+            {
+              update(hasher, finish(decoded));
+              return NoError{};
+            }
+          }
+
+          return updateRaw(hasher, name, raw);
+        }
+      }
+
+      return NoError{};
+    }
+
+    ErrorOr<void> updateCode(Hasher128& hasher, const CodeAttribute& code)
+    {
+      pcMap pcs{code};
+
+      hasher.Update(code.MaxStack);
+      hasher.Update(code.MaxLocals);
+      hasher.Update(static_cast<U32>(code.Code.size()));
+
+      for(size_t i = 0; i < code.Code.size(); i++)
+      {
+        const Instruction& instr = code.Code[i];
+        OpCode op = instr.GetOpCode();
+
+        hasher.Update(static_cast<U8>(op == OpCode::LDC_W ? OpCode::LDC : op));
+        hasher.Update(static_cast<U8>(instr.IsWide()));
+
+        for(size_t operand = 0; operand < instr.GetNOperands(); operand++)
+        {
+          auto errOrValue = instr.GetOperand(operand);
+          VERIFY(errOrValue);
+
+          if(operand == 0 && HasConstantPoolIndex(op))
+          {
+            TRY(updateConst(hasher, static_cast<U16>(errOrValue.Get())));
+          }
+          else if(operand == 0 && IsBranch(op))
+          {
+            auto errOrOffset = instr.GetBranchOffset();
+            VERIFY(errOrOffset);
+
+            hasher.Update(pcs.ToIndex(S64{pcs.GetOffset(i)} + errOrOffset.Get()));
+          }
+          else
+          {
+            hasher.Update(static_cast<U32>(errOrValue.Get()));
+          }
+        }
+      }
+
+      hasher.Update(static_cast<U32>(code.ExceptionTable.size()));
+      for(const auto& handler : code.ExceptionTable)
+      {
+        hasher.Update(pcs.ToIndex(handler.StartPC));
+        hasher.Update(pcs.ToIndex(handler.EndPC));
+        hasher.Update(pcs.ToIndex(handler.HandlerPC));
+        TRY(updateConst(hasher, handler.CatchType));
+      }
+
+      return updateAttributes(hasher, code.Attributes, &pcs);
+    }
+
+    //Frames are hashed by kind & the index of the instruction they're for,
+    //rather than by their offset deltas & compact encodings, which depend on
+    //the byte length of the code before them
+    ErrorOr<void> updateStackMapTable(Hasher128& hasher, const RawAttribute& attr, const pcMap& pcs)
+    {
+      enum : U8 { same, sameLocals1StackItem, chop, append, full };
+
+      RawAttributes::Reader r{attr.Bytes.data(), attr.Bytes.size()};
+
+      auto errOrCount = r.U2();
+      VERIFY(errOrCount);
+      hasher.Update(errOrCount.Get());
+
+      S64 pc = -1;
+
+      for(U16 i = 0; i < errOrCount.Get(); i++)
+      {
+        auto errOrType = r.U1();
+        VERIFY(errOrType);
+
+        U8 type = errOrType.Get();
+        U8 kind;
+        U32 delta;
+
+        if(type <= 63)
+        {
+          kind = same;
+          delta = type;
+        }
+        else if(type <= 127)
+        {
+          kind = sameLocals1StackItem;
+          delta = type - 64u;
+        }
+        else if(type < 247)
+        {
+          return Error{fmt::format("Fingerprint: reserved stack map frame type {}", type)};
+        }
+        else
+        {
+          auto errOrDelta = r.U2();
+          VERIFY(errOrDelta);
+          delta = errOrDelta.Get();
+
+          if(type == 247)      kind = sameLocals1StackItem;
+          else if(type <= 250) kind = chop;
+          else if(type == 251) kind = same;
+          else if(type <= 254) kind = append;
+          else                 kind = full;
+        }
+
+        //the first frame is at offset_delta, later ones offset_delta + 1 after the previous
+        pc += S64{delta} + 1;
+        hasher.Update(kind);
+        hasher.Update(pcs.ToIndex(pc));
+
+        if(kind == sameLocals1StackItem)
+        {
+          TRY(updateVerificationType(hasher, r, pcs));
+        }
+        else if(kind == chop || kind == append)
+        {
+          hasher.Update(type);
+
+          for(int j = 0; kind == append && j < type - 251; j++)
+            TRY(updateVerificationType(hasher, r, pcs));
+        }
+        else if(kind == full)
+        {
+          for(int list = 0; list < 2; list++)
+          {
+            auto errOrN = r.U2();
+            VERIFY(errOrN);
+            hasher.Update(errOrN.Get());
+
+            for(U16 j = 0; j < errOrN.Get(); j++)
+              TRY(updateVerificationType(hasher, r, pcs));
+          }
+        }
+      }
+
+      if(r.Pos != r.Len)
+        return Error{"Fingerprint: trailing bytes after the stack map frames"};
+
+      return NoError{};
+    }
+
+    //Ranges are hashed as the indices of their first instruction & of the one
+    //after them, like the ranges of the exception table
+    ErrorOr<void> updateLocalVariableTable(Hasher128& hasher, const RawAttribute& attr, const pcMap& pcs)
+    {
+      RawAttributes::Reader r{attr.Bytes.data(), attr.Bytes.size()};
+
+      auto errOrCount = r.U2();
+      VERIFY(errOrCount);
+      hasher.Update(errOrCount.Get());
+
+      for(U16 i = 0; i < errOrCount.Get(); i++)
+      {
+        auto errOrStart = r.U2();
+        VERIFY(errOrStart);
+        auto errOrLength = r.U2();
+        VERIFY(errOrLength);
+        auto errOrName = r.U2();
+        VERIFY(errOrName);
+        auto errOrDescriptor = r.U2(); //signature_index for LocalVariableTypeTable
+        VERIFY(errOrDescriptor);
+        auto errOrIndex = r.U2();
+        VERIFY(errOrIndex);
+
+        hasher.Update(pcs.ToIndex(errOrStart.Get()));
+        hasher.Update(pcs.ToIndex(S64{errOrStart.Get()} + errOrLength.Get()));
+        TRY(updateConst(hasher, errOrName.Get()));
+        TRY(updateConst(hasher, errOrDescriptor.Get()));
+        hasher.Update(errOrIndex.Get());
+      }
+
+      if(r.Pos != r.Len)
+        return Error{"Fingerprint: trailing bytes after the local variables"};
+
+      return NoError{};
+    }
+
+    ErrorOr<void> updateVerificationType(Hasher128& hasher, RawAttributes::Reader& r, const pcMap& pcs)
+    {
+      auto errOrTag = r.U1();
+      VERIFY(errOrTag);
+      hasher.Update(errOrTag.Get());
+
+      if(errOrTag.Get() == 7) //Object_variable_info
+      {
+        auto errOrIndex = r.U2();
+        VERIFY(errOrIndex);
+        return updateConst(hasher, errOrIndex.Get());
+      }
+
+      if(errOrTag.Get() == 8) //Uninitialized_variable_info, the offset of its new
+      {
+        auto errOrOffset = r.U2();
+        VERIFY(errOrOffset);
+        hasher.Update(pcs.ToIndex(errOrOffset.Get()));
+        return NoError{};
+      }
+
+      if(errOrTag.Get() > 8)
+        return Error{fmt::format("Fingerprint: invalid verification type tag {}", errOrTag.Get())};
+
+      return NoError{};
+    }
+
+    //The bytes between indices are hashed as is, the indices by value
+    ErrorOr<void> updateRaw(Hasher128& hasher, std::string_view name, const RawAttribute& attr)
+    {
+      const U8* bytes = attr.Bytes.data();
+      size_t len = attr.Bytes.size();
+
+      std::vector<size_t> offsets;
+      auto errOrRefs = RawAttributes::ForEachConstantRef(m_cp, name, bytes, len,
+          [&](size_t offset){ offsets.push_back(offset); });
+
+      hasher.Update(static_cast<U32>(len));
+
+      if(errOrRefs.IsError())
+      {
+        hasher.Update(bytes, len);
+        return NoError{};
+      }
+
+      //nested Record attributes report their name after their payload's
+      //indices, everything else is reported in order
+      std::sort(offsets.begin(), offsets.end());
+
+      size_t pos = 0;
+      for(size_t offset : offsets)
+      {
+        hasher.Update(bytes + pos, offset - pos);
+        TRY(updateConst(hasher, RawAttributes::ReadIndex(bytes, offset)));
+        pos = offset + 2;
+      }
+
+      hasher.Update(bytes + pos, len - pos);
+      return NoError{};
+    }
+
+    const ClassFile& m_cf;
+    const ConstantPool& m_cp;
+    const FingerprintOptions& m_options;
+
+    std::vector<Fingerprint> m_memo;
+    std::vector<U8> m_state;
+};
+
+ErrorOr<Fingerprint> ComputeFingerprint(const ClassFile& cf, const FingerprintOptions& options)
+{
+  return fingerprinter{cf, options}.Run();
+}
+
+} //namespace ClassFile
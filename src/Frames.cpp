@@ -0,0 +1,1516 @@
+#include "ClassFile/Frames.hpp"
+#include "ClassFile/ControlFlowGraph.hpp"
+#include "ClassFile/Misc.hpp"
+
+#include <fmt/core.h>
+
+#include "Util/Error.hpp"
+
+#include <algorithm>
+#include <array>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace ClassFile
+{
+
+static constexpr std::string_view objectClass = "java/lang/Object";
+
+ErrorOr<std::string> ClassHierarchyOracle::GetCommonSuperClass(std::string_view a,
+    std::string_view b) const
+{
+  using ClassId = ClassHierarchy::ClassId;
+
+  if(a == b)
+    return std::string{a};
+
+  if(a == objectClass || b == objectClass)
+    return std::string{objectClass};
+
+  ClassId idA = m_hierarchy.Find(a);
+  ClassId idB = m_hierarchy.Find(b);
+
+  for(auto [id, name] : {std::pair{idA, a}, std::pair{idB, b}})
+  {
+    if(id == ClassHierarchy::InvalidId || !m_hierarchy.IsDefined(id))
+    {
+      return Error{fmt::format("ClassHierarchyOracle::GetCommonSuperClass(): "
+          "\"{}\" isn't defined in the hierarchy", name)};
+    }
+  }
+
+  if(m_hierarchy.IsInterface(idA) || m_hierarchy.IsInterface(idB))
+    return std::string{objectClass};
+
+  //the chain ends at java/lang/Object or at the first class that isn't defined
+  std::vector<ClassId> chain;
+
+  for(ClassId id = idA; id != ClassHierarchy::InvalidId; id = m_hierarchy.GetSuperClass(id))
+    chain.push_back(id);
+
+  for(ClassId id = idB; id != ClassHierarchy::InvalidId; id = m_hierarchy.GetSuperClass(id))
+  {
+    if(std::find(chain.begin(), chain.end(), id) != chain.end())
+      return std::string{m_hierarchy.GetName(id)};
+  }
+
+  return Error{fmt::format("ClassHierarchyOracle::GetCommonSuperClass(): the "
+      "superclasses of \"{}\" and \"{}\" aren't fully known", a, b)};
+}
+
+//Stack effect in slots of every opcode whose effect doesn't depend on its
+//operands, variableEffect for those that do (field access, invokes &
+//multianewarray) & the unsupported ones
+static constexpr S8 variableEffect = 0x7F;
+
+static constexpr std::array<S8, 256> makeStackEffects()
+{
+  std::array<S8, 256> effects{};
+
+  for(S8& effect : effects)
+    effect = variableEffect;
+
+  auto set = [&](int first, int last, S8 effect)
+  {
+    for(int op = first; op <= last; op++)
+      effects[op] = effect;
+  };
+
+  //I, L, F, D (& A) variants follow each other in that order
+  auto setTyped = [&](int first, S8 i, S8 l, S8 f, S8 d)
+  {
+    effects[first] = i;
+    effects[first + 1] = l;
+    effects[first + 2] = f;
+    effects[first + 3] = d;
+  };
+
+  set(NOP, NOP, 0);
+  set(ACONST_NULL, ICONST_5, 1);
+  set(LCONST_0, LCONST_1, 2);
+  set(FCONST_0, FCONST_2, 1);
+  set(DCONST_0, DCONST_1, 2);
+  set(BIPUSH, LDC_W, 1);
+  set(LDC2_W, LDC2_W, 2);
+
+  setTyped(ILOAD, 1, 2, 1, 2);
+  set(ALOAD, ALOAD, 1);
+  set(ILOAD_0, ILOAD_3, 1);
+  set(LLOAD_0, LLOAD_3, 2);
+  set(FLOAD_0, FLOAD_3, 1);
+  set(DLOAD_0, DLOAD_3, 2);
+  set(ALOAD_0, ALOAD_3, 1);
+  setTyped(IALOAD, -1, 0, -1, 0);
+  set(AALOAD, SALOAD, -1);
+
+  setTyped(ISTORE, -1, -2, -1, -2);
+  set(ASTORE, ASTORE, -1);
+  set(ISTORE_0, ISTORE_3, -1);
+  set(LSTORE_0, LSTORE_3, -2);
+  set(FSTORE_0, FSTORE_3, -1);
+  set(DSTORE_0, DSTORE_3, -2);
+  set(ASTORE_0, ASTORE_3, -1);
+  setTyped(IASTORE, -3, -4, -3, -4);
+  set(AASTORE, SASTORE, -3);
+
+  set(POP, POP, -1);
+  set(POP2, POP2, -2);
+  set(DUP, DUP_X2, 1);
+  set(DUP2, DUP2_X2, 2);
+  set(SWAP, SWAP, 0);
+
+  for(int op = IADD; op <= DREM; op += 4)
+    setTyped(op, -1, -2, -1, -2);
+
+  set(INEG, DNEG, 0);
+  set(ISHL, LUSHR, -1);
+  set(IAND, LXOR, -1);
+  set(LAND, LAND, -2);
+  set(LOR, LOR, -2);
+  set(LXOR, LXOR, -2);
+  set(IINC, IINC, 0);
+
+  setTyped(I2L, 1, 0, 1, -1);         //I2L I2F I2D L2I
+  setTyped(L2F, -1, 0, 0, 1);         //L2F L2D F2I F2L
+  setTyped(F2D, 1, -1, 0, -1);        //F2D D2I D2L D2F
+  set(I2B, I2S, 0);
+  setTyped(LCMP, -3, -1, -1, -3);     //LCMP FCMPL FCMPG DCMPL
+  set(DCMPG, DCMPG, -3);
+
+  set(IFEQ, IFLE, -1);
+  set(IF_ICMPEQ, IF_ACMPNE, -2);
+  set(GOTO, GOTO, 0);
+  set(JSR, JSR, 1);
+  set(RET, RET, 0);
+  setTyped(IRETURN, -1, -2, -1, -2);
+  set(ARETURN, ARETURN, -1);
+  set(RETURN, RETURN, 0);
+
+  set(NEW, NEW, 1);
+  set(NEWARRAY, ARRAYLENGTH, 0);
+  set(ATHROW, ATHROW, -1);
+  set(CHECKCAST, INSTANCEOF, 0);
+  set(MONITORENTER, MONITOREXIT, -1);
+  set(IFNULL, IFNONNULL, -1);
+  set(GOTO_W, GOTO_W, 0);
+  set(JSR_W, JSR_W, 1);
+
+  return effects;
+}
+
+static constexpr std::array<S8, 256> stackEffects = makeStackEffects();
+
+static U16 getIndex(const Instruction& instr)
+{
+  return static_cast<U16>(instr.GetOperand(0).Get());
+}
+
+//The local variable a load, store, iinc or ret accesses & the number of slots
+//it spans, false for every other instruction
+static bool getLocal(const Instruction& instr, U32& index, U32& width)
+{
+  OpCode op = instr.GetOpCode();
+
+  switch(op)
+  {
+    case ILOAD: case FLOAD: case ALOAD: case ISTORE: case FSTORE: case ASTORE:
+    case IINC: case RET:
+      index = static_cast<U32>(instr.GetOperand(0).Get());
+      width = 1;
+      return true;
+
+    case LLOAD: case DLOAD: case LSTORE: case DSTORE:
+      index = static_cast<U32>(instr.GetOperand(0).Get());
+      width = 2;
+      return true;
+
+    default: break;
+  }
+
+  //the _n forms come in groups of 4 per type: I, L, F, D, A
+  for(OpCode first : {ILOAD_0, ISTORE_0})
+  {
+    if(op >= first && op < first + 20)
+    {
+      U32 type = (op - first) / 4;
+      index = (op - first) % 4;
+      width = type == 1 || type == 3 ? 2 : 1;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+//Stack effect of the instructions with a variableEffect
+static ErrorOr<S32> getVariableEffect(const ConstantPool& cp, const Instruction& instr)
+{
+  OpCode op = instr.GetOpCode();
+
+  switch(op)
+  {
+    case GETSTATIC: case PUTSTATIC: case GETFIELD: case PUTFIELD:
+    {
+      auto errOrRef = cp.ResolveMemberRef(getIndex(instr));
+      VERIFY(errOrRef);
+      auto errOrType = ViewFieldDescriptor(errOrRef.Get().Descriptor);
+      VERIFY(errOrType);
+
+      S32 size = static_cast<S32>(errOrType.Get().GetSlots());
+
+      switch(op)
+      {
+        case GETSTATIC: return size;
+        case PUTSTATIC: return -size;
+        case GETFIELD:  return size - 1;
+        default:        return -size - 1;
+      }
+    }
+
+    case INVOKEVIRTUAL: case INVOKESPECIAL: case INVOKESTATIC:
+    case INVOKEINTERFACE: case INVOKEDYNAMIC:
+    {
+      auto errOrRef = cp.ResolveMemberRef(getIndex(instr));
+      VERIFY(errOrRef);
+      auto errOrMethod = ViewMethodDescriptor(errOrRef.Get().Descriptor);
+      VERIFY(errOrMethod);
+
+      const MethodDescriptorView& method = errOrMethod.Get();
+      S32 effect = op == INVOKESTATIC || op == INVOKEDYNAMIC ? 0 : -1;
+
+      return effect - static_cast<S32>(method.GetParameterSlots()) +
+        static_cast<S32>(method.GetReturnType().GetSlots());
+    }
+
+    case MULTIANEWARRAY:
+      return 1 - static_cast<S32>(instr.GetOperand(1).Get());
+
+    default:
+      return Error{fmt::format("{} is not supported", instr.GetMnemonic())};
+  }
+}
+
+static CodeAttribute* findCode(FieldMethodInfo& method)
+{
+  for(auto& attr : method.Attributes)
+  {
+    if(attr->GetType() == AttributeInfo::Type::Code)
+      return &static_cast<CodeAttribute&>(attr.Mutate());
+  }
+
+  return nullptr;
+}
+
+//Slots taken by the parameters, including this
+static ErrorOr<U32> getParameterSlots(const ConstantPool& cp, const FieldMethodInfo& method)
+{
+  auto errOrDescriptor = cp.LookupString(method.DescriptorIndex);
+  VERIFY(errOrDescriptor, "failed to lookup method descriptor");
+
+  bool isStatic = method.AccessFlags & static_cast<U16>(FieldMethodInfo::AccessFlag::STATIC);
+
+  auto errOrMethod = ViewMethodDescriptor(errOrDescriptor.Get());
+  VERIFY(errOrMethod);
+
+  return (isStatic ? 0 : 1) + errOrMethod.Get().GetParameterSlots();
+}
+
+static U32 getLocalCount(const CodeAttribute& code, U32 parameterSlots)
+{
+  U32 count = parameterSlots;
+  U32 index, width;
+
+  for(const Instruction& instr : code.Code)
+  {
+    if(getLocal(instr, index, width))
+      count = std::max(count, index + width);
+  }
+
+  return count;
+}
+
+static std::vector<U32> getOffsets(const CodeAttribute& code)
+{
+  std::vector<U32> pcs;
+  pcs.reserve(code.Code.size() + 1);
+
+  U32 pc = 0;
+  for(const Instruction& instr : code.Code)
+  {
+    pcs.push_back(pc);
+    pc += static_cast<U32>(instr.GetLength());
+  }
+
+  pcs.push_back(pc);
+  return pcs;
+}
+
+ErrorOr<void> ComputeMaxs(const ConstantPool& cp, FieldMethodInfo& method)
+{
+  CodeAttribute* code = findCode(method);
+
+  if(!code)
+    return NoError{};
+
+  auto errOrCfg = ControlFlowGraph::Build(*code);
+  VERIFY(errOrCfg);
+  const ControlFlowGraph& cfg = errOrCfg.Get();
+
+  auto errOrParameters = getParameterSlots(cp, method);
+  VERIFY(errOrParameters);
+
+  std::vector<U32> pcs = getOffsets(*code);
+
+  //stack height at the start of each block, -1 until it's reached
+  std::vector<S32> heights(cfg.GetBlockCount(), -1);
+  std::vector<ControlFlowGraph::BlockId> worklist{0};
+  heights[0] = 0;
+
+  S32 maxStack = 0;
+
+  auto reach = [&](ControlFlowGraph::BlockId b, S32 height) -> ErrorOr<void>
+  {
+    if(heights[b] == -1)
+    {
+      heights[b] = height;
+      worklist.push_back(b);
+    }
+    else if(heights[b] != height)
+    {
+      return Error{fmt::format("ComputeMaxs(): inconsistent stack height at pc {}",
+          cfg.GetStartPC(b))};
+    }
+
+    return NoError{};
+  };
+
+  while(!worklist.empty())
+  {
+    ControlFlowGraph::BlockId b = worklist.back();
+    worklist.pop_back();
+
+    S32 height = heights[b];
+
+    for(U32 i = cfg.GetStart(b); i < cfg.GetEnd(b); i++)
+    {
+      const Instruction& instr = code->Code[i];
+      S32 effect = stackEffects[instr.GetOpCode()];
+
+      if(effect == variableEffect)
+      {
+        auto errOrEffect = getVariableEffect(cp, instr);
+
+        if(errOrEffect.IsError())
+        {
+          return Error{fmt::format("ComputeMaxs(): pc {}: {}", pcs[i],
+              errOrEffect.GetError().What)};
+        }
+
+        effect = errOrEffect.Get();
+      }
+
+      height += effect;
+
+      if(height < 0)
+        return Error{fmt::format("ComputeMaxs(): stack underflow at pc {}", pcs[i])};
+
+      maxStack = std::max(maxStack, height);
+    }
+
+    //the return address pushed by jsr is gone once the subroutine returns
+    OpCode last = code->Code[cfg.GetEnd(b) - 1].GetOpCode();
+    bool isJsr = last == JSR || last == JSR_W;
+
+    for(ControlFlowGraph::BlockId s : cfg.GetSuccessors(b))
+      TRY(reach(s, isJsr && s == b + 1 ? height - 1 : height));
+
+    for(ControlFlowGraph::BlockId s : cfg.GetExceptionSuccessors(b))
+      TRY(reach(s, 1));
+
+    if(!cfg.GetExceptionSuccessors(b).empty())
+      maxStack = std::max(maxStack, S32{1});
+  }
+
+  code->MaxStack = static_cast<U16>(maxStack);
+  code->MaxLocals = static_cast<U16>(getLocalCount(*code, errOrParameters.Get()));
+
+  return NoError{};
+}
+
+//Infers the types of the locals & the stack at the start of every basic block
+//and encodes the StackMapTable from them.
+//
+//Types are single U32s: the verification_type_info tag in the low 4 bits and
+//a payload above, the index of the class name for Object & the pc of the new
+//instruction for Uninitialized. Longs & doubles take two slots both in locals
+//and on the stack, the second one holding Top.
+class frameAnalyzer
+{
+  public:
+    frameAnalyzer(ClassFile& cf, FieldMethodInfo& method, CodeAttribute& code,
+        const HierarchyOracle& oracle)
+      : m_cf{cf}, m_method{method}, m_code{code}, m_oracle{oracle} {}
+
+    ErrorOr<void> Run()
+    {
+      auto errOrCfg = ControlFlowGraph::Build(m_code);
+      VERIFY(errOrCfg);
+      m_cfg = &errOrCfg.Get();
+
+      m_pcs = getOffsets(m_code);
+
+      auto errOrThis = m_cf.ConstPool.LookupString(m_cf.ThisClass);
+      VERIFY(errOrThis, "failed to lookup this_class");
+      m_thisClass = errOrThis.Get();
+
+      auto errOrParameters = getParameterSlots(m_cf.ConstPool, m_method);
+      VERIFY(errOrParameters);
+      m_localCount = getLocalCount(m_code, errOrParameters.Get());
+
+      TRY(collectHandlers());
+      TRY(initEntry());
+
+      while(!m_worklist.empty())
+      {
+        ControlFlowGraph::BlockId b = m_worklist.back();
+        m_worklist.pop_back();
+        m_queued[b] = false;
+
+        TRY(processBlock(b));
+      }
+
+      return writeFrames();
+    }
+
+  private:
+    using type = U32;
+    using BlockId = ControlFlowGraph::BlockId;
+
+    enum tag : U32
+    {
+      Top               = 0,
+      Integer           = 1,
+      Float             = 2,
+      Double            = 3,
+      Long              = 4,
+      Null              = 5,
+      UninitializedThis = 6,
+      Object            = 7,
+      Uninitialized     = 8,
+    };
+
+    static constexpr type makeType(tag t, U32 payload = 0) { return t | payload << 4; }
+    static constexpr tag getTag(type t) { return static_cast<tag>(t & 0xF); }
+    static constexpr U32 getPayload(type t) { return t >> 4; }
+
+    static bool isWide(type t) { return t == Long || t == Double; }
+    static bool isReference(type t) { return getTag(t) == Object || t == Null; }
+
+    struct frame
+    {
+      std::vector<type> Locals;
+      std::vector<type> Stack;
+    };
+
+    struct handler
+    {
+      BlockId Block;
+      type CatchType;
+    };
+
+    ErrorOr<void> error(U32 instruction, std::string_view what) const
+    {
+      return Error{fmt::format("ComputeFrames(): pc {}: {}", m_pcs[instruction], what)};
+    }
+
+    type getObject(std::string_view name)
+    {
+      auto itr = m_nameIds.find(std::string{name});
+
+      if(itr != m_nameIds.end())
+        return makeType(Object, itr->second);
+
+      U32 id = static_cast<U32>(m_names.size());
+      m_names.emplace_back(name);
+      m_nameIds.emplace(m_names.back(), id);
+
+      return makeType(Object, id);
+    }
+
+    //Type of a field descriptor, Top for void
+    type getType(std::string_view descriptor)
+    {
+      switch(descriptor[0])
+      {
+        case 'Z': case 'B': case 'C': case 'S': case 'I': return Integer;
+        case 'F': return Float;
+        case 'J': return Long;
+        case 'D': return Double;
+        case 'L': return getObject(descriptor.substr(1, descriptor.size() - 2));
+        case '[': return getObject(descriptor);
+        default:  return Top;
+      }
+    }
+
+    //Class constants name classes by internal name & arrays by descriptor,
+    //just like the types do
+    ErrorOr<type> getClassType(U16 index)
+    {
+      auto errOrName = m_cf.ConstPool.LookupString(index);
+      VERIFY(errOrName);
+      return getObject(errOrName.Get());
+    }
+
+    ErrorOr<void> collectHandlers()
+    {
+      m_handlers.resize(m_cfg->GetBlockCount());
+      m_isHandler.assign(m_cfg->GetBlockCount(), false);
+
+      for(const CodeAttribute::ExceptionHandler& entry : m_code.ExceptionTable)
+      {
+        type catchType = getObject("java/lang/Throwable");
+
+        if(entry.CatchType != 0)
+        {
+          auto errOrType = getClassType(entry.CatchType);
+          VERIFY(errOrType, "failed to lookup catch type");
+          catchType = errOrType.Get();
+        }
+
+        //the graph already checked that these are instruction boundaries
+        auto toBlock = [&](U16 pc)
+        {
+          size_t index = std::lower_bound(m_pcs.begin(), m_pcs.end(), pc) - m_pcs.begin();
+          return index < m_code.Code.size() ? m_cfg->GetBlockOf(index) :
+            static_cast<BlockId>(m_cfg->GetBlockCount());
+        };
+
+        BlockId handlerBlock = toBlock(entry.HandlerPC);
+        m_isHandler[handlerBlock] = true;
+
+        for(BlockId b = toBlock(entry.StartPC); b < toBlock(entry.EndPC); b++)
+          m_handlers[b].push_back({handlerBlock, catchType});
+      }
+
+      return NoError{};
+    }
+
+    ErrorOr<void> initEntry()
+    {
+      const size_t nBlocks = m_cfg->GetBlockCount();
+      m_entries.resize(nBlocks);
+      m_reached.assign(nBlocks, false);
+      m_queued.assign(nBlocks, false);
+
+      frame& entry = m_initial;
+      entry.Locals.assign(m_localCount, Top);
+
+      auto errOrName = m_cf.ConstPool.LookupString(m_method.NameIndex);
+      VERIFY(errOrName, "failed to lookup method name");
+      auto errOrDescriptor = m_cf.ConstPool.LookupString(m_method.DescriptorIndex);
+      VERIFY(errOrDescriptor, "failed to lookup method descriptor");
+
+      U32 slot = 0;
+
+      if(!(m_method.AccessFlags & static_cast<U16>(FieldMethodInfo::AccessFlag::STATIC)))
+      {
+        bool isConstructor = errOrName.Get() == "<init>" && m_thisClass != objectClass;
+        entry.Locals[slot++] = isConstructor ? makeType(UninitializedThis) : getObject(m_thisClass);
+      }
+
+      auto errOrMethod = ViewMethodDescriptor(errOrDescriptor.Get());
+      VERIFY(errOrMethod);
+
+      for(TypeView parameter : errOrMethod.Get())
+      {
+        type t = getType(parameter.Descriptor);
+        entry.Locals[slot++] = t;
+
+        if(isWide(t))
+          entry.Locals[slot++] = Top;
+      }
+
+      return mergeInto(0, entry.Locals, entry.Stack);
+    }
+
+    ErrorOr<type> mergeNames(U32 a, U32 b)
+    {
+      std::string_view nameA = m_names[a];
+      std::string_view nameB = m_names[b];
+
+      //arrays of references merge element wise, anything else involving an
+      //array only has java/lang/Object in common
+      if(nameA[0] == '[' || nameB[0] == '[')
+      {
+        size_t dims = 0;
+        while(dims < nameA.size() && dims < nameB.size() && nameA[dims] == '[' && nameB[dims] == '[')
+          dims++;
+
+        std::string_view elementA = nameA.substr(dims);
+        std::string_view elementB = nameB.substr(dims);
+
+        std::string element{objectClass};
+
+        if(dims > 0 && elementA[0] == 'L' && elementB[0] == 'L')
+        {
+          auto errOrCommon = mergeClasses(elementA.substr(1, elementA.size() - 2),
+              elementB.substr(1, elementB.size() - 2));
+          VERIFY(errOrCommon);
+          element = errOrCommon.Release();
+        }
+        else if(dims > 0 && (elementA[0] == '[' || elementB[0] == '['))
+        {
+          //an array & a class that can only be java/lang/Object or the array
+          //interfaces, both treated as java/lang/Object
+          if((elementA[0] != 'L' && elementA[0] != '[') || (elementB[0] != 'L' && elementB[0] != '['))
+            dims--;
+        }
+        else if(dims > 0)
+        {
+          dims--; //differently typed arrays of primitives
+        }
+
+        if(dims == 0)
+          return getObject(element);
+
+        return getObject(std::string(dims, '[') + "L" + element + ";");
+      }
+
+      auto errOrCommon = mergeClasses(nameA, nameB);
+      VERIFY(errOrCommon);
+      return getObject(errOrCommon.Get());
+    }
+
+    ErrorOr<std::string> mergeClasses(std::string_view a, std::string_view b)
+    {
+      if(a == b)
+        return std::string{a};
+
+      return m_oracle.GetCommonSuperClass(a, b);
+    }
+
+    ErrorOr<type> merge(type a, type b)
+    {
+      if(a == b)
+        return a;
+
+      if(a == Null && isReference(b))
+        return b;
+
+      if(b == Null && isReference(a))
+        return a;
+
+      if(getTag(a) != Object || getTag(b) != Object)
+        return makeType(Top);
+
+      U64 key = U64{getPayload(a)} << 32 | getPayload(b);
+      auto itr = m_merged.find(key);
+
+      if(itr != m_merged.end())
+        return itr->second;
+
+      auto errOrMerged = mergeNames(getPayload(a), getPayload(b));
+      VERIFY(errOrMerged);
+
+      m_merged.emplace(key, errOrMerged.Get());
+      return errOrMerged.Get();
+    }
+
+    ErrorOr<void> mergeInto(BlockId b, const std::vector<type>& locals, const std::vector<type>& stack)
+    {
+      frame& entry = m_entries[b];
+      bool changed = false;
+
+      if(!m_reached[b])
+      {
+        entry.Locals = locals;
+        entry.Stack = stack;
+        m_reached[b] = true;
+        changed = true;
+      }
+      else
+      {
+        if(entry.Stack.size() != stack.size())
+          return error(m_cfg->GetStart(b), "inconsistent stack height");
+
+        for(auto [into, from] : {std::pair{&entry.Locals, &locals}, std::pair{&entry.Stack, &stack}})
+        {
+          for(size_t i = 0; i < into->size(); i++)
+          {
+            auto errOrMerged = merge((*into)[i], (*from)[i]);
+            VERIFY(errOrMerged);
+
+            changed |= errOrMerged.Get() != (*into)[i];
+            (*into)[i] = errOrMerged.Get();
+          }
+        }
+      }
+
+      if(changed && !m_queued[b])
+      {
+        m_queued[b] = true;
+        m_worklist.push_back(b);
+      }
+
+      return NoError{};
+    }
+
+    void push(type t)
+    {
+      m_frame.Stack.push_back(t);
+
+      if(isWide(t))
+        m_frame.Stack.push_back(Top);
+    }
+
+    type pop()
+    {
+      if(m_frame.Stack.empty())
+      {
+        m_underflow = true;
+        return Top;
+      }
+
+      type t = m_frame.Stack.back();
+      m_frame.Stack.pop_back();
+      return t;
+    }
+
+    void pop(size_t slots)
+    {
+      for(size_t i = 0; i < slots; i++)
+        pop();
+    }
+
+    void store(U32 index, type t)
+    {
+      //overwriting the second half of a long or double invalidates it
+      if(index > 0 && isWide(m_frame.Locals[index - 1]))
+        m_frame.Locals[index - 1] = Top;
+
+      m_frame.Locals[index] = t;
+
+      if(isWide(t))
+        m_frame.Locals[index + 1] = Top;
+    }
+
+    //Replaces the uninitialized type an <init> was called on everywhere
+    void initialize(type uninitialized, type initialized)
+    {
+      for(auto* slots : {&m_frame.Locals, &m_frame.Stack})
+        std::replace(slots->begin(), slots->end(), uninitialized, initialized);
+    }
+
+    ErrorOr<void> processBlock(BlockId b)
+    {
+      m_frame = m_entries[b];
+
+      for(U32 i = m_cfg->GetStart(b); i < m_cfg->GetEnd(b); i++)
+      {
+        for(const handler& h : m_handlers[b])
+          TRY(mergeInto(h.Block, m_frame.Locals, std::vector<type>{h.CatchType}));
+
+        TRY(execute(i));
+
+        if(m_underflow)
+          return error(i, "stack underflow");
+
+        m_maxStack = std::max(m_maxStack, static_cast<U32>(m_frame.Stack.size()));
+      }
+
+      for(BlockId s : m_cfg->GetSuccessors(b))
+        TRY(mergeInto(s, m_frame.Locals, m_frame.Stack));
+
+      return NoError{};
+    }
+
+    ErrorOr<void> execute(U32 i)
+    {
+      const Instruction& instr = m_code.Code[i];
+      OpCode op = instr.GetOpCode();
+
+      U32 local, width;
+
+      if(getLocal(instr, local, width))
+      {
+        if(local + width > m_localCount)
+          return error(i, "local variable out of range");
+
+        switch(op)
+        {
+          case IINC:
+            return NoError{};
+
+          case RET:
+            return error(i, "ret is not supported");
+
+          default: break;
+        }
+
+        //I, L, F, D, A in the order of the opcodes
+        static constexpr type types[] = {Integer, Long, Float, Double};
+
+        bool isLoad = op <= ALOAD_3;
+        U32 kind = op <= ALOAD ? op - ILOAD : op <= ALOAD_3 ? (op - ILOAD_0) / 4 :
+          op <= ASTORE ? op - ISTORE : (op - ISTORE_0) / 4;
+
+        if(isLoad)
+          push(kind == 4 ? m_frame.Locals[local] : types[kind]);
+        else if(kind == 4)
+          store(local, pop());
+        else
+        {
+          pop(width);
+          store(local, types[kind]);
+        }
+
+        return NoError{};
+      }
+
+      switch(op)
+      {
+        case NOP:
+          break;
+
+        case ACONST_NULL:
+          push(Null);
+          break;
+
+        case ICONST_M1: case ICONST_0: case ICONST_1: case ICONST_2: case ICONST_3:
+        case ICONST_4: case ICONST_5: case BIPUSH: case SIPUSH:
+          push(Integer);
+          break;
+
+        case LCONST_0: case LCONST_1:
+          push(Long);
+          break;
+
+        case FCONST_0: case FCONST_1: case FCONST_2:
+          push(Float);
+          break;
+
+        case DCONST_0: case DCONST_1:
+          push(Double);
+          break;
+
+        case LDC: case LDC_W: case LDC2_W:
+        {
+          const CPInfo* info = m_cf.ConstPool[getIndex(instr)];
+
+          if(!info)
+            return error(i, "ldc of an invalid constant");
+
+          switch(info->GetType())
+          {
+            case CPInfo::Type::Integer:      push(Integer); break;
+            case CPInfo::Type::Float:        push(Float); break;
+            case CPInfo::Type::Long:         push(Long); break;
+            case CPInfo::Type::Double:       push(Double); break;
+            case CPInfo::Type::String:       push(getObject("java/lang/String")); break;
+            case CPInfo::Type::Class:        push(getObject("java/lang/Class")); break;
+            case CPInfo::Type::MethodType:   push(getObject("java/lang/invoke/MethodType")); break;
+            case CPInfo::Type::MethodHandle: push(getObject("java/lang/invoke/MethodHandle")); break;
+            default: return error(i, "ldc of an unloadable constant");
+          }
+          break;
+        }
+
+        case IALOAD: case BALOAD: case CALOAD: case SALOAD:
+          pop(2);
+          push(Integer);
+          break;
+
+        case LALOAD:
+          pop(2);
+          push(Long);
+          break;
+
+        case FALOAD:
+          pop(2);
+          push(Float);
+          break;
+
+        case DALOAD:
+          pop(2);
+          push(Double);
+          break;
+
+        case AALOAD:
+        {
+          pop();
+          type array = pop();
+
+          if(getTag(array) == Object && m_names[getPayload(array)][0] == '[')
+            push(getType(std::string_view{m_names[getPayload(array)]}.substr(1)));
+          else
+            push(array == Null ? makeType(Null) : getObject(objectClass));
+          break;
+        }
+
+        case IASTORE: case FASTORE: case AASTORE: case BASTORE: case CASTORE: case SASTORE:
+          pop(3);
+          break;
+
+        case LASTORE: case DASTORE:
+          pop(4);
+          break;
+
+        case POP:
+          pop(1);
+          break;
+
+        case POP2:
+          pop(2);
+          break;
+
+        case DUP:
+        {
+          type v1 = pop();
+          push(v1); push(v1);
+          break;
+        }
+
+        case DUP_X1:
+        {
+          type v1 = pop(), v2 = pop();
+          pushRaw({v1, v2, v1});
+          break;
+        }
+
+        case DUP_X2:
+        {
+          type v1 = pop(), v2 = pop(), v3 = pop();
+          pushRaw({v1, v3, v2, v1});
+          break;
+        }
+
+        case DUP2:
+        {
+          type v1 = pop(), v2 = pop();
+          pushRaw({v2, v1, v2, v1});
+          break;
+        }
+
+        case DUP2_X1:
+        {
+          type v1 = pop(), v2 = pop(), v3 = pop();
+          pushRaw({v2, v1, v3, v2, v1});
+          break;
+        }
+
+        case DUP2_X2:
+        {
+          type v1 = pop(), v2 = pop(), v3 = pop(), v4 = pop();
+          pushRaw({v2, v1, v4, v3, v2, v1});
+          break;
+        }
+
+        case SWAP:
+        {
+          type v1 = pop(), v2 = pop();
+          pushRaw({v1, v2});
+          break;
+        }
+
+        case GETSTATIC: case PUTSTATIC: case GETFIELD: case PUTFIELD:
+        {
+          auto errOrRef = m_cf.ConstPool.ResolveMemberRef(getIndex(instr));
+
+          if(errOrRef.IsError())
+            return error(i, "failed to lookup field descriptor");
+
+          auto errOrType = ViewFieldDescriptor(errOrRef.Get().Descriptor);
+
+          if(errOrType.IsError())
+            return error(i, errOrType.GetError().What);
+
+          type t = getType(errOrType.Get().Descriptor);
+
+          if(op == PUTSTATIC || op == PUTFIELD)
+            pop(errOrType.Get().GetSlots());
+
+          if(op == GETFIELD || op == PUTFIELD)
+            pop(1);
+
+          if(op == GETSTATIC || op == GETFIELD)
+            push(t);
+          break;
+        }
+
+        case INVOKEVIRTUAL: case INVOKESPECIAL: case INVOKESTATIC:
+        case INVOKEINTERFACE: case INVOKEDYNAMIC:
+          TRY(invoke(i));
+          break;
+
+        case NEW:
+        {
+          auto errOrType = getClassType(getIndex(instr));
+
+          if(errOrType.IsError())
+            return error(i, "failed to lookup class");
+
+          m_newTypes[m_pcs[i]] = errOrType.Get();
+          push(makeType(Uninitialized, m_pcs[i]));
+          break;
+        }
+
+        case NEWARRAY:
+        {
+          static constexpr char codes[] = "ZCFDBSIJ"; //atype 4 to 11
+          S32 atype = instr.GetOperand(0).Get();
+
+          if(atype < 4 || atype > 11)
+            return error(i, "invalid newarray type");
+
+          pop(1);
+          push(getObject(std::string{'[', codes[atype - 4]}));
+          break;
+        }
+
+        case ANEWARRAY:
+        {
+          auto errOrName = m_cf.ConstPool.LookupString(getIndex(instr));
+
+          if(errOrName.IsError())
+            return error(i, "failed to lookup class");
+
+          std::string_view name = errOrName.Get();
+          pop(1);
+          push(getObject(name[0] == '[' ? "[" + std::string{name} : "[L" + std::string{name} + ";"));
+          break;
+        }
+
+        case MULTIANEWARRAY:
+        {
+          auto errOrType = getClassType(getIndex(instr));
+
+          if(errOrType.IsError())
+            return error(i, "failed to lookup class");
+
+          pop(static_cast<size_t>(instr.GetOperand(1).Get()));
+          push(errOrType.Get());
+          break;
+        }
+
+        case CHECKCAST:
+        {
+          auto errOrType = getClassType(getIndex(instr));
+
+          if(errOrType.IsError())
+            return error(i, "failed to lookup class");
+
+          pop(1);
+          push(errOrType.Get());
+          break;
+        }
+
+        case ARRAYLENGTH: case INSTANCEOF:
+          pop(1);
+          push(Integer);
+          break;
+
+        case JSR: case JSR_W:
+          return error(i, "jsr is not supported");
+
+        default:
+        {
+          //everything else only pops & pushes primitives: arithmetic,
+          //conversions, comparisons, branches, returns, athrow & monitors
+          S8 effect = stackEffects[op];
+
+          if(effect == variableEffect)
+            return error(i, fmt::format("{} is not supported", instr.GetMnemonic()));
+
+          type result = getPrimitiveResult(op);
+          U32 pushed = result == Top ? 0 : isWide(result) ? 2 : 1;
+
+          pop(static_cast<size_t>(static_cast<S32>(pushed) - effect));
+
+          if(result != Top)
+            push(result);
+          break;
+        }
+      }
+
+      return NoError{};
+    }
+
+    void pushRaw(std::initializer_list<type> slots)
+    {
+      m_frame.Stack.insert(m_frame.Stack.end(), slots);
+    }
+
+    //Type pushed by the instructions handled through their stack effect, Top
+    //if they don't push anything
+    static type getPrimitiveResult(OpCode op)
+    {
+      static constexpr type types[] = {Integer, Long, Float, Double};
+
+      if(op >= IADD && op <= DNEG)
+        return types[(op - IADD) % 4];
+
+      if(op >= ISHL && op <= LXOR)
+        return types[(op - ISHL) % 2];
+
+      switch(op)
+      {
+        case I2L: case F2L: case D2L: return Long;
+        case I2F: case L2F: case D2F: return Float;
+        case I2D: case L2D: case F2D: return Double;
+        case L2I: case F2I: case D2I: case I2B: case I2C: case I2S:
+        case LCMP: case FCMPL: case FCMPG: case DCMPL: case DCMPG:
+          return Integer;
+
+        default:
+          return Top;
+      }
+    }
+
+    ErrorOr<void> invoke(U32 i)
+    {
+      const Instruction& instr = m_code.Code[i];
+      OpCode op = instr.GetOpCode();
+
+      auto errOrRef = m_cf.ConstPool.ResolveMemberRef(getIndex(instr));
+
+      if(errOrRef.IsError())
+        return error(i, "failed to lookup method descriptor");
+
+      const MemberRef& ref = errOrRef.Get();
+
+      auto errOrMethod = ViewMethodDescriptor(ref.Descriptor);
+
+      if(errOrMethod.IsError())
+        return error(i, errOrMethod.GetError().What);
+
+      const TypeView& returnType = errOrMethod.Get().GetReturnType();
+      pop(errOrMethod.Get().GetParameterSlots());
+
+      if(op != INVOKESTATIC && op != INVOKEDYNAMIC)
+      {
+        type receiver = pop();
+
+        if(op == INVOKESPECIAL && ref.Name == "<init>")
+        {
+          if(getTag(receiver) == UninitializedThis)
+            initialize(receiver, getObject(m_thisClass));
+          else if(getTag(receiver) == Uninitialized)
+            initialize(receiver, m_newTypes[getPayload(receiver)]);
+        }
+      }
+
+      if(returnType.ElementKind != TypeView::Kind::Void)
+        push(getType(returnType.Descriptor));
+
+      return NoError{};
+    }
+
+    //A frame is required wherever control arrives other than by falling
+    //through: branch targets, handlers & after unconditional jumps. Blocks
+    //following unreachable code are included since that becomes an athrow.
+    //The first block only needs one if it's a branch target, e.g. a loop
+    //head at pc 0.
+    std::vector<U8> getFrameBlocks() const
+    {
+      const size_t nBlocks = m_cfg->GetBlockCount();
+      std::vector<U8> needsFrame(m_isHandler);
+
+      for(BlockId b = 0; b < nBlocks; b++)
+      {
+        U32 last = m_cfg->GetEnd(b) - 1;
+
+        if(IsBranch(m_code.Code[last].GetOpCode()))
+        {
+          //the graph already checked the target
+          S64 target = S64{m_pcs[last]} + m_code.Code[last].GetBranchOffset().Get();
+          size_t index = std::lower_bound(m_pcs.begin(), m_pcs.end(), target) - m_pcs.begin();
+          needsFrame[m_cfg->GetBlockOf(index)] = true;
+        }
+
+        if(b + 1 < nBlocks && (!m_reached[b] || !falls(b)))
+          needsFrame[b + 1] = true;
+
+        if(!m_reached[b])
+          needsFrame[b] = true;
+      }
+
+      return needsFrame;
+    }
+
+    //True if control can fall through the end of block b into the next one
+    bool falls(BlockId b) const
+    {
+      switch(m_code.Code[m_cfg->GetEnd(b) - 1].GetOpCode())
+      {
+        case GOTO: case GOTO_W: case ATHROW:
+        case IRETURN: case LRETURN: case FRETURN: case DRETURN: case ARETURN: case RETURN:
+          return false;
+
+        default:
+          return true;
+      }
+    }
+
+    //Locals without trailing Tops & stack as verification_type_info lists,
+    //which hold longs & doubles in one entry
+    static std::vector<type> toList(const std::vector<type>& slots, bool trim)
+    {
+      size_t end = slots.size();
+
+      if(trim)
+      {
+        while(end > 0 && slots[end - 1] == Top)
+          end--;
+      }
+
+      std::vector<type> list;
+      list.reserve(end);
+
+      for(size_t i = 0; i < end; i += isWide(slots[i]) ? 2 : 1)
+        list.push_back(slots[i]);
+
+      return list;
+    }
+
+    ErrorOr<void> writeType(std::vector<U8>& out, type t)
+    {
+      out.push_back(static_cast<U8>(getTag(t)));
+
+      U32 value = getPayload(t);
+
+      if(getTag(t) == Object)
+      {
+        auto errOrIndex = m_cf.ConstPool.FindOrAddClass(m_names[value]);
+        VERIFY(errOrIndex);
+        value = errOrIndex.Get();
+      }
+      else if(getTag(t) != Uninitialized)
+      {
+        return NoError{};
+      }
+
+      out.push_back(static_cast<U8>(value >> 8));
+      out.push_back(static_cast<U8>(value));
+      return NoError{};
+    }
+
+    template <typename Bytes>
+    static void writeU16(Bytes& out, U32 value)
+    {
+      out.push_back(static_cast<U8>(value >> 8));
+      out.push_back(static_cast<U8>(value));
+    }
+
+    ErrorOr<void> writeTypes(std::vector<U8>& out, const std::vector<type>& types)
+    {
+      for(type t : types)
+        TRY(writeType(out, t));
+
+      return NoError{};
+    }
+
+    //Appends the smallest frame encoding relative to the previous locals
+    ErrorOr<void> writeFrame(std::vector<U8>& out, U32 delta, const std::vector<type>& prevLocals,
+        const std::vector<type>& locals, const std::vector<type>& stack)
+    {
+      size_t common = 0;
+      while(common < locals.size() && common < prevLocals.size() && locals[common] == prevLocals[common])
+        common++;
+
+      bool sameLocals = common == locals.size() && common == prevLocals.size();
+
+      if(sameLocals && stack.empty())
+      {
+        if(delta < 64)
+        {
+          out.push_back(static_cast<U8>(delta)); //same_frame
+          return NoError{};
+        }
+
+        out.push_back(251); //same_frame_extended
+        writeU16(out, delta);
+        return NoError{};
+      }
+
+      if(sameLocals && stack.size() == 1)
+      {
+        if(delta < 64)
+        {
+          out.push_back(static_cast<U8>(64 + delta)); //same_locals_1_stack_item_frame
+        }
+        else
+        {
+          out.push_back(247); //same_locals_1_stack_item_frame_extended
+          writeU16(out, delta);
+        }
+
+        return writeType(out, stack[0]);
+      }
+
+      if(stack.empty() && common == locals.size() && prevLocals.size() - common <= 3)
+      {
+        out.push_back(static_cast<U8>(251 - (prevLocals.size() - common))); //chop_frame
+        writeU16(out, delta);
+        return NoError{};
+      }
+
+      if(stack.empty() && common == prevLocals.size() && locals.size() - common <= 3)
+      {
+        out.push_back(static_cast<U8>(251 + (locals.size() - common))); //append_frame
+        writeU16(out, delta);
+        return writeTypes(out, std::vector<type>(locals.begin() + common, locals.end()));
+      }
+
+      out.push_back(255); //full_frame
+      writeU16(out, delta);
+      writeU16(out, static_cast<U32>(locals.size()));
+      TRY(writeTypes(out, locals));
+      writeU16(out, static_cast<U32>(stack.size()));
+      return writeTypes(out, stack);
+    }
+
+    ErrorOr<void> writeFrames()
+    {
+      const size_t nBlocks = m_cfg->GetBlockCount();
+      std::vector<U8> needsFrame = getFrameBlocks();
+
+      //unreachable code becomes nops & athrow, verified with an empty frame
+      //that only has the thrown exception on the stack
+      const frame deadFrame{{}, {getObject("java/lang/Throwable")}};
+      bool hasDeadCode = false;
+
+      for(BlockId b = 0; b < nBlocks; b++)
+      {
+        if(m_reached[b])
+          continue;
+
+        hasDeadCode = true;
+
+        if(!m_handlers[b].empty())
+        {
+          return Error{fmt::format("ComputeFrames(): unreachable code at pc {} is "
+              "covered by an exception handler", m_cfg->GetStartPC(b))};
+        }
+      }
+
+      std::vector<U8> bytes;
+      std::vector<type> prevLocals = toList(m_initial.Locals, true);
+      S64 prevPC = -1;
+      U16 count = 0;
+
+      for(BlockId b = 0; b < nBlocks; b++)
+      {
+        if(!needsFrame[b])
+          continue;
+
+        const frame& f = m_reached[b] ? m_entries[b] : deadFrame;
+        std::vector<type> locals = toList(f.Locals, true);
+
+        U32 delta = static_cast<U32>(m_cfg->GetStartPC(b) - prevPC - 1);
+        TRY(writeFrame(bytes, delta, prevLocals, locals, toList(f.Stack, false)));
+
+        prevLocals = std::move(locals);
+        prevPC = m_cfg->GetStartPC(b);
+        count++;
+      }
+
+      if(hasDeadCode)
+      {
+        TRY(replaceDeadCode());
+        m_maxStack = std::max(m_maxStack, U32{1});
+      }
+
+      m_code.MaxStack = static_cast<U16>(m_maxStack);
+      m_code.MaxLocals = static_cast<U16>(m_localCount);
+
+      return storeTable(count, bytes);
+    }
+
+    ErrorOr<void> replaceDeadCode()
+    {
+      std::pmr::vector<Instruction> code{m_code.Code.get_allocator()};
+      code.reserve(m_code.Code.size());
+
+      for(BlockId b = 0; b < m_cfg->GetBlockCount(); b++)
+      {
+        if(m_reached[b])
+        {
+          for(U32 i = m_cfg->GetStart(b); i < m_cfg->GetEnd(b); i++)
+            code.push_back(std::move(m_code.Code[i]));
+
+          continue;
+        }
+
+        U32 length = m_pcs[m_cfg->GetEnd(b)] - m_cfg->GetStartPC(b);
+
+        for(U32 i = 0; i < length; i++)
+        {
+          auto errOrInstr = Instruction::MakeInstruction(i + 1 < length ? NOP : ATHROW);
+          VERIFY(errOrInstr);
+          code.push_back(errOrInstr.Release());
+        }
+      }
+
+      m_code.Code = std::move(code);
+      return NoError{};
+    }
+
+    ErrorOr<void> storeTable(U16 count, const std::vector<U8>& frames)
+    {
+      auto& attributes = m_code.Attributes;
+
+      auto itr = std::find_if(attributes.begin(), attributes.end(), [&](const auto& attr)
+      {
+        if(attr->GetType() != AttributeInfo::Type::Raw)
+          return false;
+
+        auto errOrName = m_cf.ConstPool.LookupString(attr->NameIndex);
+        return !errOrName.IsError() && errOrName.Get() == "StackMapTable";
+      });
+
+      if(count == 0)
+      {
+        if(itr != attributes.end())
+          attributes.erase(itr);
+
+        return NoError{};
+      }
+
+      if(itr == attributes.end())
+      {
+        auto errOrName = m_cf.ConstPool.FindOrAddUTF8("StackMapTable");
+        VERIFY(errOrName);
+
+        auto attr = std::make_unique<RawAttribute>(attributes.get_allocator().resource());
+        attr->NameIndex = errOrName.Get();
+        attributes.push_back(std::move(attr));
+        itr = attributes.end() - 1;
+      }
+
+      std::pmr::vector<U8>& bytes = static_cast<RawAttribute&>(itr->Mutate()).Bytes;
+      bytes.clear();
+      writeU16(bytes, count);
+      bytes.insert(bytes.end(), frames.begin(), frames.end());
+
+      return NoError{};
+    }
+
+    ClassFile& m_cf;
+    FieldMethodInfo& m_method;
+    CodeAttribute& m_code;
+    const HierarchyOracle& m_oracle;
+
+    const ControlFlowGraph* m_cfg{nullptr};
+    std::vector<U32> m_pcs;
+    std::string m_thisClass;
+    U32 m_localCount{0};
+    U32 m_maxStack{0};
+
+    std::vector<std::string> m_names;
+    std::unordered_map<std::string, U32> m_nameIds;
+    std::unordered_map<U64, type> m_merged;
+    std::unordered_map<U32, type> m_newTypes; //pc of new -> the class
+
+    std::vector< std::vector<handler> > m_handlers;
+    std::vector<U8> m_isHandler;
+
+    frame m_initial;
+    std::vector<frame> m_entries;
+    std::vector<U8> m_reached;
+    std::vector<U8> m_queued;
+    std::vector<BlockId> m_worklist;
+
+    frame m_frame;
+    bool m_underflow{false};
+};
+
+ErrorOr<void> ComputeFrames(ClassFile& cf, FieldMethodInfo& method, const HierarchyOracle& oracle)
+{
+  CodeAttribute* code = findCode(method);
+
+  if(!code)
+    return NoError{};
+
+  frameAnalyzer analyzer{cf, method, *code, oracle};
+  return analyzer.Run();
+}
+
+ErrorOr<void> ComputeFrames(ClassFile& cf, const HierarchyOracle& oracle)
+{
+  for(size_t i = 0; i < cf.Methods.size(); i++)
+  {
+    auto result = ComputeFrames(cf, cf.Methods[i], oracle);
+
+    if(result.IsError())
+    {
+      auto errOrName = cf.ConstPool.LookupString(cf.Methods[i].NameIndex);
+      return Error{fmt::format("{}\n  in method {}", result.GetError().What,
+          errOrName.IsError() ? std::string_view{"?"} : errOrName.Get())};
+    }
+  }
+
+  return NoError{};
+}
+
+} //namespace ClassFile
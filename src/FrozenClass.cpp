@@ -0,0 +1,21 @@
+#include "ClassFile/FrozenClass.hpp"
+
+namespace ClassFile
+{
+
+std::shared_ptr<const FrozenClass> FrozenClass::Freeze(ClassFile&& cf)
+{
+  return std::shared_ptr<const FrozenClass>{new FrozenClass{std::move(cf)}};
+}
+
+ClassFile FrozenClass::Thaw() const
+{
+  return m_class.Clone();
+}
+
+ErrorOr<Fingerprint> FrozenClass::GetFingerprint() const
+{
+  return m_fingerprint.Get([this]() { return ComputeFingerprint(m_class); });
+}
+
+} //namespace ClassFile
@@ -5,6 +5,8 @@
 #include "Util/IO.hpp"
 #include "Util/Error.hpp"
 
+#include <cstdint>
+
 using namespace ClassFile;
 
 ErrorOr<Instruction> Instruction::MakeInstruction(OpCode op, bool wide)
@@ -23,7 +25,12 @@ ErrorOr<Instruction> Instruction::MakeInstruction(OpCode op, bool wide)
                              : ::GetOperandSize(op, i);
   }
 
-  instr.operandBytes.resize(totalOperandSize);
+  if(totalOperandSize > instr.operandBytes.size())
+  {
+    return Error{fmt::format("Instruction::MakeInstruction(): operands of \"{}\" "
+        "take {} bytes, more than the {} supported", instr.GetMnemonic(),
+        totalOperandSize, instr.operandBytes.size())};
+  }
 
   return instr;
 }
@@ -125,6 +132,44 @@ ErrorOr<void> Instruction::SetOperand(size_t index, S32 value)
       "{}\".", ToString(type)) };
 }
 
+ErrorOr<S32> Instruction::GetBranchOffset() const
+{
+  if(!::IsBranch(this->op))
+  {
+    return Error{ fmt::format("Instruction::GetBranchOffset(): \"{}\" is not "
+        "a branch", this->GetMnemonic()) };
+  }
+
+  auto errOrOffset = this->GetOperand(0);
+  VERIFY(errOrOffset);
+
+  //ifnull & ifnonnull operands are declared unsigned
+  if(this->GetOperandType(0) == TypeU16)
+    return S32{ static_cast<S16>(errOrOffset.Get()) };
+
+  return errOrOffset.Get();
+}
+
+ErrorOr<void> Instruction::SetBranchOffset(S32 offset)
+{
+  if(!::IsBranch(this->op))
+  {
+    return Error{ fmt::format("Instruction::SetBranchOffset(): \"{}\" is not "
+        "a branch", this->GetMnemonic()) };
+  }
+
+  if(this->GetOperandSize(0) == sizeof(S16) && (offset < INT16_MIN || offset > INT16_MAX))
+  {
+    return Error{ fmt::format("Instruction::SetBranchOffset(): offset {} doesn't "
+        "fit the 16 bit operand of \"{}\"", offset, this->GetMnemonic()) };
+  }
+
+  if(this->GetOperandType(0) == TypeU16)
+    return this->SetOperand(0, static_cast<U16>(static_cast<S16>(offset)));
+
+  return this->SetOperand(0, offset);
+}
+
 Error Instruction::oobError(size_t index) const
 {
   return Error{ fmt::format("Instruction: out-of-bounds operand access "
@@ -26,15 +26,10 @@ ErrorOr<TypeAndNParsed> DecodeFirstObjectType(std::string_view desc) noexcept
         desc, desc[0])};
   }
 
-  std::string typeName;
+  size_t end = desc.find(';', 1);
 
-  for(size_t i = 1; i < desc.length(); ++i)
-  {
-    if(desc[i] == ';')
-      return TypeAndNParsed{typeName, i+1};
-
-    typeName += desc[i];
-  }
+  if(end != desc.npos)
+    return TypeAndNParsed{std::string{desc.substr(1, end-1)}, end+1};
 
   return Error{fmt::format(
       "DecodeFirstObjectType(\"{}\") failed: "
@@ -290,4 +285,143 @@ ErrorOr<MethodDescriptor> DecodeMethodDescriptor(std::string_view desc) noexcept
   return MethodDescriptor{returnType, errOrParameterTypeList.Release()};
 }
 
+//Decodes the type at the start of desc into type, false if there is none.
+//V is accepted as well, the callers reject it where it's not allowed.
+static bool viewFirstType(std::string_view desc, TypeView& type) noexcept
+{
+  size_t pos = 0;
+
+  while(pos < desc.size() && desc[pos] == '[')
+    pos++;
+
+  //the JVM limits arrays to 255 dimensions
+  if(pos >= desc.size() || pos > 255)
+    return false;
+
+  type.Dimensions = static_cast<U8>(pos);
+  type.ClassName = {};
+
+  size_t end = pos + 1;
+
+  switch(desc[pos])
+  {
+    case 'B': type.ElementKind = TypeView::Kind::Byte;    break;
+    case 'C': type.ElementKind = TypeView::Kind::Char;    break;
+    case 'D': type.ElementKind = TypeView::Kind::Double;  break;
+    case 'F': type.ElementKind = TypeView::Kind::Float;   break;
+    case 'I': type.ElementKind = TypeView::Kind::Int;     break;
+    case 'J': type.ElementKind = TypeView::Kind::Long;    break;
+    case 'S': type.ElementKind = TypeView::Kind::Short;   break;
+    case 'Z': type.ElementKind = TypeView::Kind::Boolean; break;
+
+    case 'V':
+      if(pos != 0)
+        return false;
+
+      type.ElementKind = TypeView::Kind::Void;
+      break;
+
+    case 'L':
+    {
+      end = desc.find(';', pos + 1);
+
+      if(end == desc.npos || end == pos + 1)
+        return false;
+
+      type.ElementKind = TypeView::Kind::Object;
+      type.ClassName = desc.substr(pos + 1, end - pos - 1);
+      end++;
+      break;
+    }
+
+    default:
+      return false;
+  }
+
+  type.Descriptor = desc.substr(0, end);
+  return true;
+}
+
+ErrorOr<TypeView> ViewFirstFieldDescriptor(std::string_view desc) noexcept
+{
+  TypeView type;
+
+  if(!viewFirstType(desc, type) || type.ElementKind == TypeView::Kind::Void)
+  {
+    return Error{fmt::format(
+        "ViewFirstFieldDescriptor(\"{}\") failed: not a valid field descriptor", desc)};
+  }
+
+  return type;
+}
+
+ErrorOr<TypeView> ViewFieldDescriptor(std::string_view desc) noexcept
+{
+  TypeView type;
+
+  if(!viewFirstType(desc, type) || type.ElementKind == TypeView::Kind::Void ||
+      type.Descriptor.size() != desc.size())
+  {
+    return Error{fmt::format(
+        "ViewFieldDescriptor(\"{}\") failed: not a valid field descriptor", desc)};
+  }
+
+  return type;
+}
+
+MethodDescriptorView::Iterator::Iterator(std::string_view rest)
+  : m_rest{rest}
+{
+  if(!m_rest.empty())
+    viewFirstType(m_rest, m_current);
+}
+
+MethodDescriptorView::Iterator& MethodDescriptorView::Iterator::operator++()
+{
+  m_rest.remove_prefix(m_current.Descriptor.size());
+
+  if(!m_rest.empty())
+    viewFirstType(m_rest, m_current);
+
+  return *this;
+}
+
+ErrorOr<MethodDescriptorView> ViewMethodDescriptor(std::string_view desc) noexcept
+{
+  auto invalid = [&](std::string_view reason)
+  {
+    return Error{fmt::format("ViewMethodDescriptor(\"{}\") failed: {}", desc, reason)};
+  };
+
+  if(desc.empty() || desc[0] != '(')
+    return invalid("expected descriptor to start with '('");
+
+  MethodDescriptorView view;
+  size_t pos = 1;
+  TypeView type;
+
+  while(pos < desc.size() && desc[pos] != ')')
+  {
+    if(!viewFirstType(desc.substr(pos), type) || type.ElementKind == TypeView::Kind::Void)
+      return invalid(fmt::format("invalid parameter type at offset {}", pos));
+
+    view.m_parameterCount++;
+    view.m_parameterSlots += type.GetSlots();
+    pos += type.Descriptor.size();
+  }
+
+  if(pos >= desc.size())
+    return invalid("unable to find expected character ')'");
+
+  view.m_parameters = desc.substr(1, pos - 1);
+
+  std::string_view returnDesc = desc.substr(pos + 1);
+
+  if(!viewFirstType(returnDesc, view.m_returnType) || 
+      view.m_returnType.Descriptor.size() != returnDesc.size())
+    return invalid("invalid return type");
+
+  return view;
+}
+
 } //namespace ClassFile
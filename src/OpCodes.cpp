@@ -291,4 +291,38 @@ bool IsComplex(OpCode op)
   return format(op)[0] == 'c';
 }
 
+bool HasConstantPoolIndex(OpCode op)
+{
+  switch(op)
+  {
+    case LDC: case LDC_W: case LDC2_W:
+    case GETSTATIC: case PUTSTATIC: case GETFIELD: case PUTFIELD:
+    case INVOKEVIRTUAL: case INVOKESPECIAL: case INVOKESTATIC:
+    case INVOKEINTERFACE: case INVOKEDYNAMIC:
+    case NEW: case ANEWARRAY: case CHECKCAST: case INSTANCEOF:
+    case MULTIANEWARRAY:
+      return true;
+
+    default: break;
+  }
+
+  return false;
+}
+
+bool IsBranch(OpCode op)
+{
+  if(op >= IFEQ && op <= JSR)
+    return true;
+
+  switch(op)
+  {
+    case IFNULL: case IFNONNULL: case GOTO_W: case JSR_W:
+      return true;
+
+    default: break;
+  }
+
+  return false;
+}
+
 } //namespace ClassFile
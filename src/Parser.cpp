@@ -5,24 +5,265 @@
 #include "Util/IO.hpp"
 #include "Util/Error.hpp"
 
+#include <algorithm>
 #include <iostream>
 #include <cassert>
+#include <chrono>
 #include <map>
 #include <tuple>
+#include <type_traits>
 
 namespace ClassFile
 {
 
-ErrorOr<ClassFile> Parser::ParseClassFile(std::istream& stream)
+using LocalStats = Parser::BasicParseStats<U64>;
+
+//Stats policy of a parse without a sink, every hook compiles to nothing
+struct noStats
+{
+  struct Mark {};
+
+  Mark Begin(std::istream&) { return {}; }
+
+  template <typename PhaseOf>
+  void End(std::istream&, Mark, PhaseOf&&) {}
+
+  void CountConstant(U8) {}
+  void CountOpCode(OpCode) {}
+  void CountUnknownAttribute() {}
+  void CountClass() {}
+  void CountAllocation(U64) {}
+};
+
+//Stats policy that counts into a local LocalStats, added to the sink once
+//the parse is done
+struct collectStats
+{
+  using Clock = std::chrono::steady_clock;
+
+  struct Mark
+  {
+    std::streamoff Pos;
+    Clock::time_point Time;
+  };
+
+  Mark Begin(std::istream& stream) { return {stream.tellg(), Clock::now()}; }
+
+  //adds the bytes & time since mark to the phase phaseOf(Local) returns
+  template <typename PhaseOf>
+  void End(std::istream& stream, Mark mark, PhaseOf&& phaseOf)
+  {
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - mark.Time);
+    std::streamoff pos = stream.tellg();
+
+    LocalStats::Phase& phase = phaseOf(Local);
+    phase.Nanoseconds += static_cast<U64>(ns.count());
+
+    if(pos >= 0 && mark.Pos >= 0 && pos > mark.Pos)
+      phase.Bytes += static_cast<U64>(pos - mark.Pos);
+  }
+
+  void CountConstant(U8 tag) { Local.Constants[tag]++; }
+  void CountOpCode(OpCode op) { Local.OpCodes[static_cast<U8>(op)]++; }
+  void CountUnknownAttribute() { Local.UnknownAttributes++; }
+  void CountClass() { Local.Classes++; }
+
+  void CountAllocation(U64 bytes)
+  {
+    Local.Allocations++;
+    Local.AllocatedBytes += bytes;
+  }
+
+  void Flush(Parser::ParseStats& sink) const
+  {
+    auto add = [](std::atomic<U64>& to, U64 value)
+    {
+      if(value != 0)
+        to.fetch_add(value, std::memory_order_relaxed);
+    };
+
+    auto addPhase = [&](Parser::ParseStats::Phase& to, const LocalStats::Phase& from)
+    {
+      add(to.Bytes, from.Bytes);
+      add(to.Nanoseconds, from.Nanoseconds);
+    };
+
+    add(sink.Classes, Local.Classes);
+    addPhase(sink.ConstantPool, Local.ConstantPool);
+    addPhase(sink.Members, Local.Members);
+    addPhase(sink.Instructions, Local.Instructions);
+
+    for(size_t i = 0; i < std::size(Local.Attributes); i++)
+      addPhase(sink.Attributes[i], Local.Attributes[i]);
+
+    for(size_t i = 0; i < 256; i++)
+    {
+      add(sink.Constants[i], Local.Constants[i]);
+      add(sink.OpCodes[i], Local.OpCodes[i]);
+    }
+
+    add(sink.UnknownAttributes, Local.UnknownAttributes);
+    add(sink.Allocations, Local.Allocations);
+    add(sink.AllocatedBytes, Local.AllocatedBytes);
+  }
+
+  LocalStats Local;
+};
+
+//The limits of ParseOptions & what's been charged against them while parsing
+//one class. Counts & lengths read from the input go through here before
+//anything is allocated for them.
+template <typename StatsPolicy>
+class parseContext
+{
+public:
+  parseContext(std::istream& stream, const Parser::ParseOptions& options)
+    : Options{options},
+      Resource{options.Resource ? options.Resource : std::pmr::get_default_resource()}
+  {
+    if(!options.CheckLengths)
+      return;
+
+    //streams that can't seek (pipes, sockets) skip the length checks
+    std::streampos pos = stream.tellg();
+    if(pos == std::streampos(-1))
+      return;
+
+    stream.seekg(0, std::ios::end);
+    m_end = stream.tellg();
+    stream.seekg(pos);
+  }
+
+  //Fails if count items of at least minSize encoded bytes each don't fit in
+  //the rest of the input, then charges count * allocSize bytes
+  ErrorOr<void> Claim(std::istream& stream, U64 count, U64 minSize, U64 allocSize,
+      const char* what)
+  {
+    if(m_end >= 0 && count > 0)
+    {
+      std::streamoff pos = stream.tellg();
+      U64 remaining = pos < 0 || pos > m_end ? 0 : static_cast<U64>(m_end - pos);
+
+      if(count * minSize > remaining)
+      {
+        return Error{fmt::format("Parser: {} of {} needs at least {} bytes, "
+            "but only {} are left in the input", what, count, count * minSize, remaining)};
+      }
+    }
+
+    return Charge(count * allocSize, what);
+  }
+
+  //Whether Claim() checks against the end of the input, it can't for
+  //streams that don't seek or when CheckLengths is off
+  bool IsBounded() const { return m_end >= 0; }
+
+  ErrorOr<void> Charge(U64 bytes, const char* what)
+  {
+    if(bytes == 0)
+      return NoError{};
+
+    Stats.CountAllocation(bytes);
+    m_allocated += bytes;
+
+    if(Options.MaxAllocatedBytes != 0 && m_allocated > Options.MaxAllocatedBytes)
+    {
+      return Error{fmt::format("Parser: {} exceeds the allocation limit of {} bytes",
+          what, Options.MaxAllocatedBytes)};
+    }
+
+    return NoError{};
+  }
+
+  const Parser::ParseOptions& Options;
+  std::pmr::memory_resource* Resource;
+  StatsPolicy Stats;
+  U32 Depth{0};
+
+private:
+  std::streamoff m_end{-1};
+  U64 m_allocated{0};
+};
+
+//Runs parse(ctx) with the context for options, picking the stats policy once
+//up front so the parse itself never checks for a sink
+template <typename Parse>
+static auto withContext(std::istream& stream, const Parser::ParseOptions& options, Parse&& parse)
+{
+  if(!options.Stats)
+  {
+    parseContext<noStats> ctx{stream, options};
+    return parse(ctx);
+  }
+
+  parseContext<collectStats> ctx{stream, options};
+  auto result = parse(ctx);
+  ctx.Stats.Flush(*options.Stats);
+
+  return result;
+}
+
+template <typename Context>
+static ErrorOr< std::unique_ptr<CPInfo> > parseConstant(std::istream&, Context&);
+template <typename Context>
+static ErrorOr<FieldMethodInfo> parseFieldMethodInfo(std::istream&, const ConstantPool&, Context&);
+template <typename Context>
+static ErrorOr< std::unique_ptr<AttributeInfo> > parseAttribute(std::istream&, const ConstantPool&, Context&);
+
+template <typename Context>
+static ErrorOr<ConstantPool> parseConstantPool(std::istream& stream, Context& ctx)
 {
-  ClassFile cf;
+  auto mark = ctx.Stats.Begin(stream);
+  ConstantPool cp{ctx.Resource};
+
+  U16 count;
+  TRY(Read<BigEndian>(stream, count));
+
+  //every constant is at least a tag & a 2 byte index
+  TRY(ctx.Claim(stream, count > 0 ? count-1 : 0, 3, sizeof(std::shared_ptr<CPInfo>),
+        "constant pool"));
+
+  cp.Reserve(count);
+
+  //count = number of constants + 1
+  for(U16 i = 0; i < count-1; i++)
+  {
+    auto errOrCPInfo = parseConstant(stream, ctx);
+    VERIFY(errOrCPInfo);
+
+    auto cpInfo = errOrCPInfo.Release();
+
+    CPInfo::Type type = cpInfo->GetType();
+    ctx.Stats.CountConstant(static_cast<U8>(type));
+
+    cp.Add( std::move(cpInfo) ); 
+
+    //Long & Double constants require the next index into the constant pool
+    //after them be invalid.
+    if(type == CPInfo::Type::Long || type == CPInfo::Type::Double)
+    {
+      cp.Add(nullptr);
+      i++;
+    }
+
+  }
+
+  ctx.Stats.End(stream, mark, [](auto& stats) -> auto& { return stats.ConstantPool; });
+  return cp;
+}
+
+template <typename Context>
+static ErrorOr<ClassFile> parseClassHeader(std::istream& stream, Context& ctx)
+{
+  ctx.Stats.CountClass();
+  ClassFile cf{ctx.Resource};
 
   TRY(Read<BigEndian>(stream,
                       cf.Magic,
                       cf.MinorVersion,
                       cf.MajorVersion));
 
-  auto errOrCP = Parser::ParseConstantPool(stream);
+  auto errOrCP = parseConstantPool(stream, ctx);
   VERIFY(errOrCP);
 
   cf.ConstPool = errOrCP.Release();
@@ -34,6 +275,8 @@ ErrorOr<ClassFile> Parser::ParseClassFile(std::istream& stream)
                       cf.SuperClass,
                       interfacesCount));
 
+  TRY(ctx.Claim(stream, interfacesCount, sizeof(U16), sizeof(U16), "interfaces table"));
+
   cf.Interfaces.reserve(interfacesCount);
   for (auto i = 0; i < interfacesCount; i++)
   {
@@ -42,13 +285,32 @@ ErrorOr<ClassFile> Parser::ParseClassFile(std::istream& stream)
     cf.Interfaces.emplace_back(interfaceIndex);
   }
 
+  return cf;
+}
+
+ErrorOr<ClassFile> Parser::ParseClassHeader(std::istream& stream, const ParseOptions& options)
+{
+  return withContext(stream, options, [&](auto& ctx) { return parseClassHeader(stream, ctx); });
+}
+
+template <typename Context>
+static ErrorOr<ClassFile> parseClassFile(std::istream& stream, Context& ctx)
+{
+  auto errOrHeader = parseClassHeader(stream, ctx);
+  VERIFY(errOrHeader);
+
+  ClassFile cf = errOrHeader.Release();
+  auto mark = ctx.Stats.Begin(stream);
+
+  //a field or method is at least its flags, name, descriptor & attribute count
   U16 fieldsCount;
   TRY(Read<BigEndian>(stream, fieldsCount));
+  TRY(ctx.Claim(stream, fieldsCount, 8, sizeof(FieldMethodInfo), "fields table"));
 
   cf.Fields.reserve(fieldsCount);
   for (auto i = 0; i < fieldsCount; i++)
   {
-    auto errOrField = Parser::ParseFieldMethodInfo(stream, cf.ConstPool);
+    auto errOrField = parseFieldMethodInfo(stream, cf.ConstPool, ctx);
     VERIFY(errOrField);
 
     cf.Fields.emplace_back(errOrField.Release());
@@ -57,23 +319,29 @@ ErrorOr<ClassFile> Parser::ParseClassFile(std::istream& stream)
 
   U16 methodsCount;
   TRY(Read<BigEndian>(stream, methodsCount));
+  TRY(ctx.Claim(stream, methodsCount, 8, sizeof(FieldMethodInfo), "methods table"));
 
   cf.Methods.reserve(methodsCount);
   for (auto i = 0; i < methodsCount; i++)
   {
-    auto errOrMethod = Parser::ParseFieldMethodInfo(stream, cf.ConstPool);
+    auto errOrMethod = parseFieldMethodInfo(stream, cf.ConstPool, ctx);
     VERIFY(errOrMethod);
 
     cf.Methods.emplace_back(errOrMethod.Release());
   }
 
+  ctx.Stats.End(stream, mark, [](auto& stats) -> auto& { return stats.Members; });
+
+  //an attribute is at least its name index & length
   U16 attributesCount;
   TRY(Read<BigEndian>(stream, attributesCount));
+  TRY(ctx.Claim(stream, attributesCount, 6, sizeof(CowPtr<AttributeInfo>),
+        "attributes table"));
 
   cf.Attributes.reserve(attributesCount);
   for (auto i = 0; i < attributesCount; i++)
   {
-    auto errOrAttr = Parser::ParseAttribute(stream, cf.ConstPool);
+    auto errOrAttr = parseAttribute(stream, cf.ConstPool, ctx);
     VERIFY(errOrAttr);
 
     cf.Attributes.emplace_back(errOrAttr.Release());
@@ -82,38 +350,14 @@ ErrorOr<ClassFile> Parser::ParseClassFile(std::istream& stream)
   return cf;
 }
 
-ErrorOr<ConstantPool> Parser::ParseConstantPool(std::istream& stream)
+ErrorOr<ClassFile> Parser::ParseClassFile(std::istream& stream, const ParseOptions& options)
 {
-  ConstantPool cp;
-
-  U16 count;
-  TRY(Read<BigEndian>(stream, count));
-
-  cp.Reserve(count);
-
-  //count = number of constants + 1
-  for(U16 i = 0; i < count-1; i++)
-  {
-    auto errOrCPInfo = Parser::ParseConstant(stream);
-    VERIFY(errOrCPInfo);
-
-    auto cpInfo = errOrCPInfo.Release();
-
-    CPInfo::Type type = cpInfo->GetType();
-
-    cp.Add( std::move(cpInfo) ); 
-
-    //Long & Double constants require the next index into the constant pool
-    //after them be invalid.
-    if(type == CPInfo::Type::Long || type == CPInfo::Type::Double)
-    {
-      cp.Add(nullptr);
-      i++;
-    }
-
-  }
+  return withContext(stream, options, [&](auto& ctx) { return parseClassFile(stream, ctx); });
+}
 
-  return cp;
+ErrorOr<ConstantPool> Parser::ParseConstantPool(std::istream& stream, const ParseOptions& options)
+{
+  return withContext(stream, options, [&](auto& ctx) { return parseConstantPool(stream, ctx); });
 }
 
 static ErrorOr<void> readConst(std::istream& stream, ClassInfo& info)
@@ -176,18 +420,30 @@ static ErrorOr<void> readConst(std::istream& stream, NameAndTypeInfo& info)
   return {};
 }
 
-static ErrorOr<void> readConst(std::istream& stream, UTF8Info& info)
+template <typename Context>
+static ErrorOr<void> readConst(std::istream& stream, UTF8Info& info, Context& ctx)
 {
   U16 len;
   TRY(Read<BigEndian>(stream, len));
+  TRY(ctx.Claim(stream, len, 1, 1, "UTF8 constant"));
+
+  SymbolTable* symbols = ctx.Options.Symbols;
+
+  //interned strings are read into a reused buffer so that only strings the
+  //table hasn't seen yet cause an allocation
+  thread_local std::pmr::string buffer;
+  std::pmr::string& string = symbols ? buffer : info.String;
 
   //TODO: add IO util func for this
-  info.String = std::string(len, '\0');
-  stream.read(&info.String[0], len);
+  string.resize(len);
+  stream.read(&string[0], len);
 
   if (stream.bad())
     return Error{fmt::format("Parser::readConst(UTF8Info): failed to read string")};
 
+  if(symbols)
+    info.Interned = symbols->Intern(string);
+
   return {};
 }
 
@@ -209,9 +465,11 @@ static ErrorOr<void> readConst(std::istream& stream, InvokeDynamicInfo& info)
   return {};
 }
 
-template <typename CPInfoT>
-static ErrorOr< std::unique_ptr<CPInfo> > parseConstT(std::istream& stream)
+template <typename CPInfoT, typename Context>
+static ErrorOr< std::unique_ptr<CPInfo> > parseConstT(std::istream& stream, Context& ctx)
 {
+  TRY(ctx.Charge(sizeof(CPInfoT), "constant pool"));
+
   CPInfoT* pInfo = new CPInfoT{};
   auto errOrConst = readConst(stream, *pInfo);
   VERIFY(errOrConst);
@@ -219,36 +477,55 @@ static ErrorOr< std::unique_ptr<CPInfo> > parseConstT(std::istream& stream)
   return std::unique_ptr<CPInfo>(pInfo);
 }
 
-ErrorOr< std::unique_ptr<CPInfo> > Parser::ParseConstant(std::istream& stream)
+template <typename Context>
+static ErrorOr< std::unique_ptr<CPInfo> > parseUTF8(std::istream& stream, Context& ctx)
+{
+  TRY(ctx.Charge(sizeof(UTF8Info), "constant pool"));
+
+  auto info = std::make_unique<UTF8Info>(ctx.Resource);
+  auto errOrConst = readConst(stream, *info, ctx);
+  VERIFY(errOrConst);
+
+  return std::unique_ptr<CPInfo>(std::move(info));
+}
+
+template <typename Context>
+static ErrorOr< std::unique_ptr<CPInfo> > parseConstant(std::istream& stream, Context& ctx)
 {
   CPInfo::Type type = static_cast<CPInfo::Type>(stream.get());
 
   switch(type)
   {
-    case CPInfo::Type::Class:       return parseConstT<ClassInfo>(stream);
-    case CPInfo::Type::Fieldref:    return parseConstT<FieldrefInfo>(stream);
-    case CPInfo::Type::Methodref:   return parseConstT<MethodrefInfo>(stream);
-    case CPInfo::Type::InterfaceMethodref: return parseConstT<InterfaceMethodrefInfo>(stream);
-    case CPInfo::Type::String:      return parseConstT<StringInfo>(stream);
-    case CPInfo::Type::Integer:     return parseConstT<IntegerInfo>(stream);
-    case CPInfo::Type::Float:       return parseConstT<FloatInfo>(stream);
-    case CPInfo::Type::Long:        return parseConstT<LongInfo>(stream);
-    case CPInfo::Type::Double:      return parseConstT<DoubleInfo>(stream);
-    case CPInfo::Type::NameAndType: return parseConstT<NameAndTypeInfo>(stream);
-    case CPInfo::Type::UTF8:        return parseConstT<UTF8Info>(stream);
-    case CPInfo::Type::MethodHandle:  return parseConstT<MethodHandleInfo>(stream);
-    case CPInfo::Type::MethodType:    return parseConstT<MethodTypeInfo>(stream);
-    case CPInfo::Type::InvokeDynamic: return parseConstT<InvokeDynamicInfo>(stream);
+    case CPInfo::Type::Class:       return parseConstT<ClassInfo>(stream, ctx);
+    case CPInfo::Type::Fieldref:    return parseConstT<FieldrefInfo>(stream, ctx);
+    case CPInfo::Type::Methodref:   return parseConstT<MethodrefInfo>(stream, ctx);
+    case CPInfo::Type::InterfaceMethodref: return parseConstT<InterfaceMethodrefInfo>(stream, ctx);
+    case CPInfo::Type::String:      return parseConstT<StringInfo>(stream, ctx);
+    case CPInfo::Type::Integer:     return parseConstT<IntegerInfo>(stream, ctx);
+    case CPInfo::Type::Float:       return parseConstT<FloatInfo>(stream, ctx);
+    case CPInfo::Type::Long:        return parseConstT<LongInfo>(stream, ctx);
+    case CPInfo::Type::Double:      return parseConstT<DoubleInfo>(stream, ctx);
+    case CPInfo::Type::NameAndType: return parseConstT<NameAndTypeInfo>(stream, ctx);
+    case CPInfo::Type::UTF8:        return parseUTF8(stream, ctx);
+    case CPInfo::Type::MethodHandle:  return parseConstT<MethodHandleInfo>(stream, ctx);
+    case CPInfo::Type::MethodType:    return parseConstT<MethodTypeInfo>(stream, ctx);
+    case CPInfo::Type::InvokeDynamic: return parseConstT<InvokeDynamicInfo>(stream, ctx);
   }
 
   return Error{fmt::format("Parser::ParseConstant: encountered unknown tag "
       "value \"{}\"", static_cast<U8>(type))};
 }
 
-ErrorOr<FieldMethodInfo> Parser::ParseFieldMethodInfo(
-    std::istream& stream, const ConstantPool& constPool)
+ErrorOr< std::unique_ptr<CPInfo> > Parser::ParseConstant(std::istream& stream, const ParseOptions& options)
+{
+  return withContext(stream, options, [&](auto& ctx) { return parseConstant(stream, ctx); });
+}
+
+template <typename Context>
+static ErrorOr<FieldMethodInfo> parseFieldMethodInfo(
+    std::istream& stream, const ConstantPool& constPool, Context& ctx)
 {
-  FieldMethodInfo info;
+  FieldMethodInfo info{ctx.Resource};
 
   U16 attributesCount;
   TRY(Read<BigEndian>(stream, info.AccessFlags,
@@ -256,10 +533,13 @@ ErrorOr<FieldMethodInfo> Parser::ParseFieldMethodInfo(
                               info.DescriptorIndex,
                               attributesCount));
 
+  TRY(ctx.Claim(stream, attributesCount, 6, sizeof(CowPtr<AttributeInfo>),
+        "attributes table"));
+
   info.Attributes.reserve(attributesCount);
   for (auto i = 0; i < attributesCount; i++)
   {
-    auto errOrAttr = Parser::ParseAttribute(stream, constPool);
+    auto errOrAttr = parseAttribute(stream, constPool, ctx);
     VERIFY(errOrAttr);
 
     info.Attributes.emplace_back(errOrAttr.Release());
@@ -268,16 +548,25 @@ ErrorOr<FieldMethodInfo> Parser::ParseFieldMethodInfo(
   return info;
 }
 
+ErrorOr<FieldMethodInfo> Parser::ParseFieldMethodInfo(
+    std::istream& stream, const ConstantPool& constPool, const ParseOptions& options)
+{
+  return withContext(stream, options,
+      [&](auto& ctx) { return parseFieldMethodInfo(stream, constPool, ctx); });
+}
+
 
+template <typename Context>
 static ErrorOr<void> readAttribute(std::istream& stream, 
-    const ConstantPool& constPool, ConstantValueAttribute& attr)
+    const ConstantPool& constPool, Context& ctx, ConstantValueAttribute& attr)
 {
   TRY(Read<BigEndian>(stream, attr.Index));
   return {};
 }
 
+template <typename Context>
 static ErrorOr<void> readAttribute(std::istream& stream, 
-    const ConstantPool& constPool, CodeAttribute& attr)
+    const ConstantPool& constPool, Context& ctx, CodeAttribute& attr)
 {
   U32 codeLen;
   TRY(Read<BigEndian>(stream, 
@@ -285,6 +574,9 @@ static ErrorOr<void> readAttribute(std::istream& stream,
                       attr.MaxLocals,
                       codeLen));
 
+  TRY(ctx.Claim(stream, codeLen, 1, 0, "code"));
+
+  auto mark = ctx.Stats.Begin(stream);
 
   U32 parsedCodeLen{0};
   while(parsedCodeLen < codeLen)
@@ -295,6 +587,9 @@ static ErrorOr<void> readAttribute(std::istream& stream,
     auto errOrInstr = Parser::ParseInstruction(stream);
     VERIFY(errOrInstr);
 
+    TRY(ctx.Charge(sizeof(Instruction), "code"));
+    ctx.Stats.CountOpCode(errOrInstr.Get().GetOpCode());
+
     attr.Code.emplace_back(errOrInstr.Release());
 
     auto parsed = stream.tellg() - streampos_before;
@@ -303,6 +598,8 @@ static ErrorOr<void> readAttribute(std::istream& stream,
     parsedCodeLen += parsed;
   }
 
+  ctx.Stats.End(stream, mark, [](auto& stats) -> auto& { return stats.Instructions; });
+
   if(parsedCodeLen != codeLen)
   {
     return Error{fmt::format("Parser::readAttribute(CodeAttr): "
@@ -314,6 +611,8 @@ static ErrorOr<void> readAttribute(std::istream& stream,
   //      "read length, then read array of that length" scenarios
   U16 exceptionTableLen;
   TRY(Read<BigEndian>(stream, exceptionTableLen));
+  TRY(ctx.Claim(stream, exceptionTableLen, 8, sizeof(CodeAttribute::ExceptionHandler),
+        "exception table"));
 
   attr.ExceptionTable.reserve(exceptionTableLen);
   for(auto i = 0; i < exceptionTableLen; i++)
@@ -329,24 +628,30 @@ static ErrorOr<void> readAttribute(std::istream& stream,
 
   U16 attributesCount;
   TRY(Read<BigEndian>(stream, attributesCount));
+  TRY(ctx.Claim(stream, attributesCount, 6, sizeof(CowPtr<AttributeInfo>),
+        "attributes table"));
 
   attr.Attributes.reserve(attributesCount);
+  ctx.Depth++;
   for(auto i = 0; i < attributesCount; i++)
   {
-    auto errOrAttr = Parser::ParseAttribute(stream, constPool);
+    auto errOrAttr = parseAttribute(stream, constPool, ctx);
     VERIFY(errOrAttr);
 
     attr.Attributes.emplace_back( errOrAttr.Release() );
   }
+  ctx.Depth--;
 
   return {};
 }
 
+template <typename Context>
 static ErrorOr<void> readAttribute(std::istream& stream, 
-    const ConstantPool& constPool, ExceptionsAttribute& attr)
+    const ConstantPool& constPool, Context& ctx, ExceptionsAttribute& attr)
 {
   U16 nExceptions;
   TRY(Read<BigEndian>(stream, nExceptions));
+  TRY(ctx.Claim(stream, nExceptions, sizeof(U16), sizeof(U16), "exceptions table"));
 
   attr.ExceptionTable.reserve(nExceptions);
   for(auto i = 0u; i < nExceptions; i++)
@@ -359,19 +664,24 @@ static ErrorOr<void> readAttribute(std::istream& stream,
   return {};
 }
 
+template <typename Context>
 static ErrorOr<void> readAttribute(std::istream& stream, 
-    const ConstantPool& constPool, SourceFileAttribute& attr)
+    const ConstantPool& constPool, Context& ctx, SourceFileAttribute& attr)
 {
   TRY(Read<BigEndian>(stream, attr.SourceFileIndex));
   return {};
 }
 
+template <typename Context>
 static ErrorOr<void> readAttribute(std::istream& stream, 
-    const ConstantPool& constPool, LineNumberTableAttribute& attr)
+    const ConstantPool& constPool, Context& ctx, LineNumberTableAttribute& attr)
 {
   U16 tableLen;
   TRY(Read<BigEndian>(stream, tableLen));
+  TRY(ctx.Claim(stream, tableLen, 4, sizeof(LineNumberTableAttribute::LineMapping),
+        "line number table"));
 
+  attr.LineNumberMap.reserve(tableLen);
   for(auto i = 0u; i < tableLen; i++)
   {
     U16 pc, line;
@@ -383,14 +693,22 @@ static ErrorOr<void> readAttribute(std::istream& stream,
   return {};
 }
 
-template <typename AttributeT>
+template <typename AttributeT, typename Context>
 static ErrorOr< std::unique_ptr<AttributeInfo> > parseAttributeT(
-    std::istream& stream, const ConstantPool& constPool, U16 nameIndex, U32 len)
+    std::istream& stream, const ConstantPool& constPool, Context& ctx,
+    U16 nameIndex, U32 len)
 {
-  AttributeT* attr = new AttributeT();
+  TRY(ctx.Charge(sizeof(AttributeT), "attribute"));
+
+  AttributeT* attr;
+
+  if constexpr(std::is_constructible_v<AttributeT, std::pmr::memory_resource*>)
+    attr = new AttributeT(ctx.Resource);
+  else
+    attr = new AttributeT();
   attr->NameIndex = nameIndex;
 
-  auto err = readAttribute(stream, constPool, *attr);
+  auto err = readAttribute(stream, constPool, ctx, *attr);
   VERIFY(err);
 
   U32 attrLen = attr->GetLength();
@@ -404,12 +722,77 @@ static ErrorOr< std::unique_ptr<AttributeInfo> > parseAttributeT(
   return std::unique_ptr<AttributeInfo>(attr);
 }
 
-ErrorOr< std::unique_ptr<AttributeInfo> > Parser::ParseAttribute(
-    std::istream& stream, const ConstantPool& constPool)
+//Parses what follows the name & length of an attribute of the given type
+template <typename Context>
+static ErrorOr< std::unique_ptr<AttributeInfo> > parseAttributeBody(std::istream& stream,
+    const ConstantPool& constPool, Context& ctx, AttributeInfo::Type type, U16 nameIndex, U32 len)
 {
+  switch (type)
+  {
+    case AttributeInfo::Type::ConstantValue: 
+      return parseAttributeT<ConstantValueAttribute>(stream, constPool, ctx, nameIndex, len);
+    case AttributeInfo::Type::Code: 
+      return parseAttributeT<CodeAttribute>(stream, constPool, ctx, nameIndex, len);
+    case AttributeInfo::Type::Exceptions: 
+      return parseAttributeT<ExceptionsAttribute>(stream, constPool, ctx, nameIndex, len);
+    case AttributeInfo::Type::SourceFile: 
+      return parseAttributeT<SourceFileAttribute>(stream, constPool, ctx, nameIndex, len);
+    case AttributeInfo::Type::LineNumberTable: 
+      return parseAttributeT<LineNumberTableAttribute>(stream, constPool, ctx, nameIndex, len);
+
+    default: break;
+  }
+
+  TRY(ctx.Charge(sizeof(RawAttribute) + len, "attribute"));
+
+  //TODO: remove raws once everything is implemented, or WARN or something idk
+  auto attr = std::make_unique<RawAttribute>(ctx.Resource);
+  attr->NameIndex = nameIndex;
+
+  //a len checked against the rest of the input is read in one go, others
+  //in chunks so a bogus one fails at the end of the input instead of
+  //allocating all of it up front
+  constexpr U32 chunkSize = 64 * 1024;
+  U32 chunk = ctx.IsBounded() ? len : chunkSize;
+  U32 read = 0;
+
+  while(read < len)
+  {
+    U32 n = std::min(chunk, len - read);
+    attr->Bytes.resize(read + n);
+    stream.read(reinterpret_cast<char*>(attr->Bytes.data() + read), n);
+    read += static_cast<U32>(stream.gcount());
+
+    if(static_cast<U32>(stream.gcount()) != n)
+      break;
+  }
+
+  if(read != len)
+  {
+    return Error{fmt::format("Parser::ParseAttribute(): expected {} bytes of raw "
+        "attribute, but the input ended after {}", len, read)};
+  }
+
+  return std::unique_ptr<AttributeInfo>(std::move(attr));
+}
+
+template <typename Context>
+static ErrorOr< std::unique_ptr<AttributeInfo> > parseAttribute(
+    std::istream& stream, const ConstantPool& constPool, Context& ctx)
+{
+  U32 maxDepth = ctx.Options.MaxNestingDepth;
+  if(maxDepth != 0 && ctx.Depth >= maxDepth)
+  {
+    return Error{fmt::format("Parser::parseAttribute(): attributes are nested "
+        "deeper than the limit of {}", maxDepth)};
+  }
+
+  auto mark = ctx.Stats.Begin(stream);
+
   U16 nameIndex;
   U32 len;
   TRY(Read<BigEndian>(stream, nameIndex, len));
+  TRY(ctx.Claim(stream, len, 1, 0, "attribute"));
 
   auto errOrName = constPool.LookupString(nameIndex);
   VERIFY(errOrName);
@@ -422,43 +805,27 @@ ErrorOr< std::unique_ptr<AttributeInfo> > Parser::ParseAttribute(
     std::cerr << "[WARNING]: " << errOrType.GetError().What;
     std::cerr << " (interpreting as raw attribute instead)\n";
     type = AttributeInfo::Type::Raw;
+    ctx.Stats.CountUnknownAttribute();
   }
   else
     type = errOrType.Get();
 
-  switch (type)
-  {
-    case AttributeInfo::Type::ConstantValue: 
-      return parseAttributeT<ConstantValueAttribute>(stream, constPool, nameIndex, len);
-    case AttributeInfo::Type::Code: 
-      return parseAttributeT<CodeAttribute>(stream, constPool, nameIndex, len);
-    case AttributeInfo::Type::Exceptions: 
-      return parseAttributeT<ExceptionsAttribute>(stream, constPool, nameIndex, len);
-    case AttributeInfo::Type::SourceFile: 
-      return parseAttributeT<SourceFileAttribute>(stream, constPool, nameIndex, len);
-    case AttributeInfo::Type::LineNumberTable: 
-      return parseAttributeT<LineNumberTableAttribute>(stream, constPool, nameIndex, len);
-
-    default: break;
-  }
+  auto errOrAttr = parseAttributeBody(stream, constPool, ctx, type, nameIndex, len);
 
-  //TODO: remove raws once everything is implemented, or WARN or something idk
-  RawAttribute* attr = new RawAttribute{};
-  attr->NameIndex = nameIndex;
-
-  //TODO: add ReadArray<> to util
-  attr->Bytes.reserve(len);
-  for (unsigned i = 0; i < len; i++)
-  {
-    U8 byte;
-    TRY(Read(stream, byte));
+  ctx.Stats.End(stream, mark,
+      [type](auto& stats) -> auto& { return stats.Attributes[static_cast<size_t>(type)]; });
 
-    attr->Bytes.emplace_back(byte);
-  }
+  return errOrAttr;
+}
 
-  return std::unique_ptr<AttributeInfo>(attr);
+ErrorOr< std::unique_ptr<AttributeInfo> > Parser::ParseAttribute(
+    std::istream& stream, const ConstantPool& constPool, const ParseOptions& options)
+{
+  return withContext(stream, options,
+      [&](auto& ctx) { return parseAttribute(stream, constPool, ctx); });
 }
 
+
 template <typename T>
 static ErrorOr<void> readOperand(std::istream& stream, Instruction& instr, size_t i)
 {
@@ -0,0 +1,363 @@
+#include "ClassFile/Peephole.hpp"
+
+#include <fmt/core.h>
+
+#include "ClassFile/CodeEditor.hpp"
+#include "ClassFile/ControlFlowGraph.hpp"
+#include "Util/Error.hpp"
+
+#include <algorithm>
+#include <memory>
+
+namespace ClassFile
+{
+
+//Passes over a method before giving up on reaching a fixed point. Every pass
+//is linear, a rewrite rarely enables more than one further rewrite.
+static constexpr int maxPasses = 8;
+
+enum class opClass : U8
+{
+  Other,
+  Push1,  //side effect free push of a category 1 value
+  Push2,  //... & of a category 2 value
+  Load1,
+  Load2,
+  Store1,
+  Store2,
+  Dup,
+  Dup2,
+  Pop,
+  Pop2,
+};
+
+enum class pairAction : U8
+{
+  RemoveBoth,
+  DupStore, //store x; load x -> dup; store x
+};
+
+struct pairRule
+{
+  opClass First, Second;
+  bool SameLocal; //both access the same local with the same type
+  pairAction Action;
+};
+
+static constexpr pairRule pairRules[] =
+{
+  {opClass::Push1,  opClass::Pop,    false, pairAction::RemoveBoth},
+  {opClass::Push2,  opClass::Pop2,   false, pairAction::RemoveBoth},
+  {opClass::Load1,  opClass::Pop,    false, pairAction::RemoveBoth},
+  {opClass::Load2,  opClass::Pop2,   false, pairAction::RemoveBoth},
+  {opClass::Dup,    opClass::Pop,    false, pairAction::RemoveBoth},
+  {opClass::Dup2,   opClass::Pop2,   false, pairAction::RemoveBoth},
+  {opClass::Load1,  opClass::Store1, true,  pairAction::RemoveBoth},
+  {opClass::Load2,  opClass::Store2, true,  pairAction::RemoveBoth},
+  {opClass::Store1, opClass::Load1,  true,  pairAction::DupStore},
+  {opClass::Store2, opClass::Load2,  true,  pairAction::DupStore},
+};
+
+struct classified
+{
+  opClass Class;
+  U8 Kind;   //i, l, f, d, a for loads & stores
+  S32 Local;
+};
+
+//Loads & stores come in the groups (i, l, f, d, a) with an explicit index
+//followed by the (i, l, f, d, a) x (0, 1, 2, 3) short forms
+static classified classifyAccess(const Instruction& instr, OpCode explicitBase,
+    OpCode shortBase, opClass narrow, opClass wide)
+{
+  OpCode op = instr.GetOpCode();
+  U8 kind;
+  S32 local;
+
+  if(op < shortBase)
+  {
+    kind = static_cast<U8>(op - explicitBase);
+    local = instr.GetOperand(0).Get();
+  }
+  else
+  {
+    kind = static_cast<U8>((op - shortBase) / 4);
+    local = (op - shortBase) % 4;
+  }
+
+  return {kind == 1 || kind == 3 ? wide : narrow, kind, local};
+}
+
+static classified classify(const Instruction& instr)
+{
+  OpCode op = instr.GetOpCode();
+
+  if((op >= ACONST_NULL && op <= ICONST_5) || (op >= FCONST_0 && op <= FCONST_2) ||
+      op == BIPUSH || op == SIPUSH)
+    return {opClass::Push1, 0, 0};
+
+  if((op >= LCONST_0 && op <= LCONST_1) || (op >= DCONST_0 && op <= DCONST_1))
+    return {opClass::Push2, 0, 0};
+
+  if(op >= ILOAD && op <= ALOAD_3 && (op <= ALOAD || op >= ILOAD_0))
+    return classifyAccess(instr, ILOAD, ILOAD_0, opClass::Load1, opClass::Load2);
+
+  if(op >= ISTORE && op <= ASTORE_3 && (op <= ASTORE || op >= ISTORE_0))
+    return classifyAccess(instr, ISTORE, ISTORE_0, opClass::Store1, opClass::Store2);
+
+  switch(op)
+  {
+    case DUP:  return {opClass::Dup, 0, 0};
+    case DUP2: return {opClass::Dup2, 0, 0};
+    case POP:  return {opClass::Pop, 0, 0};
+    case POP2: return {opClass::Pop2, 0, 0};
+    default:   return {opClass::Other, 0, 0};
+  }
+}
+
+static ErrorOr<CodeEditor::Sequence> makeSequence(OpCode op, std::initializer_list<S32> operands = {})
+{
+  auto errOrInstr = Instruction::MakeInstruction(op);
+  VERIFY(errOrInstr);
+
+  size_t i = 0;
+  for(S32 operand : operands)
+    TRY(errOrInstr.Get().SetOperand(i++, operand));
+
+  CodeEditor::Sequence seq;
+  seq.Add(errOrInstr.Release());
+  return seq;
+}
+
+//Rules on a single instruction, returns whether one applied
+static ErrorOr<bool> applySingle(CodeEditor& editor, const Instruction& instr, size_t index)
+{
+  OpCode op = instr.GetOpCode();
+
+  if(op == NOP)
+  {
+    editor.Remove(index);
+    return true;
+  }
+
+  if(op == LDC_W)
+  {
+    S32 cpIndex = instr.GetOperand(0).Get();
+
+    if(cpIndex > 0xFF)
+      return false;
+
+    auto errOrSeq = makeSequence(LDC, {cpIndex});
+    VERIFY(errOrSeq);
+    editor.Replace(index, errOrSeq.Release());
+    return true;
+  }
+
+  if(!IsBranch(op) || op == JSR || op == JSR_W)
+    return false;
+
+  auto errOrOffset = instr.GetBranchOffset();
+  VERIFY(errOrOffset);
+
+  if(errOrOffset.Get() != static_cast<S32>(instr.GetLength()))
+    return false;
+
+  if(op == GOTO || op == GOTO_W)
+  {
+    editor.Remove(index);
+    return true;
+  }
+
+  //a condition jumping to the next instruction only consumes its operands
+  bool isBinary = op >= IF_ICMPEQ && op <= IF_ACMPNE;
+  auto errOrSeq = makeSequence(isBinary ? POP2 : POP);
+  VERIFY(errOrSeq);
+  editor.Replace(index, errOrSeq.Release());
+  return true;
+}
+
+//Rules on two adjacent instructions of a block, returns whether one applied
+static ErrorOr<bool> applyPair(CodeEditor& editor, const Instruction& first,
+    const Instruction& second, size_t index)
+{
+  classified a = classify(first), b = classify(second);
+
+  if(a.Class == opClass::Other || b.Class == opClass::Other)
+    return false;
+
+  for(const pairRule& rule : pairRules)
+  {
+    if(rule.First != a.Class || rule.Second != b.Class)
+      continue;
+
+    if(rule.SameLocal && (a.Kind != b.Kind || a.Local != b.Local))
+      continue;
+
+    if(rule.Action == pairAction::RemoveBoth)
+    {
+      editor.Remove(index);
+      editor.Remove(index + 1);
+      return true;
+    }
+
+    auto errOrDup = makeSequence(a.Class == opClass::Store1 ? DUP : DUP2);
+    VERIFY(errOrDup);
+
+    CodeEditor::Sequence store;
+    store.Add(first);
+
+    editor.Replace(index, errOrDup.Release());
+    editor.Replace(index + 1, std::move(store));
+    return true;
+  }
+
+  return false;
+}
+
+static ErrorOr<size_t> runPass(const ConstantPool& cp, CodeAttribute& code)
+{
+  auto errOrCFG = ControlFlowGraph::Build(code);
+  VERIFY(errOrCFG);
+
+  const ControlFlowGraph& cfg = errOrCFG.Get();
+  CodeEditor editor{cp, code};
+  size_t count = 0;
+
+  for(ControlFlowGraph::BlockId b = 0; b < cfg.GetBlockCount(); b++)
+  {
+    U32 start = cfg.GetStart(b), end = cfg.GetEnd(b);
+
+    if(!cfg.IsReachable(b))
+    {
+      for(U32 i = start; i < end; i++)
+        editor.Remove(i);
+
+      count++;
+      continue;
+    }
+
+    for(U32 i = start; i < end; i++)
+    {
+      auto errOrSingle = applySingle(editor, code.Code[i], i);
+      VERIFY(errOrSingle);
+
+      if(errOrSingle.Get())
+      {
+        count++;
+        continue;
+      }
+
+      if(i + 1 == end)
+        break;
+
+      auto errOrPair = applyPair(editor, code.Code[i], code.Code[i + 1], i);
+      VERIFY(errOrPair);
+
+      if(errOrPair.Get())
+      {
+        count++;
+        i++;
+      }
+    }
+  }
+
+  if(count != 0)
+    TRY(editor.Commit());
+
+  return count;
+}
+
+ErrorOr<size_t> Transform::OptimizePeephole(ClassFile& cf, FieldMethodInfo& method,
+    const HierarchyOracle& oracle)
+{
+  auto codeAttr = std::find_if(method.Attributes.begin(), method.Attributes.end(),
+      [](const CowPtr<AttributeInfo>& attr){ return attr->GetType() == AttributeInfo::Type::Code; });
+
+  if(codeAttr == method.Attributes.end())
+    return size_t{0};
+
+  //the code is rewritten in a copy, the method gets the original back if
+  //anything fails so it's never left half optimized or without its frames
+  size_t codePos = static_cast<size_t>(codeAttr - method.Attributes.begin());
+  CowPtr<AttributeInfo> original = *codeAttr;
+  CodeAttribute* code = &static_cast<CodeAttribute&>(codeAttr->Mutate());
+
+  auto restore = [&]()
+  {
+    method.Attributes[codePos] = std::move(original);
+  };
+
+  //the frames are recomputed instead of remapped, as removing code can leave
+  //several of them at the same pc
+  auto frames = std::find_if(code->Attributes.begin(), code->Attributes.end(),
+      [&](const CowPtr<AttributeInfo>& attr)
+  {
+    if(attr->GetType() != AttributeInfo::Type::Raw)
+      return false;
+
+    auto errOrName = cf.ConstPool.LookupString(attr->NameIndex);
+    return !errOrName.IsError() && errOrName.Get() == "StackMapTable";
+  });
+
+  bool hasFrames = frames != code->Attributes.end();
+
+  if(hasFrames)
+    code->Attributes.erase(frames);
+
+  size_t total = 0;
+
+  for(int pass = 0; pass < maxPasses; pass++)
+  {
+    auto errOrCount = runPass(cf.ConstPool, *code);
+
+    if(errOrCount.IsError())
+    {
+      restore();
+      return errOrCount.GetError();
+    }
+
+    if(errOrCount.Get() == 0)
+      break;
+
+    total += errOrCount.Get();
+  }
+
+  if(total == 0)
+  {
+    restore();
+    return size_t{0};
+  }
+
+  auto result = hasFrames ? ComputeFrames(cf, method, oracle) : ComputeMaxs(cf.ConstPool, method);
+
+  if(result.IsError())
+  {
+    restore();
+    return result.GetError();
+  }
+
+  return total;
+}
+
+ErrorOr<size_t> Transform::OptimizePeephole(ClassFile& cf, const HierarchyOracle& oracle)
+{
+  size_t total = 0;
+
+  for(size_t i = 0; i < cf.Methods.size(); i++)
+  {
+    auto errOrCount = OptimizePeephole(cf, cf.Methods[i], oracle);
+
+    if(errOrCount.IsError())
+    {
+      auto errOrName = cf.ConstPool.LookupString(cf.Methods[i].NameIndex);
+      return Error{fmt::format("{}\n  in method {}", errOrCount.GetError().What,
+          errOrName.IsError() ? std::string_view{"?"} : errOrName.Get())};
+    }
+
+    total += errOrCount.Get();
+  }
+
+  return total;
+}
+
+} //namespace ClassFile
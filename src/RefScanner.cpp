@@ -0,0 +1,392 @@
+#include "ClassFile/RefScanner.hpp"
+
+#include <fmt/core.h>
+
+#include "Util/Error.hpp"
+#include "Util/RawClass.hpp"
+
+#include <algorithm>
+#include <array>
+
+#if defined(__SSE2__)
+  #include <emmintrin.h>
+#endif
+
+namespace ClassFile
+{
+namespace RefScanner
+{
+
+Target Target::Class(std::string name)
+{
+  return Target{Kind::Class, std::move(name), {}, {}};
+}
+
+Target Target::String(std::string value)
+{
+  return Target{Kind::String, std::move(value), {}, {}};
+}
+
+Target Target::Field(std::string owner, std::string name, std::string descriptor)
+{
+  return Target{Kind::Field, std::move(owner), std::move(name), std::move(descriptor)};
+}
+
+Target Target::Method(std::string owner, std::string name, std::string descriptor)
+{
+  return Target{Kind::Method, std::move(owner), std::move(name), std::move(descriptor)};
+}
+
+IndexSet::IndexSet() : m_bits(0x10000 / 64, 0) {}
+
+void IndexSet::Add(U16 index)
+{
+  if(Contains(index))
+    return;
+
+  m_bits[index / 64] |= U64{1} << (index % 64);
+  m_indices.push_back(index);
+}
+
+bool IndexSet::Contains(U16 index) const
+{
+  return m_bits[index / 64] & (U64{1} << (index % 64));
+}
+
+bool IndexSet::Empty() const
+{
+  return m_indices.empty();
+}
+
+const std::vector<U16>& IndexSet::GetIndices() const
+{
+  return m_indices;
+}
+
+//Length of every fixed size instruction, 0 for the variable sized ones
+//(tableswitch, lookupswitch & wide) and undefined opcodes
+static const std::array<U8, 256> lengthTable = []()
+{
+  std::array<U8, 256> table{};
+
+  for(size_t i = 0; i < OpCode::_N; i++)
+  {
+    OpCode op = static_cast<OpCode>(i);
+
+    if(GetNOperands(op) > 0 && IsComplex(op))
+      continue;
+
+    size_t len = 1;
+    for(size_t j = 0; j < GetNOperands(op); j++)
+      len += GetOperandSize(op, j);
+
+    table[i] = static_cast<U8>(len);
+  }
+
+  return table;
+}();
+
+static S32 readS32(const U8* bytes)
+{
+  return static_cast<S32>((U32{bytes[0]} << 24) | (U32{bytes[1]} << 16) |
+                          (U32{bytes[2]} << 8)  |  U32{bytes[3]});
+}
+
+//Byte pairs an instruction referring to one of indices must contain: the
+//big endian operand itself, plus the ldc opcode followed by the index for
+//indices that fit into ldc's single byte operand
+static std::vector<U16> makePatterns(const IndexSet& indices)
+{
+  std::vector<U16> patterns;
+
+  for(U16 index : indices.GetIndices())
+  {
+    patterns.push_back(index);
+
+    if(index <= 0xFF)
+      patterns.push_back(static_cast<U16>((OpCode::LDC << 8) | index));
+  }
+
+  std::sort(patterns.begin(), patterns.end());
+  patterns.erase(std::unique(patterns.begin(), patterns.end()), patterns.end());
+  return patterns;
+}
+
+//False if no two consecutive bytes of code match any of patterns, meaning the
+//code can't contain a matching instruction
+static bool mayContain(const U8* code, size_t len, const std::vector<U16>& patterns)
+{
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  //compares 16 byte pairs per pattern at once: the first bytes from one load,
+  //the second bytes from a load shifted by one
+  for(; i + 17 <= len; i += 16)
+  {
+    __m128i first  = _mm_loadu_si128(reinterpret_cast<const __m128i*>(code + i));
+    __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(code + i + 1));
+    __m128i hits   = _mm_setzero_si128();
+
+    for(U16 pattern : patterns)
+    {
+      __m128i hi = _mm_cmpeq_epi8(first,  _mm_set1_epi8(static_cast<char>(pattern >> 8)));
+      __m128i lo = _mm_cmpeq_epi8(second, _mm_set1_epi8(static_cast<char>(pattern & 0xFF)));
+      hits = _mm_or_si128(hits, _mm_and_si128(hi, lo));
+    }
+
+    if(_mm_movemask_epi8(hits) != 0)
+      return true;
+  }
+#endif
+
+  for(; i + 1 < len; i++)
+  {
+    U16 pair = static_cast<U16>((code[i] << 8) | code[i+1]);
+
+    if(std::binary_search(patterns.begin(), patterns.end(), pair))
+      return true;
+  }
+
+  return false;
+}
+
+//beyond this many patterns the prefilter costs more than it saves
+static constexpr size_t maxPatterns = 16;
+
+ErrorOr<void> ScanCode(const U8* code, size_t len, const IndexSet& indices,
+    const std::function<void(U32 pc, OpCode, U16 index)>& onSite)
+{
+  if(indices.Empty())
+    return NoError{};
+
+  std::vector<U16> patterns = makePatterns(indices);
+
+  if(patterns.size() <= maxPatterns && !mayContain(code, len, patterns))
+    return NoError{};
+
+  size_t pc = 0;
+
+  while(pc < len)
+  {
+    U8 op = code[pc];
+    size_t length = lengthTable[op];
+
+    if(length == 0)
+    {
+      //switch operands start at the next multiple of 4 from the code start
+      size_t base = (pc + 4) & ~size_t{3};
+
+      switch(op)
+      {
+        case OpCode::TABLESWITCH:
+        {
+          if(base + 12 > len)
+            break;
+
+          S64 low  = readS32(code + base + 4);
+          S64 high = readS32(code + base + 8);
+
+          if(high < low)
+          {
+            return Error{fmt::format("RefScanner::ScanCode(): tableswitch at "
+                "{} has high < low ({} < {})", pc, high, low)};
+          }
+
+          length = base + 12 + static_cast<size_t>(high - low + 1) * 4 - pc;
+          break;
+        }
+
+        case OpCode::LOOKUPSWITCH:
+        {
+          if(base + 8 > len)
+            break;
+
+          S64 nPairs = readS32(code + base + 4);
+
+          if(nPairs < 0)
+          {
+            return Error{fmt::format("RefScanner::ScanCode(): lookupswitch at "
+                "{} has a negative npairs ({})", pc, nPairs)};
+          }
+
+          length = base + 8 + static_cast<size_t>(nPairs) * 8 - pc;
+          break;
+        }
+
+        case OpCode::WIDE:
+          if(pc + 1 < len)
+            length = code[pc+1] == OpCode::IINC ? 6 : 4;
+          break;
+
+        default:
+          return Error{fmt::format("RefScanner::ScanCode(): unknown opcode "
+              "0x{:X} at {}", op, pc)};
+      }
+
+      //a length of 0 is left by the breaks above for operands cut off early
+      if(length == 0)
+        length = len - pc + 1;
+    }
+
+    if(pc + length > len)
+    {
+      return Error{fmt::format("RefScanner::ScanCode(): instruction \"{}\" at {} "
+          "exceeds the code length {}", GetMnemonic(static_cast<OpCode>(op)), pc, len)};
+    }
+
+    if(HasConstantPoolIndex(static_cast<OpCode>(op)))
+    {
+      U16 index = op == OpCode::LDC ? code[pc+1]
+                                    : static_cast<U16>((code[pc+1] << 8) | code[pc+2]);
+
+      if(indices.Contains(index))
+        onSite(static_cast<U32>(pc), static_cast<OpCode>(op), index);
+    }
+
+    pc += length;
+  }
+
+  return NoError{};
+}
+
+static bool matchesMember(const RawClass::Skim& skim, U16 index, const Target& target)
+{
+  U16 owner = skim.GetField(index, 0);
+
+  if(!skim.Is(owner, CPInfo::Type::Class) ||
+     skim.GetIndirectUTF8(owner) != std::string_view{target.Owner})
+  {
+    return false;
+  }
+
+  U16 nameAndType = skim.GetField(index, 1);
+
+  if(!skim.Is(nameAndType, CPInfo::Type::NameAndType))
+    return false;
+
+  return skim.GetUTF8(skim.GetField(nameAndType, 0)) == std::string_view{target.Name} &&
+         skim.GetUTF8(skim.GetField(nameAndType, 1)) == std::string_view{target.Descriptor};
+}
+
+static bool matches(const RawClass::Skim& skim, U16 index, const Target& target)
+{
+  switch(target.TargetKind)
+  {
+    case Target::Kind::Class:
+      return skim.Is(index, CPInfo::Type::Class) &&
+        skim.GetIndirectUTF8(index) == std::string_view{target.Owner};
+
+    case Target::Kind::String:
+      return skim.Is(index, CPInfo::Type::String) &&
+        skim.GetIndirectUTF8(index) == std::string_view{target.Owner};
+
+    case Target::Kind::Field:
+      return skim.Is(index, CPInfo::Type::Fieldref) &&
+        matchesMember(skim, index, target);
+
+    case Target::Kind::Method:
+      return (skim.Is(index, CPInfo::Type::Methodref) ||
+              skim.Is(index, CPInfo::Type::InterfaceMethodref)) &&
+        matchesMember(skim, index, target);
+  }
+
+  return false;
+}
+
+static std::vector<IndexSet> findConstants(const RawClass::Skim& skim,
+    const std::vector<Target>& targets)
+{
+  std::vector<IndexSet> sets(targets.size());
+
+  for(U16 i = 1; i < skim.GetConstCount(); i++)
+  {
+    //UTF8s are by far the most common entries & never targets themselves
+    if(skim.GetTag(i) == static_cast<U8>(CPInfo::Type::UTF8))
+      continue;
+
+    for(size_t t = 0; t < targets.size(); t++)
+    {
+      if(matches(skim, i, targets[t]))
+        sets[t].Add(i);
+    }
+  }
+
+  return sets;
+}
+
+ErrorOr< std::vector<IndexSet> > FindConstants(const U8* classBytes, size_t len,
+    const std::vector<Target>& targets)
+{
+  auto errOrSkim = RawClass::SkimClass(classBytes, len);
+  VERIFY(errOrSkim);
+
+  return findConstants(errOrSkim.Get(), targets);
+}
+
+ErrorOr< std::vector<Site> > FindReferences(const U8* classBytes, size_t len,
+    const std::vector<Target>& targets)
+{
+  auto errOrSkim = RawClass::SkimClass(classBytes, len);
+  VERIFY(errOrSkim);
+
+  const RawClass::Skim& skim = errOrSkim.Get();
+  std::vector<IndexSet> sets = findConstants(skim, targets);
+
+  IndexSet all;
+  for(const IndexSet& set : sets)
+  {
+    for(U16 index : set.GetIndices())
+      all.Add(index);
+  }
+
+  std::vector<Site> sites;
+
+  U16 codeName = skim.FindUTF8("Code");
+
+  if(all.Empty() || codeName == 0)
+    return sites;
+
+  for(size_t m = 0; m < skim.Methods.size(); m++)
+  {
+    const RawClass::Member& method = skim.Methods[m];
+
+    for(U32 a = method.FirstAttribute; a < method.LastAttribute; a++)
+    {
+      const RawClass::Attribute& attr = skim.Attributes[a];
+
+      if(attr.NameIndex != codeName)
+        continue;
+
+      //max_stack (2), max_locals (2), code_length (4), code[]
+      RawAttributes::Reader r{classBytes + attr.Offset, attr.Length};
+      TRY(r.Skip(4));
+
+      auto errOrCodeLength = r.U4();
+      VERIFY(errOrCodeLength);
+      TRY(r.Skip(errOrCodeLength.Get()));
+
+      const U8* code = classBytes + attr.Offset + 8;
+
+      auto onSite = [&](U32 pc, OpCode op, U16 index)
+      {
+        //the same constant may match several targets, e.g. a target given twice
+        for(size_t target = 0; target < sets.size(); target++)
+        {
+          if(!sets[target].Contains(index))
+            continue;
+
+          sites.push_back({target, static_cast<U16>(m), pc, op, index,
+              skim.GetUTF8(method.NameIndex).value_or(std::string_view{}),
+              skim.GetUTF8(method.DescriptorIndex).value_or(std::string_view{})});
+        }
+      };
+
+      TRY(ScanCode(code, errOrCodeLength.Get(), all, onSite));
+    }
+  }
+
+  return sites;
+}
+
+} //namespace RefScanner
+} //namespace ClassFile
@@ -82,8 +82,10 @@ static ErrorOr<void> writeConst(std::ostream& stream, const MethodHandleInfo& in
 
 static ErrorOr<void> writeConst(std::ostream& stream, const UTF8Info& info)
 {
-  TRY(Write<BigEndian>(stream, static_cast<U16>( info.String.length() )));
-  stream << info.String;
+  std::string_view string = info.GetString();
+
+  TRY(Write<BigEndian>(stream, static_cast<U16>( string.length() )));
+  stream << string;
   return {};
 }
 
@@ -0,0 +1,251 @@
+#include "ClassFile/Shrink.hpp"
+
+#include <fmt/core.h>
+
+#include "ClassFile/Classpath.hpp"
+#include "ClassFile/Parser.hpp"
+#include "ClassFile/Serializer.hpp"
+#include "ClassFile/Transform.hpp"
+#include "Util/Error.hpp"
+#include "Util/Parallel.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string_view>
+
+namespace ClassFile
+{
+
+//Attributes defined by the JVM specification (JVMS 4.7)
+static constexpr std::string_view standardAttributes[] =
+{
+  "ConstantValue", "Code", "StackMapTable", "Exceptions", "InnerClasses",
+  "EnclosingMethod", "Synthetic", "Signature", "SourceFile",
+  "SourceDebugExtension", "LineNumberTable", "LocalVariableTable",
+  "LocalVariableTypeTable", "Deprecated", "RuntimeVisibleAnnotations",
+  "RuntimeInvisibleAnnotations", "RuntimeVisibleParameterAnnotations",
+  "RuntimeInvisibleParameterAnnotations", "RuntimeVisibleTypeAnnotations",
+  "RuntimeInvisibleTypeAnnotations", "AnnotationDefault", "BootstrapMethods",
+  "MethodParameters", "Module", "ModulePackages", "ModuleMainClass", "NestHost",
+  "NestMembers", "Record", "PermittedSubclasses",
+};
+
+static bool isStripped(std::string_view name, const StripOptions& options)
+{
+  if(options.LineNumbers && name == "LineNumberTable")
+    return true;
+
+  if(options.SourceFile && (name == "SourceFile" || name == "SourceDebugExtension"))
+    return true;
+
+  if(options.LocalVariables && (name == "LocalVariableTable" || name == "LocalVariableTypeTable"))
+    return true;
+
+  if(options.UnknownAttributes && std::find(std::begin(standardAttributes),
+        std::end(standardAttributes), name) == std::end(standardAttributes))
+    return true;
+
+  return std::find(options.Names.begin(), options.Names.end(), name) != options.Names.end();
+}
+
+template <typename AttributeList>
+static ErrorOr<bool> stripsAny(const ConstantPool& cp, const AttributeList& attrs,
+    const StripOptions& options)
+{
+  for(const auto& attr : attrs)
+  {
+    auto errOrName = cp.LookupString(attr->NameIndex);
+    VERIFY(errOrName, "failed to lookup attribute name");
+
+    if(isStripped(errOrName.Get(), options))
+      return true;
+
+    if(attr->GetType() != AttributeInfo::Type::Code)
+      continue;
+
+    auto errOrStrips = stripsAny(cp, static_cast<const CodeAttribute&>(*attr).Attributes, options);
+    VERIFY(errOrStrips);
+
+    if(errOrStrips.Get())
+      return true;
+  }
+
+  return false;
+}
+
+template <typename AttributeList>
+static ErrorOr<size_t> stripAttributes(const ConstantPool& cp, AttributeList& attrs,
+    const StripOptions& options)
+{
+  size_t removed = 0;
+
+  for(auto& attr : attrs)
+  {
+    if(attr->GetType() != AttributeInfo::Type::Code)
+      continue;
+
+    //a Code attribute shared with a clone is only copied if it loses something
+    auto errOrStrips = stripsAny(cp, static_cast<const CodeAttribute&>(*attr).Attributes, options);
+    VERIFY(errOrStrips);
+
+    if(!errOrStrips.Get())
+      continue;
+
+    auto errOrRemoved = stripAttributes(cp, static_cast<CodeAttribute&>(attr.Mutate()).Attributes, options);
+    VERIFY(errOrRemoved);
+    removed += errOrRemoved.Get();
+  }
+
+  //names are looked up before anything is erased, so a bad index leaves the
+  //list untouched
+  std::vector<U8> strip(attrs.size(), false);
+
+  for(size_t i = 0; i < attrs.size(); i++)
+  {
+    auto errOrName = cp.LookupString(attrs[i]->NameIndex);
+    VERIFY(errOrName, "failed to lookup attribute name");
+    strip[i] = isStripped(errOrName.Get(), options);
+  }
+
+  size_t kept = 0;
+
+  for(size_t i = 0; i < attrs.size(); i++)
+  {
+    if(!strip[i])
+      attrs[kept++] = std::move(attrs[i]);
+  }
+
+  removed += attrs.size() - kept;
+  attrs.resize(kept);
+  return removed;
+}
+
+ErrorOr<size_t> Transform::StripAttributes(ClassFile& cf, const StripOptions& options)
+{
+  size_t removed = 0;
+
+  for(auto* members : {&cf.Fields, &cf.Methods})
+  {
+    for(FieldMethodInfo& member : *members)
+    {
+      auto errOrRemoved = stripAttributes(cf.ConstPool, member.Attributes, options);
+      VERIFY(errOrRemoved);
+      removed += errOrRemoved.Get();
+    }
+  }
+
+  auto errOrRemoved = stripAttributes(cf.ConstPool, cf.Attributes, options);
+  VERIFY(errOrRemoved);
+
+  return removed + errOrRemoved.Get();
+}
+
+ErrorOr<void> Transform::Shrink(ClassFile& cf, const ShrinkOptions& options, ShrinkStats* stats)
+{
+  auto errOrRemoved = StripAttributes(cf, options.Strip);
+  VERIFY(errOrRemoved);
+
+  U16 freed = 0;
+
+  if(options.CompactConstantPool)
+  {
+    auto errOrFreed = CompactConstantPool(cf);
+    VERIFY(errOrFreed);
+    freed = errOrFreed.Get();
+  }
+
+  if(stats)
+  {
+    stats->AttributesRemoved += errOrRemoved.Get();
+    stats->ConstantsRemoved += freed;
+  }
+
+  return NoError{};
+}
+
+//Shrinks one file into outPath, creating its directory if needed
+static ErrorOr<void> shrinkFile(const std::string& inPath, const std::string& outPath,
+    const ShrinkOptions& options, ShrinkStats& stats)
+{
+  namespace fs = std::filesystem;
+
+  std::ifstream in{inPath, std::ios::binary};
+  auto errOrClass = Parser::ParseClassFile(in);
+  VERIFY(errOrClass, "failed to parse class");
+
+  if(!in.good())
+    return Error{"unable to read file"};
+
+  U64 bytesIn = static_cast<U64>(in.tellg());
+  TRY(Transform::Shrink(errOrClass.Get(), options, &stats));
+
+  std::error_code ec;
+  fs::path parent = fs::path{outPath}.parent_path();
+
+  if(!parent.empty())
+    fs::create_directories(parent, ec);
+
+  std::ofstream out{outPath, std::ios::binary | std::ios::trunc};
+  TRY(Serializer::SerializeClassFile(out, errOrClass.Get()));
+
+  if(!out.good())
+    return Error{fmt::format("unable to write \"{}\"", outPath)};
+
+  stats.Classes = 1;
+  stats.BytesIn = bytesIn;
+  stats.BytesOut = static_cast<U64>(out.tellp());
+  return NoError{};
+}
+
+ErrorOr<ShrinkStats> Transform::ShrinkClasspath(const std::string& inputRoot,
+    const std::string& outputRoot, const ShrinkOptions& options)
+{
+  namespace fs = std::filesystem;
+
+  auto errOrPaths = Classpath::ListClassFiles(inputRoot);
+  VERIFY(errOrPaths);
+
+  const std::vector<std::string>& paths = errOrPaths.Get();
+  bool isSingleFile = fs::is_regular_file(inputRoot);
+
+  std::vector<ShrinkStats> stats(paths.size());
+  std::vector<Error> errors(paths.size());
+  std::vector<U8> failed(paths.size(), false); //not vector<bool>, threads write it
+
+  ParallelFor(paths.size(), options.Threads, [&](size_t i)
+  {
+    std::string outPath = isSingleFile ? outputRoot :
+        (fs::path{outputRoot} / fs::path{paths[i]}.lexically_relative(inputRoot)).string();
+
+    auto result = shrinkFile(paths[i], outPath, options, stats[i]);
+
+    if(result.IsError())
+    {
+      failed[i] = true;
+      errors[i] = result.GetError();
+    }
+  });
+
+  ShrinkStats total;
+
+  //reported in input order so the error doesn't depend on thread scheduling
+  for(size_t i = 0; i < paths.size(); i++)
+  {
+    if(failed[i])
+    {
+      return Error{fmt::format("Transform::ShrinkClasspath(): failed to shrink "
+          "\"{}\":\n  {}", paths[i], errors[i].What)};
+    }
+
+    total.Classes += stats[i].Classes;
+    total.AttributesRemoved += stats[i].AttributesRemoved;
+    total.ConstantsRemoved += stats[i].ConstantsRemoved;
+    total.BytesIn += stats[i].BytesIn;
+    total.BytesOut += stats[i].BytesOut;
+  }
+
+  return total;
+}
+
+} //namespace ClassFile
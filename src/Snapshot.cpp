@@ -0,0 +1,967 @@
+#include "ClassFile/Snapshot.hpp"
+#include "ClassFile/Classpath.hpp"
+#include "ClassFile/Serializer.hpp"
+
+#include <fmt/core.h>
+
+#include "Util/Error.hpp"
+#include "Util/Hash128.hpp"
+#include "Util/RawClass.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <streambuf>
+
+#if __has_include(<sys/mman.h>)
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+  #define SNAPSHOT_USE_MMAP 1
+#else
+  #define SNAPSHOT_USE_MMAP 0
+#endif
+
+namespace ClassFile
+{
+
+//On disk layout, all offsets are relative to the start of the file unless
+//noted otherwise:
+//
+//  fileHeader
+//  U32[ClassCount]      offsets of the classRecords
+//  U32[ClassCount]      class numbers sorted by class name
+//  per class:
+//    classRecord
+//    U32[ConstCount]    offset of each constant's tag within the class bytes
+//    memberRecord[]     fields followed by methods
+//    attributeRecord[]  attributes of all members followed by the class's
+//    U8[]               the class file bytes, padded to a multiple of 4
+//
+//Records are read with memcpy, so they don't need to be aligned in memory.
+
+static constexpr char snapshotMagic[8] = {'C','F','S','N','A','P','\r','\n'};
+static constexpr U32 byteOrderMark = 0x01020304;
+static constexpr U32 noAttribute = ~U32{0};
+
+struct fileHeader
+{
+  char Magic[8];
+  U32 Version;
+  U32 ByteOrderMark;
+  U64 KeyLow;
+  U64 KeyHigh;
+  U32 ClassCount;
+  U32 ClassTableOffset;
+  U32 NameTableOffset;
+  U32 Reserved;
+  U64 FileSize;
+};
+static_assert(sizeof(fileHeader) == 56);
+
+struct classRecord
+{
+  U32 BytesOffset;
+  U32 BytesLength;
+  U32 ConstOffsetsOffset;
+  U32 MembersOffset;
+  U32 AttributesOffset;
+  U32 AttributeTotal;
+  U32 FirstClassAttribute;
+  U32 InterfacesOffset; //within the class bytes
+
+  U16 MinorVersion;
+  U16 MajorVersion;
+  U16 AccessFlags;
+  U16 ThisClass;
+  U16 SuperClass;
+  U16 ConstCount;
+  U16 InterfaceCount;
+  U16 FieldCount;
+  U16 MethodCount;
+  U16 ClassAttributeCount;
+};
+static_assert(sizeof(classRecord) == 52);
+
+struct memberRecord
+{
+  U16 AccessFlags;
+  U16 NameIndex;
+  U16 DescriptorIndex;
+  U16 AttributeCount;
+  U32 FirstAttribute;
+  U32 CodeAttribute; //noAttribute if there is none
+};
+static_assert(sizeof(memberRecord) == 16);
+
+struct attributeRecord
+{
+  U16 NameIndex;
+  U16 Reserved;
+  U32 Offset; //of the payload within the class bytes
+  U32 Length;
+};
+static_assert(sizeof(attributeRecord) == 12);
+
+template <typename T>
+static T load(const U8* bytes)
+{
+  T value;
+  std::memcpy(&value, bytes, sizeof(T));
+  return value;
+}
+
+static U16 readBE16(const U8* bytes)
+{
+  return static_cast<U16>((bytes[0] << 8) | bytes[1]);
+}
+
+static U32 readBE32(const U8* bytes)
+{
+  return (U32{bytes[0]} << 24) | (U32{bytes[1]} << 16) | (U32{bytes[2]} << 8) | U32{bytes[3]};
+}
+
+//AttributeView
+
+U16 AttributeView::GetNameIndex() const
+{
+  return load<attributeRecord>(m_record).NameIndex;
+}
+
+const U8* AttributeView::GetBytes() const
+{
+  return m_classBytes + load<attributeRecord>(m_record).Offset;
+}
+
+U32 AttributeView::GetLength() const
+{
+  return load<attributeRecord>(m_record).Length;
+}
+
+//MemberView
+
+ClassView MemberView::getClass() const
+{
+  return ClassView{m_base, m_class};
+}
+
+U16 MemberView::GetAccessFlags() const
+{
+  return load<memberRecord>(m_record).AccessFlags;
+}
+
+U16 MemberView::GetNameIndex() const
+{
+  return load<memberRecord>(m_record).NameIndex;
+}
+
+U16 MemberView::GetDescriptorIndex() const
+{
+  return load<memberRecord>(m_record).DescriptorIndex;
+}
+
+std::string_view MemberView::GetName() const
+{
+  return getClass().GetUTF8(GetNameIndex());
+}
+
+std::string_view MemberView::GetDescriptor() const
+{
+  return getClass().GetUTF8(GetDescriptorIndex());
+}
+
+U16 MemberView::GetAttributeCount() const
+{
+  return load<memberRecord>(m_record).AttributeCount;
+}
+
+AttributeView MemberView::GetAttribute(U16 index) const
+{
+  assert(index < GetAttributeCount());
+
+  classRecord cls = load<classRecord>(m_class);
+  U32 attribute = load<memberRecord>(m_record).FirstAttribute + index;
+
+  return AttributeView{m_base + cls.BytesOffset,
+    m_base + cls.AttributesOffset + attribute * sizeof(attributeRecord)};
+}
+
+const U8* MemberView::GetCode() const
+{
+  memberRecord member = load<memberRecord>(m_record);
+
+  if(member.CodeAttribute == noAttribute)
+    return nullptr;
+
+  classRecord cls = load<classRecord>(m_class);
+  attributeRecord code = load<attributeRecord>(m_base + cls.AttributesOffset +
+      member.CodeAttribute * sizeof(attributeRecord));
+
+  //max_stack (2), max_locals (2), code_length (4), code[]
+  return m_base + cls.BytesOffset + code.Offset + 8;
+}
+
+U32 MemberView::GetCodeLength() const
+{
+  const U8* code = GetCode();
+  return code ? readBE32(code - 4) : 0;
+}
+
+//ClassView
+
+ClassView::ClassView(const U8* base, const U8* record)
+  : m_base{base}, m_record{record}, m_bytes{base + load<classRecord>(record).BytesOffset} {}
+
+U16 ClassView::GetMinorVersion() const { return load<classRecord>(m_record).MinorVersion; }
+U16 ClassView::GetMajorVersion() const { return load<classRecord>(m_record).MajorVersion; }
+U16 ClassView::GetAccessFlags() const  { return load<classRecord>(m_record).AccessFlags;  }
+U16 ClassView::GetThisClass() const    { return load<classRecord>(m_record).ThisClass;    }
+U16 ClassView::GetSuperClass() const   { return load<classRecord>(m_record).SuperClass;   }
+
+std::string_view ClassView::GetName() const
+{
+  return GetUTF8(GetThisClass());
+}
+
+std::string_view ClassView::GetSuperName() const
+{
+  return GetUTF8(GetSuperClass());
+}
+
+U16 ClassView::GetConstCount() const
+{
+  return load<classRecord>(m_record).ConstCount;
+}
+
+static U32 getConstOffset(const U8* base, const classRecord& cls, U16 index)
+{
+  if(index == 0 || index >= cls.ConstCount)
+    return 0;
+
+  return load<U32>(base + cls.ConstOffsetsOffset + index * sizeof(U32));
+}
+
+U8 ClassView::GetTag(U16 index) const
+{
+  U32 offset = getConstOffset(m_base, load<classRecord>(m_record), index);
+  return offset == 0 ? 0 : m_bytes[offset];
+}
+
+U16 ClassView::GetConstField(U16 index, size_t n) const
+{
+  U32 offset = getConstOffset(m_base, load<classRecord>(m_record), index);
+  assert(offset != 0);
+
+  return readBE16(m_bytes + offset + 1 + 2*n);
+}
+
+std::string_view ClassView::GetUTF8(U16 index) const
+{
+  switch(GetTag(index))
+  {
+    case static_cast<U8>(CPInfo::Type::UTF8):
+    {
+      U32 offset = getConstOffset(m_base, load<classRecord>(m_record), index);
+      return {reinterpret_cast<const char*>(m_bytes + offset + 3), readBE16(m_bytes + offset + 1)};
+    }
+
+    case static_cast<U8>(CPInfo::Type::Class):
+    case static_cast<U8>(CPInfo::Type::String):
+    case static_cast<U8>(CPInfo::Type::MethodType):
+    {
+      U16 utf8 = GetConstField(index, 0);
+
+      if(GetTag(utf8) != static_cast<U8>(CPInfo::Type::UTF8))
+        return {};
+
+      return GetUTF8(utf8);
+    }
+
+    default: break;
+  }
+
+  return {};
+}
+
+U16 ClassView::GetInterfaceCount() const
+{
+  return load<classRecord>(m_record).InterfaceCount;
+}
+
+U16 ClassView::GetInterface(U16 index) const
+{
+  assert(index < GetInterfaceCount());
+  return readBE16(m_bytes + load<classRecord>(m_record).InterfacesOffset + 2*index);
+}
+
+U16 ClassView::GetFieldCount() const
+{
+  return load<classRecord>(m_record).FieldCount;
+}
+
+U16 ClassView::GetMethodCount() const
+{
+  return load<classRecord>(m_record).MethodCount;
+}
+
+MemberView ClassView::GetField(U16 index) const
+{
+  assert(index < GetFieldCount());
+  return MemberView{m_base, m_record, m_base + load<classRecord>(m_record).MembersOffset +
+    index * sizeof(memberRecord)};
+}
+
+MemberView ClassView::GetMethod(U16 index) const
+{
+  assert(index < GetMethodCount());
+  classRecord cls = load<classRecord>(m_record);
+  return MemberView{m_base, m_record, m_base + cls.MembersOffset +
+    (cls.FieldCount + index) * sizeof(memberRecord)};
+}
+
+U16 ClassView::GetAttributeCount() const
+{
+  return load<classRecord>(m_record).ClassAttributeCount;
+}
+
+AttributeView ClassView::GetAttribute(U16 index) const
+{
+  assert(index < GetAttributeCount());
+  classRecord cls = load<classRecord>(m_record);
+  return AttributeView{m_bytes, m_base + cls.AttributesOffset +
+    (cls.FirstClassAttribute + index) * sizeof(attributeRecord)};
+}
+
+const U8* ClassView::GetBytes() const
+{
+  return m_bytes;
+}
+
+U32 ClassView::GetLength() const
+{
+  return load<classRecord>(m_record).BytesLength;
+}
+
+//read only streambuf over memory, so the class can be parsed without a copy
+struct memoryBuf : public std::streambuf
+{
+  memoryBuf(const U8* bytes, size_t len)
+  {
+    char* begin = const_cast<char*>(reinterpret_cast<const char*>(bytes));
+    setg(begin, begin, begin + len);
+  }
+
+  //the parser measures what it consumed through tellg()
+  pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode) override
+  {
+    char* base = dir == std::ios_base::beg ? eback() :
+                 dir == std::ios_base::cur ? gptr()  : egptr();
+
+    if(base + off < eback() || base + off > egptr())
+      return pos_type(off_type(-1));
+
+    setg(eback(), base + off, egptr());
+    return pos_type(gptr() - eback());
+  }
+
+  pos_type seekpos(pos_type pos, std::ios_base::openmode mode) override
+  {
+    return seekoff(off_type(pos), std::ios_base::beg, mode);
+  }
+};
+
+ErrorOr<ClassFile> ClassView::Parse(const Parser::ParseOptions& options) const
+{
+  memoryBuf buf{GetBytes(), GetLength()};
+  std::istream stream{&buf};
+
+  return Parser::ParseClassFile(stream, options);
+}
+
+//Snapshot
+
+struct Snapshot::storage
+{
+  const U8* Data{nullptr};
+  size_t Size{0};
+
+  bool Mapped{false};
+  std::vector<U8> Buffer;
+
+  ~storage()
+  {
+#if SNAPSHOT_USE_MMAP
+    if(Mapped)
+      munmap(const_cast<U8*>(Data), Size);
+#endif
+  }
+};
+
+ErrorOr<Snapshot> Snapshot::Open(const std::string& path)
+{
+  auto storage = std::make_shared<Snapshot::storage>();
+
+#if SNAPSHOT_USE_MMAP
+  int fd = open(path.c_str(), O_RDONLY);
+
+  if(fd < 0)
+    return Error{fmt::format("Snapshot::Open(): unable to open \"{}\"", path)};
+
+  struct stat st;
+  if(fstat(fd, &st) == 0 && st.st_size > 0)
+  {
+    void* data = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if(data != MAP_FAILED)
+    {
+      storage->Data = static_cast<const U8*>(data);
+      storage->Size = static_cast<size_t>(st.st_size);
+      storage->Mapped = true;
+    }
+  }
+
+  close(fd);
+#endif
+
+  if(!storage->Mapped)
+  {
+    auto errOrBytes = Classpath::ReadFile(path);
+    VERIFY(errOrBytes);
+
+    storage->Buffer = errOrBytes.Release();
+    storage->Data = storage->Buffer.data();
+    storage->Size = storage->Buffer.size();
+  }
+
+  Snapshot snapshot;
+  snapshot.m_base = storage->Data;
+  snapshot.m_size = storage->Size;
+  snapshot.m_storage = std::move(storage);
+
+  auto errOrValid = snapshot.validate();
+  if(errOrValid.IsError())
+  {
+    return Error{fmt::format("Snapshot::Open(): \"{}\" is not a valid snapshot:"
+        "\n  {}", path, errOrValid.GetError().What)};
+  }
+
+  return snapshot;
+}
+
+//size of a constant including its tag
+static size_t getConstSize(const U8* constant)
+{
+  switch(constant[0])
+  {
+    case static_cast<U8>(CPInfo::Type::UTF8):
+      return 3 + size_t{readBE16(constant + 1)};
+
+    case static_cast<U8>(CPInfo::Type::Long):
+    case static_cast<U8>(CPInfo::Type::Double):
+      return 9;
+
+    case static_cast<U8>(CPInfo::Type::MethodHandle):
+      return 4;
+
+    case static_cast<U8>(CPInfo::Type::Class):
+    case static_cast<U8>(CPInfo::Type::String):
+    case static_cast<U8>(CPInfo::Type::MethodType):
+    case 19: case 20: //Module & Package
+      return 3;
+  }
+
+  return 5;
+}
+
+static bool inBounds(size_t offset, size_t len, size_t size)
+{
+  return offset <= size && len <= size - offset;
+}
+
+ErrorOr<void> Snapshot::validate() const
+{
+  if(m_size < sizeof(fileHeader))
+    return Error{"file is too small"};
+
+  fileHeader header = load<fileHeader>(m_base);
+
+  if(std::memcmp(header.Magic, snapshotMagic, sizeof(snapshotMagic)) != 0)
+    return Error{"bad magic"};
+
+  if(header.ByteOrderMark != byteOrderMark)
+    return Error{"written by a host of a different byte order"};
+
+  if(header.Version != Version)
+    return Error{fmt::format("version {} isn't supported", header.Version)};
+
+  if(header.FileSize != m_size)
+    return Error{fmt::format("expected {} bytes, file has {}", header.FileSize, m_size)};
+
+  size_t tableLen = size_t{header.ClassCount} * sizeof(U32);
+
+  if(!inBounds(header.ClassTableOffset, tableLen, m_size) ||
+     !inBounds(header.NameTableOffset, tableLen, m_size))
+  {
+    return Error{"class tables are out of bounds"};
+  }
+
+  for(U32 i = 0; i < header.ClassCount; i++)
+  {
+    if(load<U32>(m_base + header.NameTableOffset + i * sizeof(U32)) >= header.ClassCount)
+      return Error{fmt::format("name table entry {} is out of bounds", i)};
+
+    U32 recordOffset = load<U32>(m_base + header.ClassTableOffset + i * sizeof(U32));
+
+    if(!inBounds(recordOffset, sizeof(classRecord), m_size))
+      return Error{fmt::format("record of class {} is out of bounds", i)};
+
+    classRecord cls = load<classRecord>(m_base + recordOffset);
+    size_t nMembers = size_t{cls.FieldCount} + cls.MethodCount;
+
+    bool valid =
+      inBounds(cls.BytesOffset, cls.BytesLength, m_size) &&
+      inBounds(cls.ConstOffsetsOffset, cls.ConstCount * sizeof(U32), m_size) &&
+      inBounds(cls.MembersOffset, nMembers * sizeof(memberRecord), m_size) &&
+      inBounds(cls.AttributesOffset, size_t{cls.AttributeTotal} * sizeof(attributeRecord), m_size) &&
+      inBounds(cls.InterfacesOffset, cls.InterfaceCount * size_t{2}, cls.BytesLength) &&
+      size_t{cls.FirstClassAttribute} + cls.ClassAttributeCount <= cls.AttributeTotal;
+
+    if(!valid)
+      return Error{fmt::format("tables of class {} are out of bounds", i)};
+
+    const U8* bytes = m_base + cls.BytesOffset;
+
+    for(U16 c = 1; c < cls.ConstCount; c++)
+    {
+      U32 offset = load<U32>(m_base + cls.ConstOffsetsOffset + c * sizeof(U32));
+
+      bool validConst = offset == 0 || (inBounds(offset, 3, cls.BytesLength) &&
+        inBounds(offset, getConstSize(bytes + offset), cls.BytesLength));
+
+      if(!validConst)
+        return Error{fmt::format("constant #{} of class {} is out of bounds", c, i)};
+    }
+
+    for(U32 a = 0; a < cls.AttributeTotal; a++)
+    {
+      attributeRecord attr = load<attributeRecord>(m_base + cls.AttributesOffset +
+          a * sizeof(attributeRecord));
+
+      if(!inBounds(attr.Offset, attr.Length, cls.BytesLength))
+        return Error{fmt::format("attribute {} of class {} is out of bounds", a, i)};
+    }
+
+    for(size_t m = 0; m < nMembers; m++)
+    {
+      memberRecord member = load<memberRecord>(m_base + cls.MembersOffset +
+          m * sizeof(memberRecord));
+
+      bool validMember =
+        size_t{member.FirstAttribute} + member.AttributeCount <= cls.AttributeTotal &&
+        (member.CodeAttribute == noAttribute || member.CodeAttribute < cls.AttributeTotal);
+
+      if(validMember && member.CodeAttribute != noAttribute)
+      {
+        attributeRecord code = load<attributeRecord>(m_base + cls.AttributesOffset +
+            member.CodeAttribute * sizeof(attributeRecord));
+
+        validMember = code.Length >= 8 &&
+          readBE32(bytes + code.Offset + 4) <= code.Length - 8;
+      }
+
+      if(!validMember)
+        return Error{fmt::format("member {} of class {} is out of bounds", m, i)};
+    }
+  }
+
+  return NoError{};
+}
+
+Fingerprint Snapshot::GetKey() const
+{
+  fileHeader header = load<fileHeader>(m_base);
+  return Fingerprint{header.KeyLow, header.KeyHigh};
+}
+
+U32 Snapshot::GetClassCount() const
+{
+  return load<fileHeader>(m_base).ClassCount;
+}
+
+ClassView Snapshot::GetClass(U32 index) const
+{
+  fileHeader header = load<fileHeader>(m_base);
+  assert(index < header.ClassCount);
+
+  U32 recordOffset = load<U32>(m_base + header.ClassTableOffset + index * sizeof(U32));
+  return ClassView{m_base, m_base + recordOffset};
+}
+
+U32 Snapshot::Find(std::string_view className) const
+{
+  fileHeader header = load<fileHeader>(m_base);
+
+  auto classAt = [&](U32 i)
+  {
+    return load<U32>(m_base + header.NameTableOffset + i * sizeof(U32));
+  };
+
+  U32 first = 0;
+  U32 count = header.ClassCount;
+
+  while(count > 0)
+  {
+    U32 step = count / 2;
+
+    if(GetClass(classAt(first + step)).GetName() < className)
+    {
+      first += step + 1;
+      count -= step + 1;
+    }
+    else
+    {
+      count = step;
+    }
+  }
+
+  if(first < header.ClassCount && GetClass(classAt(first)).GetName() == className)
+    return classAt(first);
+
+  return ~U32{0};
+}
+
+//SnapshotWriter
+
+ErrorOr<void> SnapshotWriter::Add(const U8* classBytes, size_t len)
+{
+  auto errOrSkim = RawClass::SkimClass(classBytes, len);
+  VERIFY(errOrSkim, "failed to skim class");
+
+  auto name = errOrSkim.Get().GetIndirectUTF8(errOrSkim.Get().ThisClass);
+
+  if(!name)
+    return Error{"SnapshotWriter::Add(): this_class isn't a valid Class constant"};
+
+  m_names.emplace_back(*name);
+  m_classes.emplace_back(classBytes, classBytes + len);
+  return NoError{};
+}
+
+ErrorOr<void> SnapshotWriter::Add(const ClassFile& cf)
+{
+  std::stringstream ss;
+  TRY(Serializer::SerializeClassFile(ss, cf));
+
+  std::string bytes = ss.str();
+  return Add(reinterpret_cast<const U8*>(bytes.data()), bytes.size());
+}
+
+size_t SnapshotWriter::GetClassCount() const
+{
+  return m_classes.size();
+}
+
+static size_t align4(size_t n)
+{
+  return (n + 3) & ~size_t{3};
+}
+
+template <typename T>
+static void append(std::vector<U8>& out, const T& value)
+{
+  const U8* bytes = reinterpret_cast<const U8*>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+//Creates an empty file in the directory of path under a name no other
+//writer uses, so threads & processes writing the same snapshot each fill
+//their own file and the last rename wins
+static ErrorOr<std::string> createTempFile(const std::string& path)
+{
+  static std::atomic<U32> counter{0};
+  std::random_device random;
+
+#if SNAPSHOT_USE_MMAP
+  unsigned long pid = static_cast<unsigned long>(getpid());
+#else
+  unsigned long pid = 0;
+#endif
+
+  for(int attempt = 0; attempt < 16; attempt++)
+  {
+    std::string tmpPath = fmt::format("{}.{:x}.{:x}{:08x}.tmp", path, pid,
+        counter.fetch_add(1, std::memory_order_relaxed), random());
+
+#if SNAPSHOT_USE_MMAP
+    int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+
+    if(fd >= 0)
+    {
+      close(fd);
+      return tmpPath;
+    }
+
+    if(errno != EEXIST)
+      break;
+#else
+    std::error_code ec;
+
+    if(!std::filesystem::exists(tmpPath, ec) && std::ofstream{tmpPath, std::ios::binary}.good())
+      return tmpPath;
+#endif
+  }
+
+  return Error{fmt::format("SnapshotWriter::Write(): unable to create a "
+      "temporary file for \"{}\"", path)};
+}
+
+//Removes the temporary file unless it was moved into place
+struct tempFile
+{
+  std::string Path;
+  bool Moved{false};
+
+  ~tempFile()
+  {
+    std::error_code ec;
+
+    if(!Moved)
+      std::filesystem::remove(Path, ec);
+  }
+};
+
+ErrorOr<void> SnapshotWriter::Write(const std::string& path, const Fingerprint& key) const
+{
+  U32 nClasses = static_cast<U32>(m_classes.size());
+
+  fileHeader header{};
+  std::memcpy(header.Magic, snapshotMagic, sizeof(snapshotMagic));
+  header.Version = Snapshot::Version;
+  header.ByteOrderMark = byteOrderMark;
+  header.KeyLow = key.Low;
+  header.KeyHigh = key.High;
+  header.ClassCount = nClasses;
+  header.ClassTableOffset = sizeof(fileHeader);
+  header.NameTableOffset = header.ClassTableOffset + nClasses * sizeof(U32);
+
+  std::vector<U32> nameTable(nClasses);
+  std::iota(nameTable.begin(), nameTable.end(), 0);
+  std::sort(nameTable.begin(), nameTable.end(), [&](U32 a, U32 b){ return m_names[a] < m_names[b]; });
+
+  //the tables of each class are built in memory, one class at a time, and
+  //only their offsets are kept until the file header is written
+  auto errOrTmpPath = createTempFile(path);
+  VERIFY(errOrTmpPath);
+
+  tempFile tmp{errOrTmpPath.Release()};
+  const std::string& tmpPath = tmp.Path;
+  std::ofstream stream{tmpPath, std::ios::binary | std::ios::trunc};
+
+  if(!stream.good())
+    return Error{fmt::format("SnapshotWriter::Write(): unable to create \"{}\"", tmpPath)};
+
+  size_t offset = header.NameTableOffset + nClasses * sizeof(U32);
+  std::vector<U32> classTable(nClasses);
+
+  //header & tables are written last, reserve their space
+  stream.seekp(static_cast<std::streamoff>(offset));
+
+  std::vector<U8> block;
+
+  for(U32 i = 0; i < nClasses; i++)
+  {
+    const std::vector<U8>& bytes = m_classes[i];
+
+    auto errOrSkim = RawClass::SkimClass(bytes.data(), bytes.size());
+    VERIFY(errOrSkim);
+    const RawClass::Skim& skim = errOrSkim.Get();
+
+    U16 codeName = skim.FindUTF8("Code");
+
+    classRecord cls{};
+    cls.MinorVersion = skim.MinorVersion;
+    cls.MajorVersion = skim.MajorVersion;
+    cls.AccessFlags = skim.AccessFlags;
+    cls.ThisClass = skim.ThisClass;
+    cls.SuperClass = skim.SuperClass;
+    cls.ConstCount = skim.GetConstCount();
+    cls.FieldCount = static_cast<U16>(skim.Fields.size());
+    cls.MethodCount = static_cast<U16>(skim.Methods.size());
+    cls.AttributeTotal = static_cast<U32>(skim.Attributes.size());
+    cls.FirstClassAttribute = skim.FirstClassAttribute;
+    cls.ClassAttributeCount = static_cast<U16>(skim.Attributes.size() - skim.FirstClassAttribute);
+
+    cls.InterfaceCount = skim.InterfaceCount;
+    cls.InterfacesOffset = skim.InterfacesOffset;
+
+    size_t recordOffset = offset;
+    cls.ConstOffsetsOffset = static_cast<U32>(recordOffset + sizeof(classRecord));
+    cls.MembersOffset = static_cast<U32>(cls.ConstOffsetsOffset + cls.ConstCount * sizeof(U32));
+    cls.AttributesOffset = static_cast<U32>(cls.MembersOffset +
+        (skim.Fields.size() + skim.Methods.size()) * sizeof(memberRecord));
+    cls.BytesOffset = static_cast<U32>(cls.AttributesOffset +
+        skim.Attributes.size() * sizeof(attributeRecord));
+    cls.BytesLength = static_cast<U32>(bytes.size());
+
+    block.clear();
+    append(block, cls);
+
+    for(U32 constOffset : skim.ConstOffsets)
+      append(block, constOffset);
+
+    for(const auto* members : {&skim.Fields, &skim.Methods})
+    {
+      for(const RawClass::Member& m : *members)
+      {
+        memberRecord member{};
+        member.AccessFlags = m.AccessFlags;
+        member.NameIndex = m.NameIndex;
+        member.DescriptorIndex = m.DescriptorIndex;
+        member.FirstAttribute = m.FirstAttribute;
+        member.AttributeCount = static_cast<U16>(m.LastAttribute - m.FirstAttribute);
+        member.CodeAttribute = noAttribute;
+
+        for(U32 a = m.FirstAttribute; a < m.LastAttribute && codeName != 0; a++)
+        {
+          if(skim.Attributes[a].NameIndex == codeName)
+            member.CodeAttribute = a;
+        }
+
+        append(block, member);
+      }
+    }
+
+    for(const RawClass::Attribute& a : skim.Attributes)
+      append(block, attributeRecord{a.NameIndex, 0, a.Offset, a.Length});
+
+    block.insert(block.end(), bytes.begin(), bytes.end());
+    block.resize(align4(block.size()), 0);
+
+    stream.write(reinterpret_cast<const char*>(block.data()),
+        static_cast<std::streamsize>(block.size()));
+
+    classTable[i] = static_cast<U32>(recordOffset);
+    offset += block.size();
+
+    if(offset > ~U32{0})
+      return Error{"SnapshotWriter::Write(): snapshot exceeds 4GiB"};
+  }
+
+  header.FileSize = offset;
+
+  stream.seekp(0);
+  stream.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  stream.write(reinterpret_cast<const char*>(classTable.data()),
+      static_cast<std::streamsize>(classTable.size() * sizeof(U32)));
+  stream.write(reinterpret_cast<const char*>(nameTable.data()),
+      static_cast<std::streamsize>(nameTable.size() * sizeof(U32)));
+  stream.close();
+
+  if(!stream.good())
+    return Error{fmt::format("SnapshotWriter::Write(): failed to write \"{}\"", tmpPath)};
+
+  std::error_code ec;
+  std::filesystem::rename(tmpPath, path, ec);
+
+  if(ec)
+  {
+    return Error{fmt::format("SnapshotWriter::Write(): failed to move \"{}\" to "
+        "\"{}\": {}", tmpPath, path, ec.message())};
+  }
+
+  tmp.Moved = true;
+  return NoError{};
+}
+
+//SnapshotCache
+
+SnapshotCache::SnapshotCache(std::string directory) : m_directory{std::move(directory)} {}
+
+ErrorOr<Fingerprint> SnapshotCache::HashFiles(const std::vector<std::string>& paths)
+{
+  Hasher128 hasher;
+  hasher.Update(static_cast<U64>(paths.size()));
+
+  for(const std::string& path : paths)
+  {
+    auto errOrBytes = Classpath::ReadFile(path);
+    VERIFY(errOrBytes);
+
+    hasher.Update(static_cast<U64>(errOrBytes.Get().size()));
+    hasher.Update(errOrBytes.Get().data(), errOrBytes.Get().size());
+  }
+
+  auto [low, high] = hasher.Finish();
+  return Fingerprint{low, high};
+}
+
+std::string SnapshotCache::GetPath(const Fingerprint& key) const
+{
+  return fmt::format("{}/{}.snap", m_directory, key.ToString());
+}
+
+ErrorOr<Snapshot> SnapshotCache::Load(const Fingerprint& key) const
+{
+  auto errOrSnapshot = Snapshot::Open(GetPath(key));
+  VERIFY(errOrSnapshot);
+
+  if(errOrSnapshot.Get().GetKey() != key)
+  {
+    return Error{fmt::format("SnapshotCache::Load(): snapshot \"{}\" was written "
+        "with a different key", GetPath(key))};
+  }
+
+  return errOrSnapshot.Release();
+}
+
+ErrorOr<Snapshot> SnapshotCache::Store(const Fingerprint& key, const SnapshotWriter& writer) const
+{
+  std::error_code ec;
+  std::filesystem::create_directories(m_directory, ec);
+
+  if(ec)
+  {
+    return Error{fmt::format("SnapshotCache::Store(): unable to create \"{}\": {}",
+        m_directory, ec.message())};
+  }
+
+  TRY(writer.Write(GetPath(key), key));
+  return Load(key);
+}
+
+ErrorOr<Snapshot> SnapshotCache::LoadOrBuild(const std::vector<std::string>& paths) const
+{
+  auto errOrKey = HashFiles(paths);
+  VERIFY(errOrKey);
+
+  auto errOrSnapshot = Load(errOrKey.Get());
+
+  if(!errOrSnapshot.IsError())
+    return errOrSnapshot.Release();
+
+  SnapshotWriter writer;
+
+  for(const std::string& path : paths)
+  {
+    auto errOrBytes = Classpath::ReadFile(path);
+    VERIFY(errOrBytes);
+
+    auto errOrAdded = writer.Add(errOrBytes.Get().data(), errOrBytes.Get().size());
+    if(errOrAdded.IsError())
+    {
+      return Error{fmt::format("SnapshotCache::LoadOrBuild(): failed to add "
+          "\"{}\":\n  {}", path, errOrAdded.GetError().What)};
+    }
+  }
+
+  return Store(errOrKey.Get(), writer);
+}
+
+} //namespace ClassFile
@@ -0,0 +1,123 @@
+#include "ClassFile/SymbolTable.hpp"
+
+#include <functional>
+#include <cstring>
+#include <new>
+
+namespace ClassFile
+{
+
+static size_t roundUpToPowerOf2(size_t n)
+{
+  size_t pow2 = 1;
+  while(pow2 < n)
+    pow2 <<= 1;
+
+  return pow2;
+}
+
+SymbolTable::SymbolTable(size_t bucketCount)
+{
+  size_t n = roundUpToPowerOf2(bucketCount > 0 ? bucketCount : 1);
+
+  m_buckets = std::make_unique< std::atomic<const Symbol*>[] >(n);
+  m_mask = n - 1;
+
+  for(size_t i = 0; i < n; i++)
+    m_buckets[i].store(nullptr, std::memory_order_relaxed);
+}
+
+SymbolTable::~SymbolTable()
+{
+  for(size_t i = 0; i <= m_mask; i++)
+  {
+    const Symbol* sym = m_buckets[i].load(std::memory_order_relaxed);
+
+    while(sym)
+    {
+      const Symbol* next = sym->m_next;
+      sym->~Symbol();
+      ::operator delete(const_cast<Symbol*>(sym));
+      sym = next;
+    }
+  }
+}
+
+const Symbol* SymbolTable::findInChain(const Symbol* head, const Symbol* end, 
+    std::string_view string, size_t hash) const
+{
+  for(const Symbol* sym = head; sym != end; sym = sym->m_next)
+  {
+    if(sym->m_hash == hash && sym->GetString() == string)
+      return sym;
+  }
+
+  return nullptr;
+}
+
+const Symbol* SymbolTable::Find(std::string_view string) const
+{
+  size_t hash = std::hash<std::string_view>{}(string);
+  const Symbol* head = m_buckets[hash & m_mask].load(std::memory_order_acquire);
+
+  return findInChain(head, nullptr, string, hash);
+}
+
+const Symbol* SymbolTable::Intern(std::string_view string)
+{
+  size_t hash = std::hash<std::string_view>{}(string);
+  std::atomic<const Symbol*>& bucket = m_buckets[hash & m_mask];
+
+  const Symbol* head = bucket.load(std::memory_order_acquire);
+
+  if(const Symbol* existing = findInChain(head, nullptr, string, hash))
+    return existing;
+
+  size_t size = sizeof(Symbol) + string.size();
+  void* memory = ::operator new(size);
+
+  Symbol* sym = new (memory) Symbol{hash, string.size()};
+  if(!string.empty())
+    std::memcpy(static_cast<char*>(memory) + sizeof(Symbol), string.data(), string.size());
+
+  while(true)
+  {
+    sym->m_next = head;
+
+    //publishes sym, release makes its contents visible to acquiring readers
+    if(bucket.compare_exchange_weak(head, sym, 
+          std::memory_order_release, std::memory_order_acquire))
+    {
+      m_count.fetch_add(1, std::memory_order_relaxed);
+      m_memoryUsage.fetch_add(size, std::memory_order_relaxed);
+      return sym;
+    }
+
+    //head now holds the current bucket head, only the symbols inserted 
+    //since the last attempt (the ones in front of the old head) are new
+    if(const Symbol* existing = findInChain(head, sym->m_next, string, hash))
+    {
+      sym->~Symbol();
+      ::operator delete(memory);
+      return existing;
+    }
+  }
+}
+
+size_t SymbolTable::GetCount() const
+{
+  return m_count.load(std::memory_order_relaxed);
+}
+
+size_t SymbolTable::GetMemoryUsage() const
+{
+  return m_memoryUsage.load(std::memory_order_relaxed);
+}
+
+SymbolTable& SymbolTable::Global()
+{
+  static SymbolTable table{1 << 18};
+  return table;
+}
+
+} //namespace ClassFile
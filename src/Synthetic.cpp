@@ -0,0 +1,569 @@
+#include "ClassFile/Synthetic.hpp"
+
+#include <fmt/core.h>
+
+#include "ClassFile/Serializer.hpp"
+#include "Util/Error.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <type_traits>
+
+namespace ClassFile
+{
+
+//splitmix64, small & good enough to make the generated classes look varied
+class splitMix
+{
+  public:
+    explicit splitMix(U64 seed) : m_state{seed} {}
+
+    U64 Next()
+    {
+      U64 z = (m_state += 0x9E3779B97F4A7C15ull);
+      z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+      z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+      return z ^ (z >> 31);
+    }
+
+    //uniform enough in [0, n)
+    U32 Below(U32 n) { return static_cast<U32>(Next() % n); }
+
+  private:
+    U64 m_state;
+};
+
+static constexpr std::string_view fieldDescriptors[] =
+{
+  "I", "J", "D", "Z", "Ljava/lang/String;", "[I", "[[Ljava/lang/Object;",
+  "Ljava/util/Map;",
+};
+
+static void writeU16(std::vector<U8>& out, U16 value)
+{
+  out.push_back(static_cast<U8>(value >> 8));
+  out.push_back(static_cast<U8>(value));
+}
+
+static ErrorOr<Instruction> makeInstruction(OpCode op, std::initializer_list<S32> operands = {},
+    bool wide = false)
+{
+  auto errOrInstr = Instruction::MakeInstruction(op, wide);
+  VERIFY(errOrInstr);
+
+  size_t i = 0;
+  for(S32 operand : operands)
+    TRY(errOrInstr.Get().SetOperand(i++, operand));
+
+  return errOrInstr.Release();
+}
+
+template <typename AttributeT>
+static std::unique_ptr<AttributeT> makeAttribute(ConstantPool& cp, std::string_view name)
+{
+  std::unique_ptr<AttributeT> attr;
+
+  if constexpr(std::is_constructible_v<AttributeT, std::pmr::memory_resource*>)
+    attr = std::make_unique<AttributeT>(cp.GetResource());
+  else
+    attr = std::make_unique<AttributeT>();
+
+  attr->NameIndex = cp.FindOrAddUTF8(name).Get();
+  return attr;
+}
+
+static ErrorOr<std::unique_ptr<RawAttribute>> makeRawAttribute(ConstantPool& cp,
+    std::string_view name, std::vector<U8> bytes)
+{
+  auto errOrName = cp.FindOrAddUTF8(name);
+  VERIFY(errOrName);
+
+  auto attr = std::make_unique<RawAttribute>(cp.GetResource());
+  attr->NameIndex = errOrName.Get();
+  attr->Bytes.assign(bytes.begin(), bytes.end());
+  return attr;
+}
+
+//Straight line code of exactly length bytes. Locals 0-7 are ints, set up
+//front, after that every unit leaves the stack as it found it.
+static ErrorOr<void> generateCode(ConstantPool& cp, splitMix& rng, CodeAttribute& code, U32 length)
+{
+  std::pmr::vector<Instruction>& out = code.Code;
+  U32 pc = 0;
+
+  auto emit = [&](OpCode op, std::initializer_list<S32> operands = {}) -> ErrorOr<void>
+  {
+    auto errOrInstr = makeInstruction(op, operands);
+    VERIFY(errOrInstr);
+
+    pc += static_cast<U32>(errOrInstr.Get().GetLength());
+    out.push_back(errOrInstr.Release());
+    return NoError{};
+  };
+
+  for(S32 local = 0; local < 8; local++)
+  {
+    TRY(emit(ICONST_0));
+    TRY(local < 4 ? emit(static_cast<OpCode>(ISTORE_0 + local)) : emit(ISTORE, {local}));
+  }
+
+  //the longest unit is 7 bytes, the rest is padded with nops before return
+  while(pc + 7 < length - 1)
+  {
+    auto local = [&]() { return static_cast<S32>(rng.Below(8)); };
+
+    switch(rng.Below(7))
+    {
+      case 0:
+        TRY(emit(BIPUSH, {static_cast<S8>(rng.Below(256))}));
+        TRY(emit(ISTORE, {local()}));
+        break;
+
+      case 1:
+        TRY(emit(ILOAD, {local()}));
+        TRY(emit(ILOAD, {local()}));
+        TRY(emit(static_cast<OpCode>(IADD + 4 * rng.Below(3)))); //iadd, isub, imul
+        TRY(emit(POP));
+        break;
+
+      case 2:
+      {
+        auto errOrString = cp.FindOrAddString(fmt::format("s{}", rng.Below(4096)));
+        VERIFY(errOrString);
+        TRY(emit(LDC_W, {errOrString.Get()}));
+        TRY(emit(POP));
+        break;
+      }
+
+      case 3:
+        TRY(emit(IINC, {local(), static_cast<S8>(rng.Below(256))}));
+        break;
+
+      case 4:
+        TRY(emit(SIPUSH, {static_cast<S16>(rng.Below(65536))}));
+        TRY(emit(I2L));
+        TRY(emit(POP2));
+        break;
+
+      case 5:
+        //a branch to the next instruction
+        TRY(emit(ILOAD, {local()}));
+        TRY(emit(static_cast<OpCode>(IFEQ + rng.Below(6)), {3}));
+        break;
+
+      case 6:
+      {
+        auto errOrLong = cp.FindOrAddLong(0, static_cast<U32>(rng.Below(1024)));
+        VERIFY(errOrLong);
+        TRY(emit(LDC2_W, {errOrLong.Get()}));
+        TRY(emit(POP2));
+        break;
+      }
+    }
+  }
+
+  while(pc < length - 1)
+    TRY(emit(NOP));
+
+  TRY(emit(RETURN));
+
+  code.MaxStack = 4;
+  code.MaxLocals = 8;
+  return NoError{};
+}
+
+//One of each opcode that isn't complex, branches jumping to the next
+//instruction & operands referring to fitting constants
+static ErrorOr<void> generateAllOpCodes(ClassFile& cf, CodeAttribute& code)
+{
+  ConstantPool& cp = cf.ConstPool;
+
+  auto errOrInteger = cp.FindOrAddInteger(42);
+  VERIFY(errOrInteger);
+  auto errOrString = cp.FindOrAddString("synthetic");
+  VERIFY(errOrString);
+  auto errOrLong = cp.FindOrAddLong(0, 42);
+  VERIFY(errOrLong);
+  auto errOrClass = cp.FindOrAddClass("java/lang/Object");
+  VERIFY(errOrClass);
+  auto errOrArrayClass = cp.FindOrAddClass("[[I");
+  VERIFY(errOrArrayClass);
+  auto errOrField = cp.FindOrAddFieldref("synthetic/Other", "field", "I");
+  VERIFY(errOrField);
+  auto errOrMethod = cp.FindOrAddMethodref("synthetic/Other", "method", "()V");
+  VERIFY(errOrMethod);
+  auto errOrInterfaceMethod = cp.FindOrAddInterfaceMethodref("synthetic/Interface", "method", "()V");
+  VERIFY(errOrInterfaceMethod);
+
+  //invokedynamic needs a bootstrap method to refer to
+  auto errOrHandle = cp.FindOrAddMethodHandle(6, errOrMethod.Get()); //REF_invokeStatic
+  VERIFY(errOrHandle);
+  auto errOrIndy = cp.FindOrAddInvokeDynamic(0, "dynamic", "()V");
+  VERIFY(errOrIndy);
+
+  std::vector<U8> bootstrapMethods;
+  writeU16(bootstrapMethods, 1);
+  writeU16(bootstrapMethods, errOrHandle.Get());
+  writeU16(bootstrapMethods, 0);
+
+  auto errOrBootstrap = makeRawAttribute(cp, "BootstrapMethods", std::move(bootstrapMethods));
+  VERIFY(errOrBootstrap);
+  cf.Attributes.push_back(errOrBootstrap.Release());
+
+  if(errOrInteger.Get() > 0xFF)
+    return Error{"Synthetic::Generate(): the Integer for ldc doesn't fit a byte"};
+
+  std::pmr::vector<Instruction>& out = code.Code;
+
+  for(U32 i = 0; i < WIDE; i++)
+  {
+    OpCode op = static_cast<OpCode>(i);
+
+    if(op == TABLESWITCH || op == LOOKUPSWITCH)
+      continue;
+
+    S32 cpIndex = 0;
+
+    switch(op)
+    {
+      case LDC:             cpIndex = errOrInteger.Get(); break;
+      case LDC_W:           cpIndex = errOrString.Get(); break;
+      case LDC2_W:          cpIndex = errOrLong.Get(); break;
+      case GETSTATIC: case PUTSTATIC: case GETFIELD: case PUTFIELD:
+                            cpIndex = errOrField.Get(); break;
+      case INVOKEVIRTUAL: case INVOKESPECIAL: case INVOKESTATIC:
+                            cpIndex = errOrMethod.Get(); break;
+      case NEW: case ANEWARRAY: case CHECKCAST: case INSTANCEOF:
+                            cpIndex = errOrClass.Get(); break;
+      default: break;
+    }
+
+    auto errOrInstr = makeInstruction(op);
+    VERIFY(errOrInstr);
+    Instruction& instr = errOrInstr.Get();
+
+    if(IsBranch(op))
+    {
+      TRY(instr.SetBranchOffset(static_cast<S32>(instr.GetLength())));
+    }
+    else if(op == INVOKEINTERFACE)
+    {
+      TRY(instr.SetOperand(0, errOrInterfaceMethod.Get()));
+      TRY(instr.SetOperand(1, 1)); //count
+    }
+    else if(op == INVOKEDYNAMIC)
+    {
+      TRY(instr.SetOperand(0, errOrIndy.Get()));
+    }
+    else if(op == NEWARRAY)
+    {
+      TRY(instr.SetOperand(0, 10)); //T_INT
+    }
+    else if(cpIndex != 0)
+    {
+      TRY(instr.SetOperand(0, cpIndex));
+    }
+    else
+    {
+      for(size_t operand = 0; operand < instr.GetNOperands(); operand++)
+        TRY(instr.SetOperand(operand, static_cast<S32>(operand + 1)));
+    }
+
+    out.push_back(errOrInstr.Release());
+  }
+
+  for(OpCode op : {MULTIANEWARRAY, IFNULL, IFNONNULL, GOTO_W, JSR_W})
+  {
+    auto errOrInstr = makeInstruction(op);
+    VERIFY(errOrInstr);
+
+    if(op == MULTIANEWARRAY)
+    {
+      TRY(errOrInstr.Get().SetOperand(0, errOrArrayClass.Get()));
+      TRY(errOrInstr.Get().SetOperand(1, 2)); //dimensions
+    }
+    else
+    {
+      TRY(errOrInstr.Get().SetBranchOffset(static_cast<S32>(errOrInstr.Get().GetLength())));
+    }
+
+    out.push_back(errOrInstr.Release());
+  }
+
+  //the wide forms, with indices that need them
+  for(OpCode op : {ILOAD, LLOAD, FLOAD, DLOAD, ALOAD, ISTORE, LSTORE, FSTORE, DSTORE, ASTORE, RET})
+  {
+    auto errOrInstr = makeInstruction(op, {1000}, true);
+    VERIFY(errOrInstr);
+    out.push_back(errOrInstr.Release());
+  }
+
+  auto errOrIinc = makeInstruction(IINC, {1000, -1000}, true);
+  VERIFY(errOrIinc);
+  out.push_back(errOrIinc.Release());
+
+  auto errOrReturn = makeInstruction(RETURN);
+  VERIFY(errOrReturn);
+  out.push_back(errOrReturn.Release());
+
+  code.MaxStack = 8;
+  code.MaxLocals = 1002;
+  return NoError{};
+}
+
+//RuntimeVisibleAnnotations holding one annotation whose value alternates
+//between a nested annotation & a one element array depth times
+static ErrorOr<std::vector<U8>> generateNestedAnnotation(ConstantPool& cp, splitMix& rng, U32 depth)
+{
+  auto errOrType = cp.FindOrAddUTF8("Lsynthetic/Nested;");
+  VERIFY(errOrType);
+  auto errOrName = cp.FindOrAddUTF8("value");
+  VERIFY(errOrName);
+  auto errOrValue = cp.FindOrAddInteger(static_cast<U32>(rng.Next()));
+  VERIFY(errOrValue);
+
+  std::vector<U8> out;
+  writeU16(out, 1);                //num_annotations
+  writeU16(out, errOrType.Get());
+  writeU16(out, 1);                //num_element_value_pairs
+  writeU16(out, errOrName.Get());
+
+  for(U32 level = 1; level < depth; level++)
+  {
+    if(level % 2 == 1)
+    {
+      out.push_back('@');
+      writeU16(out, errOrType.Get());
+      writeU16(out, 1);
+      writeU16(out, errOrName.Get());
+    }
+    else
+    {
+      out.push_back('[');
+      writeU16(out, 1);            //num_values
+    }
+  }
+
+  out.push_back('I');
+  writeU16(out, errOrValue.Get());
+  return out;
+}
+
+SyntheticOptions Synthetic::GetPreset(Shape shape, U64 seed)
+{
+  SyntheticOptions options;
+  options.Seed = seed;
+
+  switch(shape)
+  {
+    case Shape::MaxConstantPool:
+      options.Name = "synthetic/MaxConstantPool";
+      options.Methods = 16;
+      options.CodeLength = 1024;
+      options.FillConstantPool = true;
+      break;
+
+    case Shape::MaxCode:
+      options.Name = "synthetic/MaxCode";
+      options.Methods = 4;
+      options.CodeLength = 0xFFFF;
+      break;
+
+    case Shape::ManyMembers:
+      options.Name = "synthetic/ManyMembers";
+      options.Fields = 5000;
+      options.Methods = 5000;
+      options.CodeLength = 48;
+      break;
+
+    case Shape::DeepAttributes:
+      options.Name = "synthetic/DeepAttributes";
+      options.Methods = 1;
+      options.AnnotationDepth = 1000;
+      break;
+
+    case Shape::AllOpCodes:
+      options.Name = "synthetic/AllOpCodes";
+      options.AllOpCodes = true;
+      break;
+  }
+
+  return options;
+}
+
+ErrorOr<ClassFile> Synthetic::Generate(const SyntheticOptions& options)
+{
+  if(options.Methods != 0 && (options.CodeLength < 32 || options.CodeLength > 0xFFFF))
+  {
+    return Error{fmt::format("Synthetic::Generate(): code length {} is out of "
+        "range [32, 65535]", options.CodeLength)};
+  }
+
+  if(options.Fields > 0xFFFF || options.Methods + options.AllOpCodes > 0xFFFF)
+    return Error{"Synthetic::Generate(): too many members"};
+
+  splitMix rng{options.Seed};
+
+  ClassFile cf{options.Resource ? options.Resource : std::pmr::get_default_resource()};
+  cf.Magic = 0xCAFEBABE;
+  cf.MinorVersion = 0;
+  //old enough to verify without frames, invokedynamic needs 51
+  cf.MajorVersion = options.AllOpCodes ? 52 : 49;
+  cf.AccessFlags = static_cast<U16>(ClassFile::AccessFlag::PUBLIC) |
+                   static_cast<U16>(ClassFile::AccessFlag::SUPER);
+
+  ConstantPool& cp = cf.ConstPool;
+
+  auto errOrThis = cp.FindOrAddClass(options.Name);
+  VERIFY(errOrThis);
+  cf.ThisClass = errOrThis.Get();
+
+  auto errOrSuper = cp.FindOrAddClass("java/lang/Object");
+  VERIFY(errOrSuper);
+  cf.SuperClass = errOrSuper.Get();
+
+  cf.Fields.reserve(options.Fields);
+
+  for(U32 i = 0; i < options.Fields; i++)
+  {
+    FieldMethodInfo field{cf.ConstPool.GetResource()};
+    std::string_view descriptor = fieldDescriptors[rng.Below(std::size(fieldDescriptors))];
+
+    auto errOrName = cp.FindOrAddUTF8(fmt::format("f{}", i));
+    VERIFY(errOrName);
+    auto errOrDescriptor = cp.FindOrAddUTF8(descriptor);
+    VERIFY(errOrDescriptor);
+
+    field.AccessFlags = static_cast<U16>(FieldMethodInfo::AccessFlag::PRIVATE);
+    field.NameIndex = errOrName.Get();
+    field.DescriptorIndex = errOrDescriptor.Get();
+
+    if(descriptor == "I")
+    {
+      auto errOrValue = cp.FindOrAddInteger(static_cast<U32>(rng.Next()));
+      VERIFY(errOrValue);
+
+      auto value = makeAttribute<ConstantValueAttribute>(cp, "ConstantValue");
+      value->Index = errOrValue.Get();
+
+      field.AccessFlags = static_cast<U16>(FieldMethodInfo::AccessFlag::STATIC) |
+                          static_cast<U16>(FieldMethodInfo::AccessFlag::FINAL);
+      field.Attributes.push_back(std::move(value));
+    }
+
+    cf.Fields.push_back(std::move(field));
+  }
+
+  cf.Methods.reserve(options.Methods + options.AllOpCodes);
+
+  auto addMethod = [&](std::string_view name) -> ErrorOr<CodeAttribute*>
+  {
+    FieldMethodInfo method{cf.ConstPool.GetResource()};
+
+    auto errOrName = cp.FindOrAddUTF8(name);
+    VERIFY(errOrName);
+    auto errOrDescriptor = cp.FindOrAddUTF8("()V");
+    VERIFY(errOrDescriptor);
+
+    method.AccessFlags = static_cast<U16>(FieldMethodInfo::AccessFlag::PUBLIC) |
+                         static_cast<U16>(FieldMethodInfo::AccessFlag::STATIC);
+    method.NameIndex = errOrName.Get();
+    method.DescriptorIndex = errOrDescriptor.Get();
+
+    auto code = makeAttribute<CodeAttribute>(cp, "Code");
+    CodeAttribute* ref = code.get();
+
+    method.Attributes.push_back(std::move(code));
+    cf.Methods.push_back(std::move(method));
+    return ref;
+  };
+
+  for(U32 i = 0; i < options.Methods; i++)
+  {
+    auto errOrCode = addMethod(fmt::format("m{}", i));
+    VERIFY(errOrCode);
+    TRY(generateCode(cp, rng, *errOrCode.Get(), options.CodeLength));
+  }
+
+  if(options.AllOpCodes)
+  {
+    auto errOrCode = addMethod("allOpCodes");
+    VERIFY(errOrCode);
+    TRY(generateAllOpCodes(cf, *errOrCode.Get()));
+  }
+
+  if(options.AnnotationDepth != 0)
+  {
+    auto errOrBytes = generateNestedAnnotation(cp, rng, options.AnnotationDepth);
+    VERIFY(errOrBytes);
+
+    auto errOrAttr = makeRawAttribute(cp, "RuntimeVisibleAnnotations", errOrBytes.Release());
+    VERIFY(errOrAttr);
+    cf.Attributes.push_back(errOrAttr.Release());
+  }
+
+  auto sourceFile = makeAttribute<SourceFileAttribute>(cp, "SourceFile");
+  auto errOrSource = cp.FindOrAddUTF8("Synthetic.java");
+  VERIFY(errOrSource);
+  sourceFile->SourceFileIndex = errOrSource.Get();
+  cf.Attributes.push_back(std::move(sourceFile));
+
+  //last, so that nothing has to be added to a full pool
+  if(options.FillConstantPool)
+  {
+    U32 value = static_cast<U32>(rng.Next());
+
+    while(cp.GetCount() < 0xFFFF)
+    {
+      auto errOrIndex = cp.FindOrAddInteger(value++);
+      VERIFY(errOrIndex);
+    }
+  }
+
+  return cf;
+}
+
+ErrorOr< std::vector<std::string> > Synthetic::WriteCorpus(const std::string& dir, U64 seed)
+{
+  namespace fs = std::filesystem;
+
+  static constexpr std::pair<Shape, std::string_view> shapes[] =
+  {
+    {Shape::MaxConstantPool, "MaxConstantPool"},
+    {Shape::MaxCode,         "MaxCode"},
+    {Shape::ManyMembers,     "ManyMembers"},
+    {Shape::DeepAttributes,  "DeepAttributes"},
+    {Shape::AllOpCodes,      "AllOpCodes"},
+  };
+
+  std::error_code ec;
+  fs::create_directories(dir, ec);
+
+  if(ec)
+  {
+    return Error{fmt::format("Synthetic::WriteCorpus(): unable to create "
+        "\"{}\": {}", dir, ec.message())};
+  }
+
+  std::vector<std::string> paths;
+
+  for(auto [shape, name] : shapes)
+  {
+    auto errOrClass = Generate(GetPreset(shape, seed));
+    VERIFY(errOrClass, fmt::format("failed to generate {}", name));
+
+    std::string path = (fs::path{dir} / fmt::format("{}.class", name)).string();
+    std::ofstream out{path, std::ios::binary | std::ios::trunc};
+    TRY(Serializer::SerializeClassFile(out, errOrClass.Get()));
+
+    if(!out.good())
+      return Error{fmt::format("Synthetic::WriteCorpus(): unable to write \"{}\"", path)};
+
+    paths.push_back(std::move(path));
+  }
+
+  return paths;
+}
+
+} //namespace ClassFile
@@ -0,0 +1,200 @@
+#include "ClassFile/Transform.hpp"
+
+#include <fmt/core.h>
+
+#include "Util/Error.hpp"
+#include "Util/RawAttributes.hpp"
+
+#include <optional>
+#include <vector>
+
+namespace ClassFile
+{
+
+//Every location outside of the constant pool that holds a pool index. 
+//Collected in one walk over the class so that the indices can afterwards be
+//rewritten in one linear sweep, without walking the class again.
+struct refSites
+{
+  std::vector<U16*> Fields;
+
+  //points to a big endian U16 inside of a RawAttribute payload
+  std::vector<U8*> RawIndices;
+
+  //instructions for which HasConstantPoolIndex() is true, the index is 
+  //operand 0 which is a U8 for ldc so it can't be referenced as a U16
+  std::vector<Instruction*> Instructions;
+};
+
+static ErrorOr<void> collectRefs(const ConstantPool& cp, AttributeInfo& attr, refSites& sites);
+
+template <typename AttributeList>
+static ErrorOr<void> collectRefs(const ConstantPool& cp, AttributeList& attrs, refSites& sites)
+{
+  //every reference gets rewritten, so attributes shared with a clone are copied
+  for(auto& pAttr : attrs)
+    TRY(collectRefs(cp, pAttr.Mutate(), sites));
+
+  return NoError{};
+}
+
+static ErrorOr<void> collectRefs(const ConstantPool& cp, CodeAttribute& attr, refSites& sites)
+{
+  for(Instruction& instr : attr.Code)
+  {
+    if(HasConstantPoolIndex(instr.GetOpCode()))
+      sites.Instructions.push_back(&instr);
+  }
+
+  for(auto& handler : attr.ExceptionTable)
+  {
+    //a CatchType of 0 means "any" and isn't a reference
+    if(handler.CatchType != 0)
+      sites.Fields.push_back(&handler.CatchType);
+  }
+
+  return collectRefs(cp, attr.Attributes, sites);
+}
+
+static ErrorOr<void> collectRefs(const ConstantPool& cp, RawAttribute& attr, refSites& sites)
+{
+  auto errOrName = cp.LookupString(attr.NameIndex);
+  VERIFY(errOrName);
+
+  U8* bytes = attr.Bytes.data();
+
+  TRY(RawAttributes::ForEachConstantRef(cp, errOrName.Get(), bytes, attr.Bytes.size(),
+        [&](size_t offset){ sites.RawIndices.push_back(bytes + offset); }));
+
+  return NoError{};
+}
+
+static ErrorOr<void> collectRefs(const ConstantPool& cp, AttributeInfo& attr, refSites& sites)
+{
+  sites.Fields.push_back(&attr.NameIndex);
+
+  switch(attr.GetType())
+  {
+    case AttributeInfo::Type::ConstantValue:
+      sites.Fields.push_back(&static_cast<ConstantValueAttribute&>(attr).Index);
+      break;
+
+    case AttributeInfo::Type::Code:
+      return collectRefs(cp, static_cast<CodeAttribute&>(attr), sites);
+
+    case AttributeInfo::Type::Exceptions:
+      for(U16& index : static_cast<ExceptionsAttribute&>(attr).ExceptionTable)
+        sites.Fields.push_back(&index);
+      break;
+
+    case AttributeInfo::Type::SourceFile:
+      sites.Fields.push_back(&static_cast<SourceFileAttribute&>(attr).SourceFileIndex);
+      break;
+
+    case AttributeInfo::Type::LineNumberTable:
+      break;
+
+    case AttributeInfo::Type::Raw:
+      return collectRefs(cp, static_cast<RawAttribute&>(attr), sites);
+  }
+
+  return NoError{};
+}
+
+static ErrorOr<void> collectRefs(ClassFile& cf, refSites& sites)
+{
+  sites.Fields.push_back(&cf.ThisClass);
+
+  //java/lang/Object & module-info have no super class
+  if(cf.SuperClass != 0)
+    sites.Fields.push_back(&cf.SuperClass);
+
+  for(U16& interface : cf.Interfaces)
+    sites.Fields.push_back(&interface);
+
+  for(auto* members : {&cf.Fields, &cf.Methods})
+  {
+    for(FieldMethodInfo& member : *members)
+    {
+      sites.Fields.push_back(&member.NameIndex);
+      sites.Fields.push_back(&member.DescriptorIndex);
+      TRY(collectRefs(cf.ConstPool, member.Attributes, sites));
+    }
+  }
+
+  return collectRefs(cf.ConstPool, cf.Attributes, sites);
+}
+
+ErrorOr<U16> Transform::CompactConstantPool(ClassFile& cf)
+{
+  refSites sites;
+  TRY(collectRefs(cf, sites));
+
+  const ConstantPool& cp = cf.ConstPool;
+
+  std::vector<bool> reachable(cp.GetCount(), false);
+  std::vector<U16> worklist;
+  std::optional<U16> invalidIndex; //the first one, which may be 0
+
+  auto mark = [&](U16 index)
+  {
+    if(index == 0 || index >= cp.GetCount() || cp[index] == nullptr)
+    {
+      if(!invalidIndex)
+        invalidIndex = index;
+
+      return;
+    }
+
+    if(reachable[index])
+      return;
+
+    reachable[index] = true;
+    worklist.push_back(index);
+  };
+
+  for(U16* index : sites.Fields)
+    mark(*index);
+
+  for(U8* index : sites.RawIndices)
+    mark(RawAttributes::ReadIndex(index, 0));
+
+  for(Instruction* instr : sites.Instructions)
+    mark(static_cast<U16>(instr->GetOperand(0).Get()));
+
+  //entries referenced by reachable entries are reachable too
+  while(!worklist.empty())
+  {
+    U16 index = worklist.back();
+    worklist.pop_back();
+
+    ForEachConstantRef(*cp[index], mark);
+  }
+
+  if(invalidIndex)
+  {
+    return Error{fmt::format("Transform::CompactConstantPool(): class refers to "
+        "invalid constant pool index {}", *invalidIndex)};
+  }
+
+  U16 sizeBefore = cf.ConstPool.GetSize();
+
+  auto errOrRemap = cf.ConstPool.Compact(reachable);
+  VERIFY(errOrRemap);
+
+  const std::vector<U16>& remap = errOrRemap.Get();
+
+  for(U16* index : sites.Fields)
+    *index = remap[*index];
+
+  for(U8* index : sites.RawIndices)
+    RawAttributes::WriteIndex(index, 0, remap[RawAttributes::ReadIndex(index, 0)]);
+
+  //new indices are never larger than old ones so ldc's U8 operand still fits
+  for(Instruction* instr : sites.Instructions)
+    TRY(instr->SetOperand(0, remap[instr->GetOperand(0).Get()]));
+
+  return static_cast<U16>(sizeBefore - cf.ConstPool.GetSize());
+}
+
+} //namespace ClassFile
@@ -0,0 +1,252 @@
+#include "ClassFile/TypeTable.hpp"
+#include "ClassFile/Misc.hpp"
+
+#include <fmt/core.h>
+
+#include "Util/Error.hpp"
+
+#include <cassert>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ClassFile
+{
+
+static_assert(static_cast<U8>(TypeTable::Kind::Void) == static_cast<U8>(TypeView::Kind::Void),
+    "TypeTable::Kind must start with the kinds of TypeView::Kind");
+
+struct TypeTable::entry
+{
+  Kind TypeKind{Kind::Void};
+  U8 Dimensions{0};
+  U32 Slots{0};                     //parameter slots for methods
+  const Symbol* Descriptor{nullptr};
+  const Symbol* ClassName{nullptr};
+  TypeId Component{InvalidId};      //return type for methods
+  TypeId Element{InvalidId};
+
+  U32 ParameterCount{0};
+  std::unique_ptr<TypeId[]> Parameters;
+};
+
+static std::atomic<U64> nextGeneration{0};
+
+TypeTable::TypeTable(SymbolTable& symbols)
+  : m_symbols{symbols}, m_generation{nextGeneration.fetch_add(1, std::memory_order_relaxed)},
+    m_chunks{std::make_unique< std::atomic<entry*>[] >(maxChunks)}
+{
+  for(U32 i = 0; i < maxChunks; i++)
+    m_chunks[i].store(nullptr, std::memory_order_relaxed);
+
+  //in the order of Kind, see GetPrimitive()
+  static constexpr std::pair<char, U32> primitives[] =
+  {
+    {'B', 1}, {'C', 1}, {'D', 2}, {'F', 1}, {'I', 1}, {'J', 2}, {'S', 1}, {'Z', 1}, {'V', 0},
+  };
+
+  for(auto [c, slots] : primitives)
+  {
+    entry type;
+    type.TypeKind = c == 'V' ? Kind::Void : static_cast<Kind>(m_count.load(std::memory_order_relaxed));
+    type.Slots = slots;
+    type.Descriptor = m_symbols.Intern(std::string_view{&c, 1});
+
+    TypeId id = this->insert(std::move(type));
+    assert(id == GetPrimitive(this->GetKind(id)));
+    (void)id;
+  }
+}
+
+TypeTable::~TypeTable()
+{
+  for(U32 i = 0; i < maxChunks; i++)
+    delete[] m_chunks[i].load(std::memory_order_relaxed);
+}
+
+const TypeTable::entry& TypeTable::get(TypeId id) const
+{
+  assert(id < m_count.load(std::memory_order_acquire));
+  return m_chunks[id >> chunkBits].load(std::memory_order_acquire)[id & (chunkSize - 1)];
+}
+
+TypeTable::TypeId TypeTable::findSymbol(const Symbol* descriptor) const
+{
+  std::shared_lock lock{m_mutex};
+
+  auto itr = m_ids.find(descriptor);
+  return itr == m_ids.end() ? InvalidId : itr->second;
+}
+
+//Entries are complete before their id is published, either through m_ids
+//(under the lock) or m_count & the chunk pointer (release stores), so every
+//thread that obtained an id sees the whole entry.
+TypeTable::TypeId TypeTable::insert(entry&& type)
+{
+  std::unique_lock lock{m_mutex};
+
+  if(type.Descriptor)
+  {
+    auto itr = m_ids.find(type.Descriptor);
+
+    //another thread interned it first
+    if(itr != m_ids.end())
+      return itr->second;
+  }
+
+  TypeId id = m_count.load(std::memory_order_relaxed);
+  U32 chunk = id >> chunkBits;
+
+  if(chunk >= maxChunks)
+    return InvalidId;
+
+  entry* entries = m_chunks[chunk].load(std::memory_order_relaxed);
+
+  if(!entries)
+  {
+    entries = new entry[chunkSize];
+    m_chunks[chunk].store(entries, std::memory_order_release);
+  }
+
+  if(type.Descriptor)
+    m_ids.emplace(type.Descriptor, id);
+
+  entries[id & (chunkSize - 1)] = std::move(type);
+  m_count.store(id + 1, std::memory_order_release);
+
+  return id;
+}
+
+TypeTable::TypeId TypeTable::Find(std::string_view descriptor) const
+{
+  const Symbol* symbol = m_symbols.Find(descriptor);
+  return symbol ? this->findSymbol(symbol) : InvalidId;
+}
+
+ErrorOr<TypeTable::TypeId> TypeTable::Intern(std::string_view descriptor)
+{
+  if(TypeId id = this->Find(descriptor); id != InvalidId)
+    return id;
+
+  entry type;
+
+  if(!descriptor.empty() && descriptor[0] == '(')
+  {
+    auto errOrMethod = ViewMethodDescriptor(descriptor);
+    VERIFY(errOrMethod);
+
+    const MethodDescriptorView& method = errOrMethod.Get();
+    type.TypeKind = Kind::Method;
+    type.Slots = method.GetParameterSlots();
+    type.ParameterCount = static_cast<U32>(method.GetParameterCount());
+    type.Parameters = std::make_unique<TypeId[]>(type.ParameterCount);
+
+    U32 i = 0;
+    for(TypeView parameter : method)
+    {
+      auto errOrParameter = this->Intern(parameter.Descriptor);
+      VERIFY(errOrParameter);
+      type.Parameters[i++] = errOrParameter.Get();
+    }
+
+    auto errOrReturn = this->Intern(method.GetReturnType().Descriptor);
+    VERIFY(errOrReturn);
+    type.Component = errOrReturn.Get();
+  }
+  else
+  {
+    //primitives & void are always found above
+    auto errOrField = ViewFieldDescriptor(descriptor);
+    VERIFY(errOrField);
+
+    const TypeView& field = errOrField.Get();
+    type.Slots = 1;
+    type.Dimensions = field.Dimensions;
+
+    if(field.ElementKind == TypeView::Kind::Object)
+      type.ClassName = m_symbols.Intern(field.ClassName);
+
+    if(field.IsArray())
+    {
+      auto errOrComponent = this->Intern(descriptor.substr(1));
+      VERIFY(errOrComponent);
+
+      type.TypeKind = Kind::Array;
+      type.Component = errOrComponent.Get();
+      type.Element = field.Dimensions == 1 ? type.Component : this->GetElement(type.Component);
+    }
+    else
+    {
+      type.TypeKind = Kind::Object;
+    }
+  }
+
+  type.Descriptor = m_symbols.Intern(descriptor);
+
+  TypeId id = this->insert(std::move(type));
+
+  if(id == InvalidId)
+    return Error{fmt::format("TypeTable::Intern(): table is full, unable to add \"{}\"", descriptor)};
+
+  return id;
+}
+
+ErrorOr<TypeTable::TypeId> TypeTable::InternArray(TypeId component)
+{
+  Kind kind = this->GetKind(component);
+
+  if(kind == Kind::Void || kind == Kind::Method)
+    return Error{"TypeTable::InternArray(): void & method types have no arrays"};
+
+  std::string descriptor{"["};
+  descriptor += this->GetDescriptor(component)->GetString();
+
+  return this->Intern(descriptor);
+}
+
+size_t TypeTable::GetCount() const
+{
+  return m_count.load(std::memory_order_acquire);
+}
+
+TypeTable::Kind TypeTable::GetKind(TypeId id) const { return this->get(id).TypeKind; }
+const Symbol* TypeTable::GetDescriptor(TypeId id) const { return this->get(id).Descriptor; }
+const Symbol* TypeTable::GetClassName(TypeId id) const { return this->get(id).ClassName; }
+U8 TypeTable::GetDimensions(TypeId id) const { return this->get(id).Dimensions; }
+
+U32 TypeTable::GetSlots(TypeId id) const
+{
+  const entry& type = this->get(id);
+  return type.TypeKind == Kind::Method ? 0 : type.Slots;
+}
+
+TypeTable::TypeId TypeTable::GetComponent(TypeId id) const
+{
+  const entry& type = this->get(id);
+  return type.TypeKind == Kind::Array ? type.Component : InvalidId;
+}
+
+TypeTable::TypeId TypeTable::GetElement(TypeId id) const
+{
+  return this->get(id).Element;
+}
+
+TypeTable::Range TypeTable::GetParameters(TypeId id) const
+{
+  const entry& type = this->get(id);
+  return {type.Parameters.get(), type.Parameters.get() + type.ParameterCount};
+}
+
+TypeTable::TypeId TypeTable::GetReturnType(TypeId id) const
+{
+  const entry& type = this->get(id);
+  return type.TypeKind == Kind::Method ? type.Component : InvalidId;
+}
+
+U32 TypeTable::GetParameterSlots(TypeId id) const
+{
+  const entry& type = this->get(id);
+  return type.TypeKind == Kind::Method ? type.Slots : 0;
+}
+
+} //namespace ClassFile
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "ClassFile/Defs.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+//Streaming 128 bit hash (the MurmurHash3 x64 128 construction). Fast, well
+//mixed & stable across platforms: multi byte values are fed little endian, 
+//so the result doesn't depend on the host byte order.
+class Hasher128
+{
+  public:
+    using U8  = ClassFile::U8;
+    using U16 = ClassFile::U16;
+    using U32 = ClassFile::U32;
+    using U64 = ClassFile::U64;
+
+    explicit Hasher128(U64 seed = 0) : m_h1{seed}, m_h2{seed} {}
+
+    void Update(const void* data, size_t len)
+    {
+      const U8* bytes = static_cast<const U8*>(data);
+      m_total += len;
+
+      if(m_buffered > 0)
+      {
+        size_t n = std::min(len, sizeof(m_buffer) - m_buffered);
+        std::memcpy(m_buffer + m_buffered, bytes, n);
+        m_buffered += n;
+        bytes += n;
+        len -= n;
+
+        if(m_buffered < sizeof(m_buffer))
+          return;
+
+        block(m_buffer);
+        m_buffered = 0;
+      }
+
+      for(; len >= 16; bytes += 16, len -= 16)
+        block(bytes);
+
+      std::memcpy(m_buffer, bytes, len);
+      m_buffered = len;
+    }
+
+    void Update(U8 value)  { Update(&value, 1); }
+    void Update(U16 value) { updateLE(value, 2); }
+    void Update(U32 value) { updateLE(value, 4); }
+    void Update(U64 value) { updateLE(value, 8); }
+
+    //{low, high}, the hasher can keep being updated afterwards
+    std::pair<U64, U64> Finish() const
+    {
+      U64 h1 = m_h1;
+      U64 h2 = m_h2;
+      U64 k1 = 0;
+      U64 k2 = 0;
+
+      for(size_t i = m_buffered; i > 8; i--)
+        k2 = (k2 << 8) | m_buffer[i-1];
+
+      for(size_t i = std::min<size_t>(m_buffered, 8); i > 0; i--)
+        k1 = (k1 << 8) | m_buffer[i-1];
+
+      if(m_buffered > 8)
+      {
+        k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; h2 ^= k2;
+      }
+
+      if(m_buffered > 0)
+      {
+        k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; h1 ^= k1;
+      }
+
+      h1 ^= m_total;
+      h2 ^= m_total;
+
+      h1 += h2;
+      h2 += h1;
+
+      h1 = fmix(h1);
+      h2 = fmix(h2);
+
+      h1 += h2;
+      h2 += h1;
+
+      return {h1, h2};
+    }
+
+  private:
+    static constexpr U64 c1 = 0x87c37b91114253d5ull;
+    static constexpr U64 c2 = 0x4cf5ad432745937full;
+
+    static U64 rotl(U64 x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    static U64 fmix(U64 k)
+    {
+      k ^= k >> 33;
+      k *= 0xff51afd7ed558ccdull;
+      k ^= k >> 33;
+      k *= 0xc4ceb9fe1a85ec53ull;
+      k ^= k >> 33;
+      return k;
+    }
+
+    static U64 load64(const U8* bytes)
+    {
+      U64 value = 0;
+      for(size_t i = 8; i > 0; i--)
+        value = (value << 8) | bytes[i-1];
+
+      return value;
+    }
+
+    void updateLE(U64 value, size_t size)
+    {
+      U8 bytes[8];
+      for(size_t i = 0; i < size; i++)
+        bytes[i] = static_cast<U8>(value >> (8*i));
+
+      Update(bytes, size);
+    }
+
+    void block(const U8* bytes)
+    {
+      U64 k1 = load64(bytes);
+      U64 k2 = load64(bytes + 8);
+
+      k1 *= c1; k1 = rotl(k1, 31); k1 *= c2; m_h1 ^= k1;
+      m_h1 = rotl(m_h1, 27); m_h1 += m_h2; m_h1 = m_h1*5 + 0x52dce729;
+
+      k2 *= c2; k2 = rotl(k2, 33); k2 *= c1; m_h2 ^= k2;
+      m_h2 = rotl(m_h2, 31); m_h2 += m_h1; m_h2 = m_h2*5 + 0x38495ab5;
+    }
+
+    U64 m_h1;
+    U64 m_h2;
+    U8 m_buffer[16];
+    size_t m_buffered{0};
+    U64 m_total{0};
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+//Calls fn(i) for every i in [0, n) using up to nThreads threads, the calling
+//thread being one of them. A thread count of 0 picks the hardware concurrency.
+//
+//Work is handed out in chunks of grain indices through a shared atomic 
+//counter, so threads that get cheap items simply take more of them.
+template <typename Fn>
+void ParallelFor(size_t n, unsigned nThreads, Fn&& fn, size_t grain = 1)
+{
+  if(n == 0)
+    return;
+
+  if(nThreads == 0)
+    nThreads = std::max(1u, std::thread::hardware_concurrency());
+
+  grain = std::max<size_t>(grain, 1);
+  size_t nChunks = (n + grain - 1) / grain;
+  nThreads = static_cast<unsigned>(std::min<size_t>(nThreads, nChunks));
+
+  std::atomic<size_t> next{0};
+
+  auto worker = [&]()
+  {
+    while(true)
+    {
+      size_t begin = next.fetch_add(grain, std::memory_order_relaxed);
+
+      if(begin >= n)
+        return;
+
+      size_t end = std::min(n, begin + grain);
+
+      for(size_t i = begin; i < end; i++)
+        fn(i);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(nThreads - 1);
+
+  for(unsigned i = 1; i < nThreads; i++)
+    threads.emplace_back(worker);
+
+  worker();
+
+  for(auto& thread : threads)
+    thread.join();
+}
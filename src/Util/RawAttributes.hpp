@@ -0,0 +1,504 @@
+#pragma once
+
+#include "ClassFile/ConstantPool.hpp"
+#include "ClassFile/Defs.hpp"
+#include "ClassFile/Error.hpp"
+
+#include "Util/Error.hpp"
+
+#include <fmt/core.h>
+
+#include <string_view>
+#include <functional>
+
+//Knowledge about the layout of standard attributes that the parser doesn't
+//implement yet and therefore keeps as RawAttribute byte arrays. Used by passes
+//that need to find the constant pool indices hidden inside of those bytes.
+
+namespace RawAttributes
+{
+
+using namespace ClassFile;
+
+//Calls onRef(offset) for the offset of every big endian U16 constant pool
+//index inside of a raw attribute payload. Offsets are relative to the start
+//of the payload (the bytes following attribute_length).
+using OnRef = std::function<void(size_t)>;
+
+//Bounds checked big endian reader over a raw attribute payload
+struct Reader
+{
+  const U8* Bytes;
+  size_t Len;
+  size_t Pos{0};
+
+  ErrorOr<U8> U1()
+  {
+    if(Pos + 1 > Len)
+      return truncated();
+
+    return Bytes[Pos++];
+  }
+
+  ErrorOr<U16> U2()
+  {
+    if(Pos + 2 > Len)
+      return truncated();
+
+    U16 value = static_cast<U16>((Bytes[Pos] << 8) | Bytes[Pos+1]);
+    Pos += 2;
+    return value;
+  }
+
+  ErrorOr<U32> U4()
+  {
+    if(Pos + 4 > Len)
+      return truncated();
+
+    U32 value = (U32{Bytes[Pos]} << 24) | (U32{Bytes[Pos+1]} << 16) |
+                (U32{Bytes[Pos+2]} << 8) | U32{Bytes[Pos+3]};
+    Pos += 4;
+    return value;
+  }
+
+  ErrorOr<void> Skip(size_t n)
+  {
+    if(Pos + n > Len)
+      return truncated();
+
+    Pos += n;
+    return NoError{};
+  }
+
+  //reports the offset of a U16 index at the current position & skips over it
+  ErrorOr<void> Ref(const OnRef& onRef)
+  {
+    if(Pos + 2 > Len)
+      return truncated();
+
+    onRef(Pos);
+    Pos += 2;
+    return NoError{};
+  }
+
+  //same as Ref() but an index of 0 means "none" and isn't reported
+  ErrorOr<void> OptionalRef(const OnRef& onRef)
+  {
+    size_t pos = Pos;
+
+    auto errOrIndex = U2();
+    VERIFY(errOrIndex);
+
+    if(errOrIndex.Get() != 0)
+      onRef(pos);
+
+    return NoError{};
+  }
+
+  Error truncated() const
+  {
+    return Error{fmt::format("RawAttributes::Reader: attribute payload is "
+        "truncated at offset {} (payload length: {})", Pos, Len)};
+  }
+};
+
+inline ErrorOr<void> forEachRefList(Reader& r, const OnRef& onRef)
+{
+  auto errOrCount = r.U2();
+  VERIFY(errOrCount);
+
+  for(U16 i = 0; i < errOrCount.Get(); i++)
+    TRY(r.Ref(onRef));
+
+  return NoError{};
+}
+
+inline ErrorOr<void> forEachVerificationTypeRef(Reader& r, const OnRef& onRef)
+{
+  auto errOrTag = r.U1();
+  VERIFY(errOrTag);
+
+  switch(errOrTag.Get())
+  {
+    case 7: return r.Ref(onRef); //Object_variable_info
+    case 8: return r.Skip(2);    //Uninitialized_variable_info (offset)
+    default: break;
+  }
+
+  if(errOrTag.Get() > 8)
+    return Error{fmt::format("RawAttributes: invalid verification type tag {}", errOrTag.Get())};
+
+  return NoError{};
+}
+
+inline ErrorOr<void> forEachStackMapTableRef(Reader& r, const OnRef& onRef)
+{
+  auto errOrCount = r.U2();
+  VERIFY(errOrCount);
+
+  for(U16 i = 0; i < errOrCount.Get(); i++)
+  {
+    auto errOrType = r.U1();
+    VERIFY(errOrType);
+
+    U8 type = errOrType.Get();
+
+    if(type <= 63) //same_frame
+      continue;
+
+    if(type <= 127) //same_locals_1_stack_item_frame
+    {
+      TRY(forEachVerificationTypeRef(r, onRef));
+      continue;
+    }
+
+    if(type < 247)
+      return Error{fmt::format("RawAttributes: reserved stack map frame type {}", type)};
+
+    TRY(r.Skip(2)); //offset_delta
+
+    if(type == 247) //same_locals_1_stack_item_frame_extended
+    {
+      TRY(forEachVerificationTypeRef(r, onRef));
+    }
+    else if(type >= 252 && type <= 254) //append_frame
+    {
+      for(int j = 0; j < type - 251; j++)
+        TRY(forEachVerificationTypeRef(r, onRef));
+    }
+    else if(type == 255) //full_frame
+    {
+      for(int list = 0; list < 2; list++)
+      {
+        auto errOrN = r.U2();
+        VERIFY(errOrN);
+
+        for(U16 j = 0; j < errOrN.Get(); j++)
+          TRY(forEachVerificationTypeRef(r, onRef));
+      }
+    }
+    //chop_frame & same_frame_extended only hold the offset_delta
+  }
+
+  return NoError{};
+}
+
+//Annotations, arrays of element values & Record attributes nest, and the walk
+//recurses into them, so hostile class files are stopped before they exhaust
+//the stack. Far deeper than anything javac emits.
+constexpr U32 maxNestingDepth = 2048;
+
+inline ErrorOr<void> checkNestingDepth(U32 depth)
+{
+  if(depth > maxNestingDepth)
+  {
+    return Error{fmt::format("RawAttributes: attributes are nested deeper than "
+        "the limit of {}", maxNestingDepth)};
+  }
+
+  return NoError{};
+}
+
+inline ErrorOr<void> forEachAnnotationRef(Reader& r, const OnRef& onRef, U32 depth);
+
+inline ErrorOr<void> forEachElementValueRef(Reader& r, const OnRef& onRef, U32 depth)
+{
+  TRY(checkNestingDepth(depth));
+
+  auto errOrTag = r.U1();
+  VERIFY(errOrTag);
+
+  switch(errOrTag.Get())
+  {
+    case 'B': case 'C': case 'D': case 'F': case 'I':
+    case 'J': case 'S': case 'Z': case 's':
+    case 'c':
+      return r.Ref(onRef);
+
+    case 'e':
+      TRY(r.Ref(onRef)); //type_name_index
+      return r.Ref(onRef); //const_name_index
+
+    case '@':
+      return forEachAnnotationRef(r, onRef, depth + 1);
+
+    case '[':
+    {
+      auto errOrN = r.U2();
+      VERIFY(errOrN);
+
+      for(U16 i = 0; i < errOrN.Get(); i++)
+        TRY(forEachElementValueRef(r, onRef, depth + 1));
+
+      return NoError{};
+    }
+  }
+
+  return Error{fmt::format("RawAttributes: invalid element_value tag '{}'",
+      static_cast<char>(errOrTag.Get()))};
+}
+
+inline ErrorOr<void> forEachAnnotationRef(Reader& r, const OnRef& onRef, U32 depth)
+{
+  TRY(checkNestingDepth(depth));
+  TRY(r.Ref(onRef)); //type_index
+
+  auto errOrPairs = r.U2();
+  VERIFY(errOrPairs);
+
+  for(U16 i = 0; i < errOrPairs.Get(); i++)
+  {
+    TRY(r.Ref(onRef)); //element_name_index
+    TRY(forEachElementValueRef(r, onRef, depth + 1));
+  }
+
+  return NoError{};
+}
+
+inline ErrorOr<void> forEachTypeAnnotationRef(Reader& r, const OnRef& onRef, U32 depth)
+{
+  auto errOrTarget = r.U1();
+  VERIFY(errOrTarget);
+
+  switch(errOrTarget.Get())
+  {
+    case 0x00: case 0x01: case 0x16:
+      TRY(r.Skip(1)); break;
+    case 0x10: case 0x11: case 0x12: case 0x17: case 0x42:
+    case 0x43: case 0x44: case 0x45: case 0x46:
+      TRY(r.Skip(2)); break;
+    case 0x13: case 0x14: case 0x15:
+      break;
+    case 0x40: case 0x41:
+    {
+      auto errOrN = r.U2();
+      VERIFY(errOrN);
+      TRY(r.Skip(errOrN.Get() * 6u));
+      break;
+    }
+    case 0x47: case 0x48: case 0x49: case 0x4A: case 0x4B:
+      TRY(r.Skip(3)); break;
+
+    default:
+      return Error{fmt::format("RawAttributes: invalid type annotation "
+          "target_type 0x{:x}", errOrTarget.Get())};
+  }
+
+  auto errOrPathLen = r.U1();
+  VERIFY(errOrPathLen);
+  TRY(r.Skip(errOrPathLen.Get() * 2u));
+
+  return forEachAnnotationRef(r, onRef, depth);
+}
+
+inline ErrorOr<void> forEachRawConstantRef(const ConstantPool& cp,
+    std::string_view name, Reader& r, const OnRef& onRef, U32 depth);
+
+//Record components carry their own attributes, which are parsed recursively
+inline ErrorOr<void> forEachRecordRef(const ConstantPool& cp, Reader& r, const OnRef& onRef,
+    U32 depth)
+{
+  TRY(checkNestingDepth(depth));
+
+  auto errOrCount = r.U2();
+  VERIFY(errOrCount);
+
+  for(U16 i = 0; i < errOrCount.Get(); i++)
+  {
+    TRY(r.Ref(onRef)); //name_index
+    TRY(r.Ref(onRef)); //descriptor_index
+
+    auto errOrAttrCount = r.U2();
+    VERIFY(errOrAttrCount);
+
+    for(U16 j = 0; j < errOrAttrCount.Get(); j++)
+    {
+      auto errOrNameIndex = r.U2();
+      VERIFY(errOrNameIndex);
+      onRef(r.Pos - 2);
+
+      auto errOrLen = r.U4();
+      VERIFY(errOrLen);
+
+      if(r.Pos + errOrLen.Get() > r.Len)
+        return r.truncated();
+
+      auto errOrName = cp.LookupString(errOrNameIndex.Get());
+      VERIFY(errOrName);
+
+      size_t base = r.Pos;
+      Reader nested{r.Bytes + base, errOrLen.Get()};
+
+      TRY(forEachRawConstantRef(cp, errOrName.Get(), nested,
+            [&](size_t offset){ onRef(base + offset); }, depth + 1));
+
+      r.Pos += errOrLen.Get();
+    }
+  }
+
+  return NoError{};
+}
+
+inline ErrorOr<void> forEachRawConstantRef(const ConstantPool& cp,
+    std::string_view name, Reader& r, const OnRef& onRef, U32 depth)
+{
+  using namespace std::literals;
+
+  if(name == "Signature"sv || name == "NestHost"sv || name == "ModuleMainClass"sv)
+    return r.Ref(onRef);
+
+  if(name == "SourceDebugExtension"sv || name == "Deprecated"sv || name == "Synthetic"sv)
+    return NoError{};
+
+  if(name == "NestMembers"sv || name == "PermittedSubclasses"sv || name == "ModulePackages"sv)
+    return forEachRefList(r, onRef);
+
+  if(name == "EnclosingMethod"sv)
+  {
+    TRY(r.Ref(onRef));
+    return r.OptionalRef(onRef);
+  }
+
+  if(name == "InnerClasses"sv)
+  {
+    auto errOrCount = r.U2();
+    VERIFY(errOrCount);
+
+    for(U16 i = 0; i < errOrCount.Get(); i++)
+    {
+      TRY(r.Ref(onRef));         //inner_class_info_index
+      TRY(r.OptionalRef(onRef)); //outer_class_info_index
+      TRY(r.OptionalRef(onRef)); //inner_name_index
+      TRY(r.Skip(2));            //inner_class_access_flags
+    }
+
+    return NoError{};
+  }
+
+  if(name == "LocalVariableTable"sv || name == "LocalVariableTypeTable"sv)
+  {
+    auto errOrCount = r.U2();
+    VERIFY(errOrCount);
+
+    for(U16 i = 0; i < errOrCount.Get(); i++)
+    {
+      TRY(r.Skip(4));    //start_pc & length
+      TRY(r.Ref(onRef)); //name_index
+      TRY(r.Ref(onRef)); //descriptor_index / signature_index
+      TRY(r.Skip(2));    //index
+    }
+
+    return NoError{};
+  }
+
+  if(name == "BootstrapMethods"sv)
+  {
+    auto errOrCount = r.U2();
+    VERIFY(errOrCount);
+
+    for(U16 i = 0; i < errOrCount.Get(); i++)
+    {
+      TRY(r.Ref(onRef)); //bootstrap_method_ref
+      TRY(forEachRefList(r, onRef));
+    }
+
+    return NoError{};
+  }
+
+  if(name == "MethodParameters"sv)
+  {
+    auto errOrCount = r.U1();
+    VERIFY(errOrCount);
+
+    for(U8 i = 0; i < errOrCount.Get(); i++)
+    {
+      TRY(r.OptionalRef(onRef));
+      TRY(r.Skip(2));
+    }
+
+    return NoError{};
+  }
+
+  if(name == "StackMapTable"sv)
+    return forEachStackMapTableRef(r, onRef);
+
+  if(name == "RuntimeVisibleAnnotations"sv || name == "RuntimeInvisibleAnnotations"sv)
+  {
+    auto errOrCount = r.U2();
+    VERIFY(errOrCount);
+
+    for(U16 i = 0; i < errOrCount.Get(); i++)
+      TRY(forEachAnnotationRef(r, onRef, depth));
+
+    return NoError{};
+  }
+
+  if(name == "RuntimeVisibleParameterAnnotations"sv ||
+     name == "RuntimeInvisibleParameterAnnotations"sv)
+  {
+    auto errOrParams = r.U1();
+    VERIFY(errOrParams);
+
+    for(U8 i = 0; i < errOrParams.Get(); i++)
+    {
+      auto errOrCount = r.U2();
+      VERIFY(errOrCount);
+
+      for(U16 j = 0; j < errOrCount.Get(); j++)
+        TRY(forEachAnnotationRef(r, onRef, depth));
+    }
+
+    return NoError{};
+  }
+
+  if(name == "RuntimeVisibleTypeAnnotations"sv || name == "RuntimeInvisibleTypeAnnotations"sv)
+  {
+    auto errOrCount = r.U2();
+    VERIFY(errOrCount);
+
+    for(U16 i = 0; i < errOrCount.Get(); i++)
+      TRY(forEachTypeAnnotationRef(r, onRef, depth));
+
+    return NoError{};
+  }
+
+  if(name == "AnnotationDefault"sv)
+    return forEachElementValueRef(r, onRef, depth);
+
+  if(name == "Record"sv)
+    return forEachRecordRef(cp, r, onRef, depth);
+
+  return Error{fmt::format("RawAttributes: layout of attribute \"{}\" is "
+      "unknown, unable to locate its constant pool references", name)};
+}
+
+//Reports every constant pool index inside of the payload of a raw attribute
+//named name. Fails for attributes whose layout is unknown (e.g. Module or
+//vendor specific attributes) since any of their bytes could be an index.
+inline ErrorOr<void> ForEachConstantRef(const ConstantPool& cp, std::string_view name,
+    const U8* bytes, size_t len, const OnRef& onRef)
+{
+  Reader r{bytes, len};
+  TRY(forEachRawConstantRef(cp, name, r, onRef, 0));
+
+  if(r.Pos != len)
+  {
+    return Error{fmt::format("RawAttributes::ForEachConstantRef(): decoded {} of "
+        "{} bytes of attribute \"{}\"", r.Pos, len, name)};
+  }
+
+  return NoError{};
+}
+
+inline U16 ReadIndex(const U8* bytes, size_t offset)
+{
+  return static_cast<U16>((bytes[offset] << 8) | bytes[offset+1]);
+}
+
+inline void WriteIndex(U8* bytes, size_t offset, U16 index)
+{
+  bytes[offset]   = static_cast<U8>(index >> 8);
+  bytes[offset+1] = static_cast<U8>(index & 0xFF);
+}
+
+} //namespace RawAttributes
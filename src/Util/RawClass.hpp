@@ -0,0 +1,311 @@
+#pragma once
+
+#include "ClassFile/ConstantPool.hpp"
+#include "ClassFile/Defs.hpp"
+#include "ClassFile/Error.hpp"
+
+#include "Util/Error.hpp"
+#include "Util/RawAttributes.hpp"
+
+#include <fmt/core.h>
+
+#include <optional>
+#include <string_view>
+#include <vector>
+
+//Skimming of a class file that is still in its serialized form. Instead of
+//building CPInfo, FieldMethodInfo & Instruction objects only the offsets of
+//the constants, members & attributes are recorded, which is all that queries
+//looking for a handful of constants need.
+
+namespace RawClass
+{
+
+using namespace ClassFile;
+
+struct Attribute
+{
+  U16 NameIndex;
+  U32 Offset; //of the payload, i.e. the bytes following attribute_length
+  U32 Length;
+};
+
+struct Member
+{
+  U16 AccessFlags;
+  U16 NameIndex;
+  U16 DescriptorIndex;
+
+  //[FirstAttribute, LastAttribute) of Skim::Attributes
+  U32 FirstAttribute;
+  U32 LastAttribute;
+};
+
+struct Skim
+{
+  const U8* Bytes{nullptr};
+  size_t Len{0};
+
+  //offset of the tag of every constant, 0 for index 0 & the slot following
+  //a Long or Double
+  std::vector<U32> ConstOffsets;
+
+  U16 MinorVersion{0};
+  U16 MajorVersion{0};
+  U16 AccessFlags{0};
+  U16 ThisClass{0};
+  U16 SuperClass{0};
+
+  //offset of the big endian U16 array of interfaces
+  U32 InterfacesOffset{0};
+  U16 InterfaceCount{0};
+
+  std::vector<Member> Fields;
+  std::vector<Member> Methods;
+
+  //attributes of all members followed by those of the class itself
+  std::vector<Attribute> Attributes;
+  U32 FirstClassAttribute{0};
+
+  U16 GetConstCount() const { return static_cast<U16>(ConstOffsets.size()); }
+
+  U16 ReadU16(size_t offset) const
+  {
+    return RawAttributes::ReadIndex(Bytes, offset);
+  }
+
+  //0 for indices that don't hold a constant
+  U8 GetTag(U16 index) const
+  {
+    if(index == 0 || index >= ConstOffsets.size() || ConstOffsets[index] == 0)
+      return 0;
+
+    return Bytes[ConstOffsets[index]];
+  }
+
+  bool Is(U16 index, CPInfo::Type type) const
+  {
+    return GetTag(index) == static_cast<U8>(type);
+  }
+
+  //The n-th U16 field of a constant, e.g. n=1 is a Methodref's name_and_type
+  U16 GetField(U16 index, size_t n) const
+  {
+    return ReadU16(ConstOffsets[index] + 1 + 2*n);
+  }
+
+  //nullopt unless index is a UTF8 constant
+  std::optional<std::string_view> GetUTF8(U16 index) const
+  {
+    if(!Is(index, CPInfo::Type::UTF8))
+      return std::nullopt;
+
+    size_t offset = ConstOffsets[index];
+    return std::string_view{reinterpret_cast<const char*>(Bytes + offset + 3),
+      ReadU16(offset + 1)};
+  }
+
+  //nullopt unless index is a constant with a name_index (Class, String,
+  //MethodType) pointing to a UTF8
+  std::optional<std::string_view> GetIndirectUTF8(U16 index) const
+  {
+    if(!Is(index, CPInfo::Type::Class) && !Is(index, CPInfo::Type::String) &&
+       !Is(index, CPInfo::Type::MethodType))
+    {
+      return std::nullopt;
+    }
+
+    return GetUTF8(GetField(index, 0));
+  }
+
+  //index of the UTF8 constant equal to string, 0 if there is none
+  U16 FindUTF8(std::string_view string) const
+  {
+    for(U16 i = 1; i < ConstOffsets.size(); i++)
+    {
+      if(GetUTF8(i) == string)
+        return i;
+    }
+
+    return 0;
+  }
+};
+
+inline ErrorOr<void> skimConstantPool(RawAttributes::Reader& r, Skim& skim)
+{
+  auto errOrCount = r.U2();
+  VERIFY(errOrCount);
+
+  U16 count = errOrCount.Get();
+
+  if(count == 0)
+    return Error{"RawClass::SkimClass(): constant_pool_count is 0"};
+
+  skim.ConstOffsets.assign(count, 0);
+
+  for(U16 i = 1; i < count; i++)
+  {
+    skim.ConstOffsets[i] = static_cast<U32>(r.Pos);
+
+    auto errOrTag = r.U1();
+    VERIFY(errOrTag);
+
+    size_t size;
+
+    switch(errOrTag.Get())
+    {
+      case static_cast<U8>(CPInfo::Type::UTF8):
+      {
+        auto errOrLength = r.U2();
+        VERIFY(errOrLength);
+        size = errOrLength.Get();
+        break;
+      }
+
+      case static_cast<U8>(CPInfo::Type::Long):
+      case static_cast<U8>(CPInfo::Type::Double):
+        size = 8;
+        i++; //takes up two slots
+        break;
+
+      case static_cast<U8>(CPInfo::Type::Class):
+      case static_cast<U8>(CPInfo::Type::String):
+      case static_cast<U8>(CPInfo::Type::MethodType):
+      case 19: //Module
+      case 20: //Package
+        size = 2;
+        break;
+
+      case static_cast<U8>(CPInfo::Type::MethodHandle):
+        size = 3;
+        break;
+
+      case static_cast<U8>(CPInfo::Type::Integer):
+      case static_cast<U8>(CPInfo::Type::Float):
+      case static_cast<U8>(CPInfo::Type::Fieldref):
+      case static_cast<U8>(CPInfo::Type::Methodref):
+      case static_cast<U8>(CPInfo::Type::InterfaceMethodref):
+      case static_cast<U8>(CPInfo::Type::NameAndType):
+      case static_cast<U8>(CPInfo::Type::InvokeDynamic):
+      case 17: //Dynamic
+        size = 4;
+        break;
+
+      default:
+        return Error{fmt::format("RawClass::SkimClass(): constant #{} has "
+            "unknown tag {}", i, errOrTag.Get())};
+    }
+
+    TRY(r.Skip(size));
+  }
+
+  return NoError{};
+}
+
+inline ErrorOr<void> skimAttributes(RawAttributes::Reader& r, Skim& skim)
+{
+  auto errOrCount = r.U2();
+  VERIFY(errOrCount);
+
+  for(U16 i = 0; i < errOrCount.Get(); i++)
+  {
+    auto errOrName = r.U2();
+    VERIFY(errOrName);
+    auto errOrLength = r.U4();
+    VERIFY(errOrLength);
+
+    skim.Attributes.push_back({errOrName.Get(), static_cast<U32>(r.Pos), errOrLength.Get()});
+    TRY(r.Skip(errOrLength.Get()));
+  }
+
+  return NoError{};
+}
+
+inline ErrorOr<void> skimMembers(RawAttributes::Reader& r, Skim& skim, std::vector<Member>& members)
+{
+  auto errOrCount = r.U2();
+  VERIFY(errOrCount);
+
+  members.reserve(errOrCount.Get());
+
+  for(U16 i = 0; i < errOrCount.Get(); i++)
+  {
+    Member member;
+
+    auto errOrFlags = r.U2();
+    VERIFY(errOrFlags);
+    auto errOrName = r.U2();
+    VERIFY(errOrName);
+    auto errOrDescriptor = r.U2();
+    VERIFY(errOrDescriptor);
+
+    member.AccessFlags = errOrFlags.Get();
+    member.NameIndex = errOrName.Get();
+    member.DescriptorIndex = errOrDescriptor.Get();
+
+    member.FirstAttribute = static_cast<U32>(skim.Attributes.size());
+    TRY(skimAttributes(r, skim));
+    member.LastAttribute = static_cast<U32>(skim.Attributes.size());
+
+    members.push_back(member);
+  }
+
+  return NoError{};
+}
+
+//Records the layout of the class file in bytes, which must outlive the skim.
+//Only the structure is validated, not the contents of the constants.
+inline ErrorOr<Skim> SkimClass(const U8* bytes, size_t len)
+{
+  Skim skim;
+  skim.Bytes = bytes;
+  skim.Len = len;
+
+  RawAttributes::Reader r{bytes, len};
+
+  auto errOrMagic = r.U4();
+  VERIFY(errOrMagic);
+
+  if(errOrMagic.Get() != 0xCAFEBABE)
+  {
+    return Error{fmt::format("RawClass::SkimClass(): bad magic 0x{:X}",
+        errOrMagic.Get())};
+  }
+
+  auto errOrMinor = r.U2();
+  VERIFY(errOrMinor);
+  auto errOrMajor = r.U2();
+  VERIFY(errOrMajor);
+
+  skim.MinorVersion = errOrMinor.Get();
+  skim.MajorVersion = errOrMajor.Get();
+
+  TRY(skimConstantPool(r, skim));
+
+  auto errOrFlags = r.U2();
+  VERIFY(errOrFlags);
+  auto errOrThis = r.U2();
+  VERIFY(errOrThis);
+  auto errOrSuper = r.U2();
+  VERIFY(errOrSuper);
+  auto errOrInterfaces = r.U2();
+  VERIFY(errOrInterfaces);
+
+  skim.AccessFlags = errOrFlags.Get();
+  skim.ThisClass = errOrThis.Get();
+  skim.SuperClass = errOrSuper.Get();
+  skim.InterfacesOffset = static_cast<U32>(r.Pos);
+  skim.InterfaceCount = errOrInterfaces.Get();
+
+  TRY(r.Skip(2 * size_t{errOrInterfaces.Get()}));
+
+  TRY(skimMembers(r, skim, skim.Fields));
+  TRY(skimMembers(r, skim, skim.Methods));
+
+  skim.FirstClassAttribute = static_cast<U32>(skim.Attributes.size());
+  TRY(skimAttributes(r, skim));
+
+  return skim;
+}
+
+} //namespace RawClass
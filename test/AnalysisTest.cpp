@@ -0,0 +1,969 @@
+#include <gtest/gtest.h>
+
+#include <ClassFile/ClassFile.hpp>
+#include <ClassFile/Classpath.hpp>
+#include <ClassFile/ClassHierarchy.hpp>
+#include <ClassFile/CallGraph.hpp>
+#include <ClassFile/CodeEditor.hpp>
+#include <ClassFile/ControlFlowGraph.hpp>
+#include <ClassFile/Fingerprint.hpp>
+#include <ClassFile/Frames.hpp>
+#include <ClassFile/RefScanner.hpp>
+#include <ClassFile/Parser.hpp>
+#include <ClassFile/Peephole.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+
+#ifndef RES_DIR
+  #define RES_DIR "res"
+#endif
+
+TEST(ClassHierarchyTest, BuildFromClasspath)
+{
+  auto errOrPaths = ClassFile::Classpath::ListClassFiles(RES_DIR);
+  ASSERT_TRUE( !errOrPaths.IsError() ) << errOrPaths.GetError().What;
+  ASSERT_EQ( errOrPaths.Get().size(), 3u );
+
+  ClassFile::SymbolTable symbols;
+  auto errOrHierarchy = ClassFile::ClassHierarchy::Build(errOrPaths.Get(), 2, symbols);
+  ASSERT_TRUE( !errOrHierarchy.IsError() ) << errOrHierarchy.GetError().What;
+
+  const ClassFile::ClassHierarchy& h = errOrHierarchy.Get();
+  using ClassId = ClassFile::ClassHierarchy::ClassId;
+
+  ClassId object = h.Find("java/lang/Object");
+  ClassId hello  = h.Find("HelloWorld");
+
+  ASSERT_NE( object, ClassFile::ClassHierarchy::InvalidId );
+  ASSERT_NE( hello, ClassFile::ClassHierarchy::InvalidId );
+  ASSERT_EQ( h.Find("does/not/Exist"), ClassFile::ClassHierarchy::InvalidId );
+
+  ASSERT_TRUE( h.IsDefined(hello) );
+  ASSERT_FALSE( h.IsDefined(object) );
+  ASSERT_EQ( h.GetSuperClass(hello), object );
+  ASSERT_EQ( h.GetSuperClass(object), ClassFile::ClassHierarchy::InvalidId );
+
+  auto subtypes = h.GetSubtypes(object);
+  ASSERT_EQ( subtypes.size(), 3u );
+  ASSERT_TRUE( std::find(subtypes.begin(), subtypes.end(), hello) != subtypes.end() );
+
+  ASSERT_EQ( h.GetAllSubtypes(object).size(), 3u );
+  ASSERT_EQ( h.GetAllSupertypes(hello), std::vector<ClassId>{object} );
+  ASSERT_TRUE( h.IsSubtypeOf(hello, object) );
+  ASSERT_FALSE( h.IsSubtypeOf(object, hello) );
+
+  //only class names are interned, not the rest of the pools
+  ASSERT_NE( symbols.Find("HelloWorld"), nullptr );
+  ASSERT_EQ( symbols.Find("([Ljava/lang/String;)V"), nullptr );
+}
+
+TEST(ClassHierarchyTest, CutsSuperClassCycles)
+{
+  using ClassFile::ClassHierarchy;
+
+  //A extends B extends A, C extends itself
+  ClassFile::SymbolTable symbols;
+  auto entry = [&](const char* name, const char* super)
+  {
+    ClassHierarchy::Entry e;
+    e.Name = symbols.Intern(name);
+    e.SuperName = symbols.Intern(super);
+    return e;
+  };
+
+  ClassHierarchy h = ClassHierarchy::Build({entry("A", "B"), entry("B", "A"), entry("C", "C")}, symbols);
+
+  ClassHierarchy::ClassId a = h.Find("A"), b = h.Find("B"), c = h.Find("C");
+  ASSERT_EQ( h.GetSuperClass(a), b );
+  ASSERT_EQ( h.GetSuperClass(b), ClassHierarchy::InvalidId );
+  ASSERT_EQ( h.GetSuperClass(c), ClassHierarchy::InvalidId );
+
+  ASSERT_TRUE( h.IsSubtypeOf(a, b) );
+  ASSERT_FALSE( h.IsSubtypeOf(b, a) );
+  ASSERT_FALSE( h.IsSubtypeOf(a, c) );
+
+  ClassFile::ClassHierarchyOracle oracle{h};
+  ASSERT_TRUE( oracle.GetCommonSuperClass("A", "C").IsError() );
+  ASSERT_EQ( oracle.GetCommonSuperClass("A", "B").Get(), "B" );
+}
+
+TEST(CallGraphTest, BuildFromClasspath)
+{
+  auto errOrPaths = ClassFile::Classpath::ListClassFiles(RES_DIR);
+  ASSERT_TRUE( !errOrPaths.IsError() ) << errOrPaths.GetError().What;
+
+  ClassFile::SymbolTable symbols;
+  auto errOrHierarchy = ClassFile::ClassHierarchy::Build(errOrPaths.Get(), 2, symbols);
+  ASSERT_TRUE( !errOrHierarchy.IsError() ) << errOrHierarchy.GetError().What;
+
+  ClassFile::CallGraph::Options options;
+  options.Threads = 2;
+  options.Symbols = &symbols;
+  options.Hierarchy = &errOrHierarchy.Get();
+
+  auto errOrGraph = ClassFile::CallGraph::Build(errOrPaths.Get(), options);
+  ASSERT_TRUE( !errOrGraph.IsError() ) << errOrGraph.GetError().What;
+
+  const ClassFile::CallGraph& g = errOrGraph.Get();
+  using MethodId = ClassFile::CallGraph::MethodId;
+  using CallKind = ClassFile::CallGraph::CallKind;
+
+  MethodId main    = g.Find("HelloWorld", "main", "([Ljava/lang/String;)V");
+  MethodId init    = g.Find("HelloWorld", "<init>", "()V");
+  MethodId println = g.Find("java/io/PrintStream", "println", "(Ljava/lang/String;)V");
+  MethodId objInit = g.Find("java/lang/Object", "<init>", "()V");
+
+  ASSERT_NE( main, ClassFile::CallGraph::InvalidId );
+  ASSERT_NE( println, ClassFile::CallGraph::InvalidId );
+  ASSERT_TRUE( g.IsDeclared(main) );
+  ASSERT_FALSE( g.IsDeclared(println) );
+
+  ASSERT_EQ( g.GetCallees(main), std::vector<MethodId>{println} );
+  ASSERT_EQ( *g.CallKindsBegin(main), CallKind::Virtual );
+
+  ASSERT_EQ( g.GetCallees(init), std::vector<MethodId>{objInit} );
+  ASSERT_EQ( *g.CallKindsBegin(init), CallKind::Special );
+
+  ASSERT_EQ( g.GetOffsets().size(), g.GetMethodCount() + 1 );
+  ASSERT_EQ( g.GetOffsets().back(), g.GetEdgeCount() );
+}
+
+static std::vector<ClassFile::U8> readFile(const std::string& path)
+{
+  std::ifstream stream{path, std::ios::binary};
+  return {std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>()};
+}
+
+TEST(RefScannerTest, FindReferences)
+{
+  using ClassFile::RefScanner::Target;
+
+  auto bytes = readFile(RES_DIR "/HelloWorld.class");
+
+  std::vector<Target> targets = {
+    Target::Method("java/io/PrintStream", "println", "(Ljava/lang/String;)V"),
+    Target::Field("java/lang/System", "out", "Ljava/io/PrintStream;"),
+    Target::String("hello world"),
+    Target::Class("does/not/Exist"),
+  };
+
+  auto errOrSites = ClassFile::RefScanner::FindReferences(bytes.data(), bytes.size(), targets);
+  ASSERT_TRUE( !errOrSites.IsError() ) << errOrSites.GetError().What;
+
+  const auto& sites = errOrSites.Get();
+  ASSERT_EQ( sites.size(), 3u );
+
+  //in code order: getstatic, ldc, invokevirtual
+  ASSERT_EQ( sites[0].Target, 1u );
+  ASSERT_EQ( sites[0].Op, ClassFile::OpCode::GETSTATIC );
+  ASSERT_EQ( sites[1].Target, 2u );
+  ASSERT_EQ( sites[1].Op, ClassFile::OpCode::LDC );
+  ASSERT_EQ( sites[2].Target, 0u );
+  ASSERT_EQ( sites[2].Op, ClassFile::OpCode::INVOKEVIRTUAL );
+
+  for(const auto& site : sites)
+    ASSERT_EQ( site.MethodName, "main" );
+
+  //an instruction matching several targets is a site of each of them
+  targets.push_back(Target::String("hello world"));
+
+  auto errOrBoth = ClassFile::RefScanner::FindReferences(bytes.data(), bytes.size(), targets);
+  ASSERT_TRUE( !errOrBoth.IsError() ) << errOrBoth.GetError().What;
+  ASSERT_EQ( errOrBoth.Get().size(), 4u );
+  ASSERT_EQ( errOrBoth.Get()[1].Target, 2u );
+  ASSERT_EQ( errOrBoth.Get()[2].Target, 4u );
+  ASSERT_EQ( errOrBoth.Get()[2].PC, errOrBoth.Get()[1].PC );
+}
+
+//every class constant must be found exactly where a full decode finds it
+TEST(RefScannerTest, MatchesDecodedInstructions)
+{
+  for(const char* name : {"/HelloWorld.class", "/Wide.class", "/Complex.class"})
+  {
+    std::string path = std::string{RES_DIR} + name;
+    auto bytes = readFile(path);
+
+    std::ifstream stream{path, std::ios::binary};
+    auto errOrClass = ClassFile::Parser::ParseClassFile(stream);
+    ASSERT_TRUE( !errOrClass.IsError() ) << errOrClass.GetError().What;
+    const ClassFile::ClassFile& cf = errOrClass.Get();
+
+    std::vector<ClassFile::RefScanner::Target> targets;
+    std::vector<ClassFile::U16> indices;
+
+    for(ClassFile::U16 i = 1; i < cf.ConstPool.GetCount(); i++)
+    {
+      if(cf.ConstPool[i] && cf.ConstPool[i]->GetType() == ClassFile::CPInfo::Type::Class)
+      {
+        targets.push_back(ClassFile::RefScanner::Target::Class(
+              std::string{cf.ConstPool.LookupString(i).Get()}));
+        indices.push_back(i);
+      }
+    }
+
+    std::vector<size_t> expected(targets.size(), 0);
+
+    for(const auto& method : cf.Methods)
+    {
+      for(const auto& attr : method.Attributes)
+      {
+        if(attr->GetType() != ClassFile::AttributeInfo::Type::Code)
+          continue;
+
+        for(const auto& instr : static_cast<const ClassFile::CodeAttribute&>(*attr).Code)
+        {
+          if(!ClassFile::HasConstantPoolIndex(instr.GetOpCode()))
+            continue;
+
+          auto itr = std::find(indices.begin(), indices.end(), instr.GetOperand(0).Get());
+          if(itr != indices.end())
+            expected[itr - indices.begin()]++;
+        }
+      }
+    }
+
+    auto errOrSites = ClassFile::RefScanner::FindReferences(bytes.data(), bytes.size(), targets);
+    ASSERT_TRUE( !errOrSites.IsError() ) << errOrSites.GetError().What;
+
+    std::vector<size_t> found(targets.size(), 0);
+    for(const auto& site : errOrSites.Get())
+      found[site.Target]++;
+
+    ASSERT_EQ( found, expected ) << name;
+  }
+}
+
+//Appends an instruction with the given operands to code
+static void emit(ClassFile::CodeAttribute& code, ClassFile::OpCode op,
+    std::initializer_list<ClassFile::S32> operands = {})
+{
+  auto errOrInstr = ClassFile::Instruction::MakeInstruction(op);
+  ASSERT_TRUE( !errOrInstr.IsError() );
+
+  size_t i = 0;
+  for(ClassFile::S32 operand : operands)
+    ASSERT_TRUE( !errOrInstr.Get().SetOperand(i++, operand).IsError() );
+
+  code.Code.push_back(errOrInstr.Release());
+}
+
+TEST(ControlFlowGraphTest, LoopWithHandler)
+{
+  using namespace ClassFile;
+
+  //     int i = 0;
+  //     while(i < 10)
+  //       try { i++; } catch(Throwable t) {}
+  //     return;
+  CodeAttribute code;
+  emit(code, ICONST_0);            //0
+  emit(code, ISTORE_1);            //1
+  emit(code, ILOAD_1);             //2  <- loop header
+  emit(code, BIPUSH, {10});        //3
+  emit(code, IF_ICMPGE, {9});      //5  -> 14
+  emit(code, IINC, {1, 1});        //8  try
+  emit(code, GOTO, {-9});          //11 -> 2
+  emit(code, RETURN);              //14
+  emit(code, ASTORE_2);            //15 handler
+  emit(code, GOTO, {-14});         //16 -> 2
+  code.ExceptionTable.push_back({8, 11, 15, 0});
+
+  auto errOrCfg = ControlFlowGraph::Build(code);
+  ASSERT_TRUE( !errOrCfg.IsError() ) << errOrCfg.GetError().What;
+  const ControlFlowGraph& cfg = errOrCfg.Get();
+
+  //[0,2) [2,5) [5,6) [6,7) [7,8) [8,10)
+  ASSERT_EQ( cfg.GetBlockCount(), 6u );
+  ASSERT_EQ( cfg.GetStart(2), 5u );
+  ASSERT_EQ( cfg.GetEnd(2), 6u );
+  ASSERT_EQ( cfg.GetStartPC(5), 15u );
+  ASSERT_EQ( cfg.GetBlockOf(4), 1u );
+  ASSERT_EQ( cfg.GetBlockOf(9), 5u );
+
+  auto list = [](ControlFlowGraph::Range range)
+  {
+    return std::vector<ControlFlowGraph::BlockId>(range.begin(), range.end());
+  };
+
+  using Blocks = std::vector<ControlFlowGraph::BlockId>;
+  ASSERT_EQ( list(cfg.GetSuccessors(0)), (Blocks{1}) );
+  ASSERT_EQ( list(cfg.GetSuccessors(1)), (Blocks{2, 4}) );
+  ASSERT_EQ( list(cfg.GetSuccessors(3)), (Blocks{1}) );
+  ASSERT_TRUE( cfg.GetSuccessors(4).empty() );
+  ASSERT_EQ( list(cfg.GetExceptionSuccessors(2)), (Blocks{5}) );
+  ASSERT_TRUE( cfg.GetExceptionSuccessors(3).empty() );
+  ASSERT_EQ( cfg.GetPredecessors(1).size(), 3u );
+
+  ASSERT_EQ( cfg.GetImmediateDominator(0), 0u );
+  ASSERT_EQ( cfg.GetImmediateDominator(1), 0u );
+  ASSERT_EQ( cfg.GetImmediateDominator(3), 2u );
+  ASSERT_EQ( cfg.GetImmediateDominator(4), 1u );
+  ASSERT_EQ( cfg.GetImmediateDominator(5), 2u );
+  ASSERT_TRUE( cfg.Dominates(1, 5) );
+  ASSERT_FALSE( cfg.Dominates(3, 5) );
+  ASSERT_FALSE( cfg.Dominates(4, 1) );
+
+  ASSERT_EQ( cfg.GetLoopHeaders(), (Blocks{1}) );
+  ASSERT_EQ( cfg.GetReversePostOrder().size(), 6u );
+  ASSERT_EQ( cfg.GetReversePostOrder().front(), 0u );
+}
+
+TEST(ControlFlowGraphTest, RejectsBranchIntoInstruction)
+{
+  using namespace ClassFile;
+
+  CodeAttribute code;
+  emit(code, BIPUSH, {1});
+  emit(code, GOTO, {-1});
+  ASSERT_TRUE( ControlFlowGraph::Build(code).IsError() );
+}
+
+TEST(ControlFlowGraphTest, BuildsForEveryMethod)
+{
+  std::ifstream file{RES_DIR "/Complex.class", std::ios::binary};
+  auto errOrClass = ClassFile::Parser::ParseClassFile(file);
+  ASSERT_TRUE( !errOrClass.IsError() ) << errOrClass.GetError().What;
+
+  for(const ClassFile::FieldMethodInfo& method : errOrClass.Get().Methods)
+  {
+    for(const auto& attr : method.Attributes)
+    {
+      if(attr->GetType() != ClassFile::AttributeInfo::Type::Code)
+        continue;
+
+      const auto& code = static_cast<const ClassFile::CodeAttribute&>(*attr);
+      auto errOrCfg = ClassFile::ControlFlowGraph::Build(code);
+      ASSERT_TRUE( !errOrCfg.IsError() ) << errOrCfg.GetError().What;
+
+      //every block is reachable in javac output & ends where the next starts
+      const ClassFile::ControlFlowGraph& cfg = errOrCfg.Get();
+      ASSERT_EQ( cfg.GetReversePostOrder().size(), cfg.GetBlockCount() );
+      ASSERT_EQ( cfg.GetEnd(cfg.GetBlockCount() - 1), code.Code.size() );
+    }
+  }
+}
+
+//Adds a static method to cf & returns its Code attribute
+static ClassFile::CodeAttribute& addMethod(ClassFile::ClassFile& cf, const char* name,
+    const char* descriptor)
+{
+  ClassFile::FieldMethodInfo method;
+  method.AccessFlags = static_cast<ClassFile::U16>(ClassFile::FieldMethodInfo::AccessFlag::STATIC);
+  method.NameIndex = cf.ConstPool.FindOrAddUTF8(name).Get();
+  method.DescriptorIndex = cf.ConstPool.FindOrAddUTF8(descriptor).Get();
+
+  auto code = std::make_unique<ClassFile::CodeAttribute>();
+  code->NameIndex = cf.ConstPool.FindOrAddUTF8("Code").Get();
+  ClassFile::CodeAttribute& ref = *code;
+
+  method.Attributes.push_back(std::move(code));
+  cf.Methods.push_back(std::move(method));
+  return ref;
+}
+
+static std::vector<ClassFile::U8> getStackMapTable(const ClassFile::ClassFile& cf,
+    const ClassFile::CodeAttribute& code)
+{
+  for(const auto& attr : code.Attributes)
+  {
+    if(cf.ConstPool.LookupString(attr->NameIndex).Get() == "StackMapTable")
+    {
+      const auto& bytes = static_cast<const ClassFile::RawAttribute&>(*attr).Bytes;
+      return {bytes.begin(), bytes.end()};
+    }
+  }
+
+  return {};
+}
+
+//pcs of the frames in a StackMapTable
+static std::vector<ClassFile::U32> getFramePCs(const std::vector<ClassFile::U8>& table)
+{
+  std::vector<ClassFile::U32> pcs;
+  size_t pos = 2;
+
+  if(table.empty())
+    return pcs;
+
+  auto skipTypes = [&](size_t n)
+  {
+    for(size_t i = 0; i < n; i++)
+      pos += table[pos] >= 7 ? 3 : 1; //Object & Uninitialized carry a U16
+  };
+
+  auto readU16 = [&]()
+  {
+    pos += 2;
+    return static_cast<ClassFile::U32>(table[pos - 2] << 8 | table[pos - 1]);
+  };
+
+  ClassFile::S64 pc = -1;
+
+  for(size_t frame = 0; frame < size_t(table[0] << 8 | table[1]); frame++)
+  {
+    ClassFile::U8 type = table[pos++];
+    ClassFile::U32 delta = type < 64 ? type : type < 128 ? type - 64 : readU16();
+
+    if(type >= 64 && type < 128)
+      skipTypes(1);
+    else if(type == 247)
+      skipTypes(1);
+    else if(type > 251 && type < 255)
+      skipTypes(type - 251);
+    else if(type == 255)
+    {
+      skipTypes(readU16());
+      skipTypes(readU16());
+    }
+
+    pc += delta + 1;
+    pcs.push_back(static_cast<ClassFile::U32>(pc));
+  }
+
+  return pcs;
+}
+
+//Merges every pair of classes to java/lang/Object
+struct objectOracle : public ClassFile::HierarchyOracle
+{
+  ClassFile::ErrorOr<std::string> GetCommonSuperClass(std::string_view,
+      std::string_view) const override
+  {
+    return std::string{"java/lang/Object"};
+  }
+};
+
+TEST(FramesTest, ComputesLoopFrames)
+{
+  using namespace ClassFile;
+
+  std::ifstream file{RES_DIR "/HelloWorld.class", std::ios::binary};
+  auto errOrClass = Parser::ParseClassFile(file);
+  ASSERT_TRUE( !errOrClass.IsError() );
+  ClassFile::ClassFile& cf = errOrClass.Get();
+
+  //for(int i = 0; i < 10; i++) {}
+  CodeAttribute& code = addMethod(cf, "loop", "()V");
+  emit(code, ICONST_0);            //0
+  emit(code, ISTORE_0);            //1
+  emit(code, ILOAD_0);             //2
+  emit(code, BIPUSH, {10});        //3
+  emit(code, IF_ICMPGE, {9});      //5  -> 14
+  emit(code, IINC, {0, 1});        //8
+  emit(code, GOTO, {-9});          //11 -> 2
+  emit(code, RETURN);              //14
+
+  auto result = ComputeFrames(cf, cf.Methods.back(), objectOracle{});
+  ASSERT_TRUE( !result.IsError() ) << result.GetError().What;
+
+  ASSERT_EQ( code.MaxStack, 2 );
+  ASSERT_EQ( code.MaxLocals, 1 );
+
+  //append_frame [int] at 2, same_frame at 14
+  std::vector<U8> expected{0, 2,  252, 0, 2, 1,  11};
+  ASSERT_EQ( getStackMapTable(cf, code), expected );
+
+  code.MaxStack = code.MaxLocals = 0;
+  ASSERT_TRUE( !ComputeMaxs(cf.ConstPool, cf.Methods.back()).IsError() );
+  ASSERT_EQ( code.MaxStack, 2 );
+  ASSERT_EQ( code.MaxLocals, 1 );
+}
+
+//ldc & ldc_w hash the same, so must the frames & local variable ranges
+//after them
+TEST(FramesTest, FingerprintIgnoresFrameOffsets)
+{
+  using namespace ClassFile;
+
+  std::vector<U8> tables[2];
+  Fingerprint fps[2];
+
+  for(OpCode load : {LDC, LDC_W})
+  {
+    std::ifstream file{RES_DIR "/HelloWorld.class", std::ios::binary};
+    auto errOrClass = Parser::ParseClassFile(file);
+    ASSERT_TRUE( !errOrClass.IsError() );
+    ClassFile::ClassFile& cf = errOrClass.Get();
+
+    //for(int i = 1000; i < 10; i++) {}
+    CodeAttribute& code = addMethod(cf, "loop", "()V");
+    emit(code, load, {cf.ConstPool.FindOrAddInteger(1000).Get()});
+    emit(code, ISTORE_0);
+    emit(code, ILOAD_0);
+    emit(code, BIPUSH, {10});
+    emit(code, IF_ICMPGE, {9});
+    emit(code, IINC, {0, 1});
+    emit(code, GOTO, {-9});
+    emit(code, RETURN);
+
+    auto result = ComputeFrames(cf, cf.Methods.back(), objectOracle{});
+    ASSERT_TRUE( !result.IsError() ) << result.GetError().What;
+
+    //i is live from the iload to the end of the code
+    U8 start = load == LDC ? 3 : 4;
+    auto locals = std::make_unique<RawAttribute>();
+    locals->NameIndex = cf.ConstPool.FindOrAddUTF8("LocalVariableTable").Get();
+    U16 name = cf.ConstPool.FindOrAddUTF8("i").Get();
+    U16 descriptor = cf.ConstPool.FindOrAddUTF8("I").Get();
+    locals->Bytes = {0, 1,  0, start,  0, 13,  U8(name >> 8), U8(name),
+                     U8(descriptor >> 8), U8(descriptor),  0, 0};
+    code.Attributes.push_back(std::move(locals));
+
+    auto errOrFp = ComputeFingerprint(cf);
+    ASSERT_TRUE( !errOrFp.IsError() ) << errOrFp.GetError().What;
+
+    tables[load == LDC_W] = getStackMapTable(cf, code);
+    fps[load == LDC_W] = errOrFp.Get();
+  }
+
+  ASSERT_NE( tables[0], tables[1] );
+  ASSERT_EQ( fps[0], fps[1] );
+}
+
+TEST(FramesTest, FramesBranchTargetAtZero)
+{
+  using namespace ClassFile;
+
+  std::ifstream file{RES_DIR "/HelloWorld.class", std::ios::binary};
+  auto errOrClass = Parser::ParseClassFile(file);
+  ASSERT_TRUE( !errOrClass.IsError() );
+  ClassFile::ClassFile& cf = errOrClass.Get();
+
+  //the loop head is the first instruction
+  CodeAttribute& code = addMethod(cf, "spin", "()V");
+  emit(code, ICONST_0);            //0
+  emit(code, IFEQ, {-1});          //1  -> 0
+  emit(code, RETURN);              //4
+
+  auto result = ComputeFrames(cf, cf.Methods.back(), objectOracle{});
+  ASSERT_TRUE( !result.IsError() ) << result.GetError().What;
+
+  //same_frame at 0
+  std::vector<U8> expected{0, 1,  0};
+  ASSERT_EQ( getStackMapTable(cf, code), expected );
+}
+
+TEST(FramesTest, ReplacesUnreachableCode)
+{
+  using namespace ClassFile;
+
+  std::ifstream file{RES_DIR "/HelloWorld.class", std::ios::binary};
+  auto errOrClass = Parser::ParseClassFile(file);
+  ASSERT_TRUE( !errOrClass.IsError() );
+  ClassFile::ClassFile& cf = errOrClass.Get();
+
+  CodeAttribute& code = addMethod(cf, "dead", "()V");
+  emit(code, RETURN);
+  emit(code, BIPUSH, {1});
+  emit(code, POP);
+  emit(code, RETURN);
+
+  auto result = ComputeFrames(cf, cf.Methods.back(), objectOracle{});
+  ASSERT_TRUE( !result.IsError() ) << result.GetError().What;
+
+  std::vector<OpCode> ops;
+  for(const Instruction& instr : code.Code)
+    ops.push_back(instr.GetOpCode());
+
+  ASSERT_EQ( ops, (std::vector<OpCode>{RETURN, NOP, NOP, NOP, ATHROW}) );
+
+  //same_locals_1_stack_item_frame at 1 holding a Throwable
+  U16 throwable = cf.ConstPool.FindOrAddClass("java/lang/Throwable").Get();
+  std::vector<U8> expected{0, 1,  65, 7, static_cast<U8>(throwable >> 8), static_cast<U8>(throwable)};
+  ASSERT_EQ( getStackMapTable(cf, code), expected );
+}
+
+TEST(FramesTest, MatchesCompilerFramesAndMaxs)
+{
+  using namespace ClassFile;
+
+  std::ifstream file{RES_DIR "/Complex.class", std::ios::binary};
+  auto errOrClass = Parser::ParseClassFile(file);
+  ASSERT_TRUE( !errOrClass.IsError() );
+  ClassFile::ClassFile& cf = errOrClass.Get();
+
+  for(FieldMethodInfo& method : cf.Methods)
+  {
+    for(auto& attr : method.Attributes)
+    {
+      if(attr->GetType() != AttributeInfo::Type::Code)
+        continue;
+
+      auto& code = static_cast<CodeAttribute&>(attr.Mutate());
+      U16 maxStack = code.MaxStack, maxLocals = code.MaxLocals;
+      std::vector<U8> original = getStackMapTable(cf, code);
+
+      ASSERT_TRUE( !ComputeMaxs(cf.ConstPool, method).IsError() );
+      ASSERT_EQ( code.MaxStack, maxStack );
+      ASSERT_EQ( code.MaxLocals, maxLocals );
+
+      //the types may be more precise than the compiler's, which drops the
+      //locals that aren't live anymore, but frames go to the same places
+      auto result = ComputeFrames(cf, method, objectOracle{});
+      ASSERT_TRUE( !result.IsError() ) << result.GetError().What;
+      ASSERT_EQ( code.MaxStack, maxStack );
+      ASSERT_EQ( code.MaxLocals, maxLocals );
+      ASSERT_EQ( getFramePCs(getStackMapTable(cf, code)), getFramePCs(original) );
+    }
+  }
+}
+
+TEST(FramesTest, ClassHierarchyOracle)
+{
+  auto errOrPaths = ClassFile::Classpath::ListClassFiles(RES_DIR);
+  ASSERT_TRUE( !errOrPaths.IsError() );
+
+  auto errOrHierarchy = ClassFile::ClassHierarchy::Build(errOrPaths.Get());
+  ASSERT_TRUE( !errOrHierarchy.IsError() );
+
+  ClassFile::ClassHierarchyOracle oracle{errOrHierarchy.Get()};
+
+  auto errOrCommon = oracle.GetCommonSuperClass("HelloWorld", "Wide");
+  ASSERT_TRUE( !errOrCommon.IsError() ) << errOrCommon.GetError().What;
+  ASSERT_EQ( errOrCommon.Get(), "java/lang/Object" );
+
+  ASSERT_TRUE( oracle.GetCommonSuperClass("HelloWorld", "does/not/Exist").IsError() );
+}
+
+static std::vector<ClassFile::U32> getPCs(const ClassFile::CodeAttribute& code)
+{
+  std::vector<ClassFile::U32> pcs;
+  ClassFile::U32 pc = 0;
+
+  for(const ClassFile::Instruction& instr : code.Code)
+  {
+    pcs.push_back(pc);
+    pc += static_cast<ClassFile::U32>(instr.GetLength());
+  }
+
+  return pcs;
+}
+
+static ClassFile::Instruction makeInstruction(ClassFile::OpCode op)
+{
+  return ClassFile::Instruction::MakeInstruction(op).Release();
+}
+
+TEST(CodeEditorTest, InsertsBeforeLoopHeader)
+{
+  using namespace ClassFile;
+
+  std::ifstream file{RES_DIR "/HelloWorld.class", std::ios::binary};
+  auto errOrClass = Parser::ParseClassFile(file);
+  ASSERT_TRUE( !errOrClass.IsError() );
+  ClassFile::ClassFile& cf = errOrClass.Get();
+
+  CodeAttribute& code = addMethod(cf, "loop", "()V");
+  emit(code, ICONST_0);            //0
+  emit(code, ISTORE_0);            //1
+  emit(code, ILOAD_0);             //2
+  emit(code, BIPUSH, {10});        //3
+  emit(code, IF_ICMPGE, {9});      //5  -> 14
+  emit(code, IINC, {0, 1});        //8
+  emit(code, GOTO, {-9});          //11 -> 2
+  emit(code, RETURN);              //14
+
+  ASSERT_TRUE( !ComputeFrames(cf, cf.Methods.back(), objectOracle{}).IsError() );
+  code.ExceptionTable.push_back({2, 14, 14, 0});
+
+  auto lines = std::make_unique<LineNumberTableAttribute>();
+  lines->NameIndex = cf.ConstPool.FindOrAddUTF8("LineNumberTable").Get();
+  lines->LineNumberMap = {{0, 1}, {2, 2}, {14, 3}};
+  LineNumberTableAttribute& lineTable = *lines;
+  code.Attributes.push_back(std::move(lines));
+
+  CodeEditor editor{cf.ConstPool, code};
+  CodeEditor::Sequence probe;
+  probe.Add(makeInstruction(NOP));
+  probe.Add(makeInstruction(NOP));
+  editor.InsertBefore(2, std::move(probe));
+
+  auto result = editor.Commit();
+  ASSERT_TRUE( !result.IsError() ) << result.GetError().What;
+  ASSERT_FALSE( editor.HasEdits() );
+  ASSERT_EQ( code.Code.size(), 10u );
+
+  //the loop jumps back to the inserted code, the exit skips over it
+  ASSERT_EQ( code.Code[6].GetBranchOffset().Get(), 9 );
+  ASSERT_EQ( code.Code[8].GetBranchOffset().Get(), -11 );
+
+  ASSERT_EQ( code.ExceptionTable[0].StartPC, 2 );
+  ASSERT_EQ( code.ExceptionTable[0].EndPC, 16 );
+  ASSERT_EQ( code.ExceptionTable[0].HandlerPC, 16 );
+
+  ASSERT_EQ( lineTable.LineNumberMap[1].PC, 2 );
+  ASSERT_EQ( lineTable.LineNumberMap[2].PC, 16 );
+  ASSERT_EQ( getFramePCs(getStackMapTable(cf, code)), (std::vector<U32>{2, 16}) );
+}
+
+TEST(CodeEditorTest, WidensBranches)
+{
+  using namespace ClassFile;
+
+  std::ifstream file{RES_DIR "/HelloWorld.class", std::ios::binary};
+  auto errOrClass = Parser::ParseClassFile(file);
+  ASSERT_TRUE( !errOrClass.IsError() );
+  ClassFile::ClassFile& cf = errOrClass.Get();
+
+  CodeAttribute& code = addMethod(cf, "far", "()V");
+  emit(code, ICONST_0);            //0
+  emit(code, IFEQ, {3});           //1 -> 4
+  emit(code, RETURN);              //4
+
+  CodeEditor editor{cf.ConstPool, code};
+  CodeEditor::Sequence padding;
+  for(int i = 0; i < 40000; i++)
+    padding.Add(makeInstruction(NOP));
+  editor.InsertAfter(1, std::move(padding));
+
+  auto result = editor.Commit();
+  ASSERT_TRUE( !result.IsError() ) << result.GetError().What;
+  ASSERT_EQ( code.Code.size(), 40004u );
+
+  ASSERT_EQ( code.Code[1].GetOpCode(), IFNE );
+  ASSERT_EQ( code.Code[1].GetBranchOffset().Get(), 8 );
+  ASSERT_EQ( code.Code[2].GetOpCode(), GOTO_W );
+  ASSERT_EQ( code.Code[2].GetBranchOffset().Get(), 40005 );
+  ASSERT_EQ( getPCs(code).back(), 40009u );
+}
+
+TEST(CodeEditorTest, ResolvesLabelsInInsertedCode)
+{
+  using namespace ClassFile;
+
+  std::ifstream file{RES_DIR "/HelloWorld.class", std::ios::binary};
+  auto errOrClass = Parser::ParseClassFile(file);
+  ASSERT_TRUE( !errOrClass.IsError() );
+  ClassFile::ClassFile& cf = errOrClass.Get();
+
+  CodeAttribute& code = addMethod(cf, "labels", "()V");
+  emit(code, ICONST_0);            //0
+  emit(code, POP);                 //1
+  emit(code, RETURN);              //2
+
+  //an unbound label fails without touching the code
+  {
+    CodeEditor editor{cf.ConstPool, code};
+    CodeEditor::Sequence seq;
+    seq.AddBranch(makeInstruction(GOTO), editor.NewLabel());
+    editor.InsertBefore(0, std::move(seq));
+
+    ASSERT_TRUE( editor.Commit().IsError() );
+    ASSERT_EQ( code.Code.size(), 3u );
+  }
+
+  //so does the label of an instruction past the code, instead of aliasing
+  //the first new label
+  {
+    CodeEditor editor{cf.ConstPool, code};
+#ifdef NDEBUG
+    CodeEditor::Sequence seq;
+    seq.AddBranch(makeInstruction(GOTO), editor.GetLabel(3));
+    seq.Bind(editor.NewLabel());
+    editor.InsertBefore(0, std::move(seq));
+
+    ASSERT_TRUE( editor.Commit().IsError() );
+    ASSERT_EQ( code.Code.size(), 3u );
+#else
+    ASSERT_DEATH( editor.GetLabel(3), "original instruction" );
+#endif
+  }
+
+  //goto skip; nop; skip: iconst_0 ... & a jump to the original return
+  CodeEditor editor{cf.ConstPool, code};
+  CodeEditor::Label skip = editor.NewLabel();
+
+  CodeEditor::Sequence seq;
+  seq.AddBranch(makeInstruction(GOTO), skip);
+  seq.Add(makeInstruction(NOP));
+  seq.Bind(skip);
+  editor.InsertBefore(0, std::move(seq));
+
+  CodeEditor::Sequence exit;
+  exit.AddBranch(makeInstruction(GOTO), editor.GetLabel(2));
+  editor.Replace(1, std::move(exit));
+
+  auto result = editor.Commit();
+  ASSERT_TRUE( !result.IsError() ) << result.GetError().What;
+
+  std::vector<OpCode> ops;
+  for(const Instruction& instr : code.Code)
+    ops.push_back(instr.GetOpCode());
+
+  ASSERT_EQ( ops, (std::vector<OpCode>{GOTO, NOP, ICONST_0, GOTO, RETURN}) );
+  ASSERT_EQ( code.Code[0].GetBranchOffset().Get(), 4 );
+  ASSERT_EQ( code.Code[3].GetBranchOffset().Get(), 3 );
+}
+
+TEST(CodeEditorTest, InsertsProbesEverywhere)
+{
+  using namespace ClassFile;
+
+  std::ifstream file{RES_DIR "/Complex.class", std::ios::binary};
+  auto errOrClass = Parser::ParseClassFile(file);
+  ASSERT_TRUE( !errOrClass.IsError() );
+  ClassFile::ClassFile& cf = errOrClass.Get();
+
+  for(FieldMethodInfo& method : cf.Methods)
+  {
+    for(auto& attr : method.Attributes)
+    {
+      if(attr->GetType() != AttributeInfo::Type::Code)
+        continue;
+
+      auto& code = static_cast<CodeAttribute&>(attr.Mutate());
+      std::vector<U32> pcs = getPCs(code);
+      std::vector<U32> framePCs = getFramePCs(getStackMapTable(cf, code));
+
+      CodeEditor editor{cf.ConstPool, code};
+
+      for(size_t i = 0; i < code.Code.size(); i++)
+      {
+        CodeEditor::Sequence probe;
+        probe.Add(makeInstruction(NOP));
+        editor.InsertBefore(i, std::move(probe));
+      }
+
+      auto result = editor.Commit();
+      ASSERT_TRUE( !result.IsError() ) << result.GetError().What;
+
+      //every instruction moved by the number of probes before it
+      for(U32& pc : framePCs)
+        pc += static_cast<U32>(std::find(pcs.begin(), pcs.end(), pc) - pcs.begin());
+
+      ASSERT_EQ( getFramePCs(getStackMapTable(cf, code)), framePCs );
+      ASSERT_TRUE( !ControlFlowGraph::Build(code).IsError() );
+      ASSERT_TRUE( !ComputeFrames(cf, method, objectOracle{}).IsError() );
+      ASSERT_EQ( getFramePCs(getStackMapTable(cf, code)), framePCs );
+    }
+  }
+}
+
+TEST(PeepholeTest, AppliesRules)
+{
+  using namespace ClassFile;
+
+  std::ifstream file{RES_DIR "/HelloWorld.class", std::ios::binary};
+  auto errOrClass = Parser::ParseClassFile(file);
+  ASSERT_TRUE( !errOrClass.IsError() );
+  ClassFile::ClassFile& cf = errOrClass.Get();
+
+  S32 string = cf.ConstPool.FindOrAddString("hello world").Get();
+  ASSERT_LT( string, 256 );
+
+  CodeAttribute& code = addMethod(cf, "redundant", "()V");
+  emit(code, ICONST_0);
+  emit(code, ISTORE_0);
+  emit(code, ILOAD_0);             //store & load of the same local
+  emit(code, POP);
+  emit(code, NOP);
+  emit(code, GOTO, {3});           //to the next instruction
+  emit(code, LDC_W, {string});
+  emit(code, POP);
+  emit(code, ILOAD_0);
+  emit(code, ISTORE_0);            //load & store of the same local
+  emit(code, RETURN);
+  emit(code, ICONST_1);            //unreachable
+  emit(code, RETURN);
+  code.MaxStack = 1;
+  code.MaxLocals = 1;
+
+  auto errOrCount = Transform::OptimizePeephole(cf, cf.Methods.back(), objectOracle{});
+  ASSERT_TRUE( !errOrCount.IsError() ) << errOrCount.GetError().What;
+  ASSERT_EQ( errOrCount.Get(), 6u );
+
+  //the method got the rewritten copy of its code
+  const auto& optimized = static_cast<const CodeAttribute&>(*cf.Methods.back().Attributes[0]);
+  ASSERT_NE( &optimized, &code );
+
+  std::vector<OpCode> ops;
+  for(const Instruction& instr : optimized.Code)
+    ops.push_back(instr.GetOpCode());
+
+  ASSERT_EQ( ops, (std::vector<OpCode>{ICONST_0, DUP, ISTORE_0, POP, LDC, POP, RETURN}) );
+  ASSERT_EQ( optimized.Code[4].GetOperand(0).Get(), string );
+  ASSERT_EQ( optimized.MaxStack, 2 );
+
+  //nothing left to do
+  errOrCount = Transform::OptimizePeephole(cf, cf.Methods.back(), objectOracle{});
+  ASSERT_TRUE( !errOrCount.IsError() );
+  ASSERT_EQ( errOrCount.Get(), 0u );
+}
+
+//Fails every merge of two classes
+struct failingOracle : public ClassFile::HierarchyOracle
+{
+  ClassFile::ErrorOr<std::string> GetCommonSuperClass(std::string_view,
+      std::string_view) const override
+  {
+    return ClassFile::Error{"no hierarchy"};
+  }
+};
+
+TEST(PeepholeTest, KeepsCodeOnFailure)
+{
+  using namespace ClassFile;
+
+  std::ifstream file{RES_DIR "/HelloWorld.class", std::ios::binary};
+  auto errOrClass = Parser::ParseClassFile(file);
+  ASSERT_TRUE( !errOrClass.IsError() );
+  ClassFile::ClassFile& cf = errOrClass.Get();
+
+  S32 string = cf.ConstPool.FindOrAddString("hello world").Get();
+  S32 out = cf.ConstPool.FindOrAddFieldref("java/lang/System", "out", "Ljava/io/PrintStream;").Get();
+
+  //a String & a PrintStream merge in local 0
+  CodeAttribute& code = addMethod(cf, "merge", "()V");
+  emit(code, ICONST_0);            //0
+  emit(code, IFEQ, {9});           //1  -> 10
+  emit(code, LDC, {string});       //4
+  emit(code, ASTORE_0);            //6
+  emit(code, GOTO, {7});           //7  -> 14
+  emit(code, GETSTATIC, {out});    //10
+  emit(code, ASTORE_0);            //13
+  emit(code, NOP);                 //14
+  emit(code, RETURN);              //15
+
+  ASSERT_TRUE( !ComputeFrames(cf, cf.Methods.back(), objectOracle{}).IsError() );
+
+  const AttributeInfo* before = &*cf.Methods.back().Attributes[0];
+  std::vector<U8> frames = getStackMapTable(cf, code);
+  ASSERT_FALSE( frames.empty() );
+
+  //the nop goes, then recomputing the frames fails
+  auto errOrCount = Transform::OptimizePeephole(cf, cf.Methods.back(), failingOracle{});
+  ASSERT_TRUE( errOrCount.IsError() );
+
+  const auto& kept = static_cast<const CodeAttribute&>(*cf.Methods.back().Attributes[0]);
+  ASSERT_EQ( &kept, before );
+  ASSERT_EQ( kept.Code.size(), 9u );
+  ASSERT_EQ( getStackMapTable(cf, kept), frames );
+}
+
+TEST(PeepholeTest, KeepsCompilerOutputValid)
+{
+  using namespace ClassFile;
+
+  std::ifstream file{RES_DIR "/Complex.class", std::ios::binary};
+  auto errOrClass = Parser::ParseClassFile(file);
+  ASSERT_TRUE( !errOrClass.IsError() );
+  ClassFile::ClassFile& cf = errOrClass.Get();
+
+  auto errOrCount = Transform::OptimizePeephole(cf, objectOracle{});
+  ASSERT_TRUE( !errOrCount.IsError() ) << errOrCount.GetError().What;
+
+  for(FieldMethodInfo& method : cf.Methods)
+  {
+    for(auto& attr : method.Attributes)
+    {
+      if(attr->GetType() != AttributeInfo::Type::Code)
+        continue;
+
+      auto& code = static_cast<CodeAttribute&>(attr.Mutate());
+      ASSERT_TRUE( !ControlFlowGraph::Build(code).IsError() );
+      ASSERT_TRUE( !ComputeFrames(cf, method, objectOracle{}).IsError() );
+    }
+  }
+}
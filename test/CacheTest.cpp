@@ -0,0 +1,196 @@
+#include <gtest/gtest.h>
+
+#include <ClassFile/ClassFile.hpp>
+#include <ClassFile/Classpath.hpp>
+#include <ClassFile/ClasspathIndex.hpp>
+#include <ClassFile/Fingerprint.hpp>
+#include <ClassFile/Snapshot.hpp>
+
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+#ifndef RES_DIR
+  #define RES_DIR "res"
+#endif
+
+//fresh directory below the build tree for each test
+static std::string makeTempDir(const char* name)
+{
+  std::filesystem::path dir = std::filesystem::temp_directory_path() / "ClassFileTest" / name;
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  return dir.string();
+}
+
+TEST(SnapshotTest, ViewsMatchParsedClasses)
+{
+  auto errOrPaths = ClassFile::Classpath::ListClassFiles(RES_DIR);
+  ASSERT_TRUE( !errOrPaths.IsError() ) << errOrPaths.GetError().What;
+
+  ClassFile::SnapshotCache cache{makeTempDir("Snapshot")};
+
+  auto errOrSnapshot = cache.LoadOrBuild(errOrPaths.Get());
+  ASSERT_TRUE( !errOrSnapshot.IsError() ) << errOrSnapshot.GetError().What;
+
+  const ClassFile::Snapshot& snapshot = errOrSnapshot.Get();
+  ASSERT_EQ( snapshot.GetClassCount(), 3u );
+  ASSERT_EQ( snapshot.Find("does/not/Exist"), ~ClassFile::U32{0} );
+
+  ClassFile::U32 index = snapshot.Find("HelloWorld");
+  ASSERT_NE( index, ~ClassFile::U32{0} );
+
+  ClassFile::ClassView view = snapshot.GetClass(index);
+  ASSERT_EQ( view.GetName(), "HelloWorld" );
+  ASSERT_EQ( view.GetSuperName(), "java/lang/Object" );
+
+  auto errOrClass = view.Parse();
+  ASSERT_TRUE( !errOrClass.IsError() ) << errOrClass.GetError().What;
+  const ClassFile::ClassFile& cf = errOrClass.Get();
+
+  ASSERT_EQ( view.GetConstCount(), cf.ConstPool.GetCount() );
+  ASSERT_EQ( view.GetMethodCount(), cf.Methods.size() );
+
+  for(ClassFile::U16 m = 0; m < view.GetMethodCount(); m++)
+  {
+    ClassFile::MemberView method = view.GetMethod(m);
+    ASSERT_EQ( method.GetName(), cf.ConstPool.LookupString(cf.Methods[m].NameIndex).Get() );
+
+    const auto& code = static_cast<const ClassFile::CodeAttribute&>(*cf.Methods[m].Attributes[0]);
+
+    ClassFile::U32 length = 0;
+    for(const auto& instr : code.Code)
+      length += static_cast<ClassFile::U32>(instr.GetLength());
+
+    ASSERT_NE( method.GetCode(), nullptr );
+    ASSERT_EQ( method.GetCodeLength(), length );
+  }
+
+  //a second lookup maps the stored file instead of building it again
+  auto errOrKey = ClassFile::SnapshotCache::HashFiles(errOrPaths.Get());
+  ASSERT_TRUE( !errOrKey.IsError() );
+  ASSERT_EQ( snapshot.GetKey(), errOrKey.Get() );
+
+  auto errOrLoaded = cache.Load(errOrKey.Get());
+  ASSERT_TRUE( !errOrLoaded.IsError() ) << errOrLoaded.GetError().What;
+  ASSERT_EQ( errOrLoaded.Get().GetClassCount(), 3u );
+}
+
+TEST(SnapshotTest, RejectsTruncatedFiles)
+{
+  auto errOrPaths = ClassFile::Classpath::ListClassFiles(RES_DIR);
+  ASSERT_TRUE( !errOrPaths.IsError() );
+
+  ClassFile::SnapshotCache cache{makeTempDir("Truncated")};
+
+  auto errOrSnapshot = cache.LoadOrBuild(errOrPaths.Get());
+  ASSERT_TRUE( !errOrSnapshot.IsError() ) << errOrSnapshot.GetError().What;
+
+  std::string path = cache.GetPath(errOrSnapshot.Get().GetKey());
+  std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+
+  ASSERT_TRUE( ClassFile::Snapshot::Open(path).IsError() );
+}
+
+TEST(SnapshotTest, ConcurrentWritersDontClash)
+{
+  auto errOrPaths = ClassFile::Classpath::ListClassFiles(RES_DIR);
+  ASSERT_TRUE( !errOrPaths.IsError() );
+
+  ClassFile::SnapshotWriter writer;
+  for(const std::string& classPath : errOrPaths.Get())
+  {
+    auto errOrBytes = ClassFile::Classpath::ReadFile(classPath);
+    ASSERT_TRUE( !errOrBytes.IsError() );
+    ASSERT_TRUE( !writer.Add(errOrBytes.Get().data(), errOrBytes.Get().size()).IsError() );
+  }
+
+  std::string dir = makeTempDir("Writers");
+  std::string path = dir + "/shared.snapshot";
+
+  std::vector<std::thread> threads;
+  for(int t = 0; t < 4; t++)
+  {
+    threads.emplace_back([&]
+    {
+      for(int i = 0; i < 8; i++)
+        EXPECT_TRUE( !writer.Write(path, ClassFile::Fingerprint{}).IsError() );
+    });
+  }
+
+  for(auto& thread : threads)
+    thread.join();
+
+  auto errOrSnapshot = ClassFile::Snapshot::Open(path);
+  ASSERT_TRUE( !errOrSnapshot.IsError() ) << errOrSnapshot.GetError().What;
+  ASSERT_EQ( errOrSnapshot.Get().GetClassCount(), 3u );
+
+  //no temporary files are left behind
+  auto entries = std::filesystem::directory_iterator{dir};
+  ASSERT_EQ( std::distance(begin(entries), end(entries)), 1 );
+}
+
+TEST(ClasspathIndexTest, RefreshesOnlyChangedFiles)
+{
+  namespace fs = std::filesystem;
+
+  std::string root = makeTempDir("Index");
+  std::string manifest = (fs::path{root} / "index.manifest").string();
+
+  for(const char* name : {"HelloWorld.class", "Wide.class", "Complex.class"})
+    fs::copy_file(fs::path{RES_DIR} / name, fs::path{root} / name);
+
+  auto errOrIndex = ClassFile::ClasspathIndex::Open(root, manifest);
+  ASSERT_TRUE( !errOrIndex.IsError() ) << errOrIndex.GetError().What;
+  ClassFile::ClasspathIndex& index = errOrIndex.Get();
+
+  auto errOrStats = index.Refresh();
+  ASSERT_TRUE( !errOrStats.IsError() ) << errOrStats.GetError().What;
+  ASSERT_EQ( errOrStats.Get().Added, 3u );
+  ASSERT_TRUE( errOrStats.Get().Errors.empty() );
+
+  std::string helloWorld = (fs::path{root} / "HelloWorld.class").string();
+
+  ASSERT_EQ( index.FindDefinitions("HelloWorld"), std::vector<std::string>{helloWorld} );
+  ASSERT_EQ( index.FindClassReferences("java/lang/System").size(), 2u );
+  ASSERT_EQ( index.FindStringReferences("hello world"), std::vector<std::string>{helloWorld} );
+  ASSERT_TRUE( index.GetHierarchy().IsDefined(index.GetHierarchy().Find("HelloWorld")) );
+
+  errOrStats = index.Refresh();
+  ASSERT_TRUE( !errOrStats.IsError() );
+  ASSERT_EQ( errOrStats.Get().Unchanged, 3u );
+  ASSERT_EQ( errOrStats.Get().Added + errOrStats.Get().Changed + errOrStats.Get().Removed, 0u );
+
+  //a touched file with the same content isn't reindexed, a replaced one is
+  fs::last_write_time(helloWorld, fs::last_write_time(helloWorld) + std::chrono::seconds{5});
+  fs::copy_file(fs::path{RES_DIR} / "Wide.class", fs::path{root} / "Complex.class",
+      fs::copy_options::overwrite_existing);
+
+  errOrStats = index.Refresh();
+  ASSERT_TRUE( !errOrStats.IsError() );
+  ASSERT_EQ( errOrStats.Get().Unchanged, 2u );
+  ASSERT_EQ( errOrStats.Get().Changed, 1u );
+  ASSERT_EQ( index.FindDefinitions("Wide").size(), 2u );
+  ASSERT_EQ( index.FindClassReferences("java/lang/System"), std::vector<std::string>{helloWorld} );
+
+  fs::remove(helloWorld);
+
+  errOrStats = index.Refresh();
+  ASSERT_TRUE( !errOrStats.IsError() );
+  ASSERT_EQ( errOrStats.Get().Removed, 1u );
+  ASSERT_TRUE( index.FindDefinitions("HelloWorld").empty() );
+  ASSERT_TRUE( index.FindStringReferences("hello world").empty() );
+  ASSERT_EQ( index.GetHierarchy().Find("HelloWorld"), ClassFile::ClassHierarchy::InvalidId );
+
+  //the manifest carries everything over to the next session
+  auto errOrReopened = ClassFile::ClasspathIndex::Open(root, manifest);
+  ASSERT_TRUE( !errOrReopened.IsError() );
+  ClassFile::ClasspathIndex& reopened = errOrReopened.Get();
+
+  ASSERT_EQ( reopened.GetFileCount(), 2u );
+  ASSERT_EQ( reopened.FindDefinitions("Wide").size(), 2u );
+
+  errOrStats = reopened.Refresh();
+  ASSERT_TRUE( !errOrStats.IsError() );
+  ASSERT_EQ( errOrStats.Get().Unchanged, 2u );
+}
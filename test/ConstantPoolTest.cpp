@@ -0,0 +1,309 @@
+#include <gtest/gtest.h>
+
+#include <ClassFile/ClassFile.hpp>
+#include <ClassFile/Parser.hpp>
+#include <ClassFile/Serializer.hpp>
+#include <ClassFile/Transform.hpp>
+#include <ClassFile/Shrink.hpp>
+#include <ClassFile/Fingerprint.hpp>
+#include <ClassFile/Error.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#ifndef RES_DIR
+  #define RES_DIR "res"
+#endif
+
+static ClassFile::ClassFile parseResource(const char* path)
+{
+  std::ifstream is{path};
+  EXPECT_TRUE(is.good()) << "unable to open " << path;
+
+  auto errOrClass = ClassFile::Parser::ParseClassFile(is);
+  EXPECT_TRUE( !errOrClass.IsError() ) << errOrClass.GetError().What;
+
+  return errOrClass.Release();
+}
+
+static ClassFile::ClassFile roundTrip(const ClassFile::ClassFile& cf)
+{
+  std::stringstream ss;
+  auto err = ClassFile::Serializer::SerializeClassFile(ss, cf);
+  EXPECT_TRUE( !err.IsError() ) << err.GetError().What;
+
+  auto errOrClass = ClassFile::Parser::ParseClassFile(ss);
+  EXPECT_TRUE( !errOrClass.IsError() ) << errOrClass.GetError().What;
+
+  return errOrClass.Release();
+}
+
+class ConstantPoolTest : public ::testing::Test
+{
+  protected:
+    ClassFile::ClassFile cf;
+
+    void SetUp() override
+    {
+      cf = parseResource(RES_DIR"/HelloWorld.class");
+    }
+};
+
+TEST_F(ConstantPoolTest, FindOrAddFindsExistingEntries)
+{
+  ClassFile::ConstantPool& cp = cf.ConstPool;
+  ClassFile::U16 sizeBefore = cp.GetSize();
+
+  auto errOrClass = cp.FindOrAddClass("java/lang/Object");
+  ASSERT_TRUE( !errOrClass.IsError() ) << errOrClass.GetError().What;
+  ASSERT_EQ( errOrClass.Get(), cf.SuperClass );
+
+  auto errOrRef = cp.FindOrAddMethodref("java/io/PrintStream", "println", "(Ljava/lang/String;)V");
+  ASSERT_TRUE( !errOrRef.IsError() ) << errOrRef.GetError().What;
+  ASSERT_EQ( cp[errOrRef.Get()]->GetType(), ClassFile::CPInfo::Type::Methodref );
+  ASSERT_EQ( cp.LookupString(errOrRef.Get()).Get(), "println" );
+
+  ASSERT_EQ( cp.GetSize(), sizeBefore );
+}
+
+TEST_F(ConstantPoolTest, FindOrAddAppendsNewEntriesOnce)
+{
+  ClassFile::ConstantPool& cp = cf.ConstPool;
+  ClassFile::U16 sizeBefore = cp.GetSize();
+
+  auto errOrRef = cp.FindOrAddFieldref("HelloWorld", "counter", "I");
+  ASSERT_TRUE( !errOrRef.IsError() ) << errOrRef.GetError().What;
+
+  //"counter", "I", NameAndType & Fieldref. "HelloWorld" and its Class entry already exist
+  ASSERT_EQ( cp.GetSize(), sizeBefore + 4 );
+  ASSERT_EQ( cp.LookupDescriptor(errOrRef.Get()).Get(), "I" );
+
+  auto errOrAgain = cp.FindOrAddFieldref("HelloWorld", "counter", "I");
+  ASSERT_EQ( errOrAgain.Get(), errOrRef.Get() );
+  ASSERT_EQ( cp.GetSize(), sizeBefore + 4 );
+}
+
+TEST_F(ConstantPoolTest, FindOrAddLongReservesTwoSlots)
+{
+  ClassFile::ConstantPool& cp = cf.ConstPool;
+  ClassFile::U16 sizeBefore = cp.GetSize();
+
+  ClassFile::U16 index = cp.FindOrAddLong(1, 2).Get();
+  ASSERT_EQ( cp.GetSize(), sizeBefore + 2 );
+  ASSERT_EQ( cp[index+1], nullptr );
+
+  ASSERT_EQ( cp.FindOrAddLong(1, 2).Get(), index );
+  ASSERT_NE( cp.FindOrAddDouble(1, 2).Get(), index );
+}
+
+TEST_F(ConstantPoolTest, FindOrAddMethodHandleChecksReferenceKind)
+{
+  ClassFile::ConstantPool& cp = cf.ConstPool;
+  ClassFile::U16 field  = cp.FindOrAddFieldref("HelloWorld", "counter", "I").Get();
+  ClassFile::U16 method = cp.FindOrAddMethodref("java/io/PrintStream", "println", "(Ljava/lang/String;)V").Get();
+  ClassFile::U16 utf8   = cp.FindOrAddUTF8("counter").Get();
+  ClassFile::U16 sizeBefore = cp.GetSize();
+
+  //REF_getField needs a Fieldref, REF_invokeVirtual a Methodref
+  ASSERT_TRUE( cp.FindOrAddMethodHandle(0, field).IsError() );
+  ASSERT_TRUE( cp.FindOrAddMethodHandle(10, method).IsError() );
+  ASSERT_TRUE( cp.FindOrAddMethodHandle(1, method).IsError() );
+  ASSERT_TRUE( cp.FindOrAddMethodHandle(5, field).IsError() );
+  ASSERT_TRUE( cp.FindOrAddMethodHandle(9, method).IsError() );
+  ASSERT_TRUE( cp.FindOrAddMethodHandle(5, utf8).IsError() );
+  ASSERT_EQ( cp.GetSize(), sizeBefore );
+
+  ASSERT_FALSE( cp.FindOrAddMethodHandle(1, field).IsError() );
+  ASSERT_FALSE( cp.FindOrAddMethodHandle(5, method).IsError() );
+  ASSERT_FALSE( cp.FindOrAddMethodHandle(6, method).IsError() );
+}
+
+TEST_F(ConstantPoolTest, ResolvesMemberRefs)
+{
+  ClassFile::ConstantPool& cp = cf.ConstPool;
+
+  auto errOrIndex = cp.FindOrAddMethodref("java/io/PrintStream", "println", "(Ljava/lang/String;)V");
+  ASSERT_TRUE( !errOrIndex.IsError() ) << errOrIndex.GetError().What;
+  ClassFile::U16 index = errOrIndex.Get();
+
+  auto errOrRef = cp.ResolveMemberRef(index);
+  ASSERT_TRUE( !errOrRef.IsError() ) << errOrRef.GetError().What;
+  ASSERT_EQ( errOrRef.Get().Type, ClassFile::CPInfo::Type::Methodref );
+  ASSERT_EQ( errOrRef.Get().Owner, "java/io/PrintStream" );
+  ASSERT_EQ( errOrRef.Get().Name, cp.LookupString(index).Get() );
+  ASSERT_EQ( errOrRef.Get().Descriptor, cp.LookupDescriptor(index).Get() );
+
+  ASSERT_TRUE( cp.ResolveMemberRef(cf.ThisClass).IsError() );
+  ASSERT_TRUE( cp.ResolveMemberRef(0).IsError() );
+
+  //entries added or changed after the first lookup resolve as well
+  auto errOrField = cp.FindOrAddFieldref("Foo", "bar", "I");
+  ASSERT_TRUE( !errOrField.IsError() );
+  ASSERT_EQ( cp.ResolveMemberRef(errOrField.Get()).Get().Owner, "Foo" );
+
+  auto errOrNameAndType = cp.Get<ClassFile::FieldrefInfo>(errOrField.Get());
+  auto errOrName = cp.Mutate<ClassFile::NameAndTypeInfo>(errOrNameAndType.Get()->NameAndTypeIndex);
+  errOrName.Get()->NameIndex = cp.FindOrAddUTF8("baz").Get();
+  ASSERT_EQ( cp.ResolveMemberRef(errOrField.Get()).Get().Name, "baz" );
+}
+
+TEST_F(ConstantPoolTest, CompactRemovesUnreferencedEntries)
+{
+  ClassFile::ConstantPool& cp = cf.ConstPool;
+  ClassFile::U16 sizeBefore = cp.GetSize();
+
+  ASSERT_TRUE( !cp.FindOrAddMethodref("a/B", "unused", "()V").IsError() );
+  ASSERT_TRUE( !cp.FindOrAddLong(0, 42).IsError() );
+
+  auto errOrRemoved = ClassFile::Transform::CompactConstantPool(cf);
+  ASSERT_TRUE( !errOrRemoved.IsError() ) << errOrRemoved.GetError().What;
+
+  //javac output for HelloWorld has no unused constants to begin with
+  ASSERT_EQ( cp.GetSize(), sizeBefore );
+  //"a/B", its Class, "unused", NameAndType, Methodref & the 2 Long slots
+  ASSERT_EQ( errOrRemoved.Get(), 7 );
+  ASSERT_EQ( cp.LookupString(cf.ThisClass).Get(), "HelloWorld" );
+}
+
+TEST_F(ConstantPoolTest, CompactRejectsZeroIndices)
+{
+  //name_index is required, 0 isn't "no constant" here
+  cf.Methods[0].NameIndex = 0;
+  ClassFile::U16 sizeBefore = cf.ConstPool.GetSize();
+
+  auto errOrRemoved = ClassFile::Transform::CompactConstantPool(cf);
+  ASSERT_TRUE( errOrRemoved.IsError() );
+  ASSERT_NE( errOrRemoved.GetError().What.find("index 0"), std::string::npos )
+    << errOrRemoved.GetError().What;
+  ASSERT_EQ( cf.ConstPool.GetSize(), sizeBefore );
+}
+
+TEST(ConstantPoolCompactTest, CompactedClassRoundTrips)
+{
+  ClassFile::ClassFile cf = parseResource(RES_DIR"/Complex.class");
+
+  std::vector<std::string> methodNames;
+  for(const auto& method : cf.Methods)
+    methodNames.emplace_back(cf.ConstPool.LookupString(method.NameIndex).Get());
+
+  //make the last method unreachable, its constants should go away with it
+  cf.Methods.pop_back();
+  methodNames.pop_back();
+
+  ClassFile::U16 sizeBefore = cf.ConstPool.GetSize();
+
+  auto errOrRemoved = ClassFile::Transform::CompactConstantPool(cf);
+  ASSERT_TRUE( !errOrRemoved.IsError() ) << errOrRemoved.GetError().What;
+  ASSERT_GT( errOrRemoved.Get(), 0 );
+  ASSERT_EQ( cf.ConstPool.GetSize(), sizeBefore - errOrRemoved.Get() );
+
+  ClassFile::ClassFile reparsed = roundTrip(cf);
+
+  ASSERT_EQ( reparsed.ConstPool.GetSize(), cf.ConstPool.GetSize() );
+  ASSERT_EQ( reparsed.ConstPool.LookupString(reparsed.ThisClass).Get(), "com/runewild/loader/a" );
+  ASSERT_EQ( reparsed.Methods.size(), methodNames.size() );
+
+  for(size_t i = 0; i < methodNames.size(); i++)
+    ASSERT_EQ( reparsed.ConstPool.LookupString(reparsed.Methods[i].NameIndex).Get(), methodNames[i] );
+}
+
+static ClassFile::Fingerprint fingerprint(const ClassFile::ClassFile& cf, bool excludeDebugInfo = false)
+{
+  ClassFile::FingerprintOptions options;
+  options.ExcludeDebugInfo = excludeDebugInfo;
+
+  auto errOrFp = ClassFile::ComputeFingerprint(cf, options);
+  EXPECT_TRUE( !errOrFp.IsError() ) << errOrFp.GetError().What;
+
+  return errOrFp.GetOrElse({});
+}
+
+TEST_F(ConstantPoolTest, FingerprintIgnoresPoolLayout)
+{
+  ClassFile::Fingerprint before = fingerprint(cf);
+  ASSERT_EQ( fingerprint(roundTrip(cf)), before );
+
+  //an unused entry & a compaction move every entry of the pool
+  auto errOrIndex = cf.ConstPool.FindOrAddUTF8("unused");
+  ASSERT_TRUE( !errOrIndex.IsError() );
+  ASSERT_EQ( fingerprint(cf), before );
+
+  auto errOrFreed = ClassFile::Transform::CompactConstantPool(cf);
+  ASSERT_TRUE( !errOrFreed.IsError() ) << errOrFreed.GetError().What;
+  ASSERT_EQ( fingerprint(cf), before );
+
+  //changing a referenced value does change it
+  auto errOrString = cf.ConstPool.Mutate<ClassFile::UTF8Info>(
+      cf.ConstPool.FindOrAddUTF8("hello world").Get());
+  ASSERT_TRUE( !errOrString.IsError() );
+  errOrString.Get()->String = "hello there";
+  ASSERT_NE( fingerprint(cf), before );
+}
+
+TEST_F(ConstantPoolTest, FingerprintCanExcludeDebugInfo)
+{
+  ClassFile::Fingerprint full = fingerprint(cf);
+  ClassFile::Fingerprint noDebug = fingerprint(cf, true);
+  ASSERT_NE( full, noDebug );
+
+  cf.Attributes.clear(); //SourceFile
+  ASSERT_NE( fingerprint(cf), full );
+  ASSERT_EQ( fingerprint(cf, true), noDebug );
+
+  ASSERT_EQ( noDebug.ToString().size(), 32u );
+}
+
+TEST(FingerprintTest, ComplexClassRoundTrips)
+{
+  ClassFile::ClassFile cf = parseResource(RES_DIR"/Complex.class");
+  ASSERT_EQ( fingerprint(roundTrip(cf)), fingerprint(cf) );
+}
+
+TEST_F(ConstantPoolTest, StripsDebugAttributes)
+{
+  ClassFile::ShrinkStats stats;
+  auto result = ClassFile::Transform::Shrink(cf, {}, &stats);
+  ASSERT_TRUE( !result.IsError() ) << result.GetError().What;
+
+  //SourceFile & a LineNumberTable in each of the 2 methods
+  ASSERT_EQ( stats.AttributesRemoved, 3u );
+  //"SourceFile", "HelloWorld.java" & "LineNumberTable"
+  ASSERT_EQ( stats.ConstantsRemoved, 3u );
+  ASSERT_TRUE( cf.Attributes.empty() );
+
+  ClassFile::ClassFile reparsed = roundTrip(cf);
+
+  for(const auto& method : reparsed.Methods)
+  {
+    ASSERT_EQ( method.Attributes.size(), 1u );
+    ASSERT_EQ( method.Attributes[0]->GetType(), ClassFile::AttributeInfo::Type::Code );
+    ASSERT_TRUE( static_cast<const ClassFile::CodeAttribute&>(*method.Attributes[0]).Attributes.empty() );
+  }
+}
+
+TEST(ShrinkTest, ShrinksClasspath)
+{
+  namespace fs = std::filesystem;
+
+  fs::path out = fs::temp_directory_path() / "ClassFileTest" / "Shrink";
+  fs::remove_all(out);
+
+  ClassFile::ShrinkOptions options;
+  options.Threads = 2;
+  options.Strip.Names.push_back("StackMapTable"); //exercises stripping inside Code
+
+  auto errOrStats = ClassFile::Transform::ShrinkClasspath(RES_DIR, out.string(), options);
+  ASSERT_TRUE( !errOrStats.IsError() ) << errOrStats.GetError().What;
+
+  const ClassFile::ShrinkStats& stats = errOrStats.Get();
+  ASSERT_EQ( stats.Classes, 3u );
+  ASSERT_GT( stats.AttributesRemoved, 0u );
+  ASSERT_GT( stats.ConstantsRemoved, 0u );
+  ASSERT_LT( stats.BytesOut, stats.BytesIn );
+  ASSERT_EQ( fs::file_size(out / "HelloWorld.class") + fs::file_size(out / "Wide.class") +
+      fs::file_size(out / "Complex.class"), stats.BytesOut );
+
+  ClassFile::ClassFile cf = parseResource((out / "Complex.class").string().c_str());
+  ASSERT_EQ( cf.ConstPool.LookupString(cf.ThisClass).Get(), "com/runewild/loader/a" );
+}
@@ -2,10 +2,19 @@
 
 #include <ClassFile/ClassFile.hpp>
 #include <ClassFile/Parser.hpp>
+#include <ClassFile/Serializer.hpp>
+#include <ClassFile/Shrink.hpp>
+#include <ClassFile/Synthetic.hpp>
+#include <ClassFile/Transform.hpp>
+#include <ClassFile/FrozenClass.hpp>
+#include <ClassFile/Misc.hpp>
 #include <ClassFile/Error.hpp>
 
 #include <fstream>
 #include <iostream>
+#include <memory_resource>
+#include <sstream>
+#include <thread>
 
 #ifndef RES_DIR
   #define RES_DIR "res"
@@ -59,7 +68,7 @@ TEST_F(FileParseTest, SuccessfulParseWideInstr)
   ClassFile::ClassFile cf = errOrWideClass.Release();
 
   //find code
-  ClassFile::CodeAttribute* pCode;
+  const ClassFile::CodeAttribute* pCode;
   for(const auto& method : cf.Methods)
   {
     auto codeItr = 
@@ -68,7 +77,7 @@ TEST_F(FileParseTest, SuccessfulParseWideInstr)
           { return pAttr->GetType() == ClassFile::AttributeInfo::Type::Code;});
 
     pCode = codeItr == method.Attributes.end() ? nullptr :
-      static_cast<ClassFile::CodeAttribute*>((*codeItr).get());
+      static_cast<const ClassFile::CodeAttribute*>((*codeItr).get());
   }
 
   ASSERT_TRUE(pCode != nullptr);
@@ -98,3 +107,497 @@ TEST_F(FileParseTest, SuccessfulParseComplex)
     << "Parsing failed for complex valid class, error:\n" 
     << errOrComplexClass.GetError().What;
 }
+
+static std::string serialize(const ClassFile::ClassFile& cf)
+{
+  std::ostringstream os;
+  auto result = ClassFile::Serializer::SerializeClassFile(os, cf);
+  EXPECT_TRUE( !result.IsError() ) << result.GetError().What;
+  return os.str();
+}
+
+TEST(SyntheticTest, ShapesRoundTrip)
+{
+  using Shape = ClassFile::Synthetic::Shape;
+
+  for(Shape shape : {Shape::MaxConstantPool, Shape::MaxCode, Shape::ManyMembers,
+                     Shape::DeepAttributes, Shape::AllOpCodes})
+  {
+    auto errOrClass = ClassFile::Synthetic::Generate(ClassFile::Synthetic::GetPreset(shape, 7));
+    ASSERT_TRUE( !errOrClass.IsError() ) << errOrClass.GetError().What;
+
+    std::string bytes = serialize(errOrClass.Get());
+
+    std::istringstream is{bytes};
+    auto errOrParsed = ClassFile::Parser::ParseClassFile(is);
+    ASSERT_TRUE( !errOrParsed.IsError() ) << errOrParsed.GetError().What;
+    ASSERT_EQ( static_cast<size_t>(is.tellg()), bytes.size() );
+    ASSERT_EQ( serialize(errOrParsed.Get()), bytes );
+
+    //the same seed generates the same bytes
+    ASSERT_EQ( serialize(ClassFile::Synthetic::Generate(
+        ClassFile::Synthetic::GetPreset(shape, 7)).Get()), bytes );
+  }
+}
+
+TEST(SyntheticTest, ShapesReachTheLimits)
+{
+  using namespace ClassFile;
+
+  ClassFile::ClassFile pool = Synthetic::Generate(Synthetic::GetPreset(Synthetic::Shape::MaxConstantPool)).Release();
+  ASSERT_EQ( pool.ConstPool.GetCount(), 0xFFFF );
+
+  ClassFile::ClassFile code = Synthetic::Generate(Synthetic::GetPreset(Synthetic::Shape::MaxCode)).Release();
+  ASSERT_EQ( static_cast<const CodeAttribute&>(*code.Methods[0].Attributes[0]).GetLength() -
+      12, 0xFFFFu ); //max_stack, max_locals, code_length, the two empty tables
+
+  ClassFile::ClassFile members = Synthetic::Generate(Synthetic::GetPreset(Synthetic::Shape::ManyMembers)).Release();
+  ASSERT_EQ( members.Fields.size(), 5000u );
+  ASSERT_EQ( members.Methods.size(), 5000u );
+
+  //every opcode but the switches, wide & breakpoint, plus 12 wide forms
+  ClassFile::ClassFile ops = Synthetic::Generate(Synthetic::GetPreset(Synthetic::Shape::AllOpCodes)).Release();
+  const auto& opCode = static_cast<const CodeAttribute&>(*ops.Methods[0].Attributes[0]).Code;
+  ASSERT_EQ( opCode.size(), size_t{JSR_W + 1 - 3} + 12 + 1 );
+
+  //the nested annotation is walked when compacting the pool
+  ClassFile::ClassFile deep = Synthetic::Generate(Synthetic::GetPreset(Synthetic::Shape::DeepAttributes)).Release();
+  auto errOrFreed = Transform::CompactConstantPool(deep);
+  ASSERT_TRUE( !errOrFreed.IsError() ) << errOrFreed.GetError().What;
+  ASSERT_EQ( errOrFreed.Get(), 0 );
+
+  //nesting past the limit of the walk fails instead of overflowing the stack
+  SyntheticOptions hostile = Synthetic::GetPreset(Synthetic::Shape::DeepAttributes);
+  hostile.AnnotationDepth = 50000;
+  ClassFile::ClassFile deeper = Synthetic::Generate(hostile).Release();
+  ASSERT_TRUE( Transform::CompactConstantPool(deeper).IsError() );
+}
+
+TEST_F(FileParseTest, DescriptorViewsMatchDecodedTypes)
+{
+  using namespace ClassFile;
+
+  ASSERT_TRUE( !errOrComplexClass.IsError() );
+  const ClassFile::ClassFile& cf = errOrComplexClass.Get();
+
+  for(const FieldMethodInfo& method : cf.Methods)
+  {
+    std::string_view descriptor = cf.ConstPool.LookupString(method.DescriptorIndex).Get();
+
+    auto errOrDecoded = DecodeMethodDescriptor(descriptor);
+    auto errOrView = ViewMethodDescriptor(descriptor);
+    ASSERT_TRUE( !errOrDecoded.IsError() && !errOrView.IsError() ) << descriptor;
+
+    const MethodDescriptorView& view = errOrView.Get();
+    ASSERT_EQ( view.GetParameterCount(), errOrDecoded.Get().ParamTypes.size() );
+
+    size_t i = 0;
+    for(TypeView parameter : view)
+    {
+      ASSERT_EQ( errOrDecoded.Get().ParamTypes[i++], 
+          DecodeFieldDescriptor(parameter.Descriptor).Get() );
+    }
+    ASSERT_EQ( i, view.GetParameterCount() );
+  }
+
+  auto errOrView = ViewMethodDescriptor("(J[[Ljava/lang/String;DI)[B");
+  ASSERT_TRUE( !errOrView.IsError() );
+  ASSERT_EQ( errOrView.Get().GetParameterSlots(), 6u );
+  ASSERT_EQ( std::distance(errOrView.Get().begin(), errOrView.Get().end()), 4 );
+
+  TypeView second = *std::next(errOrView.Get().begin());
+  ASSERT_EQ( second.Dimensions, 2u );
+  ASSERT_EQ( second.ElementKind, TypeView::Kind::Object );
+  ASSERT_EQ( second.ClassName, "java/lang/String" );
+  ASSERT_EQ( second.GetSlots(), 1u );
+
+  const TypeView& returnType = errOrView.Get().GetReturnType();
+  ASSERT_TRUE( returnType.IsArray() );
+  ASSERT_EQ( returnType.ElementKind, TypeView::Kind::Byte );
+
+  ASSERT_EQ( ViewMethodDescriptor("()V").Get().GetReturnType().GetSlots(), 0u );
+  ASSERT_EQ( ViewFirstFieldDescriptor("JI").Get().Descriptor, "J" );
+
+  for(std::string_view invalid : {"(V)V", "(I", "(L;)V", "([)V", "()[V", "(I)VV", "I"})
+    ASSERT_TRUE( ViewMethodDescriptor(invalid).IsError() ) << invalid;
+
+  ASSERT_TRUE( ViewFieldDescriptor("V").IsError() );
+  ASSERT_TRUE( ViewFieldDescriptor("II").IsError() );
+  ASSERT_TRUE( ViewFieldDescriptor("Ljava/lang/Object").IsError() );
+}
+
+//A class with one UTF8 constant "A", no members & a single attribute named
+//"A" whose length field claims attrLen bytes, of which none follow
+static std::string hostileClass(ClassFile::U32 attrLen, ClassFile::U16 poolCount = 2)
+{
+  std::string bytes{"\xCA\xFE\xBA\xBE\x00\x00\x00\x34", 8};
+  auto u2 = [&](ClassFile::U16 v) { bytes += char(v >> 8); bytes += char(v & 0xFF); };
+
+  u2(poolCount);
+  bytes += '\x01'; u2(1); bytes += 'A';
+
+  u2(0x21); u2(0); u2(0); //access flags, this & super class
+  u2(0); u2(0); u2(0);    //interfaces, fields & methods
+  u2(1); u2(1);
+  u2(attrLen >> 16); u2(attrLen & 0xFFFF);
+
+  return bytes;
+}
+
+TEST(ParseLimitsTest, RejectsLengthsPastTheInput)
+{
+  using namespace ClassFile;
+
+  std::istringstream attr{hostileClass(0x7FFFFFFF)};
+  auto errOrClass = Parser::ParseClassFile(attr);
+  ASSERT_TRUE( errOrClass.IsError() );
+  ASSERT_NE( errOrClass.GetError().What.find("left in the input"), std::string::npos )
+    << errOrClass.GetError().What;
+
+  std::istringstream pool{hostileClass(0, 0xFFFF)};
+  errOrClass = Parser::ParseClassFile(pool);
+  ASSERT_TRUE( errOrClass.IsError() );
+  ASSERT_NE( errOrClass.GetError().What.find("constant pool"), std::string::npos )
+    << errOrClass.GetError().What;
+
+  std::istringstream valid{hostileClass(0)};
+  errOrClass = Parser::ParseClassFile(valid);
+  ASSERT_TRUE( !errOrClass.IsError() ) << errOrClass.GetError().What;
+}
+
+//Input that can't seek, like a pipe
+struct unseekableBuf : public std::streambuf
+{
+  explicit unseekableBuf(std::string& bytes)
+  {
+    setg(bytes.data(), bytes.data(), bytes.data() + bytes.size());
+  }
+};
+
+TEST(ParseLimitsTest, ReadsUncheckedLengthsInChunks)
+{
+  using namespace ClassFile;
+
+  std::string hostile = hostileClass(0x7FFFFFFF);
+  unseekableBuf hostileBuf{hostile};
+  std::istream attr{&hostileBuf};
+
+  auto errOrClass = Parser::ParseClassFile(attr);
+  ASSERT_TRUE( errOrClass.IsError() );
+  ASSERT_NE( errOrClass.GetError().What.find("input ended after 0"), std::string::npos )
+    << errOrClass.GetError().What;
+
+  //more than a chunk arrives, but less than claimed
+  std::string cut = hostileClass(200000) + std::string(100000, 'x');
+  unseekableBuf cutBuf{cut};
+  std::istream cutStream{&cutBuf};
+
+  errOrClass = Parser::ParseClassFile(cutStream);
+  ASSERT_TRUE( errOrClass.IsError() );
+  ASSERT_NE( errOrClass.GetError().What.find("input ended after 100000"), std::string::npos )
+    << errOrClass.GetError().What;
+
+  std::string valid = hostileClass(100000) + std::string(100000, 'x');
+  unseekableBuf validBuf{valid};
+  std::istream validStream{&validBuf};
+
+  errOrClass = Parser::ParseClassFile(validStream);
+  ASSERT_TRUE( !errOrClass.IsError() ) << errOrClass.GetError().What;
+  ASSERT_EQ( serialize(errOrClass.Get()), valid );
+}
+
+TEST(ParseLimitsTest, EnforcesBudgetAndNesting)
+{
+  using namespace ClassFile;
+
+  auto parse = [](const Parser::ParseOptions& options)
+  {
+    std::ifstream is{RES_DIR"/Complex.class", std::ios::binary};
+    return Parser::ParseClassFile(is, options);
+  };
+
+  Parser::ParseOptions options;
+  ASSERT_TRUE( !parse(options).IsError() );
+
+  options.MaxAllocatedBytes = 1024;
+  auto errOrClass = parse(options);
+  ASSERT_TRUE( errOrClass.IsError() );
+  ASSERT_NE( errOrClass.GetError().What.find("allocation limit"), std::string::npos )
+    << errOrClass.GetError().What;
+
+  options.MaxAllocatedBytes = 1 << 20;
+  ASSERT_TRUE( !parse(options).IsError() );
+
+  //the Code attributes have a LineNumberTable
+  options.MaxNestingDepth = 1;
+  errOrClass = parse(options);
+  ASSERT_TRUE( errOrClass.IsError() );
+  ASSERT_NE( errOrClass.GetError().What.find("nested"), std::string::npos )
+    << errOrClass.GetError().What;
+
+  options.MaxNestingDepth = 2;
+  ASSERT_TRUE( !parse(options).IsError() );
+}
+
+TEST(ParseStatsTest, AggregatesAcrossThreads)
+{
+  using namespace ClassFile;
+
+  std::ifstream is{RES_DIR"/HelloWorld.class", std::ios::binary};
+  std::string bytes{std::istreambuf_iterator<char>{is}, {}};
+
+  auto errOrClass = [&]{ std::istringstream in{bytes}; return Parser::ParseClassFile(in); }();
+  ASSERT_TRUE( !errOrClass.IsError() ) << errOrClass.GetError().What;
+  const ClassFile::ClassFile& cf = errOrClass.Get();
+
+  Parser::ParseStats stats;
+  Parser::ParseOptions options;
+  options.Stats = &stats;
+
+  constexpr int nThreads = 4;
+  std::vector<std::thread> threads;
+
+  for(int t = 0; t < nThreads; t++)
+  {
+    threads.emplace_back([&]
+    {
+      std::istringstream in{bytes};
+      EXPECT_TRUE( !Parser::ParseClassFile(in, options).IsError() );
+    });
+  }
+
+  for(auto& thread : threads)
+    thread.join();
+
+  ASSERT_EQ( stats.Classes, U64{nThreads} );
+  ASSERT_EQ( stats.Constants[static_cast<U8>(CPInfo::Type::UTF8)] % nThreads, 0u );
+  ASSERT_GT( stats.Constants[static_cast<U8>(CPInfo::Type::UTF8)], 0u );
+
+  size_t nInstructions = 0;
+  size_t codeBytes = 0;
+
+  for(const FieldMethodInfo& method : cf.Methods)
+  {
+    const auto& code = static_cast<const CodeAttribute&>(*method.Attributes[0]);
+    nInstructions += code.Code.size();
+    codeBytes += code.GetLength() + 6;
+  }
+
+  U64 nOpCodes = 0;
+  for(const auto& count : stats.OpCodes)
+    nOpCodes += count;
+
+  ASSERT_EQ( nOpCodes, nInstructions * nThreads );
+  ASSERT_EQ( stats.Attributes[static_cast<size_t>(AttributeInfo::Type::Code)].Bytes,
+      codeBytes * nThreads );
+  ASSERT_LT( stats.Instructions.Bytes, stats.Members.Bytes );
+  ASSERT_EQ( stats.ConstantPool.Bytes % nThreads, 0u );
+  ASSERT_GT( stats.Allocations, 0u );
+  ASSERT_EQ( stats.UnknownAttributes, 0u );
+}
+
+//Counts what's allocated through it, forwarding to the default resource
+class CountingResource : public std::pmr::memory_resource
+{
+  public:
+    size_t Allocations{0};
+    size_t Bytes{0};
+
+  private:
+    void* do_allocate(size_t bytes, size_t alignment) override
+    {
+      Allocations++;
+      Bytes += bytes;
+      return std::pmr::get_default_resource()->allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void* p, size_t bytes, size_t alignment) override
+    {
+      std::pmr::get_default_resource()->deallocate(p, bytes, alignment);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+    {
+      return this == &other;
+    }
+};
+
+TEST(ParseResourceTest, AllocatesModelFromResource)
+{
+  using namespace ClassFile;
+
+  std::ifstream is{RES_DIR"/Complex.class", std::ios::binary};
+  std::string bytes{std::istreambuf_iterator<char>{is}, {}};
+
+  CountingResource counting;
+  Parser::ParseOptions options;
+  options.Resource = &counting;
+
+  {
+    std::istringstream in{bytes};
+    auto errOrClass = Parser::ParseClassFile(in, options);
+    ASSERT_TRUE( !errOrClass.IsError() ) << errOrClass.GetError().What;
+
+    const ClassFile::ClassFile& cf = errOrClass.Get();
+    ASSERT_EQ( cf.ConstPool.GetResource(), &counting );
+    ASSERT_EQ( cf.Methods.get_allocator().resource(), &counting );
+    ASSERT_EQ( cf.Methods[0].Attributes.get_allocator().resource(), &counting );
+
+    const auto& code = static_cast<const CodeAttribute&>(*cf.Methods[0].Attributes[0]);
+    ASSERT_EQ( code.Code.get_allocator().resource(), &counting );
+
+    ASSERT_GT( counting.Allocations, 0u );
+    ASSERT_EQ( serialize(cf), bytes );
+  }
+
+  //a monotonic buffer that never falls back to the heap
+  std::vector<std::byte> buffer(1 << 20);
+  std::pmr::monotonic_buffer_resource monotonic{buffer.data(), buffer.size(),
+    std::pmr::null_memory_resource()};
+  options.Resource = &monotonic;
+
+  std::istringstream in{bytes};
+  auto errOrClass = Parser::ParseClassFile(in, options);
+  ASSERT_TRUE( !errOrClass.IsError() ) << errOrClass.GetError().What;
+  ASSERT_EQ( serialize(errOrClass.Get()), bytes );
+}
+
+TEST_F(FileParseTest, CloneSharesUntilMutated)
+{
+  ASSERT_TRUE( !errOrComplexClass.IsError() );
+  const ClassFile::ClassFile& original = errOrComplexClass.Get();
+  std::string bytes = serialize(original);
+
+  ClassFile::ClassFile clone = original.Clone();
+  ASSERT_TRUE( clone.Methods[0].Attributes[0].IsShared() );
+  ASSERT_EQ( clone.Methods[0].Attributes[0].get(), original.Methods[0].Attributes[0].get() );
+  ASSERT_EQ( serialize(clone), bytes );
+
+  //shrinking the clone rewrites its attributes & constants, the original
+  //keeps its own
+  auto result = ClassFile::Transform::Shrink(clone);
+  ASSERT_TRUE( !result.IsError() ) << result.GetError().What;
+  ASSERT_LT( serialize(clone).size(), bytes.size() );
+  ASSERT_EQ( serialize(original), bytes );
+
+  ClassFile::ClassFile second = original.Clone();
+  auto errOrIndex = second.ConstPool.FindOrAddUTF8("Code");
+  ASSERT_TRUE( !errOrIndex.IsError() );
+
+  auto errOrString = second.ConstPool.Mutate<ClassFile::UTF8Info>(errOrIndex.Get());
+  ASSERT_TRUE( !errOrString.IsError() );
+  errOrString.Get()->String = "Edoc";
+  ASSERT_EQ( original.ConstPool.LookupString(errOrIndex.Get()).Get(), "Code" );
+  ASSERT_EQ( second.ConstPool.LookupString(errOrIndex.Get()).Get(), "Edoc" );
+  ASSERT_EQ( serialize(original), bytes );
+}
+
+//meant to be run under ThreadSanitizer (SANITIZE_THREAD) as well
+TEST_F(FileParseTest, FrozenClassIsSafeToShare)
+{
+  using namespace ClassFile;
+
+  ASSERT_TRUE( !errOrComplexClass.IsError() );
+  auto frozen = FrozenClass::Freeze(errOrComplexClass.Release());
+  std::string bytes = serialize(**frozen);
+
+  auto errOrExpected = ComputeFingerprint(**frozen);
+  ASSERT_TRUE( !errOrExpected.IsError() );
+  Fingerprint expected = errOrExpected.Get();
+
+  constexpr int nThreads = 8;
+  constexpr int nIterations = 20;
+  std::vector<std::thread> threads;
+
+  for(int t = 0; t < nThreads; t++)
+  {
+    threads.emplace_back([&]
+    {
+      for(int i = 0; i < nIterations; i++)
+      {
+        const ClassFile::ClassFile& cf = frozen->Get();
+
+        for(const FieldMethodInfo& method : cf.Methods)
+        {
+          auto errOrName = cf.ConstPool.LookupString(method.NameIndex);
+          auto errOrDescriptor = cf.ConstPool.LookupString(method.DescriptorIndex);
+          ASSERT_TRUE( !errOrName.IsError() && !errOrDescriptor.IsError() );
+          EXPECT_EQ( cf.FindMethod(errOrName.Get(), errOrDescriptor.Get()), &method );
+        }
+
+        for(U16 index = 1; index <= cf.ConstPool.GetSize(); index++)
+        {
+          const CPInfo* info = cf.ConstPool[index];
+          if(info && info->GetType() == CPInfo::Type::Methodref)
+          {
+            EXPECT_TRUE( !cf.ConstPool.ResolveMemberRef(index).IsError() );
+          }
+        }
+
+        auto errOrFingerprint = frozen->GetFingerprint();
+        EXPECT_TRUE( !errOrFingerprint.IsError() && errOrFingerprint.Get() == expected );
+
+        //every thread rewrites its own copy while the others read
+        ClassFile::ClassFile thawed = frozen->Thaw();
+        EXPECT_TRUE( !Transform::Shrink(thawed).IsError() );
+        EXPECT_LT( serialize(thawed).size(), bytes.size() );
+        EXPECT_EQ( serialize(cf), bytes );
+      }
+    });
+  }
+
+  for(auto& thread : threads)
+    thread.join();
+
+  ASSERT_EQ( serialize(**frozen), bytes );
+}
+
+TEST_F(FileParseTest, FindsMembersByNameAndDescriptor)
+{
+  using namespace ClassFile;
+
+  ASSERT_TRUE( !errOrComplexClass.IsError() );
+  ClassFile::ClassFile& cf = errOrComplexClass.Get();
+  const ConstantPool& cp = cf.ConstPool;
+
+  for(auto* list : {&cf.Fields, &cf.Methods})
+  {
+    for(const FieldMethodInfo& member : *list)
+    {
+      std::string_view name = cp.LookupString(member.NameIndex).Get();
+      std::string_view descriptor = cp.LookupString(member.DescriptorIndex).Get();
+
+      const FieldMethodInfo* found = list == &cf.Fields ? 
+        cf.FindField(name, descriptor) : cf.FindMethod(name, descriptor);
+      ASSERT_EQ( found, &member ) << name << descriptor;
+    }
+  }
+
+  ASSERT_EQ( cf.FindMethod("missing", "()V"), nullptr );
+  ASSERT_EQ( cf.FindField("<init>", "()V"), nullptr );
+
+  //members added after the index was built are found as well
+  FieldMethodInfo added{cf.Methods.get_allocator().resource()};
+  added.AccessFlags = 0;
+  added.NameIndex = cf.ConstPool.FindOrAddUTF8("added").Get();
+  added.DescriptorIndex = cf.ConstPool.FindOrAddUTF8("()V").Get();
+  FieldMethodInfo copy = added;
+
+  FieldMethodInfo* appended = &cf.AddMethod(std::move(added));
+  ASSERT_EQ( cf.FindMethod("added", "()V"), appended );
+
+  cf.RemoveMethod(cf.Methods.size() - 1);
+  ASSERT_EQ( cf.FindMethod("added", "()V"), nullptr );
+
+  //replacing a member leaves the size & storage of the list as they were
+  cf.RemoveMethod(0);
+  cf.AddMethod(std::move(copy));
+  ASSERT_EQ( cf.FindMethod("added", "()V"), &cf.Methods.back() );
+
+  //a copy builds its own index
+  ClassFile::ClassFile clone = cf.Clone();
+  const FieldMethodInfo& last = cf.Methods.back();
+  std::string_view name = cp.LookupString(last.NameIndex).Get();
+  std::string_view descriptor = cp.LookupString(last.DescriptorIndex).Get();
+  ASSERT_EQ( clone.FindMethod(name, descriptor), &clone.Methods.back() );
+}
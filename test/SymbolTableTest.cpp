@@ -0,0 +1,217 @@
+#include <gtest/gtest.h>
+
+#include <ClassFile/ClassFile.hpp>
+#include <ClassFile/Parser.hpp>
+#include <ClassFile/SymbolTable.hpp>
+#include <ClassFile/TypeTable.hpp>
+
+#include <fstream>
+#include <optional>
+#include <thread>
+#include <string>
+#include <vector>
+
+#ifndef RES_DIR
+  #define RES_DIR "res"
+#endif
+
+TEST(SymbolTableTest, InternReturnsSameSymbol)
+{
+  ClassFile::SymbolTable table{4};
+
+  const ClassFile::Symbol* a = table.Intern("java/lang/Object");
+  const ClassFile::Symbol* b = table.Intern(std::string{"java/lang/"} + "Object");
+
+  ASSERT_EQ( a, b );
+  ASSERT_EQ( a->GetString(), "java/lang/Object" );
+  ASSERT_NE( table.Intern("()V"), a );
+  ASSERT_EQ( table.Find("()V"), table.Intern("()V") );
+  ASSERT_EQ( table.Find("missing"), nullptr );
+  ASSERT_EQ( table.GetCount(), 2u );
+}
+
+TEST(SymbolTableTest, ConcurrentInternAgrees)
+{
+  //few buckets so that threads race on the same chains
+  ClassFile::SymbolTable table{16};
+
+  constexpr size_t nThreads = 8;
+  constexpr size_t nSymbols = 2000;
+
+  std::vector< std::vector<const ClassFile::Symbol*> > results(nThreads);
+  std::vector<std::thread> threads;
+
+  for(size_t t = 0; t < nThreads; t++)
+  {
+    threads.emplace_back([&, t]
+    {
+      for(size_t i = 0; i < nSymbols; i++)
+        results[t].push_back(table.Intern("sym" + std::to_string(i)));
+    });
+  }
+
+  for(auto& thread : threads)
+    thread.join();
+
+  ASSERT_EQ( table.GetCount(), nSymbols );
+
+  for(size_t t = 1; t < nThreads; t++)
+    ASSERT_EQ( results[t], results[0] );
+}
+
+TEST(SymbolTableTest, ParsedClassesShareStrings)
+{
+  ClassFile::SymbolTable table;
+  ClassFile::Parser::ParseOptions options;
+  options.Symbols = &table;
+
+  std::ifstream first{RES_DIR"/HelloWorld.class"};
+  std::ifstream second{RES_DIR"/Wide.class"};
+
+  auto errOrFirst = ClassFile::Parser::ParseClassFile(first, options);
+  auto errOrSecond = ClassFile::Parser::ParseClassFile(second, options);
+
+  ASSERT_TRUE( !errOrFirst.IsError() ) << errOrFirst.GetError().What;
+  ASSERT_TRUE( !errOrSecond.IsError() ) << errOrSecond.GetError().What;
+
+  auto superName = [](ClassFile::ClassFile& cf)
+  {
+    auto* pClass = cf.ConstPool.Get<ClassFile::ClassInfo>(cf.SuperClass).Get();
+    return cf.ConstPool.Get<ClassFile::UTF8Info>(pClass->NameIndex).Get()->Interned;
+  };
+
+  ASSERT_NE( superName(errOrFirst.Get()), nullptr );
+  ASSERT_EQ( superName(errOrFirst.Get()), superName(errOrSecond.Get()) );
+  ASSERT_EQ( superName(errOrFirst.Get()), table.Find("java/lang/Object") );
+
+  //a mutated entry owns its value, the symbol doesn't hide the write
+  ClassFile::ClassFile& cf = errOrFirst.Get();
+  ClassFile::ClassFile clone = cf.Clone();
+  ClassFile::U16 name = cf.ConstPool.Get<ClassFile::ClassInfo>(cf.SuperClass).Get()->NameIndex;
+
+  auto errOrName = cf.ConstPool.Mutate<ClassFile::UTF8Info>(name);
+  ASSERT_TRUE( !errOrName.IsError() );
+  ASSERT_EQ( errOrName.Get()->Interned, nullptr );
+  ASSERT_EQ( errOrName.Get()->String, "java/lang/Object" );
+
+  errOrName.Get()->String = "java/lang/Base";
+  ASSERT_EQ( cf.ConstPool.LookupString(name).Get(), "java/lang/Base" );
+  ASSERT_EQ( clone.ConstPool.LookupString(name).Get(), "java/lang/Object" );
+  ASSERT_EQ( superName(clone), table.Find("java/lang/Object") );
+}
+
+TEST(TypeTableTest, SharesTypesStructurally)
+{
+  using ClassFile::TypeTable;
+
+  ClassFile::SymbolTable symbols;
+  TypeTable types{symbols};
+
+  auto errOrMethod = types.Intern("(I[[Ljava/lang/String;J)[Ljava/lang/String;");
+  ASSERT_TRUE( !errOrMethod.IsError() ) << errOrMethod.GetError().What;
+  TypeTable::TypeId method = errOrMethod.Get();
+
+  ASSERT_EQ( types.GetKind(method), TypeTable::Kind::Method );
+  ASSERT_EQ( types.GetParameterSlots(method), 4u );
+  ASSERT_EQ( types.GetParameters(method).size(), 3u );
+
+  TypeTable::TypeId param0 = types.GetParameters(method).begin()[0];
+  TypeTable::TypeId param1 = types.GetParameters(method).begin()[1];
+  ASSERT_EQ( param0, TypeTable::GetPrimitive(TypeTable::Kind::Int) );
+
+  //String[][] is built on String[], which is the return type
+  TypeTable::TypeId returnType = types.GetReturnType(method);
+  ASSERT_EQ( types.GetKind(param1), TypeTable::Kind::Array );
+  ASSERT_EQ( types.GetComponent(param1), returnType );
+  ASSERT_EQ( types.GetDimensions(param1), 2u );
+  ASSERT_EQ( types.GetElement(param1), types.GetComponent(returnType) );
+  ASSERT_EQ( types.GetClassName(param1), symbols.Intern("java/lang/String") );
+  ASSERT_EQ( types.InternArray(returnType).Get(), param1 );
+  ASSERT_EQ( types.Find("Ljava/lang/String;"), types.GetElement(param1) );
+
+  //interning again finds the same ids
+  size_t count = types.GetCount();
+  ASSERT_EQ( types.Intern("(I[[Ljava/lang/String;J)[Ljava/lang/String;").Get(), method );
+  ASSERT_EQ( types.Intern("J").Get(), TypeTable::GetPrimitive(TypeTable::Kind::Long) );
+  ASSERT_EQ( types.GetSlots(TypeTable::GetPrimitive(TypeTable::Kind::Double)), 2u );
+  ASSERT_EQ( TypeTable::GetPrimitive(TypeTable::Kind::Void), types.Find("V") );
+  ASSERT_EQ( TypeTable::GetPrimitive(TypeTable::Kind::Object), TypeTable::InvalidId );
+  ASSERT_EQ( TypeTable::GetPrimitive(TypeTable::Kind::Method), TypeTable::InvalidId );
+  ASSERT_EQ( types.GetCount(), count );
+
+  ASSERT_TRUE( types.Intern("(V)V").IsError() );
+  ASSERT_TRUE( types.Intern("Ljava/lang/String").IsError() );
+  ASSERT_TRUE( types.InternArray(types.GetReturnType(types.Intern("()V").Get())).IsError() );
+  ASSERT_EQ( types.Find("Lmissing;"), TypeTable::InvalidId );
+}
+
+TEST(TypeTableTest, ConstantPoolCachesTypes)
+{
+  using ClassFile::TypeTable;
+
+  std::ifstream is{RES_DIR"/Complex.class", std::ios::binary};
+  auto errOrClass = ClassFile::Parser::ParseClassFile(is);
+  ASSERT_TRUE( !errOrClass.IsError() ) << errOrClass.GetError().What;
+  const ClassFile::ClassFile& cf = errOrClass.Get();
+
+  TypeTable types;
+  constexpr int nThreads = 4;
+  std::vector< std::vector<TypeTable::TypeId> > ids(nThreads);
+  std::vector<std::thread> threads;
+
+  for(int t = 0; t < nThreads; t++)
+  {
+    threads.emplace_back([&, t]
+    {
+      for(const ClassFile::FieldMethodInfo& method : cf.Methods)
+      {
+        auto errOrType = cf.ConstPool.LookupType(method.DescriptorIndex, types);
+        EXPECT_TRUE( !errOrType.IsError() );
+        ids[t].push_back(errOrType.IsError() ? TypeTable::InvalidId : errOrType.Get());
+      }
+    });
+  }
+
+  for(auto& thread : threads)
+    thread.join();
+
+  for(int t = 1; t < nThreads; t++)
+    ASSERT_EQ( ids[t], ids[0] );
+
+  for(size_t i = 0; i < cf.Methods.size(); i++)
+  {
+    auto descriptor = cf.ConstPool.LookupString(cf.Methods[i].DescriptorIndex).Get();
+    ASSERT_EQ( types.GetDescriptor(ids[0][i])->GetString(), descriptor );
+    ASSERT_EQ( types.GetKind(ids[0][i]), TypeTable::Kind::Method );
+  }
+
+  auto errOrThis = cf.ConstPool.LookupType(cf.ThisClass, types);
+  ASSERT_TRUE( !errOrThis.IsError() );
+  ASSERT_EQ( types.GetKind(errOrThis.Get()), TypeTable::Kind::Object );
+  ASSERT_EQ( types.GetClassName(errOrThis.Get())->GetString(),
+      cf.ConstPool.LookupString(cf.ThisClass).Get() );
+}
+
+TEST(TypeTableTest, ConstantPoolCacheOutlivesTable)
+{
+  using ClassFile::TypeTable;
+
+  std::ifstream is{RES_DIR"/Complex.class", std::ios::binary};
+  auto errOrClass = ClassFile::Parser::ParseClassFile(is);
+  ASSERT_TRUE( !errOrClass.IsError() ) << errOrClass.GetError().What;
+  const ClassFile::ClassFile& cf = errOrClass.Get();
+  ClassFile::U16 index = cf.Methods.back().DescriptorIndex;
+
+  //the second table lives at the same address but hands out other ids
+  std::optional<TypeTable> types{std::in_place};
+  ASSERT_TRUE( !cf.ConstPool.LookupType(index, *types).IsError() );
+
+  types.emplace();
+  ASSERT_TRUE( !types->Intern("Lfirst;").IsError() );
+  ASSERT_TRUE( !types->Intern("[[Lsecond;").IsError() );
+
+  auto errOrType = cf.ConstPool.LookupType(index, *types);
+  ASSERT_TRUE( !errOrType.IsError() );
+  ASSERT_EQ( types->GetDescriptor(errOrType.Get())->GetString(),
+      cf.ConstPool.LookupString(index).Get() );
+}